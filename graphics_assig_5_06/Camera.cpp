@@ -28,15 +28,7 @@ void Camera::rotateHorizontal(float radians)
 
 void Camera::zoom(vec3 movement)
 {
-    if (radius <= 2 && movement.z > 0) {
-        radius == 2.f;
-    } else if (radius >= 10 && movement.z < 0) {
-        radius == 10.f;
-    } else {
-        radius -= movement.z;
-    }
-    
-	pos += movement.z*dir;
+    radius = clamp(radius - movement.z, minRadius, 10.f);
     updateCamera();
 }
 
@@ -0,0 +1,194 @@
+//
+//  Ephemeris.cpp
+//  graphics_assig_5_06
+//
+
+#include <cmath>
+#include <algorithm>
+
+#include "Ephemeris.h"
+#include "ThreadPool.h"
+
+using namespace std;
+using namespace glm;
+
+static const double PI_D = 3.14159265358979323846;
+static const double TWO_PI_D = 2.0*PI_D;
+static const double HALF_PI_D = 0.5*PI_D;
+
+// Newton steps used by the batch solver; from Danby's starting guess this
+// converges to double precision for e < 0.95
+static const int KEPLER_ITERATIONS = 8;
+
+// bodies per parallel chunk in Ephemeris::evaluate
+static const int EVALUATE_GRAIN = 4096;
+
+// --------------------------------------------------------------------------
+// Branch-free sine/cosine so the batch loops vectorise (libm calls do not)
+
+static inline double WrapPi(double x)
+{
+    return x - TWO_PI_D*floor((x + PI_D)/TWO_PI_D);
+}
+
+// x in [-pi, pi]; folded into [-pi/2, pi/2], then a degree-17 Taylor
+// polynomial whose truncation error there is below 1e-13
+static inline double SinReduced(double x)
+{
+    x = (x > HALF_PI_D) ? PI_D - x : x;
+    x = (x < -HALF_PI_D) ? -PI_D - x : x;
+    double x2 = x*x;
+    double p = 1.0/355687428096000.0;
+    p = p*x2 - 1.0/1307674368000.0;
+    p = p*x2 + 1.0/6227020800.0;
+    p = p*x2 - 1.0/39916800.0;
+    p = p*x2 + 1.0/362880.0;
+    p = p*x2 - 1.0/5040.0;
+    p = p*x2 + 1.0/120.0;
+    p = p*x2 - 1.0/6.0;
+    p = p*x2 + 1.0;
+    return p*x;
+}
+
+static inline double FastSin(double x)
+{
+    return SinReduced(WrapPi(x));
+}
+
+static inline double FastCos(double x)
+{
+    return SinReduced(WrapPi(x + HALF_PI_D));
+}
+
+// --------------------------------------------------------------------------
+// Kepler's equation
+
+// M in [-pi, pi); stays on the correct side of the root for any e < 1
+static inline double DanbyGuess(double M, double e)
+{
+    return M + 0.85*e*((M >= 0.0) ? 1.0 : -1.0);
+}
+
+double SolveKepler(double meanAnomaly, double eccentricity)
+{
+    double M = WrapPi(meanAnomaly);
+    double E = DanbyGuess(M, eccentricity);
+    for (int i = 0; i < 50; i++) {
+        double delta = (E - eccentricity*sin(E) - M)/(1.0 - eccentricity*cos(E));
+        E -= delta;
+        if (fabs(delta) < 1e-14)
+            break;
+    }
+    return E;
+}
+
+void SolveKeplerBatch(const double *meanAnomaly, const double *eccentricity, double *eccentricAnomaly, int count)
+{
+    for (int i = 0; i < count; i++) {
+        double M = WrapPi(meanAnomaly[i]);
+        double e = eccentricity[i];
+        double E = DanbyGuess(M, e);
+        for (int step = 0; step < KEPLER_ITERATIONS; step++)
+            E -= (E - e*FastSin(E) - M)/(1.0 - e*FastCos(E));
+        eccentricAnomaly[i] = E;
+    }
+}
+
+// perifocal basis: P toward periapsis, Q 90 degrees ahead in the orbit
+// plane; computed in the textbook frame (Z = orbit normal) and mapped to the
+// scene with (x, y, z) -> (x, z, -y) so orbits run counter-clockwise about +Y
+static void PerifocalBasis(const OrbitalElements &elements, dvec3 &P, dvec3 &Q)
+{
+    double cO = cos(elements.ascendingNode), sO = sin(elements.ascendingNode);
+    double cw = cos(elements.argumentOfPeriapsis), sw = sin(elements.argumentOfPeriapsis);
+    double ci = cos(elements.inclination), si = sin(elements.inclination);
+
+    dvec3 p(cO*cw - sO*sw*ci, sO*cw + cO*sw*ci, sw*si);
+    dvec3 q(-cO*sw - sO*cw*ci, -sO*sw + cO*cw*ci, cw*si);
+
+    P = dvec3(p.x, p.z, -p.y);
+    Q = dvec3(q.x, q.z, -q.y);
+}
+
+// mean anomaly with the whole revolutions removed before scaling by 2pi, so
+// precision does not degrade for large t
+static inline double MeanAnomalyAt(double meanAnomalyAtEpoch, double period, double t)
+{
+    double revolutions = t/period;
+    return meanAnomalyAtEpoch + TWO_PI_D*(revolutions - floor(revolutions));
+}
+
+dvec3 OrbitPosition(const OrbitalElements &elements, double t)
+{
+    dvec3 P, Q;
+    PerifocalBasis(elements, P, Q);
+
+    double e = elements.eccentricity;
+    double E = SolveKepler(MeanAnomalyAt(elements.meanAnomalyAtEpoch, elements.period, t), e);
+    double a = elements.semiMajorAxis;
+    double b = a*sqrt(1.0 - e*e);
+    return P*(a*(cos(E) - e)) + Q*(b*sin(E));
+}
+
+double SpinAngle(double period, double t, double phase)
+{
+    double revolutions = t/period;
+    double angle = phase + TWO_PI_D*(revolutions - floor(revolutions));
+    return angle - TWO_PI_D*floor(angle/TWO_PI_D);
+}
+
+// --------------------------------------------------------------------------
+// Ephemeris
+
+Ephemeris :: Ephemeris()
+{}
+
+int Ephemeris :: addBody(const OrbitalElements &elements)
+{
+    dvec3 P, Q;
+    PerifocalBasis(elements, P, Q);
+
+    double e = elements.eccentricity;
+    meanAnomalyAtEpoch.push_back(elements.meanAnomalyAtEpoch);
+    period.push_back(elements.period);
+    eccentricity.push_back(e);
+    semiMajorAxis.push_back(elements.semiMajorAxis);
+    semiMinorAxis.push_back(elements.semiMajorAxis*sqrt(1.0 - e*e));
+    perifocalPX.push_back(P.x); perifocalPY.push_back(P.y); perifocalPZ.push_back(P.z);
+    perifocalQX.push_back(Q.x); perifocalQY.push_back(Q.y); perifocalQZ.push_back(Q.z);
+
+    positionX.push_back(0.0); positionY.push_back(0.0); positionZ.push_back(0.0);
+    meanAnomaly.push_back(0.0);
+    eccentricAnomaly.push_back(0.0);
+
+    return (int)period.size() - 1;
+}
+
+void Ephemeris :: evaluate(double t)
+{
+    ParallelFor(0, bodyCount(), EVALUATE_GRAIN, [this, t](int begin, int end) {
+        for (int i = begin; i < end; i++)
+            meanAnomaly[i] = MeanAnomalyAt(meanAnomalyAtEpoch[i], period[i], t);
+
+        SolveKeplerBatch(&meanAnomaly[begin], &eccentricity[begin], &eccentricAnomaly[begin], end - begin);
+
+        for (int i = begin; i < end; i++) {
+            double E = eccentricAnomaly[i];
+            double x = semiMajorAxis[i]*(FastCos(E) - eccentricity[i]);
+            double y = semiMinorAxis[i]*FastSin(E);
+            positionX[i] = perifocalPX[i]*x + perifocalQX[i]*y;
+            positionY[i] = perifocalPY[i]*x + perifocalQY[i]*y;
+            positionZ[i] = perifocalPZ[i]*x + perifocalQZ[i]*y;
+        }
+    });
+}
+
+dvec3 Ephemeris :: getPosition(int body) const
+{
+    return dvec3(positionX[body], positionY[body], positionZ[body]);
+}
+
+int Ephemeris :: bodyCount() const
+{
+    return (int)period.size();
+}
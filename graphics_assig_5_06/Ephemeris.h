@@ -0,0 +1,71 @@
+//
+//  Ephemeris.h
+//  graphics_assig_5_06
+//
+//  Closed-form body positions from Keplerian orbital elements. Positions
+//  are evaluated directly at any simulation time t, so there is no drift
+//  from accumulating per-frame rotations and seeking costs the same as
+//  stepping. Orbits lie in the scene's XZ plane (+Y is the orbit normal)
+//  before inclination is applied.
+//
+
+#ifndef Ephemeris_h
+#define Ephemeris_h
+
+#include <vector>
+#include <glm/glm.hpp>
+
+using namespace glm;
+using namespace std;
+
+struct OrbitalElements
+{
+    double semiMajorAxis = 1.0;         // scene units
+    double eccentricity = 0.0;
+    double inclination = 0.0;           // radians, tilted about the scene X axis
+    double ascendingNode = 0.0;         // radians
+    double argumentOfPeriapsis = 0.0;   // radians
+    double meanAnomalyAtEpoch = 0.0;    // radians at t = 0
+    double period = 1.0;                // simulation seconds per revolution
+};
+
+// eccentric anomaly E solving M = E - e sin(E)
+double SolveKepler(double meanAnomaly, double eccentricity);
+
+// batch form of SolveKepler: a fixed number of branch-free Newton steps so
+// the loop vectorises across bodies
+void SolveKeplerBatch(const double *meanAnomaly, const double *eccentricity, double *eccentricAnomaly, int count);
+
+// position relative to the focus at time t
+dvec3 OrbitPosition(const OrbitalElements &elements, double t);
+
+// rotation angle of a body spinning once per period, wrapped to [0, 2pi)
+double SpinAngle(double period, double t, double phase = 0.0);
+
+class Ephemeris
+{
+private:
+    // per body, precomputed from the elements
+    vector<double> meanAnomalyAtEpoch, period, eccentricity;
+    vector<double> semiMajorAxis, semiMinorAxis;
+    vector<double> perifocalPX, perifocalPY, perifocalPZ;
+    vector<double> perifocalQX, perifocalQY, perifocalQZ;
+
+    // results of the last evaluate()
+    vector<double> positionX, positionY, positionZ;
+    vector<double> meanAnomaly, eccentricAnomaly;
+
+public:
+    Ephemeris();
+
+    // returns the body index
+    int addBody(const OrbitalElements &elements);
+
+    // evaluates every body at time t, in parallel for large counts
+    void evaluate(double t);
+
+    dvec3 getPosition(int body) const;
+    int bodyCount() const;
+};
+
+#endif /* Ephemeris_h */
@@ -0,0 +1,130 @@
+//
+//  FileWatcher.cpp
+//  graphics_assig_5_06
+//
+
+#include <iostream>
+#include <algorithm>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#include "FileWatcher.h"
+
+using namespace std;
+
+FileWatcher :: FileWatcher()
+{
+#ifdef __linux__
+    inotifyDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+FileWatcher :: ~FileWatcher()
+{
+    if (inotifyDescriptor >= 0)
+        close(inotifyDescriptor);
+}
+
+bool FileWatcher :: statFile(WatchedFile &file)
+{
+    struct stat info;
+    if (stat(file.path.c_str(), &info) != 0)
+        return false;
+#ifdef __APPLE__
+    file.modified = int64_t(info.st_mtimespec.tv_sec)*1000000000 + info.st_mtimespec.tv_nsec;
+#else
+    file.modified = int64_t(info.st_mtim.tv_sec)*1000000000 + info.st_mtim.tv_nsec;
+#endif
+    file.size = int64_t(info.st_size);
+    return true;
+}
+
+bool FileWatcher :: watch(const string &path)
+{
+    WatchedFile file;
+    file.path = path;
+    size_t slash = path.find_last_of('/');
+    file.directory = slash == string::npos ? "." : path.substr(0, slash);
+    file.name = slash == string::npos ? path : path.substr(slash + 1);
+    if (!statFile(file)) {
+        cout << "FileWatcher: " << path << " does not exist" << endl;
+        return false;
+    }
+
+#ifdef __linux__
+    if (inotifyDescriptor >= 0) {
+        for (const auto &watch : directoryWatches)
+            file.notified = file.notified || watch.second == file.directory;
+        if (!file.notified) {
+            int watch = inotify_add_watch(inotifyDescriptor, file.directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+            if (watch < 0)
+                cout << "FileWatcher: could not watch " << file.directory << "/, polling instead" << endl;
+            else
+                directoryWatches[watch] = file.directory;
+            file.notified = watch >= 0;
+        }
+    }
+#endif
+    files.push_back(file);
+    return true;
+}
+
+void FileWatcher :: readEvents(vector<string> &changed)
+{
+#ifdef __linux__
+    alignas(inotify_event) char buffer[4096];
+    while (true) {
+        ssize_t length = read(inotifyDescriptor, buffer, sizeof(buffer));
+        if (length <= 0)
+            break;
+        for (char *p = buffer; p < buffer + length; ) {
+            const inotify_event *event = reinterpret_cast<const inotify_event*>(p);
+            p += sizeof(inotify_event) + event->len;
+            map<int, string>::const_iterator directory = directoryWatches.find(event->wd);
+            if (directory == directoryWatches.end() || event->len == 0)
+                continue;
+            for (WatchedFile &file : files)
+                if (file.directory == directory->second && file.name == event->name)
+                    changed.push_back(file.path);
+        }
+    }
+#endif
+}
+
+void FileWatcher :: pollFiles(vector<string> &changed)
+{
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    if (now - lastPoll < chrono::milliseconds(POLL_MILLISECONDS))
+        return;
+    lastPoll = now;
+
+    for (WatchedFile &file : files) {
+        if (file.notified)
+            continue;
+        int64_t modified = file.modified, size = file.size;
+        // a file that vanished mid-save is picked up when it reappears
+        if (statFile(file) && (file.modified != modified || file.size != size))
+            changed.push_back(file.path);
+    }
+}
+
+vector<string> FileWatcher :: changedFiles()
+{
+    vector<string> changed;
+    if (!directoryWatches.empty())
+        readEvents(changed);
+    pollFiles(changed);
+
+    sort(changed.begin(), changed.end());
+    changed.erase(unique(changed.begin(), changed.end()), changed.end());
+    return changed;
+}
+
+const char* FileWatcher :: backendName() const
+{
+    return directoryWatches.empty() ? "polling" : "inotify";
+}
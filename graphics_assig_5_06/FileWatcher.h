@@ -0,0 +1,61 @@
+//
+//  FileWatcher.h
+//  graphics_assig_5_06
+//
+//  Reports which of a set of files have been written since the last
+//  check, for hot reloading. On Linux it listens to inotify on the files'
+//  directories, so saves that replace the file by renaming are caught
+//  too; elsewhere it compares modification times and sizes, at most every
+//  POLL_MILLISECONDS. Checking never blocks.
+//
+
+#ifndef FileWatcher_h
+#define FileWatcher_h
+
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <cstdint>
+
+using namespace std;
+
+class FileWatcher
+{
+private:
+    static const int POLL_MILLISECONDS = 50;
+
+    struct WatchedFile
+    {
+        string path;
+        string directory;
+        string name;
+        bool notified = false;  // its directory has an inotify watch
+        int64_t modified = 0;   // nanoseconds, for polling
+        int64_t size = -1;
+    };
+
+    vector<WatchedFile> files;
+    int inotifyDescriptor = -1;
+    map<int, string> directoryWatches;      // inotify watch -> directory
+    chrono::steady_clock::time_point lastPoll;
+
+    bool statFile(WatchedFile &file);
+    void readEvents(vector<string> &changed);
+    void pollFiles(vector<string> &changed);
+
+public:
+    FileWatcher();
+    ~FileWatcher();
+
+    // starts watching path; false if it does not exist
+    bool watch(const string &path);
+
+    // files written since the last call, each listed once, as given to watch()
+    vector<string> changedFiles();
+
+    // "inotify" or "polling"
+    const char* backendName() const;
+};
+
+#endif /* FileWatcher_h */
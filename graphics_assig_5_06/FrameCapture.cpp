@@ -0,0 +1,233 @@
+//
+//  FrameCapture.cpp
+//  graphics_assig_5_06
+//
+
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+#include <thread>
+#include <memory>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb/stb_image_write.h>
+
+#include "FrameCapture.h"
+#include "Profiler.h"
+
+using namespace std;
+
+FrameCapture :: FrameCapture()
+{}
+
+FrameCapture :: ~FrameCapture()
+{
+    // GL objects need the context; destroy() must be called while it is
+    // current. Only the encoder threads are cleaned up here.
+    delete encoders;
+}
+
+bool FrameCapture :: initialize(int captureWidth, int captureHeight, const string &outputDirectory, CaptureFormat captureFormat)
+{
+    width = captureWidth;
+    height = captureHeight;
+    directory = outputDirectory;
+    format = captureFormat;
+
+    // the GL thread, the simulation and its ParallelFor pool already use a
+    // core each; the remaining ones encode
+    int encoderCount = max(1, (int)thread::hardware_concurrency() - 2);
+    encoders = new ThreadPool(encoderCount);
+    // bounds memory when encoding is slower than rendering
+    maxEncodesInFlight = 2*encoderCount;
+
+    cout << "Capturing " << width << "x" << height << " frames to " << directory << "/ as "
+         << (format == CAPTURE_PNG ? "PNG" : "PPM") << " with " << encoderCount << " encoder threads" << endl;
+    return true;
+}
+
+bool FrameCapture :: isActive() const
+{
+    return encoders != nullptr;
+}
+
+void FrameCapture :: captureFrame()
+{
+    if (!isActive())
+        return;
+
+    // created on first use, so software-rendered captures need no context
+    if (ring[0].pixelBuffer == 0) {
+        GLsizeiptr bytes = (GLsizeiptr)width*height*4;
+        for (int i = 0; i < RING_SIZE; i++) {
+            glGenBuffers(1, &ring[i].pixelBuffer);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, ring[i].pixelBuffer);
+            glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    // the slot about to be reused was filled RING_SIZE - 1 frames ago
+    Readback &slot = ring[nextSlot];
+    if (slot.frame >= 0)
+        collect(slot);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pixelBuffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.frame = framesIssued++;
+
+    nextSlot = (nextSlot + 1) % RING_SIZE;
+}
+
+// maps a finished readback, copies it out and hands it to an encoder
+void FrameCapture :: collect(Readback &slot)
+{
+    GLenum status = glClientWaitSync(slot.fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        stalls++;
+        glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(1000000000));
+    }
+    glDeleteSync(slot.fence);
+    slot.fence = 0;
+
+    shared_ptr<vector<unsigned char>> image = acquireImage();
+    size_t bytes = image->size();
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pixelBuffer);
+    void *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+    if (pixels) {
+        memcpy(image->data(), pixels, bytes);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    } else {
+        cout << "FrameCapture: could not map the readback of frame " << slot.frame << endl;
+        fill(image->begin(), image->end(), 0);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    int frame = slot.frame;
+    slot.frame = -1;
+    submitImage(frame, image, true);
+}
+
+// waits for room in the encode queue, then hands out image storage
+shared_ptr<vector<unsigned char>> FrameCapture :: acquireImage()
+{
+    shared_ptr<vector<unsigned char>> image = make_shared<vector<unsigned char>>();
+    {
+        unique_lock<mutex> lock(encodeMutex);
+        encodeFinished.wait(lock, [this] { return encodesInFlight < maxEncodesInFlight; });
+        encodesInFlight++;
+        if (!freeImages.empty()) {
+            image->swap(freeImages.back());
+            freeImages.pop_back();
+        }
+    }
+    image->resize((size_t)width*height*4);
+    return image;
+}
+
+void FrameCapture :: submitImage(int frame, shared_ptr<vector<unsigned char>> image, bool bottomUp)
+{
+    encoders->submit([this, frame, image, bottomUp] {
+        encode(frame, *image, bottomUp);
+        // the storage goes back for reuse by a later frame
+        lock_guard<mutex> lock(encodeMutex);
+        freeImages.push_back(vector<unsigned char>());
+        freeImages.back().swap(*image);
+        encodesInFlight--;
+        encodeFinished.notify_all();
+    });
+}
+
+void FrameCapture :: captureImage(const unsigned char *rgba)
+{
+    if (!isActive())
+        return;
+
+    shared_ptr<vector<unsigned char>> image = acquireImage();
+    memcpy(image->data(), rgba, image->size());
+    submitImage(framesIssued++, image, false);
+}
+
+// runs on an encoder thread: GL rows are bottom-up RGBA, CPU frames top-down;
+// files are top-down RGB
+void FrameCapture :: encode(int frame, vector<unsigned char> &rgba, bool bottomUp)
+{
+    PROFILE_SCOPE("FrameCapture::encode");
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    vector<unsigned char> rgb((size_t)width*height*3);
+    for (int y = 0; y < height; y++) {
+        const unsigned char *source = rgba.data() + (size_t)(bottomUp ? height - 1 - y : y)*width*4;
+        unsigned char *target = rgb.data() + (size_t)y*width*3;
+        for (int x = 0; x < width; x++) {
+            target[3*x + 0] = source[4*x + 0];
+            target[3*x + 1] = source[4*x + 1];
+            target[3*x + 2] = source[4*x + 2];
+        }
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "frame_%06d.%s", frame, format == CAPTURE_PNG ? "png" : "ppm");
+    string path = directory + "/" + name;
+
+    bool written;
+    if (format == CAPTURE_PNG) {
+        written = stbi_write_png(path.c_str(), width, height, 3, rgb.data(), width*3) != 0;
+    } else {
+        FILE *file = fopen(path.c_str(), "wb");
+        written = file != nullptr;
+        if (file) {
+            fprintf(file, "P6\n%d %d\n255\n", width, height);
+            written = fwrite(rgb.data(), 1, rgb.size(), file) == rgb.size();
+            fclose(file);
+        }
+    }
+
+    double milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    lock_guard<mutex> lock(encodeMutex);
+    encodeMilliseconds += milliseconds;
+    if (written)
+        framesWritten++;
+    else if (writeFailures++ == 0)
+        cout << "FrameCapture: could not write " << path << endl;
+}
+
+void FrameCapture :: finish()
+{
+    if (!isActive())
+        return;
+
+    // oldest first, so frames reach the encoders in order
+    for (int i = 0; i < RING_SIZE; i++) {
+        Readback &slot = ring[(nextSlot + i) % RING_SIZE];
+        if (slot.frame >= 0)
+            collect(slot);
+    }
+    encoders->wait();
+
+    if (framesIssued > 0)
+        cout << "Captured " << framesWritten << " of " << framesIssued << " frames, "
+             << encodeMilliseconds/max(1, framesWritten) << " ms encode per frame (off the render thread), "
+             << stalls << " readback stalls" << endl;
+}
+
+void FrameCapture :: destroy()
+{
+    if (!isActive())
+        return;
+    finish();
+
+    for (int i = 0; i < RING_SIZE; i++) {
+        if (ring[i].pixelBuffer != 0)
+            glDeleteBuffers(1, &ring[i].pixelBuffer);
+        ring[i].pixelBuffer = 0;
+    }
+    delete encoders;
+    encoders = nullptr;
+    freeImages.clear();
+}
@@ -0,0 +1,92 @@
+//
+//  FrameCapture.h
+//  graphics_assig_5_06
+//
+//  Writes every rendered frame to a numbered image sequence without
+//  stalling the GPU. glReadPixels targets a ring of pixel buffer objects,
+//  so the copy runs asynchronously; a buffer is only mapped a few frames
+//  later, once its fence has signalled. Flipping and PNG/PPM encoding then
+//  run on a separate pool of encoder threads.
+//
+
+#ifndef FrameCapture_h
+#define FrameCapture_h
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <glad/glad.h>
+
+#include "ThreadPool.h"
+
+using namespace std;
+
+enum CaptureFormat
+{
+    CAPTURE_PNG,
+    CAPTURE_PPM     // uncompressed binary PPM, for when encode time matters
+};
+
+class FrameCapture
+{
+private:
+    static const int RING_SIZE = 3;
+
+    struct Readback
+    {
+        GLuint pixelBuffer = 0;
+        GLsync fence = 0;
+        int frame = -1;     // frame number in flight, -1 if the slot is free
+    };
+
+    int width = 0, height = 0;
+    string directory;
+    CaptureFormat format = CAPTURE_PNG;
+
+    Readback ring[RING_SIZE];
+    int nextSlot = 0;
+    int framesIssued = 0;
+    int stalls = 0;         // mapped before the GPU had finished the copy
+
+    ThreadPool *encoders = nullptr;
+    mutex encodeMutex;
+    condition_variable encodeFinished;
+    int encodesInFlight = 0;
+    int maxEncodesInFlight = 0;
+    vector<vector<unsigned char>> freeImages;
+    double encodeMilliseconds = 0.0;
+    int framesWritten = 0;
+    int writeFailures = 0;
+
+    void collect(Readback &slot);
+    shared_ptr<vector<unsigned char>> acquireImage();
+    void submitImage(int frame, shared_ptr<vector<unsigned char>> image, bool bottomUp);
+    void encode(int frame, vector<unsigned char> &rgba, bool bottomUp);
+
+public:
+    FrameCapture();
+    ~FrameCapture();
+
+    // frames are written as directory/frame_000000.png (or .ppm); the
+    // directory must exist
+    bool initialize(int width, int height, const string &directory, CaptureFormat format);
+
+    // queues a copy of the bound read framebuffer; call after drawing and
+    // before swapping. Needs the context current.
+    void captureFrame();
+
+    // queues a frame drawn on the CPU: RGBA8, top row first
+    void captureImage(const unsigned char *rgba);
+
+    // collects every pending readback and waits for the encoders
+    void finish();
+
+    // finishes, then frees the buffers and encoder threads
+    void destroy();
+
+    bool isActive() const;
+};
+
+#endif /* FrameCapture_h */
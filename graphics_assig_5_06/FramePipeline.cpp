@@ -0,0 +1,50 @@
+//
+//  FramePipeline.cpp
+//  graphics_assig_5_06
+//
+
+#include <iostream>
+#include <algorithm>
+
+#include "FramePipeline.h"
+
+using namespace std;
+
+FrameMetrics :: FrameMetrics(double reportIntervalSeconds)
+    : reportInterval(reportIntervalSeconds)
+{}
+
+// Sim and render run on different threads, so their sum can exceed the
+// frame time; the excess is work that overlapped instead of running back
+// to back.
+void FrameMetrics :: addFrame(double frameSeconds, double simulationMs, double renderMs, bool fresh)
+{
+    windowSeconds += frameSeconds;
+    frames++;
+    frameMilliseconds += frameSeconds*1000.0;
+    renderMilliseconds += renderMs;
+    if (fresh) {
+        freshFrames++;
+        simulationMilliseconds += simulationMs;
+    }
+
+    if (windowSeconds < reportInterval)
+        return;
+
+    double frame = frameMilliseconds/frames;
+    double render = renderMilliseconds/frames;
+    double simulation = freshFrames ? simulationMilliseconds/freshFrames : 0.0;
+    double overlap = max(0.0, simulation + render - frame);
+
+    cout << "frame " << frame << " ms (" << frames/windowSeconds << " fps) | "
+         << "sim " << simulation << " ms | render " << render << " ms | "
+         << "overlap " << overlap << " ms | "
+         << frames - freshFrames << " repeated frames" << endl;
+
+    windowSeconds = 0.0;
+    frames = 0;
+    freshFrames = 0;
+    frameMilliseconds = 0.0;
+    simulationMilliseconds = 0.0;
+    renderMilliseconds = 0.0;
+}
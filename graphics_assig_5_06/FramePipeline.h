@@ -0,0 +1,122 @@
+//
+//  FramePipeline.h
+//  graphics_assig_5_06
+//
+//  Hand-off between the simulation thread and the GL thread. The GL thread
+//  samples input into an InputSnapshot; the simulation thread turns it into
+//  an immutable FrameSnapshot. Both cross threads through lock-free triple
+//  buffers, so the simulation of frame N+1 runs while frame N is rendered.
+//
+
+#ifndef FramePipeline_h
+#define FramePipeline_h
+
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+using namespace glm;
+using namespace std;
+
+// Single producer, single consumer. The producer always owns one slot, the
+// consumer another, and the third is swapped between them with one atomic
+// exchange; the consumer sees only the newest published value.
+template <typename T>
+class TripleBuffer
+{
+private:
+    static const int INDEX_MASK = 3;
+    static const int FRESH_BIT = 4;
+
+    T buffers[3];
+    atomic<int> middle;
+    int back = 0;      // producer's slot
+    int front = 2;     // consumer's slot
+
+public:
+    TripleBuffer() : middle(1) {}
+
+    // producer: slot to fill before publish()
+    T& writeBuffer() { return buffers[back]; }
+
+    // producer: make the written slot the newest value
+    void publish()
+    {
+        int previous = middle.exchange(back | FRESH_BIT, memory_order_acq_rel);
+        back = previous & INDEX_MASK;
+    }
+
+    // consumer: take the newest value if one was published since the last
+    // call; returns false (and keeps the old value) otherwise
+    bool update()
+    {
+        if (!(middle.load(memory_order_acquire) & FRESH_BIT))
+            return false;
+        int previous = middle.exchange(front, memory_order_acq_rel);
+        front = previous & INDEX_MASK;
+        return true;
+    }
+
+    // consumer: the value taken by the last successful update()
+    const T& readBuffer() const { return buffers[front]; }
+};
+
+// raw input state sampled on the GL thread; absolute values so nothing is
+// lost when the simulation thread skips a snapshot
+struct InputSnapshot
+{
+    vec2 cursorPosition = vec2(0.f);
+    bool leftButtonDown = false;
+    bool speedUp = false;
+    bool slowDown = false;
+    bool pause = false;
+    bool resume = false;
+    bool gravityMode = false;
+    bool cycleFocus = false;
+    double scrollTotal = 0.0;   // sum of every scroll step so far
+};
+
+// everything the GL thread needs to draw one frame
+struct FrameSnapshot
+{
+    uint64_t frameIndex = 0;
+    double simulationTime = 0.0;
+
+    // camera-relative: the view matrix is rotation only, and positions and
+    // model matrices are offsets from the eye
+    mat4 viewMatrix = mat4(1.f);
+    vec3 cameraPosition = vec3(0.f);
+    vec3 lightPosition = vec3(0.f);
+
+    // halfway to the surface the camera follows, and never beyond 0.1
+    float nearPlane = 0.1f;
+
+    // one per drawn body, in draw order
+    vector<mat4> modelMatrices;
+
+    // CPU time the simulation thread spent producing this frame
+    double simulationMilliseconds = 0.0;
+};
+
+// rolling frame-time statistics for the pipeline, printed periodically
+class FrameMetrics
+{
+private:
+    double reportInterval;
+    double windowSeconds = 0.0;
+    int frames = 0;
+    int freshFrames = 0;
+    double frameMilliseconds = 0.0;
+    double simulationMilliseconds = 0.0;
+    double renderMilliseconds = 0.0;
+
+public:
+    explicit FrameMetrics(double reportIntervalSeconds = 2.0);
+
+    // frameSeconds: wall time since the previous frame; fresh: a new
+    // snapshot was consumed this frame
+    void addFrame(double frameSeconds, double simulationMs, double renderMs, bool fresh);
+};
+
+#endif /* FramePipeline_h */
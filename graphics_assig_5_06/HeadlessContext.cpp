@@ -0,0 +1,201 @@
+//
+//  HeadlessContext.cpp
+//  graphics_assig_5_06
+//
+
+#include <iostream>
+
+#include "HeadlessContext.h"
+
+#if defined(HEADLESS_USE_EGL)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#elif defined(HEADLESS_USE_OSMESA)
+#include <GL/osmesa.h>
+#endif
+
+using namespace std;
+
+HeadlessContext :: HeadlessContext()
+{}
+
+HeadlessContext :: ~HeadlessContext()
+{
+    destroy();
+}
+
+#if defined(HEADLESS_USE_EGL)
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+// Mesa's surfaceless platform needs neither a display server nor a GPU;
+// other drivers get the default display
+static EGLDisplay OpenDisplay()
+{
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay) {
+        EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr))
+            return display;
+    }
+
+    EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr))
+        return display;
+    return EGL_NO_DISPLAY;
+}
+
+bool HeadlessContext :: create(int width, int height)
+{
+    EGLDisplay eglDisplay = OpenDisplay();
+    if (eglDisplay == EGL_NO_DISPLAY) {
+        cout << "EGL: no display could be initialised" << endl;
+        return false;
+    }
+    display = eglDisplay;
+
+    // the scene goes to an FBO, but the config must still allow a pbuffer
+    // for drivers without surfaceless contexts (below)
+    const EGLint configAttributes[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint configCount = 0;
+    if (!eglChooseConfig(eglDisplay, configAttributes, &config, 1, &configCount) || configCount == 0) {
+        cout << "EGL: no config supports desktop OpenGL" << endl;
+        destroy();
+        return false;
+    }
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        cout << "EGL: desktop OpenGL API unavailable" << endl;
+        destroy();
+        return false;
+    }
+
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 1,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext eglContext = eglCreateContext(eglDisplay, config, EGL_NO_CONTEXT, contextAttributes);
+    if (eglContext == EGL_NO_CONTEXT) {
+        cout << "EGL: could not create an OpenGL 4.1 core context (error 0x" << hex << eglGetError() << dec << ")" << endl;
+        destroy();
+        return false;
+    }
+    context = eglContext;
+
+    // surfaceless where supported, otherwise a pbuffer of the frame size
+    if (!eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext)) {
+        const EGLint pbufferAttributes[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+        EGLSurface pbuffer = eglCreatePbufferSurface(eglDisplay, config, pbufferAttributes);
+        if (pbuffer == EGL_NO_SURFACE || !eglMakeCurrent(eglDisplay, pbuffer, pbuffer, eglContext)) {
+            cout << "EGL: could not make the context current" << endl;
+            if (pbuffer != EGL_NO_SURFACE)
+                eglDestroySurface(eglDisplay, pbuffer);
+            destroy();
+            return false;
+        }
+        surface = pbuffer;
+    }
+    return true;
+}
+
+void HeadlessContext :: destroy()
+{
+    if (!display)
+        return;
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (surface)
+        eglDestroySurface(display, surface);
+    if (context)
+        eglDestroyContext(display, context);
+    eglTerminate(display);
+    display = context = surface = nullptr;
+}
+
+GLADloadproc HeadlessContext :: procLoader()
+{
+    return (GLADloadproc)eglGetProcAddress;
+}
+
+const char* HeadlessContext :: backendName()
+{
+    return "EGL";
+}
+
+#elif defined(HEADLESS_USE_OSMESA)
+
+bool HeadlessContext :: create(int width, int height)
+{
+    const int attributes[] = {
+        OSMESA_FORMAT, OSMESA_RGBA,
+        OSMESA_DEPTH_BITS, 24,
+        OSMESA_PROFILE, OSMESA_CORE_PROFILE,
+        OSMESA_CONTEXT_MAJOR_VERSION, 4,
+        OSMESA_CONTEXT_MINOR_VERSION, 1,
+        0
+    };
+    OSMesaContext osmesaContext = OSMesaCreateContextAttribs(attributes, nullptr);
+    if (!osmesaContext) {
+        cout << "OSMesa: could not create an OpenGL 4.1 core context" << endl;
+        return false;
+    }
+    context = osmesaContext;
+
+    backBuffer.resize((size_t)width*height*4);
+    if (!OSMesaMakeCurrent(osmesaContext, backBuffer.data(), GL_UNSIGNED_BYTE, width, height)) {
+        cout << "OSMesa: could not make the context current" << endl;
+        destroy();
+        return false;
+    }
+    return true;
+}
+
+void HeadlessContext :: destroy()
+{
+    if (context)
+        OSMesaDestroyContext((OSMesaContext)context);
+    context = nullptr;
+    backBuffer.clear();
+}
+
+GLADloadproc HeadlessContext :: procLoader()
+{
+    return (GLADloadproc)OSMesaGetProcAddress;
+}
+
+const char* HeadlessContext :: backendName()
+{
+    return "OSMesa";
+}
+
+#else
+
+bool HeadlessContext :: create(int width, int height)
+{
+    cout << "Headless rendering is not available: build with HEADLESS_USE_EGL or HEADLESS_USE_OSMESA" << endl;
+    return false;
+}
+
+void HeadlessContext :: destroy()
+{}
+
+GLADloadproc HeadlessContext :: procLoader()
+{
+    return nullptr;
+}
+
+const char* HeadlessContext :: backendName()
+{
+    return "none";
+}
+
+#endif
@@ -0,0 +1,44 @@
+//
+//  HeadlessContext.h
+//  graphics_assig_5_06
+//
+//  OpenGL 4.1 core context without a window, for render-farm and CI runs on
+//  machines with no display or GPU (Mesa llvmpipe works). Build with
+//  HEADLESS_USE_EGL (surfaceless EGL, link libEGL) or HEADLESS_USE_OSMESA
+//  (link libOSMesa); without either, create() reports that headless
+//  rendering is unavailable. Draw into a RenderTarget, since there is no
+//  default framebuffer to present.
+//
+
+#ifndef HeadlessContext_h
+#define HeadlessContext_h
+
+#include <vector>
+#include <glad/glad.h>
+
+using namespace std;
+
+class HeadlessContext
+{
+private:
+    void *display = nullptr;
+    void *context = nullptr;
+    void *surface = nullptr;
+    vector<unsigned char> backBuffer;   // OSMesa renders into client memory
+
+public:
+    HeadlessContext();
+    ~HeadlessContext();
+
+    // creates the context and makes it current on the calling thread
+    bool create(int width, int height);
+    void destroy();
+
+    // for gladLoadGLLoader once the context is current
+    static GLADloadproc procLoader();
+
+    // name of the compiled-in backend, or "none"
+    static const char* backendName();
+};
+
+#endif /* HeadlessContext_h */
@@ -0,0 +1,197 @@
+//
+//  ImageCompare.cpp
+//  graphics_assig_5_06
+//
+
+#include <iostream>
+#include <cstdlib>
+#include <algorithm>
+#include <stb/stb_image.h>
+#include <stb/stb_image_write.h>
+
+#include "ImageCompare.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define COMPARE_USE_SSE2 1
+#endif
+
+// SSIM over 8x8 windows every 4 pixels, with the usual constants for 8-bit
+// data (Wang et al. 2004)
+static const int SSIM_WINDOW = 8;
+static const int SSIM_STEP = 4;
+static const float SSIM_C1 = (0.01f*255.f)*(0.01f*255.f);
+static const float SSIM_C2 = (0.03f*255.f)*(0.03f*255.f);
+
+bool LoadRGBImage(RGBImage *image, const string &path)
+{
+    int components;
+    stbi_set_flip_vertically_on_load(false);
+    unsigned char *data = stbi_load(path.c_str(), &image->width, &image->height, &components, 3);
+    if (data == nullptr)
+        return false;
+    image->pixels.assign(data, data + (size_t)image->width*image->height*3);
+    stbi_image_free(data);
+    return true;
+}
+
+bool WriteRGBImage(const RGBImage &image, const string &path)
+{
+    return stbi_write_png(path.c_str(), image.width, image.height, 3, image.pixels.data(), image.width*3) != 0;
+}
+
+// absolute channel differences of one row; returns their sum and raises
+// maxError to the largest
+static long long RowDifferences(const unsigned char *a, const unsigned char *b, int bytes, unsigned char *out, int &maxError)
+{
+    long long sum = 0;
+    int i = 0;
+#if COMPARE_USE_SSE2
+    __m128i largest = _mm_setzero_si128();
+    __m128i total = _mm_setzero_si128();
+    for (; i + 16 <= bytes; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+        __m128i difference = _mm_or_si128(_mm_subs_epu8(x, y), _mm_subs_epu8(y, x));
+        _mm_storeu_si128((__m128i *)(out + i), difference);
+        largest = _mm_max_epu8(largest, difference);
+        total = _mm_add_epi64(total, _mm_sad_epu8(difference, _mm_setzero_si128()));
+    }
+    alignas(16) unsigned char lanes[16];
+    _mm_store_si128((__m128i *)lanes, largest);
+    for (int k = 0; k < 16; k++)
+        maxError = max(maxError, (int)lanes[k]);
+    alignas(16) long long sums[2];
+    _mm_store_si128((__m128i *)sums, total);
+    sum = sums[0] + sums[1];
+#endif
+    for (; i < bytes; i++) {
+        int difference = abs((int)a[i] - (int)b[i]);
+        out[i] = (unsigned char)difference;
+        maxError = max(maxError, difference);
+        sum += difference;
+    }
+    return sum;
+}
+
+static inline float Luma(const unsigned char *rgb)
+{
+    return 0.299f*rgb[0] + 0.587f*rgb[1] + 0.114f*rgb[2];
+}
+
+// mean SSIM of one row of windows
+static double SimilarityRow(const vector<float> &a, const vector<float> &b, int width, int top)
+{
+    const float inverseCount = 1.f/(SSIM_WINDOW*SSIM_WINDOW);
+    double total = 0.0;
+    int windows = 0;
+    for (int left = 0; left + SSIM_WINDOW <= width; left += SSIM_STEP) {
+        float sumA = 0.f, sumB = 0.f, sumAA = 0.f, sumBB = 0.f, sumAB = 0.f;
+        for (int y = top; y < top + SSIM_WINDOW; y++) {
+            const float *rowA = a.data() + (size_t)y*width + left;
+            const float *rowB = b.data() + (size_t)y*width + left;
+            for (int x = 0; x < SSIM_WINDOW; x++) {
+                sumA += rowA[x];
+                sumB += rowB[x];
+                sumAA += rowA[x]*rowA[x];
+                sumBB += rowB[x]*rowB[x];
+                sumAB += rowA[x]*rowB[x];
+            }
+        }
+        float meanA = sumA*inverseCount, meanB = sumB*inverseCount;
+        float varianceA = sumAA*inverseCount - meanA*meanA;
+        float varianceB = sumBB*inverseCount - meanB*meanB;
+        float covariance = sumAB*inverseCount - meanA*meanB;
+        total += ((2.f*meanA*meanB + SSIM_C1)*(2.f*covariance + SSIM_C2)) /
+                 ((meanA*meanA + meanB*meanB + SSIM_C1)*(varianceA + varianceB + SSIM_C2));
+        windows++;
+    }
+    return windows ? total/windows : 1.0;
+}
+
+ImageComparison CompareImages(const RGBImage &expected, const RGBImage &actual,
+                              const ImageTolerance &tolerance, RGBImage *diff)
+{
+    ImageComparison result;
+    result.sameSize = expected.width == actual.width && expected.height == actual.height &&
+                      expected.pixels.size() == actual.pixels.size();
+    if (!result.sameSize)
+        return result;
+
+    int width = expected.width, height = expected.height;
+    if (diff) {
+        diff->width = width;
+        diff->height = height;
+        diff->pixels.resize(expected.pixels.size());
+    }
+
+    // per-row totals, added up in order afterwards so the result does not
+    // depend on the thread count
+    vector<long long> rowSum(height);
+    vector<int> rowMax(height), rowDifferent(height);
+    vector<float> lumaExpected((size_t)width*height), lumaActual((size_t)width*height);
+
+    ParallelFor(0, height, 16, [&](int begin, int end) {
+        vector<unsigned char> differences((size_t)width*3);
+        for (int y = begin; y < end; y++) {
+            size_t offset = (size_t)y*width*3;
+            const unsigned char *a = expected.pixels.data() + offset;
+            const unsigned char *b = actual.pixels.data() + offset;
+            int maxError = 0;
+            rowSum[y] = RowDifferences(a, b, width*3, differences.data(), maxError);
+            rowMax[y] = maxError;
+
+            int different = 0;
+            for (int x = 0; x < width; x++) {
+                const unsigned char *d = differences.data() + 3*x;
+                int error = max(d[0], max(d[1], d[2]));
+                bool over = error > tolerance.channelThreshold;
+                different += over;
+                lumaExpected[(size_t)y*width + x] = Luma(a + 3*x);
+                lumaActual[(size_t)y*width + x] = Luma(b + 3*x);
+                if (diff) {
+                    unsigned char *out = diff->pixels.data() + offset + 3*x;
+                    if (over) {
+                        out[0] = (unsigned char)min(255, 128 + error);
+                        out[1] = 0;
+                        out[2] = 0;
+                    } else {
+                        out[0] = out[1] = out[2] = (unsigned char)(Luma(a + 3*x)/3.f);
+                    }
+                }
+            }
+            rowDifferent[y] = different;
+        }
+    });
+
+    long long sum = 0, different = 0;
+    for (int y = 0; y < height; y++) {
+        sum += rowSum[y];
+        different += rowDifferent[y];
+        result.maxError = max(result.maxError, rowMax[y]);
+    }
+    result.meanError = double(sum)/max<size_t>(1, expected.pixels.size());
+    result.differentFraction = double(different)/max(1, width*height);
+
+    int windowRows = height >= SSIM_WINDOW ? (height - SSIM_WINDOW)/SSIM_STEP + 1 : 0;
+    if (windowRows > 0 && width >= SSIM_WINDOW) {
+        vector<double> rowSimilarity(windowRows);
+        ParallelFor(0, windowRows, 4, [&](int begin, int end) {
+            for (int row = begin; row < end; row++)
+                rowSimilarity[row] = SimilarityRow(lumaExpected, lumaActual, width, row*SSIM_STEP);
+        });
+        double total = 0.0;
+        for (double similarity : rowSimilarity)
+            total += similarity;
+        result.similarity = total/windowRows;
+    } else {
+        result.similarity = result.maxError == 0 ? 1.0 : 0.0;
+    }
+
+    result.passed = result.differentFraction <= tolerance.maxDifferentFraction &&
+                    result.similarity >= tolerance.minSimilarity;
+    return result;
+}
@@ -0,0 +1,54 @@
+//
+//  ImageCompare.h
+//  graphics_assig_5_06
+//
+//  Compares a rendered frame with a stored golden image for the regression
+//  check (--golden). Two measures are combined: the fraction of pixels whose
+//  largest channel error is over a threshold, which catches anything
+//  missing or misplaced, and the mean structural similarity (SSIM) of the
+//  luminance, which tolerates small shading and rounding drift but not a
+//  change in what the image looks like. Rows are split over the thread pool
+//  and the per-pixel pass uses SSE2 where available.
+//
+
+#ifndef ImageCompare_h
+#define ImageCompare_h
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct RGBImage
+{
+    int width = 0;
+    int height = 0;
+    vector<unsigned char> pixels;   // RGB8, top row first
+};
+
+bool LoadRGBImage(RGBImage *image, const string &path);
+bool WriteRGBImage(const RGBImage &image, const string &path);   // PNG
+
+struct ImageTolerance
+{
+    int channelThreshold = 8;               // a pixel differs if any channel is off by more
+    double maxDifferentFraction = 0.005;
+    double minSimilarity = 0.98;            // mean SSIM
+};
+
+struct ImageComparison
+{
+    bool sameSize = false;
+    double meanError = 0.0;                 // per channel, 0-255
+    int maxError = 0;
+    double differentFraction = 0.0;
+    double similarity = 0.0;
+    bool passed = false;
+};
+
+// diff, if given, receives the expected image darkened with every differing
+// pixel in red, brighter for larger errors
+ImageComparison CompareImages(const RGBImage &expected, const RGBImage &actual,
+                              const ImageTolerance &tolerance, RGBImage *diff);
+
+#endif /* ImageCompare_h */
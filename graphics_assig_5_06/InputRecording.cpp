@@ -0,0 +1,365 @@
+//
+//  InputRecording.cpp
+//  graphics_assig_5_06
+//
+
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <cstring>
+#include <GLFW/glfw3.h>
+
+#include "InputRecording.h"
+
+using namespace std;
+
+// File layout, little-endian: a 24 byte header ("INRC", u32 version,
+// f64 simulation rate, f64 world scale), then records of a u8 type and a
+// fixed payload. A frame is any number of event records ended by a tick.
+static const char MAGIC[4] = { 'I', 'N', 'R', 'C' };
+static const uint32_t VERSION = 1;
+
+enum RecordType : uint8_t
+{
+    RECORD_TICK,        // f64 real seconds, f64 simulation time, u64 frame hash
+    RECORD_KEY,         // u16 GLFW key, u8 pressed
+    RECORD_BUTTON,      // u8 GLFW mouse button, u8 pressed
+    RECORD_CURSOR,      // f32 x, f32 y, in window coordinates
+    RECORD_SCROLL,      // f64 scroll total
+    RECORD_REFERENCE,   // no payload
+    RECORD_TYPE_COUNT
+};
+
+static const size_t PAYLOAD_SIZE[RECORD_TYPE_COUNT] = { 24, 3, 2, 8, 8, 0 };
+
+// the keys the simulation reads, and where each lands in an InputSnapshot
+struct KeyBinding
+{
+    uint16_t key;
+    bool InputSnapshot::*state;
+};
+
+static const KeyBinding KEY_BINDINGS[] = {
+    { GLFW_KEY_W, &InputSnapshot::speedUp },
+    { GLFW_KEY_S, &InputSnapshot::slowDown },
+    { GLFW_KEY_P, &InputSnapshot::pause },
+    { GLFW_KEY_O, &InputSnapshot::resume },
+    { GLFW_KEY_G, &InputSnapshot::gravityMode },
+    { GLFW_KEY_F, &InputSnapshot::cycleFocus },
+};
+static const int KEY_BINDING_COUNT = sizeof(KEY_BINDINGS)/sizeof(KEY_BINDINGS[0]);
+
+static void PutBytes(vector<unsigned char> &out, uint64_t value, int count)
+{
+    for (int i = 0; i < count; i++)
+        out.push_back((unsigned char)(value >> (8*i)));
+}
+
+static void PutFloat(vector<unsigned char> &out, float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    PutBytes(out, bits, 4);
+}
+
+static void PutDouble(vector<unsigned char> &out, double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    PutBytes(out, bits, 8);
+}
+
+static uint64_t GetBytes(const unsigned char *in, int count)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < count; i++)
+        value |= uint64_t(in[i]) << (8*i);
+    return value;
+}
+
+static float GetFloat(const unsigned char *in)
+{
+    uint32_t bits = uint32_t(GetBytes(in, 4));
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static double GetDouble(const unsigned char *in)
+{
+    uint64_t bits = GetBytes(in, 8);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+uint64_t HashFrameSnapshot(const FrameSnapshot &frame)
+{
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](const void *bytes, size_t size) {
+        const unsigned char *p = static_cast<const unsigned char*>(bytes);
+        for (size_t i = 0; i < size; i++)
+            hash = (hash ^ p[i])*1099511628211ull;
+    };
+    mix(&frame.viewMatrix[0][0], sizeof(float)*16);
+    mix(&frame.cameraPosition[0], sizeof(float)*3);
+    for (const mat4 &model : frame.modelMatrices)
+        mix(&model[0][0], sizeof(float)*16);
+    return hash;
+}
+
+// --------------------------------------------------------------------------
+// Recording
+
+InputRecorder :: ~InputRecorder()
+{
+    close();
+}
+
+bool InputRecorder :: open(const string &path, double simulationRate, double worldScale)
+{
+    close();
+    file = fopen(path.c_str(), "wb");
+    if (!file) {
+        cout << "InputRecorder: could not create " << path << endl;
+        return false;
+    }
+    this->path = path;
+    recorded = InputSnapshot();
+    frames = 0;
+    bytes = 0;
+
+    pending.assign(MAGIC, MAGIC + 4);
+    PutBytes(pending, VERSION, 4);
+    PutDouble(pending, simulationRate);
+    PutDouble(pending, worldScale);
+    flushPending();
+    cout << "Recording input to " << path << endl;
+    return true;
+}
+
+void InputRecorder :: flushPending()
+{
+    if (pending.empty())
+        return;
+    fwrite(pending.data(), 1, pending.size(), file);
+    bytes += pending.size();
+    pending.clear();
+}
+
+void InputRecorder :: recordInput(const InputSnapshot &input, bool reference)
+{
+    if (!file)
+        return;
+
+    for (int i = 0; i < KEY_BINDING_COUNT; i++) {
+        bool pressed = input.*KEY_BINDINGS[i].state;
+        if (pressed != recorded.*KEY_BINDINGS[i].state) {
+            pending.push_back(RECORD_KEY);
+            PutBytes(pending, KEY_BINDINGS[i].key, 2);
+            pending.push_back(pressed);
+        }
+    }
+    if (input.leftButtonDown != recorded.leftButtonDown) {
+        pending.push_back(RECORD_BUTTON);
+        pending.push_back(GLFW_MOUSE_BUTTON_LEFT);
+        pending.push_back(input.leftButtonDown);
+    }
+    // positions are stored whole rather than as deltas, so the replayed
+    // cursor is bit-identical and so is every difference taken from it
+    if (input.cursorPosition != recorded.cursorPosition) {
+        pending.push_back(RECORD_CURSOR);
+        PutFloat(pending, input.cursorPosition.x);
+        PutFloat(pending, input.cursorPosition.y);
+    }
+    if (input.scrollTotal != recorded.scrollTotal) {
+        pending.push_back(RECORD_SCROLL);
+        PutDouble(pending, input.scrollTotal);
+    }
+    if (reference)
+        pending.push_back(RECORD_REFERENCE);
+    recorded = input;
+}
+
+void InputRecorder :: recordTick(double realSeconds, const FrameSnapshot &frame)
+{
+    if (!file)
+        return;
+
+    pending.push_back(RECORD_TICK);
+    PutDouble(pending, realSeconds);
+    PutDouble(pending, frame.simulationTime);
+    PutBytes(pending, HashFrameSnapshot(frame), 8);
+    frames++;
+
+    // a few seconds of frames per write
+    if (pending.size() >= 4096)
+        flushPending();
+}
+
+void InputRecorder :: close()
+{
+    if (!file)
+        return;
+    flushPending();
+    bool failed = ferror(file) != 0;
+    fclose(file);
+    file = nullptr;
+    if (failed)
+        cout << "InputRecorder: could not write " << path << endl;
+    else
+        cout << "Recorded " << frames << " frames of input (" << bytes << " bytes) to " << path << endl;
+}
+
+bool InputRecorder :: isOpen() const
+{
+    return file != nullptr;
+}
+
+// --------------------------------------------------------------------------
+// Replay
+
+InputReplay :: InputReplay()
+    : done(false)
+{}
+
+bool InputReplay :: open(const string &path)
+{
+    ifstream file(path, ios::binary);
+    if (!file) {
+        cout << "InputReplay: could not open " << path << endl;
+        return false;
+    }
+    data.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+
+    if (data.size() < 24 || memcmp(data.data(), MAGIC, 4) != 0) {
+        cout << "InputReplay: " << path << " is not an input recording" << endl;
+        return false;
+    }
+    uint32_t version = uint32_t(GetBytes(&data[4], 4));
+    if (version != VERSION) {
+        cout << "InputReplay: " << path << " is version " << version << ", expected " << VERSION << endl;
+        return false;
+    }
+    recordedRate = GetDouble(&data[8]);
+    recordedScale = GetDouble(&data[16]);
+
+    // walk the records once so playback never meets a malformed one
+    frames = 0;
+    size_t position = 24;
+    while (position < data.size()) {
+        uint8_t type = data[position];
+        if (type >= RECORD_TYPE_COUNT || position + 1 + PAYLOAD_SIZE[type] > data.size()) {
+            cout << "InputReplay: " << path << " is damaged at byte " << position << ", replaying the "
+                 << frames << " frames before it" << endl;
+            break;
+        }
+        if (type == RECORD_TICK)
+            frames++;
+        position += 1 + PAYLOAD_SIZE[type];
+    }
+    if (frames == 0) {
+        cout << "InputReplay: " << path << " has no frames" << endl;
+        return false;
+    }
+
+    cursor = 24;
+    framesPlayed = 0;
+    firstDivergence = -1;
+    done = false;
+    opened = true;
+    cout << "Replaying " << frames << " frames of input from " << path << " (" << recordedRate
+         << " Hz simulation, world scale " << recordedScale << ")" << endl;
+    return true;
+}
+
+bool InputReplay :: isOpen() const
+{
+    return opened;
+}
+
+double InputReplay :: simulationRate() const
+{
+    return recordedRate;
+}
+
+double InputReplay :: worldScale() const
+{
+    return recordedScale;
+}
+
+uint64_t InputReplay :: frameCount() const
+{
+    return frames;
+}
+
+bool InputReplay :: nextFrame(InputSnapshot &input, bool &reference, double &realSeconds)
+{
+    reference = false;
+    if (!opened || framesPlayed >= frames) {
+        done = true;
+        return false;
+    }
+
+    while (true) {
+        uint8_t type = data[cursor];
+        const unsigned char *payload = &data[cursor + 1];
+        cursor += 1 + PAYLOAD_SIZE[type];
+
+        switch (type) {
+            case RECORD_TICK:
+                realSeconds = GetDouble(payload);
+                expectedTime = GetDouble(payload + 8);
+                expectedHash = GetBytes(payload + 16, 8);
+                framesPlayed++;
+                return true;
+            case RECORD_KEY: {
+                uint16_t key = uint16_t(GetBytes(payload, 2));
+                for (int i = 0; i < KEY_BINDING_COUNT; i++)
+                    if (KEY_BINDINGS[i].key == key)
+                        input.*KEY_BINDINGS[i].state = payload[2] != 0;
+                break;
+            }
+            case RECORD_BUTTON:
+                if (payload[0] == GLFW_MOUSE_BUTTON_LEFT)
+                    input.leftButtonDown = payload[1] != 0;
+                break;
+            case RECORD_CURSOR:
+                input.cursorPosition = vec2(GetFloat(payload), GetFloat(payload + 4));
+                break;
+            case RECORD_SCROLL:
+                input.scrollTotal = GetDouble(payload);
+                break;
+            case RECORD_REFERENCE:
+                reference = true;
+                break;
+        }
+    }
+}
+
+void InputReplay :: checkFrame(const FrameSnapshot &frame)
+{
+    if (done || firstDivergence >= 0 || framesPlayed == 0)
+        return;
+    if (frame.simulationTime != expectedTime || HashFrameSnapshot(frame) != expectedHash) {
+        firstDivergence = int64_t(framesPlayed);
+        cout << "InputReplay: frame " << framesPlayed << " differs from the recording (simulation time "
+             << frame.simulationTime << ", recorded " << expectedTime << ")" << endl;
+    }
+}
+
+bool InputReplay :: finished() const
+{
+    return done;
+}
+
+void InputReplay :: report() const
+{
+    if (!opened)
+        return;
+    cout << "Replayed " << framesPlayed << " of " << frames << " frames: ";
+    if (firstDivergence < 0)
+        cout << "every frame matched the recording" << endl;
+    else
+        cout << "diverged from frame " << firstDivergence << " on" << endl;
+}
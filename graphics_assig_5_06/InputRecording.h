@@ -0,0 +1,103 @@
+//
+//  InputRecording.h
+//  graphics_assig_5_06
+//
+//  Records what the simulation thread consumes each frame (key, mouse
+//  button, cursor and scroll changes, then the clock tick it advanced by)
+//  to a compact binary file, and plays it back in place of live input so
+//  the same frame sequence can be rendered and timed across builds and
+//  machines. Each tick also stores the simulation time and a hash of the
+//  resulting FrameSnapshot, so a replay can tell where it stopped
+//  reproducing the recording.
+//
+
+#ifndef InputRecording_h
+#define InputRecording_h
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+
+#include "FramePipeline.h"
+
+using namespace std;
+
+// FNV-1a over the camera and model matrices of a frame
+uint64_t HashFrameSnapshot(const FrameSnapshot &frame);
+
+class InputRecorder
+{
+private:
+    FILE *file = nullptr;
+    string path;
+    InputSnapshot recorded;     // state a replay has reconstructed so far
+    vector<unsigned char> pending;
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+
+    void flushPending();
+
+public:
+    ~InputRecorder();
+
+    // the rate and scale are stored so a replay can run with the same ones
+    bool open(const string &path, double simulationRate, double worldScale);
+
+    // writes an event for every field that differs from the last recorded
+    // input; reference marks the frame where the live cursor position
+    // became the one later movement is measured from
+    void recordInput(const InputSnapshot &input, bool reference);
+
+    // ends the frame: realSeconds is what the simulation clock accumulated
+    void recordTick(double realSeconds, const FrameSnapshot &frame);
+
+    void close();
+    bool isOpen() const;
+};
+
+class InputReplay
+{
+private:
+    vector<unsigned char> data;
+    size_t cursor = 0;
+    double recordedRate = 60.0;
+    double recordedScale = 1.0;
+    uint64_t frames = 0;
+    uint64_t framesPlayed = 0;
+
+    // tick of the frame last returned by nextFrame
+    double expectedTime = 0.0;
+    uint64_t expectedHash = 0;
+    int64_t firstDivergence = -1;
+    bool opened = false;
+    atomic<bool> done;
+
+public:
+    InputReplay();
+
+    // reads and validates the whole recording
+    bool open(const string &path);
+    bool isOpen() const;
+
+    double simulationRate() const;
+    double worldScale() const;
+    uint64_t frameCount() const;
+
+    // applies the next frame's events to input and returns the seconds its
+    // clock tick accumulated; false once the recording is used up, leaving
+    // input unchanged
+    bool nextFrame(InputSnapshot &input, bool &reference, double &realSeconds);
+
+    // compares the frame produced from the last nextFrame with the recording
+    void checkFrame(const FrameSnapshot &frame);
+
+    // true after nextFrame has run out; safe to poll from another thread
+    bool finished() const;
+
+    // prints how many frames were replayed and whether they matched
+    void report() const;
+};
+
+#endif /* InputRecording_h */
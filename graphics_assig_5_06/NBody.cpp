@@ -0,0 +1,438 @@
+//
+//  NBody.cpp
+//  graphics_assig_5_06
+//
+
+#include <iostream>
+#include <chrono>
+#include <atomic>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+#include "NBody.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
+
+using namespace std;
+using namespace glm;
+
+// coincident bodies would otherwise subdivide forever; below this depth
+// they share a leaf and are summed directly
+static const int MAX_TREE_DEPTH = 40;
+
+// enough for MAX_TREE_DEPTH levels of 7 pending siblings each
+static const int WALK_STACK_SIZE = 8*MAX_TREE_DEPTH + 8;
+
+// bodies per parallel chunk in the force pass
+static const int FORCE_GRAIN = 256;
+
+static inline int Octant(const dvec3 &centre, double x, double y, double z)
+{
+    return (x >= centre.x ? 1 : 0) | (y >= centre.y ? 2 : 0) | (z >= centre.z ? 4 : 0);
+}
+
+NBodySimulation :: NBodySimulation()
+{}
+
+int NBodySimulation :: addBody(dvec3 position, dvec3 velocity, double bodyMass)
+{
+    posX.push_back(position.x); posY.push_back(position.y); posZ.push_back(position.z);
+    velX.push_back(velocity.x); velY.push_back(velocity.y); velZ.push_back(velocity.z);
+    accX.push_back(0.0); accY.push_back(0.0); accZ.push_back(0.0);
+    mass.push_back(bodyMass);
+    potential.push_back(0.0);
+    nextInLeaf.push_back(-1);
+    accelerationsValid = false;
+    return bodyCount() - 1;
+}
+
+void NBodySimulation :: clear()
+{
+    posX.clear(); posY.clear(); posZ.clear();
+    velX.clear(); velY.clear(); velZ.clear();
+    accX.clear(); accY.clear(); accZ.clear();
+    mass.clear();
+    potential.clear();
+    nextInLeaf.clear();
+    tree.clear();
+    accelerationsValid = false;
+}
+
+void NBodySimulation :: reserve(int count)
+{
+    posX.reserve(count); posY.reserve(count); posZ.reserve(count);
+    velX.reserve(count); velY.reserve(count); velZ.reserve(count);
+    accX.reserve(count); accY.reserve(count); accZ.reserve(count);
+    mass.reserve(count);
+    potential.reserve(count);
+    nextInLeaf.reserve(count);
+}
+
+// --------------------------------------------------------------------------
+// Octree
+
+void NBodySimulation :: insertBody(int body)
+{
+    double x = posX[body], y = posY[body], z = posZ[body];
+    int node = 0;
+    int depth = 0;
+
+    while (true) {
+        if (tree[node].firstChild < 0) {
+            if (tree[node].firstBody < 0) {
+                tree[node].firstBody = body;
+                nextInLeaf[body] = -1;
+                return;
+            }
+            if (depth >= MAX_TREE_DEPTH) {
+                nextInLeaf[body] = tree[node].firstBody;
+                tree[node].firstBody = body;
+                return;
+            }
+
+            // occupied leaf: split it and push its body down one level
+            int existing = tree[node].firstBody;
+            int first = (int)tree.size();
+            dvec3 centre = tree[node].centre;
+            double quarter = tree[node].halfSize*0.5;
+            for (int octant = 0; octant < 8; octant++) {
+                OctreeNode child;
+                child.centre = centre + dvec3((octant & 1) ? quarter : -quarter,
+                                              (octant & 2) ? quarter : -quarter,
+                                              (octant & 4) ? quarter : -quarter);
+                child.halfSize = quarter;
+                child.mass = 0.0;
+                child.centreOfMass = child.centre;
+                child.firstChild = -1;
+                child.firstBody = -1;
+                tree.push_back(child);
+            }
+            tree[node].firstChild = first;
+            tree[node].firstBody = -1;
+
+            int octant = Octant(centre, posX[existing], posY[existing], posZ[existing]);
+            tree[first + octant].firstBody = existing;
+            nextInLeaf[existing] = -1;
+        }
+
+        node = tree[node].firstChild + Octant(tree[node].centre, x, y, z);
+        depth++;
+    }
+}
+
+void NBodySimulation :: buildTree()
+{
+    tree.clear();
+    int count = bodyCount();
+    if (count == 0)
+        return;
+
+    dvec3 lower(posX[0], posY[0], posZ[0]);
+    dvec3 upper = lower;
+    for (int i = 1; i < count; i++) {
+        lower = min(lower, dvec3(posX[i], posY[i], posZ[i]));
+        upper = max(upper, dvec3(posX[i], posY[i], posZ[i]));
+    }
+    dvec3 extent = upper - lower;
+
+    OctreeNode root;
+    root.centre = (lower + upper)*0.5;
+    root.halfSize = 0.5*std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-9))*1.0001;
+    root.mass = 0.0;
+    root.centreOfMass = root.centre;
+    root.firstChild = -1;
+    root.firstBody = -1;
+
+    tree.reserve(2*count + 8);
+    tree.push_back(root);
+    for (int i = 0; i < count; i++)
+        insertBody(i);
+
+    computeMassDistribution();
+}
+
+// children are always created after their parent, so walking the node
+// array backwards visits every child before the node that owns it
+void NBodySimulation :: computeMassDistribution()
+{
+    for (int node = (int)tree.size() - 1; node >= 0; node--) {
+        OctreeNode &n = tree[node];
+        double m = 0.0;
+        dvec3 weighted(0.0);
+
+        if (n.firstChild < 0) {
+            for (int body = n.firstBody; body >= 0; body = nextInLeaf[body]) {
+                m += mass[body];
+                weighted += dvec3(posX[body], posY[body], posZ[body])*mass[body];
+            }
+        } else {
+            for (int octant = 0; octant < 8; octant++) {
+                const OctreeNode &child = tree[n.firstChild + octant];
+                m += child.mass;
+                weighted += child.centreOfMass*child.mass;
+            }
+        }
+
+        n.mass = m;
+        n.centreOfMass = (m > 0.0) ? weighted/m : n.centre;
+    }
+}
+
+// --------------------------------------------------------------------------
+// Forces
+
+void NBodySimulation :: computeForces()
+{
+    bool direct = forceMethod == FORCE_DIRECT_SUM ||
+                  (forceMethod == FORCE_AUTOMATIC && bodyCount() <= DIRECT_SUM_MAX_BODIES);
+    if (direct)
+        computeDirectForces();
+    else
+        computeTreeForces();
+    accelerationsValid = true;
+}
+
+// the kernel works in single precision; positions are only narrowed for
+// the force pass, and integration stays in double
+void NBodySimulation :: computeDirectForces()
+{
+    int count = bodyCount();
+    directSum.setBodies(posX.data(), posY.data(), posZ.data(), mass.data(), count);
+    directSum.compute((float)softening, BestDirectSumKernel());
+
+    const double G = gravitationalConstant;
+    for (int i = 0; i < count; i++) {
+        accX[i] = G*directSum.getAccelerationX(i);
+        accY[i] = G*directSum.getAccelerationY(i);
+        accZ[i] = G*directSum.getAccelerationZ(i);
+        potential[i] = G*directSum.getPotential(i);
+    }
+
+    tree.clear();
+    interactionsLastPass = (long long)count*(count - 1);
+}
+
+void NBodySimulation :: computeTreeForces()
+{
+    buildTree();
+
+    const double G = gravitationalConstant;
+    const double eps2 = softening*softening;
+    const double theta2 = openingAngle*openingAngle;
+    atomic<long long> interactions(0);
+
+    ParallelFor(0, bodyCount(), FORCE_GRAIN, [&](int begin, int end) {
+        int stack[WALK_STACK_SIZE];
+        long long chunkInteractions = 0;
+
+        for (int i = begin; i < end; i++) {
+            double x = posX[i], y = posY[i], z = posZ[i];
+            double ax = 0.0, ay = 0.0, az = 0.0, phi = 0.0;
+
+            int top = 0;
+            stack[top++] = 0;
+            while (top > 0) {
+                const OctreeNode &n = tree[stack[--top]];
+                if (n.mass == 0.0)
+                    continue;
+
+                if (n.firstChild < 0) {
+                    for (int body = n.firstBody; body >= 0; body = nextInLeaf[body]) {
+                        if (body == i)
+                            continue;
+                        double dx = posX[body] - x, dy = posY[body] - y, dz = posZ[body] - z;
+                        double r2 = dx*dx + dy*dy + dz*dz + eps2;
+                        double invR = 1.0/sqrt(r2);
+                        double mInvR = mass[body]*invR;
+                        double mInvR3 = mInvR*invR*invR;
+                        ax += dx*mInvR3; ay += dy*mInvR3; az += dz*mInvR3;
+                        phi -= mInvR;
+                        chunkInteractions++;
+                    }
+                    continue;
+                }
+
+                double dx = n.centreOfMass.x - x, dy = n.centreOfMass.y - y, dz = n.centreOfMass.z - z;
+                double d2 = dx*dx + dy*dy + dz*dz;
+                double size = 2.0*n.halfSize;
+                if (size*size < theta2*d2) {
+                    // far enough away: the whole cell acts as one point mass
+                    double r2 = d2 + eps2;
+                    double invR = 1.0/sqrt(r2);
+                    double mInvR = n.mass*invR;
+                    double mInvR3 = mInvR*invR*invR;
+                    ax += dx*mInvR3; ay += dy*mInvR3; az += dz*mInvR3;
+                    phi -= mInvR;
+                    chunkInteractions++;
+                } else {
+                    for (int octant = 0; octant < 8; octant++)
+                        stack[top++] = n.firstChild + octant;
+                }
+            }
+
+            accX[i] = G*ax; accY[i] = G*ay; accZ[i] = G*az;
+            potential[i] = G*phi;
+        }
+        interactions += chunkInteractions;
+    });
+
+    interactionsLastPass = interactions;
+}
+
+void NBodySimulation :: step(double dt)
+{
+    PROFILE_SCOPE("NBodySimulation::step");
+    if (!accelerationsValid)
+        computeForces();
+
+    int count = bodyCount();
+    double halfDt = 0.5*dt;
+
+    // kick, drift
+    for (int i = 0; i < count; i++) {
+        velX[i] += accX[i]*halfDt; velY[i] += accY[i]*halfDt; velZ[i] += accZ[i]*halfDt;
+        posX[i] += velX[i]*dt; posY[i] += velY[i]*dt; posZ[i] += velZ[i]*dt;
+    }
+
+    computeForces();
+
+    // kick
+    for (int i = 0; i < count; i++) {
+        velX[i] += accX[i]*halfDt; velY[i] += accY[i]*halfDt; velZ[i] += accZ[i]*halfDt;
+    }
+}
+
+double NBodySimulation :: totalEnergy()
+{
+    if (!accelerationsValid)
+        computeForces();
+
+    double kinetic = 0.0, potentialEnergy = 0.0;
+    for (int i = 0; i < bodyCount(); i++) {
+        kinetic += 0.5*mass[i]*(velX[i]*velX[i] + velY[i]*velY[i] + velZ[i]*velZ[i]);
+        potentialEnergy += 0.5*mass[i]*potential[i];
+    }
+    return kinetic + potentialEnergy;
+}
+
+void NBodySimulation :: removeNetMomentum()
+{
+    double totalMass = 0.0;
+    dvec3 momentum(0.0);
+    for (int i = 0; i < bodyCount(); i++) {
+        totalMass += mass[i];
+        momentum += dvec3(velX[i], velY[i], velZ[i])*mass[i];
+    }
+    if (totalMass <= 0.0)
+        return;
+
+    dvec3 drift = momentum/totalMass;
+    for (int i = 0; i < bodyCount(); i++) {
+        velX[i] -= drift.x; velY[i] -= drift.y; velZ[i] -= drift.z;
+    }
+}
+
+dvec3 NBodySimulation :: getPosition(int body) const
+{
+    return dvec3(posX[body], posY[body], posZ[body]);
+}
+
+dvec3 NBodySimulation :: getVelocity(int body) const
+{
+    return dvec3(velX[body], velY[body], velZ[body]);
+}
+
+int NBodySimulation :: bodyCount() const
+{
+    return (int)mass.size();
+}
+
+int NBodySimulation :: treeNodeCount() const
+{
+    return (int)tree.size();
+}
+
+long long NBodySimulation :: interactionsPerForcePass() const
+{
+    return interactionsLastPass;
+}
+
+bool NBodySimulation :: usedDirectSum() const
+{
+    return tree.empty() && bodyCount() > 0;
+}
+
+// --------------------------------------------------------------------------
+// Benchmark
+
+static dvec3 RandomDirection(mt19937 &random)
+{
+    uniform_real_distribution<double> uniform(-1.0, 1.0);
+    double z = uniform(random);
+    double phi = 3.14159265358979323846*uniform(random);
+    double s = sqrt(1.0 - z*z);
+    return dvec3(s*cos(phi), s*sin(phi), z);
+}
+
+// Plummer sphere in G = M = 1 units with scale radius 1 (Aarseth, Henon &
+// Wielen 1974): a self-gravitating cluster in equilibrium
+static void BuildPlummerSphere(NBodySimulation &simulation, int count)
+{
+    mt19937 random(453);
+    uniform_real_distribution<double> unit(0.0, 1.0);
+
+    simulation.clear();
+    simulation.reserve(count);
+    for (int i = 0; i < count; i++) {
+        double r;
+        do {
+            r = 1.0/sqrt(pow(max(unit(random), 1e-12), -2.0/3.0) - 1.0);
+        } while (r > 20.0);
+
+        double q, g;
+        do {
+            q = unit(random);
+            g = 0.1*unit(random);
+        } while (g > q*q*pow(1.0 - q*q, 3.5));
+        double speed = q*sqrt(2.0)*pow(1.0 + r*r, -0.25);
+
+        simulation.addBody(RandomDirection(random)*r, RandomDirection(random)*speed, 1.0/count);
+    }
+    simulation.removeNetMomentum();
+}
+
+int BenchmarkNBody(int bodyCount, int steps)
+{
+    NBodySimulation simulation;
+    simulation.softening = 0.02;
+    simulation.openingAngle = 0.5;
+    simulation.forceMethod = FORCE_BARNES_HUT;
+    BuildPlummerSphere(simulation, bodyCount);
+
+    const double dt = 0.005;
+
+    cout << "Barnes-Hut N-body benchmark: " << bodyCount << " bodies, " << steps << " steps, theta "
+         << simulation.openingAngle << ", " << DefaultThreadPool().threadCount() + 1 << " threads" << endl;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    double initialEnergy = simulation.totalEnergy();
+    double firstPass = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cout << "  initial force pass " << firstPass << " ms, " << simulation.treeNodeCount() << " tree nodes" << endl;
+
+    long long interactions = 0;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < steps; i++) {
+        simulation.step(dt);
+        interactions += simulation.interactionsPerForcePass();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    double finalEnergy = simulation.totalEnergy();
+    cout << "  " << seconds*1000.0/steps << " ms/step, "
+         << interactions/seconds/1e6 << " M interactions/s, "
+         << double(interactions)/steps/bodyCount << " interactions/body" << endl;
+    cout << "  energy " << initialEnergy << " -> " << finalEnergy
+         << ", relative drift " << fabs((finalEnergy - initialEnergy)/initialEnergy) << endl;
+    return 0;
+}
@@ -0,0 +1,105 @@
+//
+//  NBody.h
+//  graphics_assig_5_06
+//
+//  Gravitational N-body integrator. Bodies are stored as structure-of-arrays
+//  in double precision and advanced with kick-drift-kick leapfrog, which is
+//  symplectic, so energy error stays bounded instead of drifting. Forces
+//  come from a Barnes-Hut octree (O(N log N)) evaluated across the thread
+//  pool, or from the exact SIMD direct sum in NBodyDirect for smaller
+//  systems.
+//
+
+#ifndef NBody_h
+#define NBody_h
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "NBodyDirect.h"
+
+using namespace glm;
+using namespace std;
+
+enum ForceMethod
+{
+    FORCE_AUTOMATIC,        // direct sum up to DIRECT_SUM_MAX_BODIES, tree above
+    FORCE_BARNES_HUT,
+    FORCE_DIRECT_SUM
+};
+
+// below this the O(N^2) SIMD kernel beats building and walking the tree
+const int DIRECT_SUM_MAX_BODIES = 20000;
+
+struct OctreeNode
+{
+    dvec3 centre;           // centre of the cube
+    double halfSize;
+    double mass;
+    dvec3 centreOfMass;
+    int firstChild;         // index of 8 consecutive children, -1 for a leaf
+    int firstBody;          // leaf body chain (see NBodySimulation::nextInLeaf), -1 if empty
+};
+
+class NBodySimulation
+{
+private:
+    vector<double> posX, posY, posZ;
+    vector<double> velX, velY, velZ;
+    vector<double> accX, accY, accZ;
+    vector<double> mass;
+    vector<double> potential;       // per unit mass, from the last force pass
+
+    vector<OctreeNode> tree;
+    vector<int> nextInLeaf;
+    DirectSumSolver directSum;
+
+    bool accelerationsValid = false;
+    long long interactionsLastPass = 0;
+
+    void buildTree();
+    void insertBody(int body);
+    void computeMassDistribution();
+    void computeForces();
+    void computeTreeForces();
+    void computeDirectForces();
+
+public:
+    double gravitationalConstant = 1.0;
+    double softening = 0.01;        // Plummer softening length
+    double openingAngle = 0.5;      // Barnes-Hut theta; 0 gives exact sums
+    ForceMethod forceMethod = FORCE_AUTOMATIC;
+
+    NBodySimulation();
+
+    int addBody(dvec3 position, dvec3 velocity, double bodyMass);
+    void clear();
+    void reserve(int count);
+
+    // one kick-drift-kick leapfrog step
+    void step(double dt);
+
+    // kinetic plus potential energy, using the potentials of the last force
+    // pass (forces are computed first if they are stale)
+    double totalEnergy();
+
+    // shifts velocities so the total momentum is zero
+    void removeNetMomentum();
+
+    dvec3 getPosition(int body) const;
+    dvec3 getVelocity(int body) const;
+    int bodyCount() const;
+    int treeNodeCount() const;
+
+    // body-body plus body-node interactions in the most recent force pass
+    long long interactionsPerForcePass() const;
+
+    // whether the most recent force pass used the direct sum
+    bool usedDirectSum() const;
+};
+
+// integrates a Plummer sphere of bodyCount bodies for the given number of
+// steps and prints step time, interactions per second and energy drift
+int BenchmarkNBody(int bodyCount, int steps);
+
+#endif /* NBody_h */
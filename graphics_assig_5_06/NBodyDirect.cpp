@@ -0,0 +1,411 @@
+//
+//  NBodyDirect.cpp
+//  graphics_assig_5_06
+//
+
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+#include "NBodyDirect.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define DIRECT_SUM_X86 1
+#include <immintrin.h>
+#endif
+
+// widest vector is 16 floats; padding bodies sit far away with no mass
+static const int PADDING = 16;
+static const float PADDING_POSITION = 1e18f;
+
+// 1024 sources * 4 floats = 16 KB, so a source tile stays in L1 while every
+// target of the block streams past it
+static const int SOURCE_TILE = 1024;
+
+// targets per parallel chunk; a multiple of PADDING so chunks stay aligned
+// to whole vectors
+static const int TARGET_BLOCK = 128;
+
+struct DirectSumArrays
+{
+    const float *x, *y, *z, *m;
+    float *ax, *ay, *az, *phi;
+};
+
+// adds the pull of sources [jBegin, jEnd) to targets [iBegin, iEnd)
+typedef void (*DirectSumTile)(const DirectSumArrays &a, int iBegin, int iEnd, int jBegin, int jEnd, float eps2);
+
+static void DirectTileScalar(const DirectSumArrays &a, int iBegin, int iEnd, int jBegin, int jEnd, float eps2)
+{
+    for (int i = iBegin; i < iEnd; i++) {
+        float xi = a.x[i], yi = a.y[i], zi = a.z[i];
+        float ax = 0.f, ay = 0.f, az = 0.f, phi = 0.f;
+        for (int j = jBegin; j < jEnd; j++) {
+            float dx = a.x[j] - xi, dy = a.y[j] - yi, dz = a.z[j] - zi;
+            float d2 = dx*dx + dy*dy + dz*dz;
+            if (d2 <= 0.f)
+                continue;
+            float invR = 1.f/sqrtf(d2 + eps2);
+            float mInvR = a.m[j]*invR;
+            float mInvR3 = mInvR*invR*invR;
+            ax += dx*mInvR3; ay += dy*mInvR3; az += dz*mInvR3;
+            phi -= mInvR;
+        }
+        a.ax[i] += ax; a.ay[i] += ay; a.az[i] += az;
+        a.phi[i] += phi;
+    }
+}
+
+#ifdef DIRECT_SUM_X86
+
+// Each kernel holds one vector of targets in registers and broadcasts one
+// source per iteration. The hardware reciprocal square root gets one Newton
+// step, y*(1.5 - 0.5*r2*y*y), to reach full float precision. Lanes where
+// the separation is exactly zero are masked out: that is how a body skips
+// itself without a branch.
+
+__attribute__((target("sse2")))
+static void DirectTileSSE(const DirectSumArrays &a, int iBegin, int iEnd, int jBegin, int jEnd, float eps2)
+{
+    const __m128 eps = _mm_set1_ps(eps2);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 threeHalves = _mm_set1_ps(1.5f);
+
+    for (int i = iBegin; i < iEnd; i += 4) {
+        __m128 xi = _mm_loadu_ps(a.x + i), yi = _mm_loadu_ps(a.y + i), zi = _mm_loadu_ps(a.z + i);
+        __m128 ax = zero, ay = zero, az = zero, phi = zero;
+
+        for (int j = jBegin; j < jEnd; j++) {
+            __m128 dx = _mm_sub_ps(_mm_set1_ps(a.x[j]), xi);
+            __m128 dy = _mm_sub_ps(_mm_set1_ps(a.y[j]), yi);
+            __m128 dz = _mm_sub_ps(_mm_set1_ps(a.z[j]), zi);
+            __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            __m128 r2 = _mm_add_ps(d2, eps);
+
+            __m128 invR = _mm_rsqrt_ps(r2);
+            invR = _mm_mul_ps(invR, _mm_sub_ps(threeHalves, _mm_mul_ps(_mm_mul_ps(half, r2), _mm_mul_ps(invR, invR))));
+            invR = _mm_and_ps(invR, _mm_cmpgt_ps(d2, zero));
+
+            __m128 mInvR = _mm_mul_ps(_mm_set1_ps(a.m[j]), invR);
+            __m128 mInvR3 = _mm_mul_ps(mInvR, _mm_mul_ps(invR, invR));
+            ax = _mm_add_ps(ax, _mm_mul_ps(dx, mInvR3));
+            ay = _mm_add_ps(ay, _mm_mul_ps(dy, mInvR3));
+            az = _mm_add_ps(az, _mm_mul_ps(dz, mInvR3));
+            phi = _mm_sub_ps(phi, mInvR);
+        }
+
+        _mm_storeu_ps(a.ax + i, _mm_add_ps(_mm_loadu_ps(a.ax + i), ax));
+        _mm_storeu_ps(a.ay + i, _mm_add_ps(_mm_loadu_ps(a.ay + i), ay));
+        _mm_storeu_ps(a.az + i, _mm_add_ps(_mm_loadu_ps(a.az + i), az));
+        _mm_storeu_ps(a.phi + i, _mm_add_ps(_mm_loadu_ps(a.phi + i), phi));
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static void DirectTileAVX2(const DirectSumArrays &a, int iBegin, int iEnd, int jBegin, int jEnd, float eps2)
+{
+    const __m256 eps = _mm256_set1_ps(eps2);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 threeHalves = _mm256_set1_ps(1.5f);
+
+    for (int i = iBegin; i < iEnd; i += 8) {
+        __m256 xi = _mm256_loadu_ps(a.x + i), yi = _mm256_loadu_ps(a.y + i), zi = _mm256_loadu_ps(a.z + i);
+        __m256 ax = zero, ay = zero, az = zero, phi = zero;
+
+        for (int j = jBegin; j < jEnd; j++) {
+            __m256 dx = _mm256_sub_ps(_mm256_set1_ps(a.x[j]), xi);
+            __m256 dy = _mm256_sub_ps(_mm256_set1_ps(a.y[j]), yi);
+            __m256 dz = _mm256_sub_ps(_mm256_set1_ps(a.z[j]), zi);
+            __m256 d2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz)));
+            __m256 r2 = _mm256_add_ps(d2, eps);
+
+            __m256 invR = _mm256_rsqrt_ps(r2);
+            invR = _mm256_mul_ps(invR, _mm256_fnmadd_ps(_mm256_mul_ps(half, r2), _mm256_mul_ps(invR, invR), threeHalves));
+            invR = _mm256_and_ps(invR, _mm256_cmp_ps(d2, zero, _CMP_GT_OQ));
+
+            __m256 mInvR = _mm256_mul_ps(_mm256_set1_ps(a.m[j]), invR);
+            __m256 mInvR3 = _mm256_mul_ps(mInvR, _mm256_mul_ps(invR, invR));
+            ax = _mm256_fmadd_ps(dx, mInvR3, ax);
+            ay = _mm256_fmadd_ps(dy, mInvR3, ay);
+            az = _mm256_fmadd_ps(dz, mInvR3, az);
+            phi = _mm256_sub_ps(phi, mInvR);
+        }
+
+        _mm256_storeu_ps(a.ax + i, _mm256_add_ps(_mm256_loadu_ps(a.ax + i), ax));
+        _mm256_storeu_ps(a.ay + i, _mm256_add_ps(_mm256_loadu_ps(a.ay + i), ay));
+        _mm256_storeu_ps(a.az + i, _mm256_add_ps(_mm256_loadu_ps(a.az + i), az));
+        _mm256_storeu_ps(a.phi + i, _mm256_add_ps(_mm256_loadu_ps(a.phi + i), phi));
+    }
+}
+
+__attribute__((target("avx512f")))
+static void DirectTileAVX512(const DirectSumArrays &a, int iBegin, int iEnd, int jBegin, int jEnd, float eps2)
+{
+    const __m512 eps = _mm512_set1_ps(eps2);
+    const __m512 zero = _mm512_setzero_ps();
+    const __m512 half = _mm512_set1_ps(0.5f);
+    const __m512 threeHalves = _mm512_set1_ps(1.5f);
+
+    for (int i = iBegin; i < iEnd; i += 16) {
+        __m512 xi = _mm512_loadu_ps(a.x + i), yi = _mm512_loadu_ps(a.y + i), zi = _mm512_loadu_ps(a.z + i);
+        __m512 ax = zero, ay = zero, az = zero, phi = zero;
+
+        for (int j = jBegin; j < jEnd; j++) {
+            __m512 dx = _mm512_sub_ps(_mm512_set1_ps(a.x[j]), xi);
+            __m512 dy = _mm512_sub_ps(_mm512_set1_ps(a.y[j]), yi);
+            __m512 dz = _mm512_sub_ps(_mm512_set1_ps(a.z[j]), zi);
+            __m512 d2 = _mm512_fmadd_ps(dx, dx, _mm512_fmadd_ps(dy, dy, _mm512_mul_ps(dz, dz)));
+            __m512 r2 = _mm512_add_ps(d2, eps);
+
+            __m512 invR = _mm512_maskz_rsqrt14_ps(_mm512_cmp_ps_mask(d2, zero, _CMP_GT_OQ), r2);
+            invR = _mm512_mul_ps(invR, _mm512_fnmadd_ps(_mm512_mul_ps(half, r2), _mm512_mul_ps(invR, invR), threeHalves));
+
+            __m512 mInvR = _mm512_mul_ps(_mm512_set1_ps(a.m[j]), invR);
+            __m512 mInvR3 = _mm512_mul_ps(mInvR, _mm512_mul_ps(invR, invR));
+            ax = _mm512_fmadd_ps(dx, mInvR3, ax);
+            ay = _mm512_fmadd_ps(dy, mInvR3, ay);
+            az = _mm512_fmadd_ps(dz, mInvR3, az);
+            phi = _mm512_sub_ps(phi, mInvR);
+        }
+
+        _mm512_storeu_ps(a.ax + i, _mm512_add_ps(_mm512_loadu_ps(a.ax + i), ax));
+        _mm512_storeu_ps(a.ay + i, _mm512_add_ps(_mm512_loadu_ps(a.ay + i), ay));
+        _mm512_storeu_ps(a.az + i, _mm512_add_ps(_mm512_loadu_ps(a.az + i), az));
+        _mm512_storeu_ps(a.phi + i, _mm512_add_ps(_mm512_loadu_ps(a.phi + i), phi));
+    }
+}
+
+#endif
+
+bool DirectSumKernelSupported(DirectSumKernel kernel)
+{
+    switch (kernel) {
+        case DIRECT_SUM_SCALAR:
+            return true;
+#ifdef DIRECT_SUM_X86
+        case DIRECT_SUM_SSE:
+            return __builtin_cpu_supports("sse2");
+        case DIRECT_SUM_AVX2:
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        case DIRECT_SUM_AVX512:
+            return __builtin_cpu_supports("avx512f");
+#endif
+        default:
+            return false;
+    }
+}
+
+DirectSumKernel BestDirectSumKernel()
+{
+    static DirectSumKernel best = [] {
+        for (int kernel = DIRECT_SUM_KERNEL_COUNT - 1; kernel > DIRECT_SUM_SCALAR; kernel--)
+            if (DirectSumKernelSupported((DirectSumKernel)kernel))
+                return (DirectSumKernel)kernel;
+        return DIRECT_SUM_SCALAR;
+    }();
+    return best;
+}
+
+const char* DirectSumKernelName(DirectSumKernel kernel)
+{
+    switch (kernel) {
+        case DIRECT_SUM_SCALAR: return "scalar";
+        case DIRECT_SUM_SSE:    return "SSE";
+        case DIRECT_SUM_AVX2:   return "AVX2";
+        case DIRECT_SUM_AVX512: return "AVX-512";
+        default:                return "unknown";
+    }
+}
+
+static DirectSumTile TileFunction(DirectSumKernel kernel)
+{
+#ifdef DIRECT_SUM_X86
+    switch (kernel) {
+        case DIRECT_SUM_SSE:    return DirectTileSSE;
+        case DIRECT_SUM_AVX2:   return DirectTileAVX2;
+        case DIRECT_SUM_AVX512: return DirectTileAVX512;
+        default:                break;
+    }
+#endif
+    return DirectTileScalar;
+}
+
+// --------------------------------------------------------------------------
+// Solver
+
+DirectSumSolver :: DirectSumSolver()
+{}
+
+void DirectSumSolver :: setBodies(const double *x, const double *y, const double *z, const double *m, int bodyCount)
+{
+    count = bodyCount;
+    int padded = (bodyCount + PADDING - 1)/PADDING*PADDING;
+
+    posX.assign(padded, PADDING_POSITION);
+    posY.assign(padded, PADDING_POSITION);
+    posZ.assign(padded, PADDING_POSITION);
+    mass.assign(padded, 0.f);
+    accX.resize(padded); accY.resize(padded); accZ.resize(padded);
+    potential.resize(padded);
+
+    for (int i = 0; i < bodyCount; i++) {
+        posX[i] = (float)x[i]; posY[i] = (float)y[i]; posZ[i] = (float)z[i];
+        mass[i] = (float)m[i];
+    }
+}
+
+void DirectSumSolver :: compute(float softening, DirectSumKernel kernel)
+{
+    if (!DirectSumKernelSupported(kernel))
+        kernel = BestDirectSumKernel();
+    DirectSumTile tile = TileFunction(kernel);
+
+    int padded = (int)mass.size();
+    fill(accX.begin(), accX.end(), 0.f);
+    fill(accY.begin(), accY.end(), 0.f);
+    fill(accZ.begin(), accZ.end(), 0.f);
+    fill(potential.begin(), potential.end(), 0.f);
+
+    DirectSumArrays arrays = { posX.data(), posY.data(), posZ.data(), mass.data(),
+                               accX.data(), accY.data(), accZ.data(), potential.data() };
+    float eps2 = softening*softening;
+
+    // padding sources have no mass, so only real bodies need visiting
+    int sourceEnd = count;
+    ParallelFor(0, padded, TARGET_BLOCK, [&](int begin, int end) {
+        for (int j = 0; j < sourceEnd; j += SOURCE_TILE)
+            tile(arrays, begin, end, j, min(j + SOURCE_TILE, sourceEnd), eps2);
+    });
+}
+
+int DirectSumSolver :: bodyCount() const
+{
+    return count;
+}
+
+float DirectSumSolver :: getAccelerationX(int body) const
+{
+    return accX[body];
+}
+
+float DirectSumSolver :: getAccelerationY(int body) const
+{
+    return accY[body];
+}
+
+float DirectSumSolver :: getAccelerationZ(int body) const
+{
+    return accZ[body];
+}
+
+float DirectSumSolver :: getPotential(int body) const
+{
+    return potential[body];
+}
+
+void DirectSumReference(const double *x, const double *y, const double *z, const double *m, int bodyCount,
+                        double softening, double *ax, double *ay, double *az, double *phi)
+{
+    double eps2 = softening*softening;
+    for (int i = 0; i < bodyCount; i++) {
+        double sumX = 0.0, sumY = 0.0, sumZ = 0.0, sumPhi = 0.0;
+        for (int j = 0; j < bodyCount; j++) {
+            if (j == i)
+                continue;
+            double dx = x[j] - x[i], dy = y[j] - y[i], dz = z[j] - z[i];
+            double r2 = dx*dx + dy*dy + dz*dz + eps2;
+            double invR = 1.0/sqrt(r2);
+            double mInvR = m[j]*invR;
+            double mInvR3 = mInvR*invR*invR;
+            sumX += dx*mInvR3; sumY += dy*mInvR3; sumZ += dz*mInvR3;
+            sumPhi -= mInvR;
+        }
+        ax[i] = sumX; ay[i] = sumY; az[i] = sumZ;
+        phi[i] = sumPhi;
+    }
+}
+
+// --------------------------------------------------------------------------
+// Correctness check and throughput
+
+int CheckDirectSum(int bodyCount)
+{
+    const double softening = 0.01;
+    const double tolerance = 1e-4;
+    bodyCount = max(bodyCount, 2);
+
+    // uniform ball of unit radius and unit total mass
+    mt19937 random(2018);
+    uniform_real_distribution<double> unit(-1.0, 1.0);
+    vector<double> x(bodyCount), y(bodyCount), z(bodyCount), m(bodyCount, 1.0/bodyCount);
+    for (int i = 0; i < bodyCount; i++) {
+        do {
+            x[i] = unit(random); y[i] = unit(random); z[i] = unit(random);
+        } while (x[i]*x[i] + y[i]*y[i] + z[i]*z[i] > 1.0);
+    }
+
+    vector<double> ax(bodyCount), ay(bodyCount), az(bodyCount), phi(bodyCount);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    DirectSumReference(x.data(), y.data(), z.data(), m.data(), bodyCount, softening,
+                       ax.data(), ay.data(), az.data(), phi.data());
+    double referenceSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    double rmsForce = 0.0;
+    for (int i = 0; i < bodyCount; i++)
+        rmsForce += ax[i]*ax[i] + ay[i]*ay[i] + az[i]*az[i];
+    rmsForce = sqrt(rmsForce/bodyCount);
+
+    double interactions = double(bodyCount)*bodyCount;
+    cout << "Direct-sum check: " << bodyCount << " bodies, " << DefaultThreadPool().threadCount() + 1
+         << " threads, best kernel " << DirectSumKernelName(BestDirectSumKernel()) << endl;
+    cout << "  reference (double, 1 thread) " << referenceSeconds*1000.0 << " ms, "
+         << interactions*DIRECT_SUM_FLOPS_PER_INTERACTION/referenceSeconds/1e9 << " GFLOP/s" << endl;
+
+    DirectSumSolver solver;
+    solver.setBodies(x.data(), y.data(), z.data(), m.data(), bodyCount);
+
+    int failures = 0;
+    for (int k = 0; k < DIRECT_SUM_KERNEL_COUNT; k++) {
+        DirectSumKernel kernel = (DirectSumKernel)k;
+        if (!DirectSumKernelSupported(kernel)) {
+            cout << "  " << DirectSumKernelName(kernel) << ": not supported on this CPU" << endl;
+            continue;
+        }
+
+        // warm up once, then take the best of a few passes
+        solver.compute((float)softening, kernel);
+        double best = 1e30;
+        for (int pass = 0; pass < 3; pass++) {
+            start = chrono::steady_clock::now();
+            solver.compute((float)softening, kernel);
+            best = min(best, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        }
+
+        // force errors are measured against the RMS force: near the centre
+        // of the ball the net pull cancels to almost nothing
+        double worstForce = 0.0, worstPotential = 0.0;
+        for (int i = 0; i < bodyCount; i++) {
+            double dx = solver.getAccelerationX(i) - ax[i];
+            double dy = solver.getAccelerationY(i) - ay[i];
+            double dz = solver.getAccelerationZ(i) - az[i];
+            worstForce = max(worstForce, sqrt(dx*dx + dy*dy + dz*dz)/rmsForce);
+            worstPotential = max(worstPotential, fabs(solver.getPotential(i) - phi[i])/fabs(phi[i]));
+        }
+
+        bool pass = worstForce < tolerance && worstPotential < tolerance;
+        if (!pass)
+            failures++;
+        cout << "  " << DirectSumKernelName(kernel) << ": " << best*1000.0 << " ms, "
+             << interactions*DIRECT_SUM_FLOPS_PER_INTERACTION/best/1e9 << " GFLOP/s, "
+             << "max relative error force " << worstForce << " potential " << worstPotential
+             << (pass ? " ok" : " FAILED") << endl;
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,69 @@
+//
+//  NBodyDirect.h
+//  graphics_assig_5_06
+//
+//  Exact O(N^2) gravity for small and mid-sized clusters (up to ~20k
+//  bodies), where it beats the tree code. Bodies are copied into padded
+//  float SoA arrays; sources are processed in L1-sized tiles against blocks
+//  of targets spread over the thread pool, with SSE / AVX2 / AVX-512
+//  kernels picked at run time.
+//
+
+#ifndef NBodyDirect_h
+#define NBodyDirect_h
+
+#include <vector>
+
+using namespace std;
+
+enum DirectSumKernel
+{
+    DIRECT_SUM_SCALAR,
+    DIRECT_SUM_SSE,
+    DIRECT_SUM_AVX2,
+    DIRECT_SUM_AVX512,
+    DIRECT_SUM_KERNEL_COUNT
+};
+
+bool DirectSumKernelSupported(DirectSumKernel kernel);
+DirectSumKernel BestDirectSumKernel();
+const char* DirectSumKernelName(DirectSumKernel kernel);
+
+// the conventional count per body-body interaction (Nyland et al., GPU
+// Gems 3), with the reciprocal square root as one operation; for GFLOP/s
+const int DIRECT_SUM_FLOPS_PER_INTERACTION = 20;
+
+class DirectSumSolver
+{
+private:
+    int count = 0;
+    vector<float> posX, posY, posZ, mass;
+    vector<float> accX, accY, accZ, potential;
+
+public:
+    DirectSumSolver();
+
+    // copies the bodies in, padding to a whole number of widest vectors
+    void setBodies(const double *x, const double *y, const double *z, const double *m, int bodyCount);
+
+    // accelerations and potentials per unit mass with G = 1; bodies at
+    // exactly the same position (including a body and itself) are skipped
+    void compute(float softening, DirectSumKernel kernel);
+
+    int bodyCount() const;
+    float getAccelerationX(int body) const;
+    float getAccelerationY(int body) const;
+    float getAccelerationZ(int body) const;
+    float getPotential(int body) const;
+};
+
+// straightforward double-precision sum, the reference for the kernels above
+void DirectSumReference(const double *x, const double *y, const double *z, const double *m, int bodyCount,
+                        double softening, double *ax, double *ay, double *az, double *phi);
+
+// compares every supported kernel with the reference on bodyCount random
+// bodies and prints the worst error relative to the RMS force and GFLOP/s; returns non-zero
+// if any kernel is outside tolerance
+int CheckDirectSum(int bodyCount);
+
+#endif /* NBodyDirect_h */
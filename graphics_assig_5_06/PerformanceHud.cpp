@@ -0,0 +1,370 @@
+//
+//  PerformanceHud.cpp
+//  graphics_assig_5_06
+//
+
+#include <cstdio>
+#include <cstddef>
+#include <cstring>
+#include <cctype>
+#include <cmath>
+#include <algorithm>
+
+#include "PerformanceHud.h"
+#include "Profiler.h"
+
+using namespace std;
+
+// 5x7 glyphs for ASCII 32-95, one byte per row, top row first, bit 4 is
+// the leftmost column. Lower case is drawn as upper case.
+static const int GLYPH_WIDTH = 5;
+static const int GLYPH_HEIGHT = 7;
+static const int FIRST_GLYPH = 32;
+static const int GLYPH_COUNT = 64;
+static const uint8_t FONT_GLYPHS[GLYPH_COUNT][GLYPH_HEIGHT] = {
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // ' '
+    { 0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04 },   // '!'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // '"'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // '#'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // '$'
+    { 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 },   // '%'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // '&'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // '''
+    { 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 },   // '('
+    { 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 },   // ')'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // '*'
+    { 0x00, 0x04, 0x04, 0x1f, 0x04, 0x04, 0x00 },   // '+'
+    { 0x00, 0x00, 0x00, 0x00, 0x0c, 0x04, 0x08 },   // ','
+    { 0x00, 0x00, 0x00, 0x1f, 0x00, 0x00, 0x00 },   // '-'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0c },   // '.'
+    { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 },   // '/'
+    { 0x0e, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0e },   // '0'
+    { 0x04, 0x0c, 0x04, 0x04, 0x04, 0x04, 0x0e },   // '1'
+    { 0x0e, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1f },   // '2'
+    { 0x1f, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0e },   // '3'
+    { 0x02, 0x06, 0x0a, 0x12, 0x1f, 0x02, 0x02 },   // '4'
+    { 0x1f, 0x10, 0x1e, 0x01, 0x01, 0x11, 0x0e },   // '5'
+    { 0x06, 0x08, 0x10, 0x1e, 0x11, 0x11, 0x0e },   // '6'
+    { 0x1f, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 },   // '7'
+    { 0x0e, 0x11, 0x11, 0x0e, 0x11, 0x11, 0x0e },   // '8'
+    { 0x0e, 0x11, 0x11, 0x0f, 0x01, 0x02, 0x0c },   // '9'
+    { 0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x0c, 0x00 },   // ':'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // ';'
+    { 0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02 },   // '<'
+    { 0x00, 0x00, 0x1f, 0x00, 0x1f, 0x00, 0x00 },   // '='
+    { 0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08 },   // '>'
+    { 0x0e, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 },   // '?'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // '@'
+    { 0x0e, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11 },   // 'A'
+    { 0x1e, 0x11, 0x11, 0x1e, 0x11, 0x11, 0x1e },   // 'B'
+    { 0x0e, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0e },   // 'C'
+    { 0x1c, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1c },   // 'D'
+    { 0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x1f },   // 'E'
+    { 0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x10 },   // 'F'
+    { 0x0e, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0f },   // 'G'
+    { 0x11, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11 },   // 'H'
+    { 0x0e, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0e },   // 'I'
+    { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0c },   // 'J'
+    { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 },   // 'K'
+    { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1f },   // 'L'
+    { 0x11, 0x1b, 0x15, 0x15, 0x11, 0x11, 0x11 },   // 'M'
+    { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 },   // 'N'
+    { 0x0e, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e },   // 'O'
+    { 0x1e, 0x11, 0x11, 0x1e, 0x10, 0x10, 0x10 },   // 'P'
+    { 0x0e, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0d },   // 'Q'
+    { 0x1e, 0x11, 0x11, 0x1e, 0x14, 0x12, 0x11 },   // 'R'
+    { 0x0f, 0x10, 0x10, 0x0e, 0x01, 0x01, 0x1e },   // 'S'
+    { 0x1f, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 },   // 'T'
+    { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e },   // 'U'
+    { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0a, 0x04 },   // 'V'
+    { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0a },   // 'W'
+    { 0x11, 0x11, 0x0a, 0x04, 0x0a, 0x11, 0x11 },   // 'X'
+    { 0x11, 0x11, 0x0a, 0x04, 0x04, 0x04, 0x04 },   // 'Y'
+    { 0x1f, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1f },   // 'Z'
+    { 0x0e, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0e },   // '['
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // backslash
+    { 0x0e, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0e },   // ']'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // '^'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1f },   // '_'
+};
+
+// atlas cells leave a blank column and row around each glyph so linear
+// neighbours never bleed; the cell after the last glyph is solid and
+// textures the rectangles
+static const int CELL_WIDTH = GLYPH_WIDTH + 1;
+static const int CELL_HEIGHT = GLYPH_HEIGHT + 1;
+static const int ATLAS_WIDTH = CELL_WIDTH*(GLYPH_COUNT + 1);
+static const int SOLID_CELL = GLYPH_COUNT;
+
+// layout in screen pixels
+static const float TEXT_SCALE = 2.f;
+static const float ADVANCE = CELL_WIDTH*TEXT_SCALE;
+static const float LINE_HEIGHT = (CELL_HEIGHT + 1)*TEXT_SCALE;
+static const float MARGIN = 8.f;
+static const float PADDING = 8.f;
+static const float PANEL_WIDTH = 26*ADVANCE + 2*PADDING;
+static const float HISTOGRAM_HEIGHT = 64.f;
+static const float HISTOGRAM_GAP = 4.f;
+// two lines, the histogram and its axis labels, then five lines of counters
+static const float PANEL_HEIGHT = 2*PADDING + 2*LINE_HEIGHT + HISTOGRAM_GAP + HISTOGRAM_HEIGHT + LINE_HEIGHT + 2*HISTOGRAM_GAP +
+                                  4*LINE_HEIGHT + GLYPH_HEIGHT*TEXT_SCALE;
+
+// frames averaged for the headline frame time, so it is readable
+static const int AVERAGE_FRAMES = 30;
+
+static uint32_t Colour(int r, int g, int b, int a = 255)
+{
+    return uint32_t(r) | uint32_t(g) << 8 | uint32_t(b) << 16 | uint32_t(a) << 24;
+}
+
+static const uint32_t TEXT_COLOUR = Colour(235, 235, 235);
+static const uint32_t PANEL_COLOUR = Colour(0, 0, 0, 170);
+static const uint32_t BAR_COLOUR = Colour(110, 170, 255);
+static const uint32_t PERCENTILE_COLOURS[3] = { Colour(90, 220, 110), Colour(240, 200, 60), Colour(240, 80, 70) };
+static const float PERCENTILES[3] = { 0.50f, 0.95f, 0.99f };
+
+void RenderCounters :: beginFrame()
+{
+    drawCalls = 0;
+    stateChanges = 0;
+    triangles = 0;
+}
+
+size_t TextureMemoryBytes(GLenum target, GLuint texture)
+{
+    const GLenum sizeQueries[] = { GL_TEXTURE_RED_SIZE, GL_TEXTURE_GREEN_SIZE, GL_TEXTURE_BLUE_SIZE,
+                                   GL_TEXTURE_ALPHA_SIZE, GL_TEXTURE_DEPTH_SIZE, GL_TEXTURE_STENCIL_SIZE };
+    // a cube map's levels are asked of one face; the other five match it
+    GLenum levelTarget = target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X : target;
+    size_t bytes = 0;
+    glBindTexture(target, texture);
+    for (int level = 0; ; level++) {
+        GLint width = 0, height = 0;
+        glGetTexLevelParameteriv(levelTarget, level, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(levelTarget, level, GL_TEXTURE_HEIGHT, &height);
+        if (width == 0 || height == 0)
+            break;
+        int bits = 0;
+        for (GLenum query : sizeQueries) {
+            GLint size = 0;
+            glGetTexLevelParameteriv(levelTarget, level, query, &size);
+            bits += size;
+        }
+        bytes += (size_t)width*height*bits/8;
+    }
+    glBindTexture(target, 0);
+    return target == GL_TEXTURE_CUBE_MAP ? 6*bytes : bytes;
+}
+
+bool PerformanceHud :: initialize(GLuint hudProgram)
+{
+    program = hudProgram;
+    if (program == 0)
+        return false;
+    screenSizeLocation = glGetUniformLocation(program, "screenSize");
+
+    vector<uint8_t> atlas((size_t)ATLAS_WIDTH*CELL_HEIGHT, 0);
+    for (int glyph = 0; glyph < GLYPH_COUNT; glyph++)
+        for (int row = 0; row < GLYPH_HEIGHT; row++)
+            for (int column = 0; column < GLYPH_WIDTH; column++)
+                if (FONT_GLYPHS[glyph][row] & (1 << (GLYPH_WIDTH - 1 - column)))
+                    atlas[(size_t)row*ATLAS_WIDTH + glyph*CELL_WIDTH + column] = 255;
+    for (int row = 0; row < CELL_HEIGHT; row++)
+        for (int column = 0; column < CELL_WIDTH; column++)
+            atlas[(size_t)row*ATLAS_WIDTH + SOLID_CELL*CELL_WIDTH + column] = 255;
+
+    glGenTextures(1, &fontTexture);
+    glBindTexture(GL_TEXTURE_2D, fontTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, ATLAS_WIDTH, CELL_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, atlas.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenVertexArrays(1, &vertexArray);
+    glGenBuffers(1, &vertexBuffer);
+    glBindVertexArray(vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, x));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, u));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (void*)offsetof(Vertex, colour));
+    glEnableVertexAttribArray(2);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+
+    return glGetError() == GL_NO_ERROR;
+}
+
+void PerformanceHud :: destroy()
+{
+    glDeleteBuffers(1, &vertexBuffer);
+    glDeleteVertexArrays(1, &vertexArray);
+    glDeleteTextures(1, &fontTexture);
+    glDeleteProgram(program);
+    vertexBuffer = vertexArray = fontTexture = program = 0;
+}
+
+void PerformanceHud :: setProgram(GLuint hudProgram)
+{
+    program = hudProgram;
+    screenSizeLocation = glGetUniformLocation(program, "screenSize");
+}
+
+void PerformanceHud :: addFrame(double frameMilliseconds)
+{
+    frameTimes[frameCount % HISTORY] = float(frameMilliseconds);
+    frameCount++;
+}
+
+void PerformanceHud :: addQuad(float x0, float y0, float x1, float y1, float u0, float v0, float u1, float v1, uint32_t colour)
+{
+    Vertex corners[4] = {
+        { x0, y0, u0, v0, colour }, { x1, y0, u1, v0, colour },
+        { x1, y1, u1, v1, colour }, { x0, y1, u0, v1, colour }
+    };
+    const int order[6] = { 0, 1, 2, 0, 2, 3 };
+    for (int i : order)
+        vertices.push_back(corners[i]);
+}
+
+void PerformanceHud :: addRect(float x0, float y0, float x1, float y1, uint32_t colour)
+{
+    // centre of the solid cell, which nearest filtering samples everywhere
+    float u = (SOLID_CELL*CELL_WIDTH + CELL_WIDTH*0.5f)/ATLAS_WIDTH;
+    float v = 0.5f;
+    addQuad(x0, y0, x1, y1, u, v, u, v, colour);
+}
+
+float PerformanceHud :: addText(float x, float y, const string &text, uint32_t colour)
+{
+    for (char c : text) {
+        int glyph = toupper((unsigned char)c) - FIRST_GLYPH;
+        if (glyph > 0 && glyph < GLYPH_COUNT) {
+            float u0 = float(glyph*CELL_WIDTH)/ATLAS_WIDTH;
+            float u1 = float(glyph*CELL_WIDTH + GLYPH_WIDTH)/ATLAS_WIDTH;
+            float v1 = float(GLYPH_HEIGHT)/CELL_HEIGHT;
+            addQuad(x, y, x + GLYPH_WIDTH*TEXT_SCALE, y + GLYPH_HEIGHT*TEXT_SCALE, u0, 0.f, u1, v1, colour);
+        }
+        x += ADVANCE;
+    }
+    return x;
+}
+
+// distribution of the recent frame times, with a marker at each percentile
+void PerformanceHud :: addHistogram(float x, float y, float width, float height, const float percentiles[3])
+{
+    // the range grows in 10 ms steps so the bars do not rescale every frame
+    float range = max(20.f, ceil(sorted.back()*1.1f/10.f)*10.f);
+    int counts[HISTOGRAM_BUCKETS] = {};
+    int tallest = 1;
+    for (float time : sorted) {
+        int bucket = min(HISTOGRAM_BUCKETS - 1, int(time/range*HISTOGRAM_BUCKETS));
+        tallest = max(tallest, ++counts[bucket]);
+    }
+
+    addRect(x, y, x + width, y + height, Colour(255, 255, 255, 30));
+    float barWidth = width/HISTOGRAM_BUCKETS;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        if (counts[i] == 0)
+            continue;
+        float barHeight = max(1.f, height*counts[i]/tallest);
+        addRect(x + i*barWidth, y + height - barHeight, x + (i + 1)*barWidth - 1.f, y + height, BAR_COLOUR);
+    }
+    for (int i = 0; i < 3; i++) {
+        float markerX = x + min(1.f, percentiles[i]/range)*width;
+        addRect(markerX - 1.f, y, markerX + 1.f, y + height, PERCENTILE_COLOURS[i]);
+    }
+
+    char label[32];
+    addText(x, y + height + HISTOGRAM_GAP, "0", TEXT_COLOUR);
+    snprintf(label, sizeof(label), "%.0f MS", range);
+    addText(x + width - ADVANCE*strlen(label), y + height + HISTOGRAM_GAP, label, TEXT_COLOUR);
+}
+
+void PerformanceHud :: render(int width, int height, const RenderCounters &counters)
+{
+    if (program == 0 || frameCount == 0)
+        return;
+    PROFILE_SCOPE("PerformanceHud::render");
+
+    int frames = min(frameCount, HISTORY);
+    sorted.assign(frameTimes, frameTimes + frames);
+    sort(sorted.begin(), sorted.end());
+    // nearest rank
+    float percentiles[3];
+    for (int i = 0; i < 3; i++)
+        percentiles[i] = sorted[max(0, int(ceil(PERCENTILES[i]*frames)) - 1)];
+
+    float average = 0.f;
+    int averaged = min(frameCount, AVERAGE_FRAMES);
+    for (int i = 1; i <= averaged; i++)
+        average += frameTimes[(frameCount - i) % HISTORY];
+    average /= averaged;
+
+    vertices.clear();
+    float x = MARGIN + PADDING;
+    float y = MARGIN + PADDING;
+    addRect(MARGIN, MARGIN, MARGIN + PANEL_WIDTH, MARGIN + PANEL_HEIGHT, PANEL_COLOUR);
+
+    char line[64];
+    snprintf(line, sizeof(line), "FRAME %.2f MS  %.0f FPS", average, average > 0.f ? 1000.f/average : 0.f);
+    addText(x, y, line, TEXT_COLOUR);
+    y += LINE_HEIGHT;
+
+    float column = x;
+    const char* names[3] = { "P50", "P95", "P99" };
+    for (int i = 0; i < 3; i++) {
+        snprintf(line, sizeof(line), "%s %.1f ", names[i], percentiles[i]);
+        column = addText(column, y, line, PERCENTILE_COLOURS[i]);
+    }
+    y += LINE_HEIGHT + HISTOGRAM_GAP;
+
+    addHistogram(x, y, PANEL_WIDTH - 2*PADDING, HISTOGRAM_HEIGHT, percentiles);
+    y += HISTOGRAM_HEIGHT + LINE_HEIGHT + 2*HISTOGRAM_GAP;
+
+    snprintf(line, sizeof(line), "DRAW CALLS %d", counters.drawCalls);
+    addText(x, y, line, TEXT_COLOUR);
+    y += LINE_HEIGHT;
+    snprintf(line, sizeof(line), "STATE CHANGES %d", counters.stateChanges);
+    addText(x, y, line, TEXT_COLOUR);
+    y += LINE_HEIGHT;
+    snprintf(line, sizeof(line), "TRIANGLES %lld", counters.triangles);
+    addText(x, y, line, TEXT_COLOUR);
+    y += LINE_HEIGHT;
+    snprintf(line, sizeof(line), "TEXTURES %.1f MB", counters.textureBytes/(1024.0*1024.0));
+    addText(x, y, line, TEXT_COLOUR);
+    y += LINE_HEIGHT;
+    snprintf(line, sizeof(line), "BUFFERS %.1f MB", counters.bufferBytes/(1024.0*1024.0));
+    addText(x, y, line, TEXT_COLOUR);
+
+    // the overlay goes over everything and blends with the scene
+    GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+    GLboolean blend = glIsEnabled(GL_BLEND);
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    glUseProgram(program);
+    glUniform2f(screenSizeLocation, float(width), float(height));
+    glBindVertexArray(vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    // orphan last frame's storage rather than wait for the GPU to finish it
+    glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex)*vertices.size(), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(Vertex)*vertices.size(), vertices.data());
+    glBindTexture(GL_TEXTURE_2D, fontTexture);
+    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)vertices.size());
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    glUseProgram(0);
+    if (depthTest)
+        glEnable(GL_DEPTH_TEST);
+    if (!blend)
+        glDisable(GL_BLEND);
+}
@@ -0,0 +1,86 @@
+//
+//  PerformanceHud.h
+//  graphics_assig_5_06
+//
+//  On-screen performance overlay (H key, or --hud). Shows the frame time,
+//  a histogram of the recent frame times with its 50th, 95th and 99th
+//  percentiles, and the scene's draw calls, state changes, triangles and
+//  texture and buffer memory. The overlay is drawn in its own pass after
+//  the scene: text and rectangles are built into one vertex array on the
+//  CPU and drawn with a single call, glyphs coming from a built-in 5x7
+//  bitmap font.
+//
+
+#ifndef PerformanceHud_h
+#define PerformanceHud_h
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <glad/glad.h>
+
+using namespace std;
+
+// Filled in by the render path as it issues GL calls; plain increments, so
+// counting costs nothing measurable. The per-frame fields are cleared by
+// beginFrame(); the memory totals are running sums of what was allocated.
+struct RenderCounters
+{
+    int drawCalls = 0;
+    int stateChanges = 0;           // program, vertex array and texture binds not skipped as redundant
+    long long triangles = 0;
+
+    size_t textureBytes = 0;
+    size_t bufferBytes = 0;
+
+    void beginFrame();
+};
+
+// bytes held by every mip level of a texture, from its internal format
+size_t TextureMemoryBytes(GLenum target, GLuint texture);
+
+class PerformanceHud
+{
+private:
+    static const int HISTORY = 256;         // frames in the histogram
+    static const int HISTOGRAM_BUCKETS = 48;
+
+    struct Vertex
+    {
+        float x, y;                         // pixels from the top left
+        float u, v;
+        uint32_t colour;                    // RGBA8
+    };
+
+    GLuint program = 0;
+    GLuint vertexArray = 0;
+    GLuint vertexBuffer = 0;
+    GLuint fontTexture = 0;
+    GLint screenSizeLocation = -1;
+
+    float frameTimes[HISTORY];
+    int frameCount = 0;
+    vector<float> sorted;
+    vector<Vertex> vertices;
+
+    void addQuad(float x0, float y0, float x1, float y1, float u0, float v0, float u1, float v1, uint32_t colour);
+    void addRect(float x0, float y0, float x1, float y1, uint32_t colour);
+    // returns the x after the last character
+    float addText(float x, float y, const string &text, uint32_t colour);
+    void addHistogram(float x, float y, float width, float height, const float percentiles[3]);
+
+public:
+    // program is built from shaders/hud_vertex.glsl and hud_fragment.glsl
+    bool initialize(GLuint program);
+    void destroy();
+
+    // uses a rebuilt program from here on; the caller deletes the old one
+    void setProgram(GLuint program);
+
+    void addFrame(double frameMilliseconds);
+
+    // draws over the bound framebuffer of the given size
+    void render(int width, int height, const RenderCounters &counters);
+};
+
+#endif /* PerformanceHud_h */
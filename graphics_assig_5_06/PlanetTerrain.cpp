@@ -0,0 +1,436 @@
+//
+//  PlanetTerrain.cpp
+//  graphics_assig_5_06
+//
+
+#include <iostream>
+#include <algorithm>
+#include <queue>
+#include <mutex>
+#include <cmath>
+#include <iterator>
+
+#include "PlanetTerrain.h"
+#include "SceneRenderer.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
+
+using namespace std;
+using namespace glm;
+
+namespace {
+
+const float PI = 3.14159265359f;
+
+const int GRID = TERRAIN_PATCH_CELLS + 1;                  // vertices along a patch edge
+const int GRID_VERTICES = GRID*GRID;
+const int PATCH_VERTICES = GRID_VERTICES + 4*GRID;         // and a skirt below each edge
+const int VERTEX_FLOATS = 8;                               // position, texture coordinate, normal
+
+// angle across one mesh cell in the middle of a face
+float CellArc(int level)
+{
+    return 0.5f*PI/float(1 << level)/TERRAIN_PATCH_CELLS;
+}
+
+// the triangles of every patch, which only differ in their vertices
+vector<uint16_t> PatchIndices()
+{
+    vector<uint16_t> indices;
+    for (int j = 0; j < TERRAIN_PATCH_CELLS; j++) {
+        for (int i = 0; i < TERRAIN_PATCH_CELLS; i++) {
+            uint16_t a = uint16_t(j*GRID + i), b = uint16_t(a + GRID);
+            uint16_t cell[6] = { a, uint16_t(a + 1), uint16_t(b + 1), a, uint16_t(b + 1), b };
+            indices.insert(indices.end(), cell, cell + 6);
+        }
+    }
+    // skirts below the bottom, top, left and right edges, wound so that
+    // every wall faces out of the patch
+    for (int edge = 0; edge < 4; edge++) {
+        for (int k = 0; k < TERRAIN_PATCH_CELLS; k++) {
+            int rim[4] = { k, TERRAIN_PATCH_CELLS*GRID + k, k*GRID, k*GRID + TERRAIN_PATCH_CELLS };
+            int step = edge < 2 ? 1 : GRID;
+            uint16_t e0 = uint16_t(rim[edge]), e1 = uint16_t(rim[edge] + step);
+            uint16_t s0 = uint16_t(GRID_VERTICES + edge*GRID + k), s1 = uint16_t(s0 + 1);
+            if (edge == 0 || edge == 2) {
+                uint16_t wall[6] = { e0, s0, s1, e0, s1, e1 };
+                indices.insert(indices.end(), wall, wall + 6);
+            } else {
+                uint16_t wall[6] = { e0, s1, s0, e0, e1, s1 };
+                indices.insert(indices.end(), wall, wall + 6);
+            }
+        }
+    }
+    return indices;
+}
+
+}
+
+struct PlanetTerrain :: LoadQueue
+{
+    mutex lock;
+    vector<PatchData> finished;
+
+    // patches finished after their terrain was destroyed
+    ~LoadQueue()
+    {
+        for (PatchData &data : finished)
+            FreeTextureImage(&data.albedo);
+    }
+};
+
+// --------------------------------------------------------------------------
+// Building patches, on the thread pool
+
+void PlanetTerrain :: buildPatch(const string &directory, float heightScale, PatchData &data)
+{
+    PROFILE_SCOPE("PlanetTerrain::buildPatch");
+    const TerrainPatchKey &key = data.key;
+    data.found = DecodeTextureImage(&data.albedo, TerrainTilePath(directory, key, "png").c_str());
+    if (!data.found)
+        return;
+
+    // every height sample, the outer ring only to take normals across
+    const int S = TERRAIN_HEIGHT_SAMPLES;
+    vector<float> heights;
+    bool hilly = heightScale > 0.f && ReadHeightTile(TerrainTilePath(directory, key, "height"), heights);
+    vector<vec3> directions(S*S), positions(S*S);
+    for (int row = 0; row < S; row++) {
+        for (int column = 0; column < S; column++) {
+            int sample = row*S + column;
+            directions[sample] = TerrainPatchDirection(key, float(column - 1)/TERRAIN_PATCH_CELLS, float(row - 1)/TERRAIN_PATCH_CELLS);
+            positions[sample] = directions[sample]*(1.f + (hilly ? heights[sample]*heightScale : 0.f));
+        }
+    }
+
+    // skirts hang deep enough to cover a coarser neighbour's cells and any
+    // mountain between them
+    const float T = float(TERRAIN_ALBEDO_TEXELS);
+    float skirt = 2.f*CellArc(key.level) + heightScale;
+    data.vertices.resize(PATCH_VERTICES*VERTEX_FLOATS);
+    auto emit = [&](int vertex, int i, int j, float depth) {
+        int sample = (j + 1)*S + i + 1;
+        vec3 normal = directions[sample];
+        if (hilly)
+            normal = normalize(cross(positions[sample + 1] - positions[sample - 1], positions[sample + S] - positions[sample - S]));
+        vec3 position = positions[sample] - directions[sample]*depth;
+        float *out = &data.vertices[vertex*VERTEX_FLOATS];
+        out[0] = position.x;
+        out[1] = position.y;
+        out[2] = position.z;
+        // the edges of the patch fall on the centres of the outer texels
+        out[3] = (0.5f + float(i)/TERRAIN_PATCH_CELLS*(T - 1.f))/T;
+        out[4] = (0.5f + float(j)/TERRAIN_PATCH_CELLS*(T - 1.f))/T;
+        out[5] = normal.x;
+        out[6] = normal.y;
+        out[7] = normal.z;
+    };
+    for (int j = 0; j < GRID; j++)
+        for (int i = 0; i < GRID; i++)
+            emit(j*GRID + i, i, j, 0.f);
+    for (int k = 0; k < GRID; k++) {
+        emit(GRID_VERTICES + k, k, 0, skirt);
+        emit(GRID_VERTICES + GRID + k, k, TERRAIN_PATCH_CELLS, skirt);
+        emit(GRID_VERTICES + 2*GRID + k, 0, k, skirt);
+        emit(GRID_VERTICES + 3*GRID + k, TERRAIN_PATCH_CELLS, k, skirt);
+    }
+}
+
+// --------------------------------------------------------------------------
+// GPU residency
+
+bool PlanetTerrain :: initialize(const string &directory, int levels, float heightScale)
+{
+    PROFILE_SCOPE("PlanetTerrain::initialize");
+    this->directory = directory;
+    this->levels = levels;
+    this->heightScale = heightScale;
+    queue = make_shared<LoadQueue>();
+    statistics = Statistics();
+
+    // filled through the array target; the patches' vertex arrays bind it
+    // for their elements
+    vector<uint16_t> indices = PatchIndices();
+    indexCount = GLsizei(indices.size());
+    glGenBuffers(1, &indexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, indexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(uint16_t)*indices.size(), indices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // the six faces are always drawn, so they are in place before the first frame
+    vector<PatchData> roots(6);
+    ParallelFor(0, 6, 1, [&](int begin, int end) {
+        for (int face = begin; face < end; face++) {
+            roots[face].key.face = face;
+            buildPatch(directory, heightScale, roots[face]);
+        }
+    });
+    bool complete = true;
+    for (PatchData &root : roots) {
+        complete = complete && root.found;
+        upload(root);
+    }
+    if (!complete) {
+        cout << "Terrain: " << directory << " is missing level 0 tiles" << endl;
+        destroy();
+        return false;
+    }
+    return true;
+}
+
+void PlanetTerrain :: upload(PatchData &data)
+{
+    Patch &patch = patches[data.key.packed()];
+    patch.key = data.key;
+    if (!data.found) {
+        patch.state = PATCH_MISSING;
+        return;
+    }
+
+    glGenBuffers(1, &patch.vertexBuffer);
+    glGenVertexArrays(1, &patch.vertexArray);
+    glBindVertexArray(patch.vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, patch.vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(float)*data.vertices.size(), data.vertices.data(), GL_STATIC_DRAW);
+    const GLsizei stride = VERTEX_FLOATS*sizeof(float);
+    glVertexAttribPointer(VERTEX_INDEX, 3, GL_FLOAT, GL_FALSE, stride, (const void*)0);
+    glVertexAttribPointer(TEXTURE_INDEX, 2, GL_FLOAT, GL_FALSE, stride, (const void*)(3*sizeof(float)));
+    glVertexAttribPointer(NORMAL_INDEX, 3, GL_FLOAT, GL_FALSE, stride, (const void*)(5*sizeof(float)));
+    glEnableVertexAttribArray(VERTEX_INDEX);
+    glEnableVertexAttribArray(TEXTURE_INDEX);
+    glEnableVertexAttribArray(NORMAL_INDEX);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    bool uploaded = UploadTexture(&patch.albedo, data.albedo);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    FreeTextureImage(&data.albedo);
+    if (!uploaded) {
+        cout << "Terrain: could not upload " << TerrainTilePath(directory, data.key, "png") << endl;
+        release(patch);
+        patch.state = PATCH_MISSING;
+        return;
+    }
+    patch.state = PATCH_RESIDENT;
+    statistics.residentPatches++;
+    statistics.patchesLoaded++;
+}
+
+void PlanetTerrain :: release(Patch &patch)
+{
+    glDeleteVertexArrays(1, &patch.vertexArray);
+    glDeleteBuffers(1, &patch.vertexBuffer);
+    if (patch.albedo.textureID != 0)
+        DestroyTexture(&patch.albedo);
+    patch.vertexArray = 0;
+    patch.vertexBuffer = 0;
+    patch.albedo = MyTexture();
+}
+
+// queues the most needed of the wanted patches that are not already loading
+void PlanetTerrain :: request(vector<Candidate> &wanted)
+{
+    sort(wanted.begin(), wanted.end(), [](const Candidate &a, const Candidate &b) { return a.first > b.first; });
+    for (const Candidate &candidate : wanted) {
+        if (statistics.loadingPatches >= MAX_LOADING_PATCHES)
+            break;
+        auto inserted = patches.insert(make_pair(candidate.second.packed(), Patch()));
+        if (!inserted.second)
+            continue;
+        inserted.first->second.key = candidate.second;
+        inserted.first->second.lastUsed = frame;
+        statistics.loadingPatches++;
+
+        shared_ptr<LoadQueue> queue = this->queue;
+        string directory = this->directory;
+        float heightScale = this->heightScale;
+        TerrainPatchKey key = candidate.second;
+        DefaultThreadPool().submit([queue, directory, heightScale, key]() {
+            PatchData data;
+            data.key = key;
+            buildPatch(directory, heightScale, data);
+            lock_guard<mutex> lock(queue->lock);
+            queue->finished.push_back(move(data));
+        });
+    }
+}
+
+// drops the patches left unused longest until the budget is met; the six
+// faces and anything used this frame stay
+void PlanetTerrain :: evict()
+{
+    if (statistics.residentPatches <= MAX_RESIDENT_PATCHES)
+        return;
+    vector<pair<uint64_t, uint64_t>> idle;     // last used, key
+    for (const auto &entry : patches) {
+        const Patch &patch = entry.second;
+        if (patch.state == PATCH_RESIDENT && patch.key.level > 0 && patch.lastUsed < frame)
+            idle.push_back(make_pair(patch.lastUsed, entry.first));
+    }
+    sort(idle.begin(), idle.end());
+    size_t excess = std::min(idle.size(), size_t(statistics.residentPatches - MAX_RESIDENT_PATCHES));
+    for (size_t i = 0; i < excess; i++) {
+        auto found = patches.find(idle[i].second);
+        release(found->second);
+        patches.erase(found);
+        statistics.residentPatches--;
+        statistics.patchesEvicted++;
+    }
+}
+
+void PlanetTerrain :: destroy()
+{
+    for (auto &entry : patches)
+        release(entry.second);
+    patches.clear();
+    selected.clear();
+    glDeleteBuffers(1, &indexBuffer);
+    indexBuffer = 0;
+    queue.reset();
+    statistics.residentPatches = 0;
+    statistics.loadingPatches = 0;
+}
+
+// --------------------------------------------------------------------------
+// Choosing patches
+
+PlanetTerrain::PatchBounds PlanetTerrain :: bounds(const TerrainPatchKey &key) const
+{
+    PatchBounds bounds;
+    bounds.centre = TerrainPatchDirection(key, 0.5f, 0.5f);
+    bounds.radius = 0.f;
+    float nearest = 1.f;
+    for (int corner = 0; corner < 4; corner++) {
+        vec3 point = TerrainPatchDirection(key, float(corner & 1), float(corner >> 1));
+        bounds.radius = std::max(bounds.radius, length(point - bounds.centre));
+        nearest = std::min(nearest, dot(point, bounds.centre));
+    }
+    bounds.radius = 1.01f*bounds.radius + heightScale;
+    bounds.spread = acos(std::max(-1.f, std::min(1.f, nearest)));
+    return bounds;
+}
+
+void PlanetTerrain :: update(const mat4 &modelViewProjection, vec3 eye, float pixelsPerUnit)
+{
+    PROFILE_SCOPE("PlanetTerrain::update");
+    frame++;
+
+    // a few finished patches a frame; the rest wait their turn
+    vector<PatchData> finished;
+    {
+        lock_guard<mutex> lock(queue->lock);
+        size_t count = std::min(queue->finished.size(), size_t(MAX_UPLOADS_PER_FRAME));
+        finished.assign(make_move_iterator(queue->finished.begin()), make_move_iterator(queue->finished.begin() + count));
+        queue->finished.erase(queue->finished.begin(), queue->finished.begin() + count);
+    }
+    for (PatchData &data : finished) {
+        upload(data);
+        statistics.loadingPatches--;
+    }
+
+    // the view frustum's planes in the sphere's own space, inside positive
+    vec4 planes[6];
+    for (int axis = 0; axis < 3; axis++) {
+        vec4 row(modelViewProjection[0][axis], modelViewProjection[1][axis], modelViewProjection[2][axis], modelViewProjection[3][axis]);
+        vec4 w(modelViewProjection[0][3], modelViewProjection[1][3], modelViewProjection[2][3], modelViewProjection[3][3]);
+        planes[2*axis] = w + row;
+        planes[2*axis + 1] = w - row;
+    }
+
+    // Beyond the horizon the sphere hides everything but mountain tops,
+    // which stick out for the angle a mountain's own horizon adds.
+    float eyeDistance = length(eye);
+    vec3 eyeDirection = eye/eyeDistance;
+    float horizon = PI;
+    if (eyeDistance > 1.f)
+        horizon = acos(1.f/eyeDistance) + acos(1.f/(1.f + heightScale));
+
+    auto visible = [&](const PatchBounds &patch) {
+        for (const vec4 &plane : planes)
+            if (dot(vec3(plane), patch.centre) + plane.w < -patch.radius*length(vec3(plane)))
+                return false;
+        return acos(std::max(-1.f, std::min(1.f, dot(patch.centre, eyeDirection)))) - patch.spread <= horizon;
+    };
+    // pixels across a cell at the patch's nearest possible point
+    auto screenError = [&](const TerrainPatchKey &key, const PatchBounds &patch) {
+        return CellArc(key.level)*pixelsPerUnit/std::max(length(eye - patch.centre) - patch.radius, 1e-5f);
+    };
+
+    auto lower = [](const Candidate &a, const Candidate &b) { return a.first < b.first; };
+    priority_queue<Candidate, vector<Candidate>, decltype(lower)> open(lower);
+    vector<Candidate> wanted;
+    for (int face = 0; face < 6; face++) {
+        TerrainPatchKey key;
+        key.face = face;
+        patches[key.packed()].lastUsed = frame;
+        PatchBounds patch = bounds(key);
+        if (visible(patch))
+            open.push(Candidate(screenError(key, patch), key));
+    }
+
+    // Splits the patch with the largest error until every patch is fine
+    // enough, the budget is spent or the children needed are not loaded.
+    selected.clear();
+    statistics.deepestLevel = 0;
+    int drawn = int(open.size());
+    while (!open.empty()) {
+        Candidate top = open.top();
+        open.pop();
+        const TerrainPatchKey &key = top.second;
+        bool split = top.first > maxCellPixels && key.level + 1 < levels;
+        Candidate children[4];
+        int count = 0;
+        if (split) {
+            bool ready = true;
+            for (int index = 0; index < 4; index++) {
+                TerrainPatchKey child = key.child(index);
+                PatchBounds patch = bounds(child);
+                if (!visible(patch))
+                    continue;
+                children[count++] = Candidate(screenError(child, patch), child);
+                auto found = patches.find(child.packed());
+                if (found == patches.end()) {
+                    wanted.push_back(Candidate(top.first, child));
+                    ready = false;
+                    continue;
+                }
+                found->second.lastUsed = frame;
+                if (found->second.state == PATCH_MISSING)
+                    split = false;
+                ready = ready && found->second.state == PATCH_RESIDENT;
+            }
+            split = split && ready && drawn - 1 + count <= MAX_DRAWN_PATCHES;
+        }
+        if (split) {
+            for (int index = 0; index < count; index++)
+                open.push(children[index]);
+            drawn += count - 1;
+        } else {
+            selected.push_back(key.packed());
+            statistics.deepestLevel = std::max(statistics.deepestLevel, key.level);
+        }
+    }
+
+    request(wanted);
+    evict();
+    statistics.drawnPatches = int(selected.size());
+    statistics.drawnTriangles = int(selected.size())*indexCount/3;
+}
+
+int PlanetTerrain :: draw() const
+{
+    PROFILE_SCOPE("PlanetTerrain::draw");
+    for (uint64_t packed : selected) {
+        const Patch &patch = patches.at(packed);
+        BindVertexArray(patch.vertexArray);
+        BindTexture(0, GL_TEXTURE_2D, patch.albedo.textureID);
+        glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_SHORT, 0);
+    }
+    return statistics.drawnTriangles;
+}
+
+const PlanetTerrain::Statistics& PlanetTerrain :: getStatistics() const
+{
+    return statistics;
+}
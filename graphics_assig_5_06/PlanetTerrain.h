@@ -0,0 +1,137 @@
+//
+//  PlanetTerrain.h
+//  graphics_assig_5_06
+//
+//  Draws a body's surface from the quadtree of tiles in TerrainTiles.h
+//  instead of one sphere mesh. Every frame update() walks the tree from the
+//  six faces, always splitting the patch whose cells look largest on
+//  screen, until cells are under maxCellPixels or MAX_DRAWN_PATCHES would
+//  be exceeded. Patches outside the view or behind the horizon are left
+//  out.
+//
+//  A patch is only split once its four children are on the GPU. Missing
+//  children are read and meshed on the thread pool, most needed first, and
+//  uploaded a few per frame; until then the parent is drawn. Patches not
+//  used for a while are dropped beyond MAX_RESIDENT_PATCHES, so memory
+//  stays bounded wherever the camera goes.
+//
+//  Each patch hangs a skirt below its edges, which hides the cracks where
+//  it meets a neighbour of another level.
+//
+
+#ifndef PlanetTerrain_h
+#define PlanetTerrain_h
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "TerrainTiles.h"
+#include "texture.h"
+
+using namespace glm;
+using namespace std;
+
+class PlanetTerrain
+{
+public:
+    static const int MAX_DRAWN_PATCHES = 160;
+    static const int MAX_RESIDENT_PATCHES = 320;    // some 60 MB of albedo
+    static const int MAX_LOADING_PATCHES = 16;
+    static const int MAX_UPLOADS_PER_FRAME = 8;
+
+    struct Statistics
+    {
+        int drawnPatches = 0;
+        int drawnTriangles = 0;
+        int deepestLevel = 0;
+        int residentPatches = 0;
+        int loadingPatches = 0;
+        int patchesLoaded = 0;      // since initialize()
+        int patchesEvicted = 0;
+    };
+
+private:
+    enum PatchState
+    {
+        PATCH_LOADING,
+        PATCH_RESIDENT,
+        PATCH_MISSING       // no tiles on disk; never split into
+    };
+
+    struct Patch
+    {
+        TerrainPatchKey key;
+        PatchState state = PATCH_LOADING;
+        GLuint vertexArray = 0;
+        GLuint vertexBuffer = 0;
+        MyTexture albedo;
+        uint64_t lastUsed = 0;
+    };
+
+    // what a worker hands back: interleaved position, texture coordinate
+    // and normal per vertex, and the decoded albedo
+    struct PatchData
+    {
+        TerrainPatchKey key;
+        bool found = false;
+        vector<float> vertices;
+        TextureImage albedo;
+    };
+
+    struct PatchBounds
+    {
+        vec3 centre;        // the surface in the middle of the patch
+        float radius;       // of a sphere around all of it, mountains too
+        float spread;       // largest angle from the centre to a corner
+    };
+
+    typedef pair<float, TerrainPatchKey> Candidate;     // screen error, patch
+
+    // shared with the workers, so a PlanetTerrain can go while they run
+    struct LoadQueue;
+
+    string directory;
+    int levels = 0;
+    float heightScale = 0.f;
+    unordered_map<uint64_t, Patch> patches;
+    vector<uint64_t> selected;
+    shared_ptr<LoadQueue> queue;
+    GLuint indexBuffer = 0;
+    GLsizei indexCount = 0;
+    uint64_t frame = 0;
+    Statistics statistics;
+
+    static void buildPatch(const string &directory, float heightScale, PatchData &data);
+    void upload(PatchData &data);
+    void release(Patch &patch);
+    void request(vector<Candidate> &wanted);
+    void evict();
+    PatchBounds bounds(const TerrainPatchKey &key) const;
+
+public:
+    float maxCellPixels = 16.f;     // one albedo texel per pixel
+
+    // needs a current context; reads the six level 0 patches before
+    // returning, and fails if they are not all there
+    bool initialize(const string &directory, int levels, float heightScale);
+
+    // Chooses the patches to draw, from the unit sphere's modelViewProjection,
+    // the eye in the unit sphere's space and the pixels a unit covers at a
+    // distance of one, and uploads what the workers have finished.
+    void update(const mat4 &modelViewProjection, vec3 eye, float pixelsPerUnit);
+
+    // draws the chosen patches with whatever program is bound, which reads
+    // attributes 0, 1 and 2 and its texture from unit 0; returns triangles
+    int draw() const;
+
+    void destroy();
+
+    const Statistics& getStatistics() const;
+};
+
+#endif /* PlanetTerrain_h */
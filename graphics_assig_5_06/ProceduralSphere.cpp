@@ -0,0 +1,590 @@
+//
+//  ProceduralSphere.cpp
+//  graphics_assig_5_06
+//
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SPHERE_USE_SSE2 1
+#endif
+
+#include "ProceduralSphere.h"
+
+using namespace std;
+using namespace glm;
+
+namespace {
+
+const float PI = 3.14159265358979f;
+
+const int MAX_UV_SEGMENTS = 2048;
+const int MAX_ICO_LEVEL = 8;
+const int MAX_CUBE_CELLS = 512;
+
+// --------------------------------------------------------------------------
+// Topology
+//
+// Each sphere is made of patches whose vertices form a regular grid: one
+// patch for a UV sphere, a triangular grid per icosahedron face and a
+// square grid per cube face. The functions below list a patch's triangles
+// as indices into its grid, counter-clockwise seen from outside, through
+// sink.add(). They are constexpr so the compiler can fill the tables of
+// the common sizes; other sizes call them at run time.
+
+// segments + 1 vertices on each of rings + 1 rows from the north pole down;
+// the quads touching a pole are single triangles
+template <class Sink>
+constexpr void UvSphereTriangles(int segments, int rings, Sink &sink)
+{
+    for (int ring = 0; ring < rings; ring++) {
+        int top = ring*(segments + 1);
+        int bottom = top + segments + 1;
+        for (int segment = 0; segment < segments; segment++) {
+            int a = top + segment, b = bottom + segment;
+            if (ring != 0)
+                sink.add(a, b, a + 1);
+            if (ring != rings - 1)
+                sink.add(a + 1, b, b + 1);
+        }
+    }
+}
+
+// rows from the apex of the face, row r holding r + 1 vertices
+template <class Sink>
+constexpr void TriangleGridTriangles(int frequency, Sink &sink)
+{
+    for (int row = 0; row < frequency; row++) {
+        int top = row*(row + 1)/2;
+        int bottom = top + row + 1;
+        for (int column = 0; column <= row; column++) {
+            sink.add(top + column, bottom + column, bottom + column + 1);
+            if (column < row)
+                sink.add(top + column, bottom + column + 1, top + column + 1);
+        }
+    }
+}
+
+// cells + 1 rows of cells + 1 vertices, columns along the face's right
+// vector and rows along its up vector
+template <class Sink>
+constexpr void QuadGridTriangles(int cells, Sink &sink)
+{
+    for (int row = 0; row < cells; row++) {
+        for (int column = 0; column < cells; column++) {
+            int a = row*(cells + 1) + column, b = a + cells + 1;
+            sink.add(a, a + 1, b + 1);
+            sink.add(a, b + 1, b);
+        }
+    }
+}
+
+template <int Size>
+struct IndexTable
+{
+    uint16_t indices[Size];
+    int count;
+
+    constexpr IndexTable() : indices(), count(0)
+    {}
+
+    constexpr void add(int a, int b, int c)
+    {
+        indices[count++] = uint16_t(a);
+        indices[count++] = uint16_t(b);
+        indices[count++] = uint16_t(c);
+    }
+};
+
+template <int Segments>
+constexpr IndexTable<6*Segments*(Segments/2 - 1)> UvSphereTable()
+{
+    IndexTable<6*Segments*(Segments/2 - 1)> table;
+    UvSphereTriangles(Segments, Segments/2, table);
+    return table;
+}
+
+template <int Frequency>
+constexpr IndexTable<3*Frequency*Frequency> TriangleGridTable()
+{
+    IndexTable<3*Frequency*Frequency> table;
+    TriangleGridTriangles(Frequency, table);
+    return table;
+}
+
+template <int Cells>
+constexpr IndexTable<6*Cells*Cells> QuadGridTable()
+{
+    IndexTable<6*Cells*Cells> table;
+    QuadGridTriangles(Cells, table);
+    return table;
+}
+
+constexpr auto uvSphere16 = UvSphereTable<16>();
+constexpr auto uvSphere32 = UvSphereTable<32>();
+constexpr auto uvSphere64 = UvSphereTable<64>();
+constexpr auto triangleGrid1 = TriangleGridTable<1>();
+constexpr auto triangleGrid2 = TriangleGridTable<2>();
+constexpr auto triangleGrid4 = TriangleGridTable<4>();
+constexpr auto triangleGrid8 = TriangleGridTable<8>();
+constexpr auto triangleGrid16 = TriangleGridTable<16>();
+constexpr auto triangleGrid32 = TriangleGridTable<32>();
+constexpr auto quadGrid4 = QuadGridTable<4>();
+constexpr auto quadGrid8 = QuadGridTable<8>();
+constexpr auto quadGrid16 = QuadGridTable<16>();
+constexpr auto quadGrid32 = QuadGridTable<32>();
+
+static_assert(uvSphere32.count == 3*960, "a 32-segment UV sphere has the triangles of sphere.obj");
+static_assert(triangleGrid32.indices[3*32*32 - 1] == 32*33/2 + 32, "triangle grids end at the last vertex");
+
+// a patch's index list, from a table or built for an uncommon size
+struct Topology
+{
+    const uint16_t *table = nullptr;
+    vector<uint32_t> built;
+    size_t count = 0;
+
+    template <int Size>
+    void use(const IndexTable<Size> &source)
+    {
+        table = source.indices;
+        count = source.count;
+    }
+
+    void add(int a, int b, int c)
+    {
+        built.push_back(a);
+        built.push_back(b);
+        built.push_back(c);
+        count = built.size();
+    }
+};
+
+void UvSphereTopology(int segments, Topology &topology)
+{
+    switch (segments) {
+        case 16: topology.use(uvSphere16); return;
+        case 32: topology.use(uvSphere32); return;
+        case 64: topology.use(uvSphere64); return;
+    }
+    topology.built.reserve(6*segments*(segments/2 - 1));
+    UvSphereTriangles(segments, segments/2, topology);
+}
+
+void TriangleGridTopology(int frequency, Topology &topology)
+{
+    switch (frequency) {
+        case 1: topology.use(triangleGrid1); return;
+        case 2: topology.use(triangleGrid2); return;
+        case 4: topology.use(triangleGrid4); return;
+        case 8: topology.use(triangleGrid8); return;
+        case 16: topology.use(triangleGrid16); return;
+        case 32: topology.use(triangleGrid32); return;
+    }
+    topology.built.reserve(3*frequency*frequency);
+    TriangleGridTriangles(frequency, topology);
+}
+
+void QuadGridTopology(int cells, Topology &topology)
+{
+    switch (cells) {
+        case 4: topology.use(quadGrid4); return;
+        case 8: topology.use(quadGrid8); return;
+        case 16: topology.use(quadGrid16); return;
+        case 32: topology.use(quadGrid32); return;
+    }
+    topology.built.reserve(6*cells*cells);
+    QuadGridTriangles(cells, topology);
+}
+
+// --------------------------------------------------------------------------
+// Vertices
+//
+// A patch's grid is filled a row at a time, four vertices per step. Rows
+// are stored back to back, so the last step of a row may run into the next
+// one; rows are filled in order, which puts those vertices right again,
+// and the arrays have room for the last row's overrun.
+
+struct PatchVertices
+{
+    vector<float> x, y, z, u, v;
+
+    void resize(int count)
+    {
+        int padded = count + 4;
+        x.resize(padded);
+        y.resize(padded);
+        z.resize(padded);
+        u.resize(padded);
+        v.resize(padded);
+    }
+};
+
+#ifdef SPHERE_USE_SSE2
+inline __m128 Select(__m128 mask, __m128 whenSet, __m128 otherwise)
+{
+    return _mm_or_ps(_mm_and_ps(mask, whenSet), _mm_andnot_ps(mask, otherwise));
+}
+
+// atan2 to within about 1e-5 radians, which is well under a texel
+inline __m128 Atan2(__m128 y, __m128 x)
+{
+    const __m128 signBit = _mm_set1_ps(-0.f);
+    __m128 absX = _mm_andnot_ps(signBit, x);
+    __m128 absY = _mm_andnot_ps(signBit, y);
+    __m128 ratio = _mm_div_ps(_mm_min_ps(absX, absY), _mm_max_ps(_mm_max_ps(absX, absY), _mm_set1_ps(1e-30f)));
+    __m128 s = _mm_mul_ps(ratio, ratio);
+    __m128 r = _mm_set1_ps(-0.01172120f);
+    r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(0.05265332f));
+    r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(-0.11643287f));
+    r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(0.19354346f));
+    r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(-0.33262347f));
+    r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(0.99997726f));
+    r = _mm_mul_ps(r, ratio);
+    r = Select(_mm_cmpgt_ps(absY, absX), _mm_sub_ps(_mm_set1_ps(0.5f*PI), r), r);
+    r = Select(_mm_cmplt_ps(x, _mm_setzero_ps()), _mm_sub_ps(_mm_set1_ps(PI), r), r);
+    return _mm_or_ps(r, _mm_and_ps(y, signBit));
+}
+
+// stores four points already on the sphere with their texture coordinates
+inline void StoreSphereVertices(PatchVertices &patch, int index, __m128 x, __m128 y, __m128 z)
+{
+    __m128 horizontal = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(z, z)));
+    __m128 u = _mm_sub_ps(_mm_set1_ps(0.5f), _mm_mul_ps(Atan2(z, x), _mm_set1_ps(0.5f/PI)));
+    __m128 v = _mm_mul_ps(Atan2(horizontal, y), _mm_set1_ps(1.f/PI));
+    _mm_storeu_ps(&patch.x[index], x);
+    _mm_storeu_ps(&patch.y[index], y);
+    _mm_storeu_ps(&patch.z[index], z);
+    _mm_storeu_ps(&patch.u[index], u);
+    _mm_storeu_ps(&patch.v[index], v);
+}
+
+inline __m128 ColumnSteps(int column)
+{
+    return _mm_set_ps(float(column + 3), float(column + 2), float(column + 1), float(column));
+}
+#else
+inline void StoreSphereVertex(PatchVertices &patch, int index, float x, float y, float z)
+{
+    vec2 textureCoord = SphereTextureCoord(vec3(x, y, z));
+    patch.x[index] = x;
+    patch.y[index] = y;
+    patch.z[index] = z;
+    patch.u[index] = textureCoord.x;
+    patch.v[index] = textureCoord.y;
+}
+#endif
+
+// Texture coordinates are exact here: u follows the column and v the ring,
+// except that a pole vertex takes the u of the middle of its triangle.
+void UvSpherePatch(int segments, int rings, PatchVertices &patch)
+{
+    int columns = segments + 1;
+    patch.resize(columns*(rings + 1));
+
+    // the last column repeats the first exactly, so the seam has no gap
+    vector<float> cosines(columns + 3), sines(columns + 3);
+    for (int column = 0; column < segments; column++) {
+        double angle = 2.0*M_PI*column/segments;
+        cosines[column] = float(-cos(angle));
+        sines[column] = float(sin(angle));
+    }
+    cosines[segments] = cosines[0];
+    sines[segments] = sines[0];
+
+    for (int ring = 0; ring <= rings; ring++) {
+        double angle = M_PI*ring/rings;
+        float ringRadius = (ring == 0 || ring == rings) ? 0.f : float(sin(angle));
+        float height = ring == 0 ? 1.f : ring == rings ? -1.f : float(cos(angle));
+        float uOffset = ring == 0 ? -0.5f : ring == rings ? 0.5f : 0.f;
+        float v = float(ring)/rings;
+        int start = ring*columns;
+#ifdef SPHERE_USE_SSE2
+        __m128 radius4 = _mm_set1_ps(ringRadius);
+        __m128 height4 = _mm_set1_ps(height);
+        __m128 offset4 = _mm_set1_ps(uOffset);
+        __m128 uScale = _mm_set1_ps(1.f/segments);
+        __m128 v4 = _mm_set1_ps(v);
+        for (int column = 0; column < columns; column += 4) {
+            int index = start + column;
+            _mm_storeu_ps(&patch.x[index], _mm_mul_ps(radius4, _mm_loadu_ps(&cosines[column])));
+            _mm_storeu_ps(&patch.y[index], height4);
+            _mm_storeu_ps(&patch.z[index], _mm_mul_ps(radius4, _mm_loadu_ps(&sines[column])));
+            _mm_storeu_ps(&patch.u[index], _mm_mul_ps(_mm_add_ps(ColumnSteps(column), offset4), uScale));
+            _mm_storeu_ps(&patch.v[index], v4);
+        }
+#else
+        for (int column = 0; column < columns; column++) {
+            int index = start + column;
+            patch.x[index] = ringRadius*cosines[column];
+            patch.y[index] = height;
+            patch.z[index] = ringRadius*sines[column];
+            patch.u[index] = (column + uOffset)/segments;
+            patch.v[index] = v;
+        }
+#endif
+    }
+}
+
+// the twelve vertices and twenty faces of an icosahedron, counter-clockwise
+// from outside; no vertex sits on a pole
+const float GOLDEN = 1.61803398874989f;
+const float icosahedronVertices[12][3] = {
+    { -1.f, GOLDEN, 0.f }, { 1.f, GOLDEN, 0.f }, { -1.f, -GOLDEN, 0.f }, { 1.f, -GOLDEN, 0.f },
+    { 0.f, -1.f, GOLDEN }, { 0.f, 1.f, GOLDEN }, { 0.f, -1.f, -GOLDEN }, { 0.f, 1.f, -GOLDEN },
+    { GOLDEN, 0.f, -1.f }, { GOLDEN, 0.f, 1.f }, { -GOLDEN, 0.f, -1.f }, { -GOLDEN, 0.f, 1.f }
+};
+const int icosahedronFaces[20][3] = {
+    { 0, 11, 5 }, { 0, 5, 1 }, { 0, 1, 7 }, { 0, 7, 10 }, { 0, 10, 11 },
+    { 1, 5, 9 }, { 5, 11, 4 }, { 11, 10, 2 }, { 10, 7, 6 }, { 7, 1, 8 },
+    { 3, 9, 4 }, { 3, 4, 2 }, { 3, 2, 6 }, { 3, 6, 8 }, { 3, 8, 9 },
+    { 4, 9, 5 }, { 2, 4, 11 }, { 6, 2, 10 }, { 8, 6, 7 }, { 9, 8, 1 }
+};
+
+// points spread evenly over the flat face, then pushed out onto the sphere
+void IcospherePatch(int face, int frequency, PatchVertices &patch)
+{
+    patch.resize((frequency + 1)*(frequency + 2)/2);
+    vec3 apex = vec3(icosahedronVertices[icosahedronFaces[face][0]][0], icosahedronVertices[icosahedronFaces[face][0]][1],
+                     icosahedronVertices[icosahedronFaces[face][0]][2]);
+    vec3 left = vec3(icosahedronVertices[icosahedronFaces[face][1]][0], icosahedronVertices[icosahedronFaces[face][1]][1],
+                     icosahedronVertices[icosahedronFaces[face][1]][2]);
+    vec3 right = vec3(icosahedronVertices[icosahedronFaces[face][2]][0], icosahedronVertices[icosahedronFaces[face][2]][1],
+                      icosahedronVertices[icosahedronFaces[face][2]][2]);
+    vec3 down = (left - apex)/float(frequency);
+    vec3 across = (right - left)/float(frequency);
+
+    for (int row = 0; row <= frequency; row++) {
+        vec3 rowStart = apex + float(row)*down;
+        int start = row*(row + 1)/2;
+#ifdef SPHERE_USE_SSE2
+        for (int column = 0; column <= row; column += 4) {
+            __m128 steps = ColumnSteps(column);
+            __m128 x = _mm_add_ps(_mm_set1_ps(rowStart.x), _mm_mul_ps(steps, _mm_set1_ps(across.x)));
+            __m128 y = _mm_add_ps(_mm_set1_ps(rowStart.y), _mm_mul_ps(steps, _mm_set1_ps(across.y)));
+            __m128 z = _mm_add_ps(_mm_set1_ps(rowStart.z), _mm_mul_ps(steps, _mm_set1_ps(across.z)));
+            __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+            __m128 inverse = _mm_div_ps(_mm_set1_ps(1.f), length);
+            StoreSphereVertices(patch, start + column, _mm_mul_ps(x, inverse), _mm_mul_ps(y, inverse), _mm_mul_ps(z, inverse));
+        }
+#else
+        for (int column = 0; column <= row; column++) {
+            vec3 point = normalize(rowStart + float(column)*across);
+            StoreSphereVertex(patch, start + column, point.x, point.y, point.z);
+        }
+#endif
+    }
+}
+
+// outward normal, right and up of each cube face, with right x up = normal
+const float cubeFaces[6][3][3] = {
+    { { 1.f, 0.f, 0.f }, { 0.f, 0.f, -1.f }, { 0.f, 1.f, 0.f } },
+    { { -1.f, 0.f, 0.f }, { 0.f, 0.f, 1.f }, { 0.f, 1.f, 0.f } },
+    { { 0.f, 1.f, 0.f }, { 1.f, 0.f, 0.f }, { 0.f, 0.f, -1.f } },
+    { { 0.f, -1.f, 0.f }, { 1.f, 0.f, 0.f }, { 0.f, 0.f, 1.f } },
+    { { 0.f, 0.f, 1.f }, { 1.f, 0.f, 0.f }, { 0.f, 1.f, 0.f } },
+    { { 0.f, 0.f, -1.f }, { -1.f, 0.f, 0.f }, { 0.f, 1.f, 0.f } }
+};
+
+// A point p on the cube goes to p.x * sqrt(1 - p.y^2/2 - p.z^2/2 + p.y^2 p.z^2/3)
+// and so on, which lands on the unit sphere and keeps cells near the
+// corners about as large as those in the middle of a face.
+void CubeSpherePatch(int face, int cells, PatchVertices &patch)
+{
+    int columns = cells + 1;
+    patch.resize(columns*columns);
+    vec3 normal, right, up;
+    CubeSphereFace(face, normal, right, up);
+    vec3 across = right*(2.f/cells);
+
+    for (int row = 0; row <= cells; row++) {
+        vec3 rowStart = normal - right + up*(2.f*row/cells - 1.f);
+        int start = row*columns;
+#ifdef SPHERE_USE_SSE2
+        const __m128 half = _mm_set1_ps(0.5f), third = _mm_set1_ps(1.f/3.f), one = _mm_set1_ps(1.f);
+        for (int column = 0; column < columns; column += 4) {
+            __m128 steps = ColumnSteps(column);
+            __m128 x = _mm_add_ps(_mm_set1_ps(rowStart.x), _mm_mul_ps(steps, _mm_set1_ps(across.x)));
+            __m128 y = _mm_add_ps(_mm_set1_ps(rowStart.y), _mm_mul_ps(steps, _mm_set1_ps(across.y)));
+            __m128 z = _mm_add_ps(_mm_set1_ps(rowStart.z), _mm_mul_ps(steps, _mm_set1_ps(across.z)));
+            __m128 x2 = _mm_mul_ps(x, x), y2 = _mm_mul_ps(y, y), z2 = _mm_mul_ps(z, z);
+            __m128 sx = _mm_sub_ps(_mm_add_ps(one, _mm_mul_ps(_mm_mul_ps(y2, z2), third)), _mm_mul_ps(_mm_add_ps(y2, z2), half));
+            __m128 sy = _mm_sub_ps(_mm_add_ps(one, _mm_mul_ps(_mm_mul_ps(x2, z2), third)), _mm_mul_ps(_mm_add_ps(x2, z2), half));
+            __m128 sz = _mm_sub_ps(_mm_add_ps(one, _mm_mul_ps(_mm_mul_ps(x2, y2), third)), _mm_mul_ps(_mm_add_ps(x2, y2), half));
+            StoreSphereVertices(patch, start + column, _mm_mul_ps(x, _mm_sqrt_ps(sx)), _mm_mul_ps(y, _mm_sqrt_ps(sy)),
+                                _mm_mul_ps(z, _mm_sqrt_ps(sz)));
+        }
+#else
+        for (int column = 0; column < columns; column++) {
+            vec3 point = CubeToSphere(rowStart + float(column)*across);
+            StoreSphereVertex(patch, start + column, point.x, point.y, point.z);
+        }
+#endif
+    }
+}
+
+// Texture coordinates worked out from positions jump from 1 back to 0 where
+// a triangle crosses -X, and u means nothing at a pole; both are mended
+// per triangle, the pole taking the u of the other two corners.
+void MendSeam(vec2 *textureCoords, const vec3 *positions)
+{
+    bool pole[3];
+    float low = 1.f, high = 0.f;
+    for (int corner = 0; corner < 3; corner++) {
+        pole[corner] = positions[corner].x*positions[corner].x + positions[corner].z*positions[corner].z < 1e-10f;
+        if (!pole[corner]) {
+            low = std::min(low, textureCoords[corner].x);
+            high = std::max(high, textureCoords[corner].x);
+        }
+    }
+    float uSum = 0.f;
+    int others = 0;
+    for (int corner = 0; corner < 3; corner++) {
+        if (pole[corner])
+            continue;
+        if (high - low > 0.5f && textureCoords[corner].x < 0.5f)
+            textureCoords[corner].x += 1.f;
+        uSum += textureCoords[corner].x;
+        others++;
+    }
+    for (int corner = 0; corner < 3; corner++) {
+        if (pole[corner] && others > 0)
+            textureCoords[corner].x = uSum/others;
+    }
+}
+
+template <class Index>
+void EmitTriangles(const PatchVertices &patch, const Index *indices, size_t count, bool mend,
+                   vec3 *vertices, vec2 *textureCoords, vec3 *normals)
+{
+    for (size_t i = 0; i < count; i++) {
+        Index index = indices[i];
+        vertices[i] = vec3(patch.x[index], patch.y[index], patch.z[index]);
+        textureCoords[i] = vec2(patch.u[index], patch.v[index]);
+    }
+    if (mend) {
+        for (size_t i = 0; i < count; i += 3)
+            MendSeam(textureCoords + i, vertices + i);
+    }
+    if (normals)
+        copy(vertices, vertices + count, normals);
+}
+
+void EmitPatch(const PatchVertices &patch, const Topology &topology, bool mend, size_t &offset,
+               vector<vec3> &vertices, vector<vec2> &textureCoords, vector<vec3> *normals)
+{
+    vec3 *normalOut = normals ? &(*normals)[offset] : nullptr;
+    if (topology.table)
+        EmitTriangles(patch, topology.table, topology.count, mend, &vertices[offset], &textureCoords[offset], normalOut);
+    else
+        EmitTriangles(patch, topology.built.data(), topology.count, mend, &vertices[offset], &textureCoords[offset], normalOut);
+    offset += topology.count;
+}
+
+}
+
+void CubeSphereFace(int face, vec3 &normal, vec3 &right, vec3 &up)
+{
+    normal = vec3(cubeFaces[face][0][0], cubeFaces[face][0][1], cubeFaces[face][0][2]);
+    right = vec3(cubeFaces[face][1][0], cubeFaces[face][1][1], cubeFaces[face][1][2]);
+    up = vec3(cubeFaces[face][2][0], cubeFaces[face][2][1], cubeFaces[face][2][2]);
+}
+
+vec3 CubeToSphere(vec3 point)
+{
+    vec3 squared = point*point;
+    return vec3(point.x*sqrtf(1.f - squared.y/2.f - squared.z/2.f + squared.y*squared.z/3.f),
+                point.y*sqrtf(1.f - squared.x/2.f - squared.z/2.f + squared.x*squared.z/3.f),
+                point.z*sqrtf(1.f - squared.x/2.f - squared.y/2.f + squared.x*squared.y/3.f));
+}
+
+// u runs from -X through -Z, +X and +Z back to -X, v from the north pole
+// (+Y) to the south
+vec2 SphereTextureCoord(vec3 direction)
+{
+    return vec2(0.5f - atan2f(direction.z, direction.x)/(2.f*PI),
+                atan2f(sqrtf(direction.x*direction.x + direction.z*direction.z), direction.y)/PI);
+}
+
+bool IsProceduralSphere(const string &name)
+{
+    return name.compare(0, 10, "uv-sphere:") == 0 || name.compare(0, 10, "icosphere:") == 0
+           || name.compare(0, 12, "cube-sphere:") == 0;
+}
+
+bool ParseProceduralSphere(const string &name, SphereParameters &parameters)
+{
+    struct { const char *prefix; SphereKind kind; int lowest, highest; const char *unit; } kinds[] = {
+        { "uv-sphere:", SPHERE_UV, 4, MAX_UV_SEGMENTS, "segments" },
+        { "icosphere:", SPHERE_ICO, 0, MAX_ICO_LEVEL, "subdivision levels" },
+        { "cube-sphere:", SPHERE_CUBE, 1, MAX_CUBE_CELLS, "cells per edge" }
+    };
+    for (const auto &kind : kinds) {
+        size_t length = strlen(kind.prefix);
+        if (name.compare(0, length, kind.prefix) != 0)
+            continue;
+        const char *number = name.c_str() + length;
+        char *end = nullptr;
+        long detail = strtol(number, &end, 10);
+        if (end == number || *end != '\0' || detail < kind.lowest || detail > kind.highest) {
+            cout << "Sphere: " << name << " needs " << kind.lowest << " to " << kind.highest << " " << kind.unit << endl;
+            return false;
+        }
+        parameters.kind = kind.kind;
+        parameters.detail = int(detail);
+        return true;
+    }
+    cout << "Sphere: " << name << " is not a procedural sphere" << endl;
+    return false;
+}
+
+size_t SphereTriangleCount(const SphereParameters &parameters)
+{
+    size_t detail = parameters.detail;
+    switch (parameters.kind) {
+        case SPHERE_UV: return 2*detail*(detail/2 - 1);
+        case SPHERE_ICO: return size_t(20) << (2*detail);
+        case SPHERE_CUBE: return 12*detail*detail;
+    }
+    return 0;
+}
+
+void GenerateSphere(const SphereParameters &parameters, vector<vec3> &vertices, vector<vec2> &textureCoords, vector<vec3> *normals)
+{
+    size_t count = 3*SphereTriangleCount(parameters);
+    vertices.resize(count);
+    textureCoords.resize(count);
+    if (normals)
+        normals->resize(count);
+
+    PatchVertices patch;
+    Topology topology;
+    size_t offset = 0;
+    switch (parameters.kind) {
+        case SPHERE_UV:
+            UvSphereTopology(parameters.detail, topology);
+            UvSpherePatch(parameters.detail, parameters.detail/2, patch);
+            EmitPatch(patch, topology, false, offset, vertices, textureCoords, normals);
+            break;
+        case SPHERE_ICO:
+            TriangleGridTopology(1 << parameters.detail, topology);
+            for (int face = 0; face < 20; face++) {
+                IcospherePatch(face, 1 << parameters.detail, patch);
+                EmitPatch(patch, topology, true, offset, vertices, textureCoords, normals);
+            }
+            break;
+        case SPHERE_CUBE:
+            QuadGridTopology(parameters.detail, topology);
+            for (int face = 0; face < 6; face++) {
+                CubeSpherePatch(face, parameters.detail, patch);
+                EmitPatch(patch, topology, true, offset, vertices, textureCoords, normals);
+            }
+            break;
+    }
+}
@@ -0,0 +1,68 @@
+//
+//  ProceduralSphere.h
+//  graphics_assig_5_06
+//
+//  Unit spheres generated in memory instead of read from an OBJ file, in
+//  the layout ObjectReader produces (three vertices per triangle, texture
+//  coordinates mapped like sphere.obj, normals equal to positions):
+//
+//  - UV spheres: segments around the equator and half as many rings,
+//    without the degenerate triangles at the poles.
+//  - Icospheres: each face of an icosahedron split into 4^level triangles.
+//  - Cube-spheres: each face of a cube split into a grid and mapped onto
+//    the sphere so that cells stay close to the same size.
+//
+//  Which vertices make up each triangle only depends on the grid size, so
+//  the index lists of the common sizes are tables built at compile time;
+//  other sizes build theirs when asked. Positions and texture coordinates
+//  are computed four vertices at a time with SSE2 where available.
+//
+
+#ifndef ProceduralSphere_h
+#define ProceduralSphere_h
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+using namespace glm;
+using namespace std;
+
+enum SphereKind
+{
+    SPHERE_UV,
+    SPHERE_ICO,
+    SPHERE_CUBE
+};
+
+struct SphereParameters
+{
+    SphereKind kind = SPHERE_UV;
+    int detail = 32;    // segments, subdivision level or cells per cube edge
+};
+
+// true for mesh names of the form "uv-sphere:<segments>",
+// "icosphere:<level>" or "cube-sphere:<cells>", however bad the number
+bool IsProceduralSphere(const string &name);
+
+// reads such a name; reports a detail out of range and returns false
+bool ParseProceduralSphere(const string &name, SphereParameters &parameters);
+
+size_t SphereTriangleCount(const SphereParameters &parameters);
+
+// replaces the contents of the arrays; normals may be null for unlit meshes
+void GenerateSphere(const SphereParameters &parameters, vector<vec3> &vertices, vector<vec2> &textureCoords, vector<vec3> *normals);
+
+// The pieces of the cube-sphere, for code that builds its own patches of
+// one. Faces 0 to 5 are +X, -X, +Y, -Y, +Z and -Z; a face's points are
+// normal + a*right + b*up for a and b in [-1, 1], and right x up = normal.
+void CubeSphereFace(int face, vec3 &normal, vec3 &right, vec3 &up);
+
+// a point on the surface of the cube [-1, 1]^3 moved onto the unit sphere
+vec3 CubeToSphere(vec3 point);
+
+// where sphere.obj and the generated spheres sample a texture for a
+// direction from the centre
+vec2 SphereTextureCoord(vec3 direction);
+
+#endif /* ProceduralSphere_h */
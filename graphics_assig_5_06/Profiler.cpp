@@ -0,0 +1,259 @@
+//
+//  Profiler.cpp
+//  graphics_assig_5_06
+//
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+
+#include "Profiler.h"
+
+using namespace std;
+
+atomic<bool> profilingEnabled(false);
+
+// events kept per thread; older ones are overwritten
+static const uint64_t RING_SIZE = 1 << 16;
+
+// Chrome trace track of the GPU events
+static const int GPU_TRACK = 0;
+
+struct ProfileEvent
+{
+    const char *name;
+    uint64_t start;
+    uint64_t duration;
+    bool gpu;
+};
+
+// Written only by its own thread. The count is published after the event,
+// so a reader that loads it with acquire sees every event it covers.
+struct ThreadEvents
+{
+    vector<ProfileEvent> ring;
+    atomic<uint64_t> written;
+    int track;
+    string name;
+
+    ThreadEvents(int track) : ring(RING_SIZE), written(0), track(track)
+    {}
+};
+
+// taken once per thread, when it records its first event
+static mutex registryMutex;
+static vector<unique_ptr<ThreadEvents>> registry;
+
+static thread_local ThreadEvents *threadEvents = nullptr;
+
+static ThreadEvents* CurrentThreadEvents()
+{
+    if (threadEvents == nullptr) {
+        lock_guard<mutex> lock(registryMutex);
+        // tracks start at 1; 0 is the GPU
+        registry.push_back(unique_ptr<ThreadEvents>(new ThreadEvents((int)registry.size() + 1)));
+        threadEvents = registry.back().get();
+    }
+    return threadEvents;
+}
+
+void EnableProfiling(bool enabled)
+{
+    profilingEnabled.store(enabled);
+}
+
+uint64_t ProfileTimestamp()
+{
+    return (uint64_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count() | 1;
+}
+
+void RecordProfileEvent(const char *name, uint64_t start, uint64_t duration, bool gpu)
+{
+    ThreadEvents *events = CurrentThreadEvents();
+    uint64_t index = events->written.load(memory_order_relaxed);
+    ProfileEvent &event = events->ring[index & (RING_SIZE - 1)];
+    event.name = name;
+    event.start = start;
+    event.duration = duration;
+    event.gpu = gpu;
+    events->written.store(index + 1, memory_order_release);
+}
+
+void SetProfileThreadName(const char *name)
+{
+    // threads that never record should not get a ring
+    if (!ProfilingEnabled())
+        return;
+    ThreadEvents *events = CurrentThreadEvents();
+    lock_guard<mutex> lock(registryMutex);
+    events->name = name;
+}
+
+// names are literals from our own code, but keep the JSON valid regardless
+static void WriteJSONString(ostream &out, const char *text)
+{
+    out << '"';
+    for (const char *c = text; *c; c++) {
+        if (*c == '"' || *c == '\\')
+            out << '\\' << *c;
+        else if ((unsigned char)*c >= 0x20)
+            out << *c;
+    }
+    out << '"';
+}
+
+bool WriteChromeTrace(const string &path)
+{
+    struct TrackEvent
+    {
+        ProfileEvent event;
+        int track;
+    };
+    vector<TrackEvent> events;
+    vector<pair<int, string>> tracks;
+    uint64_t wrapped = 0;
+    {
+        lock_guard<mutex> lock(registryMutex);
+        for (const unique_ptr<ThreadEvents> &thread : registry) {
+            uint64_t written = thread->written.load(memory_order_acquire);
+            uint64_t first = written > RING_SIZE ? written - RING_SIZE : 0;
+            wrapped += first;
+            for (uint64_t i = first; i < written; i++) {
+                const ProfileEvent &event = thread->ring[i & (RING_SIZE - 1)];
+                events.push_back({ event, event.gpu ? GPU_TRACK : thread->track });
+            }
+            string name = thread->name.empty() ? "Thread " + to_string(thread->track) : thread->name;
+            tracks.push_back(make_pair(thread->track, name));
+        }
+    }
+
+    // scopes are recorded as they close, children before their parents;
+    // viewers nest them more reliably in start order
+    stable_sort(events.begin(), events.end(), [](const TrackEvent &a, const TrackEvent &b) {
+        if (a.event.start != b.event.start)
+            return a.event.start < b.event.start;
+        return a.event.duration > b.event.duration;
+    });
+    uint64_t origin = events.empty() ? 0 : events.front().event.start;
+
+    ofstream out(path);
+    if (!out) {
+        cout << "Could not write profile " << path << endl;
+        return false;
+    }
+    out << fixed << setprecision(3);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"graphics_assig_5_06\"}},\n";
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << GPU_TRACK << ",\"args\":{\"name\":\"GPU\"}}";
+    for (const pair<int, string> &track : tracks) {
+        out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << track.first << ",\"args\":{\"name\":";
+        WriteJSONString(out, track.second.c_str());
+        out << "}}";
+    }
+    // Chrome traces count in microseconds
+    for (const TrackEvent &event : events) {
+        out << ",\n{\"name\":";
+        WriteJSONString(out, event.event.name);
+        out << ",\"cat\":\"" << (event.event.gpu ? "gpu" : "cpu") << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.track
+            << ",\"ts\":" << (event.event.start - origin)/1000.0 << ",\"dur\":" << event.event.duration/1000.0 << "}";
+    }
+    out << "\n]}\n";
+    out.close();
+    if (!out) {
+        cout << "Could not write profile " << path << endl;
+        return false;
+    }
+
+    cout << "Profile: " << events.size() << " events on " << tracks.size() << " threads written to " << path;
+    if (wrapped > 0)
+        cout << " (" << wrapped << " older events overwritten)";
+    cout << endl;
+    return true;
+}
+
+// --------------------------------------------------------------------------
+
+void GpuTimer :: resolve(QuerySet &set, bool wait)
+{
+    if (set.count == 0)
+        return;
+
+    // queries finish in order, so the last one stands for the whole set
+    if (!wait) {
+        GLint available = 0;
+        glGetQueryObjectiv(set.queries[set.count - 1].id, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            droppedFrames++;
+            set.count = 0;
+            return;
+        }
+    }
+    for (int i = 0; i < set.count; i++) {
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(set.queries[i].id, GL_QUERY_RESULT, &nanoseconds);
+        RecordProfileEvent(set.queries[i].name, set.queries[i].issued, nanoseconds, true);
+    }
+    set.count = 0;
+}
+
+void GpuTimer :: beginFrame()
+{
+    if (open)
+        end();
+    current = 1 - current;
+    resolve(sets[current], false);
+}
+
+void GpuTimer :: begin(const char *name)
+{
+    QuerySet &set = sets[current];
+    if (!ProfilingEnabled() || open || set.count == MAX_QUERIES)
+        return;
+
+    Query &query = set.queries[set.count++];
+    if (query.id == 0)
+        glGenQueries(1, &query.id);
+    query.name = name;
+    query.issued = ProfileTimestamp();
+    glBeginQuery(GL_TIME_ELAPSED, query.id);
+    open = true;
+}
+
+void GpuTimer :: end()
+{
+    if (!open)
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    open = false;
+}
+
+void GpuTimer :: finish()
+{
+    if (open)
+        end();
+    // the other set is the older one
+    resolve(sets[1 - current], true);
+    resolve(sets[current], true);
+}
+
+void GpuTimer :: destroy()
+{
+    for (QuerySet &set : sets) {
+        for (Query &query : set.queries) {
+            if (query.id != 0)
+                glDeleteQueries(1, &query.id);
+            query.id = 0;
+        }
+        set.count = 0;
+    }
+}
+
+int GpuTimer :: framesDropped() const
+{
+    return droppedFrames;
+}
@@ -0,0 +1,115 @@
+//
+//  Profiler.h
+//  graphics_assig_5_06
+//
+//  Frame profiler (--profile). CPU work is marked with PROFILE_SCOPE, which
+//  timestamps the enclosing block with steady_clock and appends one event to
+//  a ring buffer owned by the calling thread, so recording never takes a
+//  lock. GPU work is timed with GL_TIME_ELAPSED queries in two alternating
+//  sets: a frame's results are only read back after the following frame has
+//  been submitted, so the GL thread never waits on them. Everything is
+//  written out as a Chrome trace, which chrome://tracing and ui.perfetto.dev
+//  both open.
+//
+
+#ifndef Profiler_h
+#define Profiler_h
+
+#include <string>
+#include <atomic>
+#include <cstdint>
+#include <glad/glad.h>
+
+using namespace std;
+
+// checked by every scope; off unless --profile is given
+extern atomic<bool> profilingEnabled;
+
+void EnableProfiling(bool enabled);
+
+inline bool ProfilingEnabled()
+{
+    return profilingEnabled.load(memory_order_relaxed);
+}
+
+// steady_clock nanoseconds; never zero
+uint64_t ProfileTimestamp();
+
+// appends to the calling thread's ring; gpu events go on their own track.
+// name must outlive the profiler (a string literal).
+void RecordProfileEvent(const char *name, uint64_t start, uint64_t duration, bool gpu = false);
+
+// label of the calling thread's track in the trace
+void SetProfileThreadName(const char *name);
+
+// Writes every buffered event as Chrome trace JSON. Call once the traced
+// threads are idle: a ring that is still being written may tear.
+bool WriteChromeTrace(const string &path);
+
+class ProfileScope
+{
+private:
+    const char *name;
+    uint64_t start;
+
+public:
+    explicit ProfileScope(const char *name) : name(name), start(ProfilingEnabled() ? ProfileTimestamp() : 0)
+    {}
+    ~ProfileScope()
+    {
+        if (start != 0)
+            RecordProfileEvent(name, start, ProfileTimestamp() - start);
+    }
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+
+// GL_TIME_ELAPSED timers for the GL thread. Queries cannot nest, so a
+// begin() while another is open is ignored. A GPU event is placed at the CPU
+// time its commands were issued, which lines it up with the CPU scope that
+// submitted it.
+class GpuTimer
+{
+private:
+    static const int MAX_QUERIES = 32;
+
+    struct Query
+    {
+        GLuint id = 0;
+        const char *name = nullptr;
+        uint64_t issued = 0;
+    };
+
+    struct QuerySet
+    {
+        Query queries[MAX_QUERIES];
+        int count = 0;
+    };
+
+    QuerySet sets[2];
+    int current = 0;
+    bool open = false;
+    int droppedFrames = 0;
+
+    // records the results of one set; with wait, blocks until they exist
+    void resolve(QuerySet &set, bool wait);
+
+public:
+    // call once per frame before any begin(): collects the results of the
+    // frame before last, which used the same set, or drops that frame if
+    // the GPU is still behind
+    void beginFrame();
+
+    void begin(const char *name);
+    void end();
+
+    // waits for and records everything outstanding
+    void finish();
+    void destroy();
+
+    int framesDropped() const;
+};
+
+#endif /* Profiler_h */
@@ -0,0 +1,49 @@
+//
+//  RenderTarget.cpp
+//  graphics_assig_5_06
+//
+
+#include <iostream>
+
+#include "RenderTarget.h"
+
+using namespace std;
+
+bool InitializeRenderTarget(RenderTarget *target, int width, int height, GLenum colourFormat)
+{
+    target->width = width;
+    target->height = height;
+
+    glGenRenderbuffers(1, &target->colourBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, target->colourBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, colourFormat, width, height);
+
+    glGenRenderbuffers(1, &target->depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, target->depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &target->framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, target->framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target->colourBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target->depthBuffer);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        cout << "Framebuffer incomplete (status 0x" << hex << status << dec << ")" << endl;
+        DestroyRenderTarget(target);
+        return false;
+    }
+
+    glViewport(0, 0, width, height);
+    return true;
+}
+
+void DestroyRenderTarget(RenderTarget *target)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &target->framebuffer);
+    glDeleteRenderbuffers(1, &target->colourBuffer);
+    glDeleteRenderbuffers(1, &target->depthBuffer);
+    target->framebuffer = target->colourBuffer = target->depthBuffer = 0;
+}
@@ -0,0 +1,35 @@
+//
+//  RenderTarget.h
+//  graphics_assig_5_06
+//
+//  Offscreen framebuffer object with a colour (RGBA8 unless asked
+//  otherwise) and a 24-bit depth renderbuffer, for rendering without a
+//  window.
+//
+
+#ifndef RenderTarget_h
+#define RenderTarget_h
+
+#include <glad/glad.h>
+
+struct RenderTarget
+{
+    GLuint framebuffer;
+    GLuint colourBuffer;
+    GLuint depthBuffer;
+    int width;
+    int height;
+
+    // initialize object names to zero (OpenGL reserved value)
+    RenderTarget() : framebuffer(0), colourBuffer(0), depthBuffer(0), width(0), height(0)
+    {}
+};
+
+// creates the framebuffer and leaves it bound for drawing, with the viewport
+// set to its size; returns false if it is incomplete
+bool InitializeRenderTarget(RenderTarget *target, int width, int height, GLenum colourFormat = GL_RGBA8);
+
+// deallocate framebuffer-related objects
+void DestroyRenderTarget(RenderTarget *target);
+
+#endif /* RenderTarget_h */
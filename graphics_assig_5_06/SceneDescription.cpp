@@ -0,0 +1,718 @@
+//
+//  SceneDescription.cpp
+//  graphics_assig_5_06
+//
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <map>
+#include <unordered_map>
+#include <type_traits>
+
+#include "SceneDescription.h"
+#include "Profiler.h"
+
+using namespace std;
+
+// File layout of the binary form: this header, bodyCount SceneBody records,
+// then stringBytes of NUL-terminated strings starting with an empty one.
+struct SceneFileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t bodyCount;
+    uint32_t stringBytes;
+};
+
+static const char MAGIC[4] = { 'S', 'C', 'N', 'B' };
+static const uint32_t VERSION = 3;
+
+// the binary form is the in-memory layout, so the layout is the format
+static_assert(is_trivially_copyable<SceneBody>::value, "SceneBody is written as raw bytes");
+static_assert(sizeof(SceneBody) == 152, "changing SceneBody changes the binary scene format");
+static_assert(sizeof(SceneFileHeader) % alignof(SceneBody) == 0, "bodies must stay aligned in the file");
+
+static const double DEGREES = 3.14159265358979323846/180.0;
+
+// --------------------------------------------------------------------------
+// Values, checked the same way whichever form they came from
+
+// Ephemeris divides by the period and solves Kepler's equation only for an
+// ellipse, and a NaN or infinity anywhere spreads to every body below it.
+// Returns what is wrong with body, or nullptr.
+static const char* BodyValuesProblem(const SceneBody &body)
+{
+    const OrbitalElements &orbit = body.orbit;
+    const double values[] = {
+        orbit.semiMajorAxis, orbit.eccentricity, orbit.inclination, orbit.ascendingNode,
+        orbit.argumentOfPeriapsis, orbit.meanAnomalyAtEpoch, orbit.period,
+        body.spinPeriod, body.mass, body.massRatio,
+        body.spinAxis[0], body.spinAxis[1], body.spinAxis[2],
+        body.tilt, body.scale, body.heightScale,
+    };
+    for (double value : values)
+        if (!isfinite(value))
+            return "a body's numbers must all be finite";
+    if (orbit.period <= 0.0 || orbit.eccentricity < 0.0 || orbit.eccentricity >= 1.0)
+        return "an orbit needs a positive period and an eccentricity in [0, 1)";
+    if (body.scale <= 0.f)
+        return "a body's scale must be positive";
+    if (body.heightScale < 0.f || body.heightScale > 1.f)
+        return "a terrain's heightScale is a fraction of the radius, from 0 to 1";
+    return nullptr;
+}
+
+// --------------------------------------------------------------------------
+// JSON
+
+// A forward-only reader over the file buffer. Strings are unescaped over
+// their own text and NUL-terminated there, so they are used without copying.
+struct JsonParser
+{
+    char *begin;
+    char *p;
+    char *end;
+    string error;
+
+    void skipSpace()
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+            p++;
+    }
+
+    bool fail(const string &message)
+    {
+        if (error.empty()) {
+            int line = 1, column = 1;
+            for (const char *c = begin; c < p; c++, column++)
+                if (*c == '\n') {
+                    line++;
+                    column = 0;
+                }
+            error = to_string(line) + ":" + to_string(column) + ": " + message;
+        }
+        return false;
+    }
+
+    bool expect(char c)
+    {
+        skipSpace();
+        if (p >= end || *p != c)
+            return fail(string("expected '") + c + "'");
+        p++;
+        return true;
+    }
+
+    // 1 for another member, whose key is returned, 0 at the closing brace,
+    // -1 on an error; first is true before the first call on an object
+    int nextMember(bool &first, const char *&key)
+    {
+        skipSpace();
+        if (p < end && *p == '}') {
+            p++;
+            return 0;
+        }
+        if (!first && !expect(','))
+            return -1;
+        first = false;
+        uint32_t offset;
+        if (!parseString(offset) || !expect(':'))
+            return -1;
+        key = begin + offset;
+        return 1;
+    }
+
+    // the same for array elements
+    int nextElement(bool &first)
+    {
+        skipSpace();
+        if (p < end && *p == ']') {
+            p++;
+            return 0;
+        }
+        if (!first && !expect(','))
+            return -1;
+        first = false;
+        return 1;
+    }
+
+    static int HexDigit(char c)
+    {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    bool parseHex4(unsigned &value)
+    {
+        value = 0;
+        for (int i = 0; i < 4; i++) {
+            int digit = p < end ? HexDigit(*p) : -1;
+            if (digit < 0)
+                return fail("bad \\u escape");
+            value = value*16 + digit;
+            p++;
+        }
+        return true;
+    }
+
+    // offset of the string's first character from begin
+    bool parseString(uint32_t &offset)
+    {
+        if (!expect('"'))
+            return false;
+        char *out = p;
+        offset = uint32_t(p - begin);
+        while (true) {
+            if (p >= end)
+                return fail("unterminated string");
+            char c = *p++;
+            if (c == '"')
+                break;
+            if ((unsigned char)c < 0x20)
+                return fail("control character in string");
+            if (c != '\\') {
+                *out++ = c;
+                continue;
+            }
+            if (p >= end)
+                return fail("unterminated string");
+            c = *p++;
+            switch (c) {
+                case '"': case '\\': case '/': *out++ = c; break;
+                case 'b': *out++ = '\b'; break;
+                case 'f': *out++ = '\f'; break;
+                case 'n': *out++ = '\n'; break;
+                case 'r': *out++ = '\r'; break;
+                case 't': *out++ = '\t'; break;
+                case 'u': {
+                    unsigned code;
+                    if (!parseHex4(code))
+                        return false;
+                    if (code >= 0xD800 && code < 0xDC00) {
+                        unsigned low;
+                        if (end - p < 2 || p[0] != '\\' || p[1] != 'u')
+                            return fail("unpaired surrogate");
+                        p += 2;
+                        if (!parseHex4(low) || low < 0xDC00 || low >= 0xE000)
+                            return fail("unpaired surrogate");
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    // never longer than the escape it replaces
+                    if (code < 0x80)
+                        *out++ = char(code);
+                    else if (code < 0x800) {
+                        *out++ = char(0xC0 | (code >> 6));
+                        *out++ = char(0x80 | (code & 0x3F));
+                    } else if (code < 0x10000) {
+                        *out++ = char(0xE0 | (code >> 12));
+                        *out++ = char(0x80 | ((code >> 6) & 0x3F));
+                        *out++ = char(0x80 | (code & 0x3F));
+                    } else {
+                        *out++ = char(0xF0 | (code >> 18));
+                        *out++ = char(0x80 | ((code >> 12) & 0x3F));
+                        *out++ = char(0x80 | ((code >> 6) & 0x3F));
+                        *out++ = char(0x80 | (code & 0x3F));
+                    }
+                    break;
+                }
+                default:
+                    return fail(string("bad escape \\") + c);
+            }
+        }
+        *out = '\0';
+        return true;
+    }
+
+    bool parseNumber(double &value)
+    {
+        skipSpace();
+        if (p >= end || !(*p == '-' || (*p >= '0' && *p <= '9')))
+            return fail("expected a number");
+        // the buffer ends in a NUL, so strtod cannot run off it
+        char *after;
+        value = strtod(p, &after);
+        if (after == p)
+            return fail("expected a number");
+        p = after;
+        return true;
+    }
+
+    bool parseNumber(float &value)
+    {
+        double number;
+        if (!parseNumber(number))
+            return false;
+        value = float(number);
+        return true;
+    }
+
+    bool parseBool(bool &value)
+    {
+        skipSpace();
+        if (end - p >= 4 && strncmp(p, "true", 4) == 0) {
+            value = true;
+            p += 4;
+        } else if (end - p >= 5 && strncmp(p, "false", 5) == 0) {
+            value = false;
+            p += 5;
+        } else
+            return fail("expected true or false");
+        return true;
+    }
+
+    // steps over any value; keys this version does not know are ignored
+    bool skipValue()
+    {
+        skipSpace();
+        if (p >= end)
+            return fail("expected a value");
+        if (*p == '"') {
+            uint32_t offset;
+            return parseString(offset);
+        }
+        if (*p == '{' || *p == '[') {
+            bool object = *p++ == '{';
+            bool first = true;
+            const char *key;
+            int more;
+            while ((more = object ? nextMember(first, key) : nextElement(first)) > 0)
+                if (!skipValue())
+                    return false;
+            return more == 0;
+        }
+        if (*p == 't' || *p == 'f') {
+            bool value;
+            return parseBool(value);
+        }
+        if (end - p >= 4 && strncmp(p, "null", 4) == 0) {
+            p += 4;
+            return true;
+        }
+        double number;
+        return parseNumber(number);
+    }
+};
+
+// "orbit": { "semiMajorAxis": 3, "eccentricity": 0.0167, "period": 12, ... }
+static bool ParseOrbit(JsonParser &json, OrbitalElements &orbit)
+{
+    if (!json.expect('{'))
+        return false;
+    bool first = true;
+    const char *key;
+    int more;
+    while ((more = json.nextMember(first, key)) > 0) {
+        static const struct { const char *key; double OrbitalElements::*element; double unit; } fields[] = {
+            { "semiMajorAxis", &OrbitalElements::semiMajorAxis, 1.0 },
+            { "eccentricity", &OrbitalElements::eccentricity, 1.0 },
+            { "inclination", &OrbitalElements::inclination, DEGREES },
+            { "ascendingNode", &OrbitalElements::ascendingNode, DEGREES },
+            { "argumentOfPeriapsis", &OrbitalElements::argumentOfPeriapsis, DEGREES },
+            { "meanAnomalyAtEpoch", &OrbitalElements::meanAnomalyAtEpoch, DEGREES },
+            { "period", &OrbitalElements::period, 1.0 },
+        };
+        bool known = false;
+        for (const auto &field : fields) {
+            if (strcmp(key, field.key) != 0)
+                continue;
+            double value;
+            if (!json.parseNumber(value))
+                return false;
+            orbit.*field.element = value*field.unit;
+            known = true;
+        }
+        if (!known && !json.skipValue())
+            return false;
+    }
+    return more == 0;
+}
+
+// "spin": { "period": 3, "axis": [0, 1, 0] }
+static bool ParseSpin(JsonParser &json, SceneBody &body)
+{
+    if (!json.expect('{'))
+        return false;
+    bool first = true;
+    const char *key;
+    int more;
+    while ((more = json.nextMember(first, key)) > 0) {
+        if (strcmp(key, "period") == 0) {
+            if (!json.parseNumber(body.spinPeriod))
+                return false;
+        } else if (strcmp(key, "axis") == 0) {
+            if (!json.expect('['))
+                return false;
+            bool firstElement = true;
+            int component = 0;
+            while ((more = json.nextElement(firstElement)) > 0) {
+                if (component == 3)
+                    return json.fail("an axis has three components");
+                if (!json.parseNumber(body.spinAxis[component++]))
+                    return false;
+            }
+            if (more < 0)
+                return false;
+            if (component != 3)
+                return json.fail("an axis has three components");
+        } else if (!json.skipValue())
+            return false;
+    }
+    return more == 0;
+}
+
+// "material": { "texture": "...", "normalMap": "...", "virtualTexture": "...", "features": ["LIT", "SPECULAR"] }
+static bool ParseMaterial(JsonParser &json, SceneBody &body)
+{
+    if (!json.expect('{'))
+        return false;
+    bool first = true;
+    const char *key;
+    int more;
+    while ((more = json.nextMember(first, key)) > 0) {
+        if (strcmp(key, "texture") == 0) {
+            if (!json.parseString(body.texture))
+                return false;
+        } else if (strcmp(key, "normalMap") == 0) {
+            if (!json.parseString(body.normalMap))
+                return false;
+        } else if (strcmp(key, "virtualTexture") == 0) {
+            if (!json.parseString(body.virtualTexture))
+                return false;
+        } else if (strcmp(key, "features") == 0) {
+            if (!json.expect('['))
+                return false;
+            body.shaderFeatures = SHADER_UNLIT;
+            bool firstElement = true;
+            while ((more = json.nextElement(firstElement)) > 0) {
+                uint32_t name;
+                if (!json.parseString(name))
+                    return false;
+                int feature = ShaderFeatureFromName(json.begin + name);
+                if (feature < 0)
+                    return json.fail(string("unknown shader feature ") + (json.begin + name));
+                body.shaderFeatures |= feature;
+            }
+            if (more < 0)
+                return false;
+        } else if (!json.skipValue())
+            return false;
+    }
+    return more == 0;
+}
+
+// "terrain": { "tiles": "terrain/earth", "levels": 5, "heightMap": "...", "heightScale": 0.01 }
+static bool ParseTerrain(JsonParser &json, SceneBody &body)
+{
+    if (!json.expect('{'))
+        return false;
+    bool first = true;
+    const char *key;
+    int more;
+    double levels = 0.0;
+    while ((more = json.nextMember(first, key)) > 0) {
+        bool ok;
+        if (strcmp(key, "tiles") == 0)
+            ok = json.parseString(body.terrainTiles);
+        else if (strcmp(key, "heightMap") == 0)
+            ok = json.parseString(body.heightMap);
+        else if (strcmp(key, "heightScale") == 0)
+            ok = json.parseNumber(body.heightScale);
+        else if (strcmp(key, "levels") == 0)
+            ok = json.parseNumber(levels);
+        else
+            ok = json.skipValue();
+        if (!ok)
+            return false;
+    }
+    if (more < 0)
+        return false;
+    if (body.terrainTiles == 0)
+        return json.fail("a terrain needs a tiles directory");
+    if (levels != floor(levels) || levels < 1 || levels > SCENE_MAX_TERRAIN_LEVELS)
+        return json.fail("terrain levels must be a whole number from 1 to " + to_string(SCENE_MAX_TERRAIN_LEVELS));
+    body.terrainLevels = int32_t(levels);
+    return true;
+}
+
+static bool ParseBody(JsonParser &json, SceneBody &body, uint32_t &parentName)
+{
+    if (!json.expect('{'))
+        return false;
+    bool first = true;
+    const char *key;
+    int more;
+    while ((more = json.nextMember(first, key)) > 0) {
+        bool ok, flag = false;
+        if (strcmp(key, "name") == 0)
+            ok = json.parseString(body.name);
+        else if (strcmp(key, "parent") == 0)
+            ok = json.parseString(parentName);
+        else if (strcmp(key, "orbit") == 0) {
+            ok = ParseOrbit(json, body.orbit);
+            body.flags |= SCENE_BODY_ORBITS;
+        } else if (strcmp(key, "spin") == 0)
+            ok = ParseSpin(json, body);
+        else if (strcmp(key, "tilt") == 0) {
+            double degrees = 0.0;
+            ok = json.parseNumber(degrees);
+            body.tilt = float(degrees*DEGREES);
+        } else if (strcmp(key, "scale") == 0)
+            ok = json.parseNumber(body.scale);
+        else if (strcmp(key, "mass") == 0)
+            ok = json.parseNumber(body.mass);
+        else if (strcmp(key, "massRatio") == 0)
+            ok = json.parseNumber(body.massRatio);
+        else if (strcmp(key, "backdrop") == 0) {
+            ok = json.parseBool(flag);
+            if (flag)
+                body.flags |= SCENE_BODY_BACKDROP;
+        } else if (strcmp(key, "light") == 0) {
+            ok = json.parseBool(flag);
+            if (flag)
+                body.flags |= SCENE_BODY_LIGHT;
+        } else if (strcmp(key, "mesh") == 0)
+            ok = json.parseString(body.mesh);
+        else if (strcmp(key, "material") == 0)
+            ok = ParseMaterial(json, body);
+        else if (strcmp(key, "terrain") == 0)
+            ok = ParseTerrain(json, body);
+        else
+            ok = json.skipValue();
+        if (!ok)
+            return false;
+    }
+    if (more < 0)
+        return false;
+    if (body.mesh == 0 || body.texture == 0)
+        return json.fail("a body needs a mesh and a texture");
+    if (const char *problem = BodyValuesProblem(body))
+        return json.fail(problem);
+    body.shaderFeatures = NormalizeShaderFeatures(body.shaderFeatures);
+    return true;
+}
+
+// names are looked up where they lie in the buffer
+struct CStringHash
+{
+    size_t operator()(const char *s) const
+    {
+        size_t hash = 14695981039346656037ull;
+        for (; *s; s++)
+            hash = (hash ^ (unsigned char)*s)*1099511628211ull;
+        return hash;
+    }
+};
+
+struct CStringEqual
+{
+    bool operator()(const char *a, const char *b) const
+    {
+        return strcmp(a, b) == 0;
+    }
+};
+
+bool SceneDescription :: parseJson(const string &path, size_t fileBytes)
+{
+    JsonParser json;
+    json.begin = json.p = reinterpret_cast<char*>(storage.data());
+    json.end = json.begin + fileBytes;
+
+    parsedBodies.clear();
+    unordered_map<const char*, int, CStringHash, CStringEqual> bodyIndex;
+    bool ok = json.expect('{');
+    bool first = true;
+    const char *key;
+    int more = -1;
+    while (ok && (more = json.nextMember(first, key)) > 0) {
+        if (strcmp(key, "bodies") != 0) {
+            ok = json.skipValue();
+            continue;
+        }
+        ok = json.expect('[');
+        bool firstElement = true;
+        while (ok && (more = json.nextElement(firstElement)) > 0) {
+            SceneBody body;
+            uint32_t parentName = 0;
+            ok = ParseBody(json, body, parentName);
+            if (!ok)
+                break;
+            if (parentName != 0) {
+                auto parent = bodyIndex.find(json.begin + parentName);
+                if (parent == bodyIndex.end()) {
+                    ok = json.fail(string("parent ") + (json.begin + parentName) + " is not a body listed before this one");
+                    break;
+                }
+                body.parent = parent->second;
+            }
+            if (body.name != 0 && !bodyIndex.insert(make_pair(json.begin + body.name, int(parsedBodies.size()))).second) {
+                ok = json.fail(string("there is already a body named ") + (json.begin + body.name));
+                break;
+            }
+            parsedBodies.push_back(body);
+        }
+        ok = ok && more == 0;
+    }
+    if (ok && more != 0)
+        ok = false;
+    if (ok) {
+        json.skipSpace();
+        if (json.p != json.end)
+            ok = json.fail("unexpected text after the scene");
+    }
+    if (!ok) {
+        cout << "Scene: " << path << ":" << json.error << endl;
+        return false;
+    }
+
+    bodies = parsedBodies.data();
+    count = parsedBodies.size();
+    strings = json.begin;
+    stringBytes = fileBytes;
+    return true;
+}
+
+// --------------------------------------------------------------------------
+// Binary
+
+bool SceneDescription :: loadBinary(const string &path, size_t fileBytes)
+{
+    const char *file = reinterpret_cast<const char*>(storage.data());
+    SceneFileHeader header;
+    memcpy(&header, file, sizeof(header));
+    if (header.version != VERSION) {
+        cout << "Scene: " << path << " is version " << header.version << ", expected " << VERSION << endl;
+        return false;
+    }
+    uint64_t expectedBytes = sizeof(header) + uint64_t(header.bodyCount)*sizeof(SceneBody) + header.stringBytes;
+    const char *table = file + sizeof(header) + size_t(header.bodyCount)*sizeof(SceneBody);
+    if (expectedBytes != fileBytes || header.stringBytes == 0 || table[0] != '\0' || table[header.stringBytes - 1] != '\0') {
+        cout << "Scene: " << path << " is damaged" << endl;
+        return false;
+    }
+
+    // checked once here so nothing later has to
+    const SceneBody *records = reinterpret_cast<const SceneBody*>(file + sizeof(header));
+    for (uint32_t i = 0; i < header.bodyCount; i++) {
+        const SceneBody &body = records[i];
+        bool stringsOk = body.name < header.stringBytes && body.mesh < header.stringBytes
+                         && body.texture < header.stringBytes && body.normalMap < header.stringBytes
+                         && body.virtualTexture < header.stringBytes && body.terrainTiles < header.stringBytes
+                         && body.heightMap < header.stringBytes;
+        bool terrainOk = body.terrainLevels >= 0 && body.terrainLevels <= SCENE_MAX_TERRAIN_LEVELS
+                         && (body.terrainLevels == 0) == (body.terrainTiles == 0);
+        if (!stringsOk || !terrainOk || body.parent >= int32_t(i) || body.parent < -1 || body.mesh == 0 || body.texture == 0) {
+            cout << "Scene: " << path << " is damaged at body " << i << endl;
+            return false;
+        }
+        if (const char *problem = BodyValuesProblem(body)) {
+            cout << "Scene: " << path << " is damaged at body " << i << ": " << problem << endl;
+            return false;
+        }
+    }
+
+    parsedBodies.clear();
+    bodies = records;
+    count = header.bodyCount;
+    strings = table;
+    stringBytes = header.stringBytes;
+    return true;
+}
+
+bool SceneDescription :: writeBinary(const string &path) const
+{
+    // the strings, each once, behind the empty one
+    string table(1, '\0');
+    map<string, uint32_t> offsets;
+    auto intern = [&](uint32_t offset) -> uint32_t {
+        if (offset == 0)
+            return 0;
+        auto inserted = offsets.insert(make_pair(string(text(offset)), uint32_t(table.size())));
+        if (inserted.second) {
+            table += inserted.first->first;
+            table += '\0';
+        }
+        return inserted.first->second;
+    };
+    vector<SceneBody> records(bodies, bodies + count);
+    for (SceneBody &body : records) {
+        body.name = intern(body.name);
+        body.mesh = intern(body.mesh);
+        body.texture = intern(body.texture);
+        body.normalMap = intern(body.normalMap);
+        body.virtualTexture = intern(body.virtualTexture);
+        body.terrainTiles = intern(body.terrainTiles);
+        body.heightMap = intern(body.heightMap);
+    }
+
+    SceneFileHeader header;
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.bodyCount = uint32_t(records.size());
+    header.stringBytes = uint32_t(table.size());
+
+    ofstream file(path, ios::binary);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(records.data()), records.size()*sizeof(SceneBody));
+    file.write(table.data(), table.size());
+    if (!file) {
+        cout << "Scene: could not write " << path << endl;
+        return false;
+    }
+    cout << "Scene: wrote " << count << " bodies to " << path << endl;
+    return true;
+}
+
+// --------------------------------------------------------------------------
+
+bool SceneDescription :: readFile(const string &path, size_t &fileBytes)
+{
+    ifstream file(path, ios::binary | ios::ate);
+    if (!file) {
+        cout << "Scene: could not open " << path << endl;
+        return false;
+    }
+    fileBytes = size_t(file.tellg());
+    file.seekg(0);
+    // one spare NUL after the text for the parser
+    storage.assign(fileBytes/sizeof(uint64_t) + 1, 0);
+    file.read(reinterpret_cast<char*>(storage.data()), fileBytes);
+    if (!file) {
+        cout << "Scene: could not read " << path << endl;
+        return false;
+    }
+    return true;
+}
+
+bool SceneDescription :: load(const string &path)
+{
+    PROFILE_SCOPE("SceneDescription::load");
+    bodies = nullptr;
+    count = 0;
+    size_t fileBytes;
+    if (!readFile(path, fileBytes))
+        return false;
+    const char *file = reinterpret_cast<const char*>(storage.data());
+    if (fileBytes >= sizeof(SceneFileHeader) && memcmp(file, MAGIC, sizeof(MAGIC)) == 0)
+        return loadBinary(path, fileBytes);
+    return parseJson(path, fileBytes);
+}
+
+size_t SceneDescription :: bodyCount() const
+{
+    return count;
+}
+
+const SceneBody& SceneDescription :: body(size_t index) const
+{
+    return bodies[index];
+}
+
+const char* SceneDescription :: text(uint32_t offset) const
+{
+    return offset == 0 ? "" : strings + offset;
+}
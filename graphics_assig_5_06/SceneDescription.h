@@ -0,0 +1,97 @@
+//
+//  SceneDescription.h
+//  graphics_assig_5_06
+//
+//  The bodies of a scene as read from a file: hierarchy, orbital elements,
+//  spin, mesh and material. Two forms hold the same data:
+//
+//  - JSON (scenes/solar_system.json), for editing. It is parsed in place:
+//    no document tree is built and strings are unescaped where they lie
+//    in the file buffer, so a body costs one SceneBody and nothing else.
+//  - Binary (--write-scene), for large scenes: a header, the SceneBody
+//    array exactly as it is in memory, then the strings. Loading reads the
+//    file, checks it and points at it; nothing is copied or converted.
+//
+//  The binary form is little-endian, like every platform this builds for.
+//
+
+#ifndef SceneDescription_h
+#define SceneDescription_h
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "Ephemeris.h"
+#include "ShaderVariants.h"
+
+using namespace std;
+
+enum SceneBodyFlags : uint32_t
+{
+    SCENE_BODY_ORBITS = 1 << 0,     // orbit holds its path around the parent
+    SCENE_BODY_BACKDROP = 1 << 1,   // drawn around the viewer, unlit, without normals
+    SCENE_BODY_LIGHT = 1 << 2       // the scene's light sits at its centre
+};
+
+// deepest quadtree level a body's terrain may have; float positions are
+// still a hundred times finer than its cells
+const int SCENE_MAX_TERRAIN_LEVELS = 12;
+
+// Angles are radians and lengths scene units; the JSON form uses degrees.
+// Strings are offsets for SceneDescription::text(), 0 meaning none.
+struct SceneBody
+{
+    OrbitalElements orbit;
+    double spinPeriod = 0.0;        // simulation seconds per turn, 0 for none
+    double mass = 0.0;              // for physics mode; see SeedGravity in main
+    double massRatio = 0.0;         // or as a fraction of the parent's
+    float spinAxis[3] = { 0.f, 1.f, 0.f };
+    float tilt = 0.f;               // about the X axis, before spinning
+    float scale = 1.f;
+    int32_t parent = -1;            // index of an earlier body, or -1
+    uint32_t flags = 0;
+    uint32_t shaderFeatures = SHADER_LIT | SHADER_SPECULAR;
+    uint32_t name = 0;
+    uint32_t mesh = 0;
+    uint32_t texture = 0;
+    uint32_t normalMap = 0;
+    uint32_t virtualTexture = 0;    // directory of pages baked from texture
+    uint32_t terrainTiles = 0;      // directory of the surface's quadtree tiles
+    uint32_t heightMap = 0;         // image they are baked from, with texture
+    float heightScale = 0.f;        // highest point above the surface, in radii
+    int32_t terrainLevels = 0;      // quadtree depth, 0 for no terrain
+    uint32_t reserved = 0;          // so no padding goes into the file unset
+};
+
+class SceneDescription
+{
+private:
+    // the file, 8-byte aligned so the binary form's bodies can be used in place
+    vector<uint64_t> storage;
+    vector<SceneBody> parsedBodies;
+    const SceneBody *bodies = nullptr;
+    size_t count = 0;
+    const char *strings = nullptr;
+    size_t stringBytes = 0;
+
+    bool readFile(const string &path, size_t &fileBytes);
+    bool parseJson(const string &path, size_t fileBytes);
+    bool loadBinary(const string &path, size_t fileBytes);
+
+public:
+    // reads either form, telling them apart by content; reports errors
+    // with their line and column and returns false
+    bool load(const string &path);
+
+    // the binary form of whatever was loaded
+    bool writeBinary(const string &path) const;
+
+    size_t bodyCount() const;
+    const SceneBody& body(size_t index) const;
+
+    // a string of a body, "" for offset 0
+    const char* text(uint32_t offset) const;
+};
+
+#endif /* SceneDescription_h */
@@ -0,0 +1,126 @@
+//
+//  SceneGraph.cpp
+//  graphics_assig_5_06
+//
+
+#include <iostream>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SCENE_USE_SSE2 1
+#endif
+
+#include "SceneGraph.h"
+
+using namespace std;
+using namespace glm;
+
+SceneGraph :: SceneGraph()
+{}
+
+int SceneGraph :: createNode(int parent)
+{
+    return transforms.createTransform(parent);
+}
+
+void SceneGraph :: setParent(int node, int parent)
+{
+    // refuse to create a cycle
+    for (int p = parent; p >= 0; p = transforms.getParent(p)) {
+        if (p == node) {
+            cout << "SceneGraph: node " << node << " cannot be parented to its own descendant" << endl;
+            return;
+        }
+    }
+    transforms.setParent(node, parent);
+}
+
+void SceneGraph :: setTranslation(int node, dvec3 translation)
+{
+    transforms.setTranslation(node, translation);
+}
+
+void SceneGraph :: setRotation(int node, quat rotation)
+{
+    transforms.setRotation(node, rotation);
+}
+
+void SceneGraph :: setScale(int node, vec3 scaling)
+{
+    transforms.setScale(node, scaling);
+}
+
+dvec3 SceneGraph :: getTranslation(int node) const
+{
+    return transforms.getTranslation(node);
+}
+
+quat SceneGraph :: getRotation(int node) const
+{
+    return transforms.getRotation(node);
+}
+
+vec3 SceneGraph :: getScale(int node) const
+{
+    return transforms.getScale(node);
+}
+
+int SceneGraph :: getParent(int node) const
+{
+    return transforms.getParent(node);
+}
+
+void SceneGraph :: updateWorldMatrices()
+{
+    transforms.update();
+}
+
+const dmat4& SceneGraph :: getWorldMatrix(int node) const
+{
+    return transforms.getWorldMatrix(node);
+}
+
+dvec3 SceneGraph :: getWorldPosition(int node) const
+{
+    return dvec3(transforms.getWorldMatrix(node)[3]);
+}
+
+// The subtraction happens in double, so the translation that reaches float
+// is the small camera-to-body offset rather than two large, nearly equal
+// positions. Rotation and scale columns are only narrowed.
+void SceneGraph :: getRelativeMatrices(const int *nodeList, int count, dvec3 origin, mat4 *out) const
+{
+#ifdef SCENE_USE_SSE2
+    const __m128d originXY = _mm_set_pd(origin.y, origin.x);
+    const __m128d originZW = _mm_set_pd(0.0, origin.z);
+    for (int i = 0; i < count; i++) {
+        const double *source = &transforms.getWorldMatrix(nodeList[i])[0][0];
+        float *target = &out[i][0][0];
+        for (int column = 0; column < 4; column++) {
+            __m128d low = _mm_loadu_pd(source + column*4);
+            __m128d high = _mm_loadu_pd(source + column*4 + 2);
+            if (column == 3) {
+                low = _mm_sub_pd(low, originXY);
+                high = _mm_sub_pd(high, originZW);
+            }
+            _mm_storeu_ps(target + column*4, _mm_movelh_ps(_mm_cvtpd_ps(low), _mm_cvtpd_ps(high)));
+        }
+    }
+#else
+    for (int i = 0; i < count; i++) {
+        const dmat4 &world = transforms.getWorldMatrix(nodeList[i]);
+        out[i] = mat4(world);
+        out[i][3] = vec4(dvec3(world[3]) - origin, world[3].w);
+    }
+#endif
+}
+
+int SceneGraph :: nodeCount() const
+{
+    return transforms.size();
+}
+
+int SceneGraph :: nodesUpdatedLastFrame() const
+{
+    return transforms.transformsUpdatedLastFrame();
+}
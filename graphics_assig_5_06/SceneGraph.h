@@ -0,0 +1,63 @@
+//
+//  SceneGraph.h
+//  graphics_assig_5_06
+//
+//  Hierarchy of transform nodes. Each node keeps its local translation,
+//  rotation and scale plus a cached world matrix; changing a node only marks
+//  it dirty, and updateWorldMatrices() recomputes it and its subtree. The
+//  nodes are stored in a TransformSystem, sorted by depth, so the update
+//  runs a level at a time across the thread pool.
+//  Translations and matrices are double precision so bodies far from the
+//  origin keep sub-millimetre placement; getRelativeMatrices() narrows them
+//  to float only after moving the origin to the camera.
+//
+
+#ifndef SceneGraph_h
+#define SceneGraph_h
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "TransformSystem.h"
+
+using namespace glm;
+using namespace std;
+
+class SceneGraph
+{
+private:
+    TransformSystem transforms;     // a node's index is its handle
+
+public:
+    SceneGraph();
+
+    // returns the index of the new node, attached under parent (-1 for a root)
+    int createNode(int parent = -1);
+    void setParent(int node, int parent);
+
+    void setTranslation(int node, dvec3 translation);
+    void setRotation(int node, quat rotation);
+    void setScale(int node, vec3 scaling);
+
+    dvec3 getTranslation(int node) const;
+    quat getRotation(int node) const;
+    vec3 getScale(int node) const;
+    int getParent(int node) const;
+
+    // recomputes world matrices of every dirty subtree, a level at a time
+    void updateWorldMatrices();
+
+    // world matrix as of the last updateWorldMatrices() call
+    const dmat4& getWorldMatrix(int node) const;
+    dvec3 getWorldPosition(int node) const;
+
+    // world matrices of count nodes with origin moved to (0,0,0), converted
+    // to float for upload; out receives count matrices
+    void getRelativeMatrices(const int *nodeList, int count, dvec3 origin, mat4 *out) const;
+
+    int nodeCount() const;
+    int nodesUpdatedLastFrame() const;
+};
+
+#endif /* SceneGraph_h */
@@ -0,0 +1,235 @@
+//
+//  SceneRenderer.cpp
+//  graphics_assig_5_06
+//
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "SceneRenderer.h"
+#include "VirtualTexture.h"
+#include "Profiler.h"
+
+using namespace std;
+using namespace glm;
+
+RenderCounters renderCounters;
+
+namespace {
+
+// not a GL name, so the first bind after ForgetBindings() always happens
+const GLuint UNKNOWN_BINDING = ~0u;
+
+// the units RenderScene uses; binds on others are made every time
+const int TRACKED_UNITS = 3;
+
+struct Bindings
+{
+    GLuint program = UNKNOWN_BINDING;
+    GLuint vertexArray = UNKNOWN_BINDING;
+    GLenum targets[TRACKED_UNITS] = {};
+    GLuint textures[TRACKED_UNITS] = { UNKNOWN_BINDING, UNKNOWN_BINDING, UNKNOWN_BINDING };
+};
+
+Bindings bindings;
+
+}
+
+// --------------------------------------------------------------------------
+// Functions to set up vertex arrays and buffers
+
+bool InitializeVAO(Geometry *geometry){
+
+    //Generate Vertex Buffer Objects
+    // create an array buffer object for storing our vertices
+    glGenBuffers(1, &geometry->vertexBuffer);
+    glGenBuffers(1, &geometry->textureBuffer);
+    glGenBuffers(1, &geometry->normalBuffer);
+
+    //Set up Vertex Array Object
+    // create a vertex array object encapsulating all our vertex attributes
+    glGenVertexArrays(1, &geometry->vertexArray);
+    glBindVertexArray(geometry->vertexArray);
+
+    // associate the position array with the vertex array object
+    glBindBuffer(GL_ARRAY_BUFFER, geometry->vertexBuffer);
+    glVertexAttribPointer(
+        VERTEX_INDEX,        //Attribute index
+        3,                     //# of components
+        GL_FLOAT,             //Type of component
+        GL_FALSE,             //Should be normalized?
+        sizeof(vec3),        //Stride - can use 0 if tightly packed
+        0);                    //Offset to first element
+    glEnableVertexAttribArray(VERTEX_INDEX);
+
+    // texture buffer
+    glBindBuffer(GL_ARRAY_BUFFER, geometry->textureBuffer);
+    glVertexAttribPointer(
+        TEXTURE_INDEX,
+        2,
+        GL_FLOAT,
+        GL_FALSE,
+        sizeof(vec2),
+        0);
+    glEnableVertexAttribArray(TEXTURE_INDEX);
+
+    // normal buffer
+    glBindBuffer(GL_ARRAY_BUFFER, geometry->normalBuffer);
+    glVertexAttribPointer(
+                          NORMAL_INDEX,
+                          3,
+                          GL_FLOAT,
+                          GL_FALSE,
+                          sizeof(vec3),
+                          0);
+    glEnableVertexAttribArray(NORMAL_INDEX);
+
+    // unbind our buffers, resetting to default state
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+
+    return !CheckGLErrors("OpenGL ERROR:  ");
+}
+
+// create buffers and fill with geometry data, returning true if successful
+bool LoadGeometry(Geometry *geometry, vector<vec3> vertices, vector<vec2> textureCoords, vector<vec3> normals, int elementCount)
+{
+    PROFILE_SCOPE("LoadGeometry");
+    geometry->elementCount = elementCount;
+
+    // create an array buffer object for storing our vertices
+    glBindBuffer(GL_ARRAY_BUFFER, geometry->vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vec3)*geometry->elementCount, &vertices[0], GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ARRAY_BUFFER, geometry->textureBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vec2)*textureCoords.size(), &textureCoords[0], GL_STATIC_DRAW);
+
+    // unlit geometry has no normals; the attribute is turned off rather
+    // than pointed at an empty buffer
+    if (normals.empty()) {
+        glBindVertexArray(geometry->vertexArray);
+        glDisableVertexAttribArray(NORMAL_INDEX);
+        glBindVertexArray(0);
+    } else {
+        glBindBuffer(GL_ARRAY_BUFFER, geometry->normalBuffer);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(vec3)*normals.size(), &normals[0], GL_STATIC_DRAW);
+    }
+
+    //Unbind buffer to reset to default state
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    renderCounters.bufferBytes += sizeof(vec3)*geometry->elementCount + sizeof(vec2)*textureCoords.size() + sizeof(vec3)*normals.size();
+
+    // check for OpenGL errors and return false if error occurred
+    return !CheckGLErrors("OpenGL ERROR:  ");
+}
+
+void DestroyGeometry(Geometry *geometry)
+{
+    // unbind and destroy our vertex array object and associated buffers
+    glBindVertexArray(0);
+    glDeleteVertexArrays(1, &geometry->vertexArray);
+    glDeleteBuffers(1, &geometry->vertexBuffer);
+}
+
+// --------------------------------------------------------------------------
+// Binds that skip what is already bound, and count the rest
+
+void BindProgram(GLuint program)
+{
+    if (bindings.program == program)
+        return;
+    glUseProgram(program);
+    bindings.program = program;
+    renderCounters.stateChanges++;
+}
+
+void BindVertexArray(GLuint vertexArray)
+{
+    if (bindings.vertexArray == vertexArray)
+        return;
+    glBindVertexArray(vertexArray);
+    bindings.vertexArray = vertexArray;
+    renderCounters.stateChanges++;
+}
+
+void BindTexture(int unit, GLenum target, GLuint texture)
+{
+    bool tracked = unit < TRACKED_UNITS;
+    // a unit holds one texture per target; only the last one bound is
+    // remembered, so going back to another target binds again
+    if (tracked && bindings.targets[unit] == target && bindings.textures[unit] == texture)
+        return;
+    if (unit != 0)
+        glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(target, texture);
+    if (unit != 0)
+        glActiveTexture(GL_TEXTURE0);
+    if (tracked) {
+        bindings.targets[unit] = target;
+        bindings.textures[unit] = texture;
+    }
+    renderCounters.stateChanges++;
+}
+
+void ForgetBindings()
+{
+    bindings = Bindings();
+}
+
+void ResetBindings()
+{
+    for (int unit = 0; unit < TRACKED_UNITS; unit++) {
+        if (bindings.textures[unit] != 0 && bindings.textures[unit] != UNKNOWN_BINDING)
+            BindTexture(unit, bindings.targets[unit], 0);
+    }
+    BindVertexArray(0);
+    BindProgram(0);
+}
+
+// --------------------------------------------------------------------------
+// Rendering function that draws one body to the frame buffer
+
+void SetSceneUniforms(GLuint program, const FrameSnapshot &frame, mat4 perspectiveMatrix, mat4 transformVertice)
+{
+    mat4 modelViewProjection = perspectiveMatrix*frame.viewMatrix;
+    GLint uniformLocation = glGetUniformLocation(program, "modelViewProjection");
+    glUniformMatrix4fv(uniformLocation, 1, false, glm::value_ptr(modelViewProjection));
+
+    unsigned int transformLoc = glGetUniformLocation(program, "transform");
+    glUniformMatrix4fv(transformLoc, 1, GL_FALSE, value_ptr(transformVertice));
+
+    unsigned int lightPos = glGetUniformLocation(program, "lightPosition");
+    glUniform3f(lightPos, frame.lightPosition.x, frame.lightPosition.y, frame.lightPosition.z);
+
+    unsigned int camPos = glGetUniformLocation(program, "cameraPosition");
+    glUniform3f(camPos, frame.cameraPosition.x, frame.cameraPosition.y, frame.cameraPosition.z);
+}
+
+void RenderScene(Geometry *geometry, MyTexture *texture, MyTexture *normalMap, const VirtualTexture *virtualTexture, GLuint program, const FrameSnapshot &frame, mat4 perspectiveMatrix, GLenum rendermode, mat4 transformVertice)
+{
+    PROFILE_SCOPE("RenderScene");
+
+    // bind our shader program and the vertex array object containing our
+    // scene geometry, then tell OpenGL to draw our geometry; what the body
+    // before left bound is only rebound where it differs
+    BindProgram(program);
+    SetSceneUniforms(program, frame, perspectiveMatrix, transformVertice);
+
+    if (normalMap) {
+        glUniform1i(glGetUniformLocation(program, "normalMap"), 1);
+        BindTexture(1, normalMap->target, normalMap->textureID);
+    }
+    if (virtualTexture)
+        virtualTexture->bindPageTable(program);
+
+    BindVertexArray(geometry->vertexArray);
+    BindTexture(0, texture->target, texture->textureID);
+    glDrawArrays(rendermode, 0, geometry->elementCount);
+
+    renderCounters.drawCalls++;
+    renderCounters.triangles += geometry->elementCount/3;
+
+    // check for an report any OpenGL errors
+    CheckGLErrors("OpenGL ERROR:  ");
+}
@@ -0,0 +1,82 @@
+//
+//  SceneRenderer.h
+//  graphics_assig_5_06
+//
+//  The GL calls that put one body's mesh on screen: its vertex arrays and
+//  buffers, and RenderScene, which binds a body's program, textures and
+//  geometry and draws it. The app's frame loop and the bench target's
+//  submission benchmark both go through these, so what is timed is what
+//  is drawn.
+//
+
+#ifndef SceneRenderer_h
+#define SceneRenderer_h
+
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "texture.h"
+#include "FramePipeline.h"
+#include "PerformanceHud.h"
+
+using namespace glm;
+using namespace std;
+
+class VirtualTexture;
+
+// attribute locations, as laid out in shaders/vertex.glsl
+const GLuint VERTEX_INDEX = 0;
+const GLuint TEXTURE_INDEX = 1;
+const GLuint NORMAL_INDEX = 2;
+
+struct Geometry
+{
+    // OpenGL names for array buffer objects, vertex array object
+    GLuint  vertexBuffer;
+    GLuint  textureBuffer;
+    GLuint  colourBuffer;
+    GLuint  normalBuffer;
+
+    GLuint  vertexArray;
+    GLsizei elementCount;
+
+    // initialize object names to zero (OpenGL reserved value)
+    Geometry() : vertexBuffer(0), colourBuffer(0), vertexArray(0), elementCount(0)
+    {}
+};
+
+// what this frame has drawn so far, and the memory in use, for the HUD
+extern RenderCounters renderCounters;
+
+// The binds of the frame's draws go through these. Each remembers what it
+// bound last and skips binding it again, and counts the binds it does make
+// in renderCounters.stateChanges. GL code that binds directly (uploads,
+// the HUD) leaves them out of date, so ForgetBindings() is called after it.
+void BindProgram(GLuint program);
+void BindVertexArray(GLuint vertexArray);
+void BindTexture(int unit, GLenum target, GLuint texture);     // leaves unit 0 active
+void ForgetBindings();
+
+// unbinds what the calls above left bound, for code outside the frame
+void ResetBindings();
+
+// a vertex array with position, texture coordinate and normal buffers
+bool InitializeVAO(Geometry *geometry);
+
+// create buffers and fill with geometry data, returning true if successful;
+// with no normals the attribute is turned off
+bool LoadGeometry(Geometry *geometry, vector<vec3> vertices, vector<vec2> textureCoords, vector<vec3> normals, int elementCount);
+
+// deallocate geometry-related objects
+void DestroyGeometry(Geometry *geometry);
+
+// sets the uniforms every body's program reads on the bound program
+void SetSceneUniforms(GLuint program, const FrameSnapshot &frame, mat4 perspectiveMatrix, mat4 transformVertice);
+
+// Draws geometry with program, its texture on unit 0 and, if given, the
+// normal map on unit 1 and the virtual texture's page table on unit 2.
+// They are left bound for the next body; see ResetBindings().
+void RenderScene(Geometry *geometry, MyTexture *texture, MyTexture *normalMap, const VirtualTexture *virtualTexture, GLuint program, const FrameSnapshot &frame, mat4 perspectiveMatrix, GLenum rendermode, mat4 transformVertice);
+
+#endif /* SceneRenderer_h */
@@ -0,0 +1,450 @@
+//
+//  ShaderManager.cpp
+//  graphics_assig_5_06
+//
+
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <set>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+
+#include "ShaderManager.h"
+#include "Profiler.h"
+
+using namespace std;
+
+// GL 4.1 / ARB_get_program_binary and KHR_parallel_shader_compile, which the
+// generated glad (GL 4.0 core, no extensions) leaves out
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+
+typedef void (APIENTRYP GetProgramBinaryFunction)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (APIENTRYP ProgramBinaryFunction)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (APIENTRYP ProgramParameteriFunction)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP MaxShaderCompilerThreadsFunction)(GLuint count);
+
+static GetProgramBinaryFunction getProgramBinary = nullptr;
+static ProgramBinaryFunction programBinary = nullptr;
+static ProgramParameteriFunction programParameteri = nullptr;
+
+// cache files: "PBIN", u32 binary format, u64 key, then the driver's blob
+static const char CACHE_MAGIC[4] = { 'P', 'B', 'I', 'N' };
+static const size_t CACHE_HEADER_SIZE = 16;
+
+static double MillisecondsSince(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+static uint64_t HashString(uint64_t hash, const string &text)
+{
+    for (unsigned char c : text)
+        hash = (hash ^ c)*1099511628211ull;
+    // separator, so ("ab", "c") and ("a", "bc") differ
+    return (hash ^ 0xff)*1099511628211ull;
+}
+
+static string GLString(GLenum name)
+{
+    const GLubyte *value = glGetString(name);
+    return value ? reinterpret_cast<const char*>(value) : "";
+}
+
+// reads a text file with the given name into a string
+string LoadSource(const string &filename)
+{
+    string source;
+
+    ifstream input(filename.c_str());
+    if (input) {
+        copy(istreambuf_iterator<char>(input),
+             istreambuf_iterator<char>(),
+             back_inserter(source));
+        input.close();
+    }
+    else {
+        cout << "ERROR: Could not load shader source from file "
+        << filename << endl;
+    }
+
+    return source;
+}
+
+// adds the defines on the line after #version, which has to come first
+static string InjectDefines(const string &source, const vector<string> &defines)
+{
+    if (defines.empty())
+        return source;
+    string lines;
+    for (const string &define : defines)
+        lines += "#define " + define + "\n";
+
+    size_t version = source.find("#version");
+    if (version == string::npos)
+        return lines + source;
+    size_t lineEnd = source.find('\n', version);
+    if (lineEnd == string::npos)
+        return source + "\n" + lines;
+    return source.substr(0, lineEnd + 1) + lines + source.substr(lineEnd + 1);
+}
+
+void ShaderManager :: initialize(GLADloadproc loader, const string &cacheDirectory)
+{
+    this->cacheDirectory = cacheDirectory;
+    driverId = GLString(GL_VENDOR) + "|" + GLString(GL_RENDERER) + "|" + GLString(GL_VERSION);
+
+    GLint major = 0, minor = 0, extensionCount = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+    set<string> extensions;
+    for (GLint i = 0; i < extensionCount; i++)
+        extensions.insert(reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)));
+
+    // program binaries are core from 4.1; formats can still number zero,
+    // e.g. when the driver's own shader cache is off
+    binarySupported = false;
+    if (!cacheDirectory.empty() && (major*10 + minor >= 41 || extensions.count("GL_ARB_get_program_binary"))) {
+        getProgramBinary = (GetProgramBinaryFunction)loader("glGetProgramBinary");
+        programBinary = (ProgramBinaryFunction)loader("glProgramBinary");
+        programParameteri = (ProgramParameteriFunction)loader("glProgramParameteri");
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        binarySupported = getProgramBinary && programBinary && programParameteri && formats > 0;
+    }
+    if (binarySupported) {
+        mkdir(cacheDirectory.c_str(), 0755);
+        struct stat info;
+        if (stat(cacheDirectory.c_str(), &info) != 0 || !S_ISDIR(info.st_mode)) {
+            cout << "ShaderManager: could not create " << cacheDirectory << ", program binaries will not be cached" << endl;
+            binarySupported = false;
+        }
+    }
+
+    // let the driver pick how many compiler threads to use
+    MaxShaderCompilerThreadsFunction maxThreads = nullptr;
+    if (extensions.count("GL_KHR_parallel_shader_compile"))
+        maxThreads = (MaxShaderCompilerThreadsFunction)loader("glMaxShaderCompilerThreadsKHR");
+    else if (extensions.count("GL_ARB_parallel_shader_compile"))
+        maxThreads = (MaxShaderCompilerThreadsFunction)loader("glMaxShaderCompilerThreadsARB");
+    parallelSupported = maxThreads != nullptr;
+    if (parallelSupported)
+        maxThreads(0xFFFFFFFF);
+
+    cout << "Shaders: " << (parallelSupported ? "parallel" : "serial") << " compilation, "
+         << (binarySupported ? "program binary cache in " + cacheDirectory + "/" : string("no program binary cache")) << endl;
+}
+
+int ShaderManager :: request(const string &vertexFile, const string &fragmentFile, const vector<string> &defines)
+{
+    PROFILE_SCOPE("ShaderManager request");
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    Program entry;
+    entry.vertexFile = vertexFile;
+    entry.fragmentFile = fragmentFile;
+    entry.defines = defines;
+    entry.submitted = start;
+    if (!prepare(entry))
+        return -1;
+
+    map<uint64_t, int>::iterator existing = handles.find(entry.key);
+    if (existing != handles.end()) {
+        duplicates++;
+        return existing->second;
+    }
+
+    build(entry);
+    programs.push_back(entry);
+    handles[entry.key] = int(programs.size()) - 1;
+    return int(programs.size()) - 1;
+}
+
+// reads the sources and works out the name and cache key
+bool ShaderManager :: prepare(Program &entry)
+{
+    entry.name = entry.vertexFile + " + " + entry.fragmentFile;
+    for (size_t i = 0; i < entry.defines.size(); i++)
+        entry.name += (i == 0 ? " [" : " ") + entry.defines[i] + (i + 1 == entry.defines.size() ? "]" : "");
+    string vertexSource = LoadSource(entry.vertexFile);
+    string fragmentSource = LoadSource(entry.fragmentFile);
+    if (vertexSource.empty() || fragmentSource.empty())
+        return false;
+    entry.vertexSource = InjectDefines(vertexSource, entry.defines);
+    entry.fragmentSource = InjectDefines(fragmentSource, entry.defines);
+
+    uint64_t key = 14695981039346656037ull;
+    key = HashString(key, entry.vertexSource);
+    key = HashString(key, entry.fragmentSource);
+    entry.key = HashString(key, driverId);
+    return true;
+}
+
+void ShaderManager :: build(Program &entry)
+{
+    if (binarySupported && loadBinary(entry))
+        entry.fromCache = true;
+    else
+        compileAndLink(entry);
+    entry.submitMilliseconds = MillisecondsSince(entry.submitted);
+}
+
+// frees a rebuild that was overtaken by a newer one
+void ShaderManager :: discard(Program &entry)
+{
+    glDeleteShader(entry.vertex);
+    glDeleteShader(entry.fragment);
+    glDeleteProgram(entry.program);
+    entry.vertex = entry.fragment = entry.program = 0;
+}
+
+// nothing here asks for a status: any query would wait for the compiler
+void ShaderManager :: compileAndLink(Program &entry)
+{
+    const GLchar *vertexSource = entry.vertexSource.c_str();
+    entry.vertex = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(entry.vertex, 1, &vertexSource, 0);
+    glCompileShader(entry.vertex);
+
+    const GLchar *fragmentSource = entry.fragmentSource.c_str();
+    entry.fragment = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(entry.fragment, 1, &fragmentSource, 0);
+    glCompileShader(entry.fragment);
+
+    entry.program = glCreateProgram();
+    glAttachShader(entry.program, entry.vertex);
+    glAttachShader(entry.program, entry.fragment);
+    if (binarySupported)
+        programParameteri(entry.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(entry.program);
+}
+
+string ShaderManager :: cachePath(uint64_t key) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+    return cacheDirectory + "/" + name;
+}
+
+bool ShaderManager :: loadBinary(Program &entry)
+{
+    ifstream file(cachePath(entry.key), ios::binary);
+    if (!file)
+        return false;
+    vector<char> data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    if (data.size() <= CACHE_HEADER_SIZE || memcmp(data.data(), CACHE_MAGIC, 4) != 0)
+        return false;
+    uint32_t format;
+    uint64_t key;
+    memcpy(&format, &data[4], sizeof(format));
+    memcpy(&key, &data[8], sizeof(key));
+    if (key != entry.key)
+        return false;
+
+    entry.program = glCreateProgram();
+    programBinary(entry.program, format, &data[CACHE_HEADER_SIZE], GLsizei(data.size() - CACHE_HEADER_SIZE));
+    GLint status = GL_FALSE;
+    glGetProgramiv(entry.program, GL_LINK_STATUS, &status);
+    if (status == GL_FALSE) {
+        cout << "Shaders: the cached binary of " << entry.name << " was rejected, recompiling" << endl;
+        glDeleteProgram(entry.program);
+        entry.program = 0;
+        return false;
+    }
+    cacheHits++;
+    return true;
+}
+
+void ShaderManager :: saveBinary(const Program &entry)
+{
+    GLint length = 0;
+    glGetProgramiv(entry.program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+    vector<char> data(CACHE_HEADER_SIZE + length);
+    GLenum format = 0;
+    getProgramBinary(entry.program, length, &length, &format, &data[CACHE_HEADER_SIZE]);
+    uint32_t storedFormat = format;
+    memcpy(&data[0], CACHE_MAGIC, 4);
+    memcpy(&data[4], &storedFormat, sizeof(storedFormat));
+    memcpy(&data[8], &entry.key, sizeof(entry.key));
+
+    // written aside and renamed, so a concurrent launch never reads half a file
+    string path = cachePath(entry.key);
+    string partial = path + ".partial";
+    FILE *file = fopen(partial.c_str(), "wb");
+    if (!file)
+        return;
+    bool written = fwrite(data.data(), 1, CACHE_HEADER_SIZE + length, file) == CACHE_HEADER_SIZE + size_t(length);
+    written = (fclose(file) == 0) && written;
+    if (written && rename(partial.c_str(), path.c_str()) == 0)
+        cacheWrites++;
+    else
+        remove(partial.c_str());
+}
+
+bool ShaderManager :: isComplete(const Program &entry) const
+{
+    if (entry.resolved || entry.fromCache || !parallelSupported)
+        return true;
+    GLint complete = GL_TRUE;
+    glGetProgramiv(entry.program, GL_COMPLETION_STATUS_KHR, &complete);
+    return complete == GL_TRUE;
+}
+
+bool ShaderManager :: isReady(int handle)
+{
+    if (handle < 0 || handle >= int(programs.size()))
+        return true;
+    return isComplete(programs[handle]);
+}
+
+void ShaderManager :: resolve(Program &entry)
+{
+    PROFILE_SCOPE("ShaderManager wait");
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    // a cached binary is ready when request() returns; a compile that has
+    // already finished only gives an upper bound on how long it took
+    bool finishedEarlier = parallelSupported && !entry.fromCache && isComplete(entry);
+    GLint status = GL_FALSE;
+    glGetProgramiv(entry.program, GL_LINK_STATUS, &status);
+    entry.linked = status == GL_TRUE;
+    entry.readyMilliseconds = entry.fromCache ? entry.submitMilliseconds : MillisecondsSince(entry.submitted);
+    double blockedMilliseconds = entry.submitMilliseconds + MillisecondsSince(start);
+
+    if (!entry.linked) {
+        GLuint shaders[2] = { entry.vertex, entry.fragment };
+        const string *sources[2] = { &entry.vertexSource, &entry.fragmentSource };
+        for (int i = 0; i < 2; i++) {
+            GLint compiled = GL_TRUE;
+            if (shaders[i])
+                glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &compiled);
+            if (compiled == GL_FALSE) {
+                GLint length;
+                glGetShaderiv(shaders[i], GL_INFO_LOG_LENGTH, &length);
+                string info(length, ' ');
+                glGetShaderInfoLog(shaders[i], info.length(), &length, &info[0]);
+                cout << "ERROR compiling shader:" << endl << endl;
+                cout << *sources[i] << endl;
+                cout << info << endl;
+            }
+        }
+        GLint length;
+        glGetProgramiv(entry.program, GL_INFO_LOG_LENGTH, &length);
+        string info(length, ' ');
+        glGetProgramInfoLog(entry.program, info.length(), &length, &info[0]);
+        cout << "ERROR linking shader program " << entry.name << ":" << endl;
+        cout << info << endl;
+    } else {
+        cout << "Shaders: " << entry.name << (entry.fromCache ? " loaded from the binary cache" : " compiled and linked")
+             << (finishedEarlier ? " in at most " : " in ") << entry.readyMilliseconds << " ms, "
+             << blockedMilliseconds << " ms of it blocking" << endl;
+        if (!entry.fromCache && binarySupported)
+            saveBinary(entry);
+    }
+
+    if (entry.vertex) {
+        glDetachShader(entry.program, entry.vertex);
+        glDeleteShader(entry.vertex);
+    }
+    if (entry.fragment) {
+        glDetachShader(entry.program, entry.fragment);
+        glDeleteShader(entry.fragment);
+    }
+    entry.vertex = entry.fragment = 0;
+    if (!entry.linked) {
+        glDeleteProgram(entry.program);
+        entry.program = 0;
+    }
+    entry.vertexSource.clear();
+    entry.fragmentSource.clear();
+    entry.resolved = true;
+}
+
+GLuint ShaderManager :: program(int handle)
+{
+    if (handle < 0 || handle >= int(programs.size()))
+        return 0;
+    Program &entry = programs[handle];
+    if (!entry.resolved)
+        resolve(entry);
+    return entry.program;
+}
+
+int ShaderManager :: reloadFile(const string &file)
+{
+    int started = 0;
+    for (int handle = 0; handle < int(programs.size()); handle++) {
+        const Program &current = programs[handle];
+        if (current.vertexFile != file && current.fragmentFile != file)
+            continue;
+
+        Program entry;
+        entry.vertexFile = current.vertexFile;
+        entry.fragmentFile = current.fragmentFile;
+        entry.defines = current.defines;
+        entry.submitted = chrono::steady_clock::now();
+        if (!prepare(entry))
+            continue;
+
+        // a save in the middle of a rebuild supersedes it
+        for (size_t i = 0; i < reloads.size(); i++) {
+            if (reloads[i].first == handle) {
+                discard(reloads[i].second);
+                reloads.erase(reloads.begin() + i);
+                break;
+            }
+        }
+        build(entry);
+        reloads.push_back(make_pair(handle, entry));
+        started++;
+    }
+    return started;
+}
+
+vector<ShaderManager::ProgramSwap> ShaderManager :: collectReloads()
+{
+    vector<ProgramSwap> swaps;
+    for (size_t i = 0; i < reloads.size(); ) {
+        int handle = reloads[i].first;
+        Program &entry = reloads[i].second;
+        if (!isComplete(entry)) {
+            i++;
+            continue;
+        }
+
+        resolve(entry);
+        if (entry.linked) {
+            ProgramSwap swap = { handle, programs[handle].program, entry.program };
+            swaps.push_back(swap);
+            if (handles.count(programs[handle].key) && handles[programs[handle].key] == handle)
+                handles.erase(programs[handle].key);
+            handles[entry.key] = handle;
+            programs[handle] = entry;
+        } else
+            cout << "Shaders: keeping the previous build of " << programs[handle].name << endl;
+        reloads.erase(reloads.begin() + i);
+    }
+    return swaps;
+}
+
+void ShaderManager :: report() const
+{
+    int built = 0;
+    double slowest = 0.0;
+    for (const Program &entry : programs) {
+        if (!entry.resolved)
+            continue;
+        built++;
+        slowest = max(slowest, entry.readyMilliseconds);
+    }
+    cout << "Shaders: " << built << " programs ready after " << slowest << " ms (" << duplicates
+         << " duplicate requests shared), " << cacheHits << " from the binary cache, " << cacheWrites << " newly cached" << endl;
+}
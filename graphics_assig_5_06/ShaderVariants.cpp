@@ -0,0 +1,54 @@
+//
+//  ShaderVariants.cpp
+//  graphics_assig_5_06
+//
+
+#include <cstring>
+
+#include "ShaderVariants.h"
+
+using namespace std;
+
+unsigned NormalizeShaderFeatures(unsigned features)
+{
+    if (features & SHADER_EMISSIVE)
+        return features & (SHADER_EMISSIVE | SHADER_VIRTUAL_TEXTURE);
+    if (features & (SHADER_SPECULAR | SHADER_NORMAL_MAP))
+        features |= SHADER_LIT;
+    return features;
+}
+
+vector<string> ShaderFeatureDefines(unsigned features)
+{
+    features = NormalizeShaderFeatures(features);
+    vector<string> defines;
+    if (features & SHADER_LIT)
+        defines.push_back("LIT");
+    if (features & SHADER_SPECULAR)
+        defines.push_back("SPECULAR");
+    if (features & SHADER_NORMAL_MAP)
+        defines.push_back("NORMAL_MAP");
+    if (features & SHADER_EMISSIVE)
+        defines.push_back("EMISSIVE");
+    if (defines.empty())
+        defines.push_back("UNLIT");
+    if (features & SHADER_VIRTUAL_TEXTURE)
+        defines.push_back("VIRTUAL_TEXTURE");
+    return defines;
+}
+
+int ShaderFeatureFromName(const char *name)
+{
+    static const struct { const char *name; int feature; } names[] = {
+        { "UNLIT", SHADER_UNLIT },
+        { "LIT", SHADER_LIT },
+        { "SPECULAR", SHADER_SPECULAR },
+        { "NORMAL_MAP", SHADER_NORMAL_MAP },
+        { "EMISSIVE", SHADER_EMISSIVE },
+        { "VIRTUAL_TEXTURE", SHADER_VIRTUAL_TEXTURE },
+    };
+    for (const auto &entry : names)
+        if (strcmp(name, entry.name) == 0)
+            return entry.feature;
+    return -1;
+}
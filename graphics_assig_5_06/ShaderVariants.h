@@ -0,0 +1,41 @@
+//
+//  ShaderVariants.h
+//  graphics_assig_5_06
+//
+//  Feature flags for the variants of shaders/vertex.glsl and
+//  fragment.glsl. Each flag becomes a #define, so a body only pays for the
+//  lighting it uses: the stars backdrop has no normals at all, the sun is
+//  lit from inside, and only bodies with a normal map sample one.
+//  VIRTUAL_TEXTURE is independent of the lighting and combines with any of
+//  it.
+//
+
+#ifndef ShaderVariants_h
+#define ShaderVariants_h
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+enum ShaderFeature
+{
+    SHADER_UNLIT = 0,               // texture only
+    SHADER_LIT = 1 << 0,            // diffuse light from lightPosition
+    SHADER_SPECULAR = 1 << 1,       // highlight; implies LIT
+    SHADER_NORMAL_MAP = 1 << 2,     // normal from the normalMap sampler; implies LIT
+    SHADER_EMISSIVE = 1 << 3,       // a light source's own surface; replaces the others
+    SHADER_VIRTUAL_TEXTURE = 1 << 4 // texture read through a page table (VirtualTexture.h)
+};
+
+// adds the features others depend on and drops ones that cannot combine,
+// so equivalent sets map to the same program
+unsigned NormalizeShaderFeatures(unsigned features);
+
+// the #define names for a normalised set, in a fixed order
+vector<string> ShaderFeatureDefines(unsigned features);
+
+// the flag whose #define is name ("UNLIT" is 0), or -1 if there is none
+int ShaderFeatureFromName(const char *name);
+
+#endif /* ShaderVariants_h */
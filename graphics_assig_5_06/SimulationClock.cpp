@@ -0,0 +1,89 @@
+//
+//  SimulationClock.cpp
+//  graphics_assig_5_06
+//
+
+#include <algorithm>
+
+#include "SimulationClock.h"
+
+using namespace std;
+using namespace glm;
+
+SimulationClock :: SimulationClock(double stepSeconds, int maxStepsPerFrame)
+    : fixedStep(stepSeconds), maxStepsPerFrame(maxStepsPerFrame)
+{}
+
+void SimulationClock :: accumulate(double realSeconds)
+{
+    if (paused || realSeconds <= 0.0)
+        return;
+    accumulator += realSeconds*timeWarp;
+    accumulator = min(accumulator, fixedStep*maxStepsPerFrame);
+}
+
+bool SimulationClock :: consumeStep()
+{
+    if (accumulator < fixedStep)
+        return false;
+    accumulator -= fixedStep;
+    simulationTime += fixedStep;
+    return true;
+}
+
+double SimulationClock :: interpolationAlpha() const
+{
+    return accumulator/fixedStep;
+}
+
+double SimulationClock :: time() const
+{
+    return simulationTime;
+}
+
+double SimulationClock :: step() const
+{
+    return fixedStep;
+}
+
+void SimulationClock :: setStep(double stepSeconds)
+{
+    // keep the same fraction of a step owed
+    accumulator *= stepSeconds/fixedStep;
+    fixedStep = stepSeconds;
+}
+
+void SimulationClock :: setTimeWarp(double warp)
+{
+    timeWarp = warp;
+}
+
+double SimulationClock :: getTimeWarp() const
+{
+    return timeWarp;
+}
+
+void SimulationClock :: setPaused(bool pause)
+{
+    paused = pause;
+}
+
+bool SimulationClock :: isPaused() const
+{
+    return paused;
+}
+
+void InterpolateStates(const SimulationState &previous, const SimulationState &current, float alpha, SimulationState &out)
+{
+    out.time = previous.time + (current.time - previous.time)*alpha;
+    out.bodies.resize(current.bodies.size());
+
+    // a body added this step has no previous state to blend from
+    size_t blended = min(previous.bodies.size(), current.bodies.size());
+    for (size_t i = 0; i < blended; i++) {
+        out.bodies[i].translation = mix(previous.bodies[i].translation, current.bodies[i].translation, double(alpha));
+        out.bodies[i].rotation = slerp(previous.bodies[i].rotation, current.bodies[i].rotation, alpha);
+    }
+    for (size_t i = blended; i < current.bodies.size(); i++)
+        out.bodies[i] = current.bodies[i];
+}
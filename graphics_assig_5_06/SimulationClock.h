@@ -0,0 +1,72 @@
+//
+//  SimulationClock.h
+//  graphics_assig_5_06
+//
+//  Fixed-timestep simulation clock. Real frame time (scaled by the time
+//  warp) goes into an accumulator that is drained in whole simulation
+//  steps; whatever is left over gives the fraction used to interpolate
+//  between the last two simulation states when rendering.
+//
+
+#ifndef SimulationClock_h
+#define SimulationClock_h
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+using namespace glm;
+using namespace std;
+
+class SimulationClock
+{
+private:
+    double fixedStep;
+    int maxStepsPerFrame;
+    double accumulator = 0.0;
+    double simulationTime = 0.0;
+    double timeWarp = 1.0;
+    bool paused = false;
+
+public:
+    // stepSeconds is simulation time per step; at most maxStepsPerFrame
+    // steps are owed at once so a long stall cannot snowball
+    explicit SimulationClock(double stepSeconds = 1.0/60.0, int maxStepsPerFrame = 8);
+
+    // adds real elapsed seconds, scaled by the time warp unless paused
+    void accumulate(double realSeconds);
+
+    // takes one step off the accumulator if a whole step is owed, advancing
+    // the simulation time; loop on this after accumulate()
+    bool consumeStep();
+
+    // fraction of a step left in the accumulator, in [0, 1)
+    double interpolationAlpha() const;
+
+    double time() const;
+    double step() const;
+    void setStep(double stepSeconds);
+
+    void setTimeWarp(double warp);
+    double getTimeWarp() const;
+    void setPaused(bool pause);
+    bool isPaused() const;
+};
+
+// transform of one animated body at the end of a simulation step
+struct BodyState
+{
+    dvec3 translation = dvec3(0.0);
+    quat rotation = quat(1.f, 0.f, 0.f, 0.f);
+};
+
+struct SimulationState
+{
+    double time = 0.0;
+    vector<BodyState> bodies;
+};
+
+// out = previous + alpha*(current - previous); rotations are slerped
+void InterpolateStates(const SimulationState &previous, const SimulationState &current, float alpha, SimulationState &out);
+
+#endif /* SimulationClock_h */
@@ -0,0 +1,119 @@
+//
+//  SkyBox.cpp
+//  graphics_assig_5_06
+//
+
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "SkyBox.h"
+#include "SceneRenderer.h"
+#include "ProceduralSphere.h"
+#include "Profiler.h"
+
+using namespace std;
+using namespace glm;
+
+namespace {
+
+// the direction through face coordinates s, t in [-1, 1], following the
+// table of cube map faces in the OpenGL specification
+vec3 CubemapDirection(int face, float s, float t)
+{
+    switch (face) {
+        case 0:  return vec3(1.f, -t, -s);
+        case 1:  return vec3(-1.f, -t, s);
+        case 2:  return vec3(s, 1.f, t);
+        case 3:  return vec3(s, -1.f, -t);
+        case 4:  return vec3(s, -t, 1.f);
+        default: return vec3(-s, -t, -1.f);
+    }
+}
+
+}
+
+void ConvertToCubemap(const TextureImage &image, CubemapImage &cubemap)
+{
+    PROFILE_SCOPE("ConvertToCubemap");
+    const int N = std::max(1, image.width/4);
+    cubemap.size = N;
+    for (int face = 0; face < 6; face++) {
+        vector<unsigned char> &texels = cubemap.faces[face];
+        texels.resize(size_t(N)*N*3);
+        for (int row = 0; row < N; row++) {
+            for (int column = 0; column < N; column++) {
+                float s = 2.f*(column + 0.5f)/N - 1.f;
+                float t = 2.f*(row + 0.5f)/N - 1.f;
+                vec2 coord = SphereTextureCoord(CubemapDirection(face, s, t));
+                float colour[3];
+                SampleTextureImage(image, coord.x, coord.y, colour, 3);
+                for (int c = 0; c < 3; c++)
+                    texels[(size_t(row)*N + column)*3 + c] = (unsigned char)std::min(255.f, colour[c] + 0.5f);
+            }
+        }
+    }
+}
+
+bool UploadCubemap(MyTexture *texture, const CubemapImage &cubemap)
+{
+    PROFILE_SCOPE("UploadCubemap");
+    texture->target = GL_TEXTURE_CUBE_MAP;
+    texture->width = cubemap.size;
+    texture->height = cubemap.size;
+    glGenTextures(1, &texture->textureID);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, texture->textureID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int face = 0; face < 6; face++)
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGB8, cubemap.size, cubemap.size, 0, GL_RGB, GL_UNSIGNED_BYTE,
+                     cubemap.faces[face].data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    // a face covers more pixels than it has texels at this field of view,
+    // so there is nothing to gain from mip levels
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    return glGetError() == GL_NO_ERROR;
+}
+
+bool SkyBox :: initialize(GLuint skyProgram)
+{
+    setProgram(skyProgram);
+    if (program == 0)
+        return false;
+    glGenVertexArrays(1, &vertexArray);
+    // filtering carries on across the edges of the faces
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+    return glGetError() == GL_NO_ERROR;
+}
+
+void SkyBox :: destroy()
+{
+    glDeleteVertexArrays(1, &vertexArray);
+    glDeleteProgram(program);
+    vertexArray = program = 0;
+}
+
+void SkyBox :: setProgram(GLuint skyProgram)
+{
+    program = skyProgram;
+    skyFromClipLocation = glGetUniformLocation(program, "skyFromClip");
+}
+
+void SkyBox :: render(const MyTexture &cubemap, const mat4 &modelViewProjection)
+{
+    // only the direction through each pixel matters, so the backdrop's
+    // scale and the far plane cancel out
+    mat4 skyFromClip = inverse(modelViewProjection);
+
+    glDepthMask(GL_FALSE);
+    BindProgram(program);
+    glUniformMatrix4fv(skyFromClipLocation, 1, GL_FALSE, value_ptr(skyFromClip));
+    BindVertexArray(vertexArray);
+    BindTexture(0, GL_TEXTURE_CUBE_MAP, cubemap.textureID);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glDepthMask(GL_TRUE);
+}
@@ -0,0 +1,63 @@
+//
+//  SkyBox.h
+//  graphics_assig_5_06
+//
+//  The sky pass. A backdrop body's image, which wraps around a sphere like
+//  sphere.obj's texture coordinates, is resampled into a cube map when it
+//  is loaded, and drawn after every other body as one triangle covering the
+//  screen at the far plane. With the depth test at GL_LEQUAL the sky only
+//  lands where nothing has been drawn, and the fragments behind bodies are
+//  rejected before shading; it writes no depth. The shaders, in
+//  shaders/sky_vertex.glsl and sky_fragment.glsl, only look the cube map up
+//  in each pixel's direction: there is no geometry and no lighting.
+//
+
+#ifndef SkyBox_h
+#define SkyBox_h
+
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "texture.h"
+
+using namespace glm;
+using namespace std;
+
+// six square RGB faces in the order of GL_TEXTURE_CUBE_MAP_POSITIVE_X and
+// the five targets after it, rows as glTexImage2D reads them
+struct CubemapImage
+{
+    int size = 0;
+    vector<unsigned char> faces[6];
+};
+
+// Faces a quarter of the image's width on a side, as detailed as its
+// equator; needs no context, so it runs with the decoding.
+void ConvertToCubemap(const TextureImage &image, CubemapImage &cubemap);
+
+// uploads the faces as a GL_TEXTURE_CUBE_MAP
+bool UploadCubemap(MyTexture *texture, const CubemapImage &cubemap);
+
+class SkyBox
+{
+private:
+    GLuint program = 0;
+    GLuint vertexArray = 0;     // empty; the vertices come from gl_VertexID
+    GLint skyFromClipLocation = -1;
+
+public:
+    // program is built from shaders/sky_vertex.glsl and sky_fragment.glsl
+    bool initialize(GLuint program);
+    void destroy();
+
+    // uses a rebuilt program from here on; the caller deletes the old one
+    void setProgram(GLuint program);
+
+    // Draws cubemap wherever the depth buffer is still clear, turned as the
+    // backdrop's model matrix turns it; the matrix is the backdrop's
+    // modelViewProjection, with the eye at the origin.
+    void render(const MyTexture &cubemap, const mat4 &modelViewProjection);
+};
+
+#endif /* SkyBox_h */
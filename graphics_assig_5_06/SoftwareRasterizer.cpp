@@ -0,0 +1,443 @@
+//
+//  SoftwareRasterizer.cpp
+//  graphics_assig_5_06
+//
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define RASTER_USE_SSE2 1
+#endif
+
+#include "SoftwareRasterizer.h"
+#include "Profiler.h"
+
+using namespace std;
+using namespace glm;
+
+// triangles per vertex-stage task
+static const int CHUNK_TRIANGLES = 128;
+static const int ATTRIBUTE_COUNT = 8;
+
+// per-thread working memory of the tile stage, reused between tiles
+struct TileScratch
+{
+    float depth[SoftwareRasterizer::TILE_SIZE*SoftwareRasterizer::TILE_SIZE];
+    int triangle[SoftwareRasterizer::TILE_SIZE*SoftwareRasterizer::TILE_SIZE];
+    vector<int> drawStart;
+    vector<int> sortedPixels;
+    FragmentBatch batch;
+    vector<unsigned char> shaded;
+};
+
+SoftwareRasterizer :: SoftwareRasterizer(int width, int height, int threadCount)
+    : width(width), height(height)
+{
+    tilesX = (width + TILE_SIZE - 1)/TILE_SIZE;
+    tilesY = (height + TILE_SIZE - 1)/TILE_SIZE;
+    threads = threadCount > 0 ? threadCount : max(1, (int)thread::hardware_concurrency());
+    // the calling thread works too, so it counts as one of them
+    if (threads > 1)
+        pool = new ThreadPool(threads - 1);
+    colour.assign((size_t)width*height*4, 0);
+}
+
+SoftwareRasterizer :: ~SoftwareRasterizer()
+{
+    delete pool;
+}
+
+void SoftwareRasterizer :: parallelFor(int begin, int end, int grain, const function<void(int, int)> &body)
+{
+    if (pool)
+        pool->parallelFor(begin, end, grain, body);
+    else if (begin < end)
+        body(begin, end);
+}
+
+void SoftwareRasterizer :: render(const vector<SoftwareDrawCall> &drawCalls, const mat4 &matrix, const ShadingParameters &parameters)
+{
+    draws = &drawCalls;
+    viewProjection = matrix;
+    shading = parameters;
+
+    drawFirstTriangle.resize(drawCalls.size() + 1);
+    drawFirstTriangle[0] = 0;
+    for (size_t i = 0; i < drawCalls.size(); i++)
+        drawFirstTriangle[i + 1] = drawFirstTriangle[i] + (int)drawCalls[i].vertices->size()/3;
+    int triangleCount = drawFirstTriangle.back();
+
+    // geometry: transform, clip, set up and bin; each chunk bins on its own
+    // so no locking is needed and submission order survives
+    int chunkCount = (triangleCount + CHUNK_TRIANGLES - 1)/CHUNK_TRIANGLES;
+    if ((int)chunkTriangles.size() < chunkCount) {
+        chunkTriangles.resize(chunkCount);
+        chunkBins.resize(chunkCount);
+    }
+    {
+        PROFILE_SCOPE("Raster geometry");
+        parallelFor(0, chunkCount, 1, [this, triangleCount](int begin, int end) {
+            for (int chunk = begin; chunk < end; chunk++)
+                processChunk(chunk, chunk*CHUNK_TRIANGLES, min(triangleCount, (chunk + 1)*CHUNK_TRIANGLES));
+        });
+    }
+
+    chunkOffset.resize(chunkCount + 1);
+    chunkOffset[0] = 0;
+    for (int chunk = 0; chunk < chunkCount; chunk++)
+        chunkOffset[chunk + 1] = chunkOffset[chunk] + (int)chunkTriangles[chunk].size();
+    triangles.resize(chunkOffset[chunkCount]);
+    for (int chunk = 0; chunk < chunkCount; chunk++)
+        std::copy(chunkTriangles[chunk].begin(), chunkTriangles[chunk].end(), triangles.begin() + chunkOffset[chunk]);
+    chunkOffset.resize(chunkCount);
+
+    // pixels: tiles are claimed one at a time, so busy tiles (the sun close
+    // up) do not hold up a thread that was handed a block of empty ones
+    {
+        PROFILE_SCOPE("Raster tiles");
+        parallelFor(0, tilesX*tilesY, 1, [this](int begin, int end) {
+            for (int tile = begin; tile < end; tile++)
+                rasterizeTile(tile);
+        });
+    }
+    draws = nullptr;
+}
+
+void SoftwareRasterizer :: processChunk(int chunk, int firstTriangle, int lastTriangle)
+{
+    PROFILE_SCOPE("processChunk");
+    vector<SetupTriangle> &output = chunkTriangles[chunk];
+    output.clear();
+    vector<vector<int>> &bins = chunkBins[chunk];
+    bins.resize(tilesX*tilesY);
+    for (vector<int> &bin : bins)
+        bin.clear();
+
+    int draw = (int)(upper_bound(drawFirstTriangle.begin(), drawFirstTriangle.end(), firstTriangle) - drawFirstTriangle.begin()) - 1;
+    for (int t = firstTriangle; t < lastTriangle; t++) {
+        while (t >= drawFirstTriangle[draw + 1])
+            draw++;
+        const SoftwareDrawCall &call = (*draws)[draw];
+        mat4 modelViewProjection = viewProjection*call.model;
+        mat3 normalMatrix = mat3(call.model);
+
+        // polygon after near clipping has up to four corners
+        vec4 clip[4];
+        float attributes[4][ATTRIBUTE_COUNT];
+        vec4 in[3];
+        float inAttributes[3][ATTRIBUTE_COUNT];
+        for (int k = 0; k < 3; k++) {
+            size_t index = (size_t)(t - drawFirstTriangle[draw])*3 + k;
+            vec3 position = (*call.vertices)[index];
+            vec4 world = call.model*vec4(position, 1.f);
+            in[k] = modelViewProjection*vec4(position, 1.f);
+            vec2 uv = index < call.textureCoords->size() ? (*call.textureCoords)[index] : vec2(0.f);
+            vec3 normal = call.normals && index < call.normals->size() ? normalMatrix*(*call.normals)[index] : vec3(0.f);
+            float *a = inAttributes[k];
+            a[0] = uv.x; a[1] = uv.y;
+            a[2] = world.x; a[3] = world.y; a[4] = world.z;
+            a[5] = normal.x; a[6] = normal.y; a[7] = normal.z;
+        }
+
+        // all three corners outside one plane of the frustum
+        bool rejected = false;
+        for (int axis = 0; axis < 3 && !rejected; axis++) {
+            if (in[0][axis] > in[0].w && in[1][axis] > in[1].w && in[2][axis] > in[2].w)
+                rejected = true;
+            if (in[0][axis] < -in[0].w && in[1][axis] < -in[1].w && in[2][axis] < -in[2].w)
+                rejected = true;
+        }
+        if (rejected)
+            continue;
+
+        // Sutherland-Hodgman against the near plane z = -w only; the sides
+        // are handled by the pixel bounds and the far plane by the depth test
+        int corners = 0;
+        for (int k = 0; k < 3; k++) {
+            const vec4 &current = in[k];
+            const vec4 &next = in[(k + 1) % 3];
+            float currentDistance = current.z + current.w;
+            float nextDistance = next.z + next.w;
+            if (currentDistance >= 0.f) {
+                clip[corners] = current;
+                memcpy(attributes[corners], inAttributes[k], sizeof(attributes[0]));
+                corners++;
+            }
+            if ((currentDistance >= 0.f) != (nextDistance >= 0.f)) {
+                float s = currentDistance/(currentDistance - nextDistance);
+                clip[corners] = current + (next - current)*s;
+                for (int i = 0; i < ATTRIBUTE_COUNT; i++)
+                    attributes[corners][i] = inAttributes[k][i] + (inAttributes[(k + 1) % 3][i] - inAttributes[k][i])*s;
+                corners++;
+            }
+        }
+
+        for (int k = 1; k + 1 < corners; k++) {
+            vec4 fan[3] = {clip[0], clip[k], clip[k + 1]};
+            float fanAttributes[3][ATTRIBUTE_COUNT];
+            memcpy(fanAttributes[0], attributes[0], sizeof(fanAttributes[0]));
+            memcpy(fanAttributes[1], attributes[k], sizeof(fanAttributes[0]));
+            memcpy(fanAttributes[2], attributes[k + 1], sizeof(fanAttributes[0]));
+            setupTriangle(chunk, fan, fanAttributes, draw);
+        }
+    }
+}
+
+void SoftwareRasterizer :: setupTriangle(int chunk, const vec4 clip[3], const float attributes[3][8], int draw)
+{
+    float x[3], y[3], z[3], inverseW[3];
+    for (int k = 0; k < 3; k++) {
+        inverseW[k] = 1.f/clip[k].w;
+        x[k] = (clip[k].x*inverseW[k]*0.5f + 0.5f)*width;
+        y[k] = (0.5f - clip[k].y*inverseW[k]*0.5f)*height;   // rows run top-down
+        z[k] = clip[k].z*inverseW[k]*0.5f + 0.5f;
+    }
+
+    double area = ((double)x[1] - x[0])*((double)y[2] - y[0]) - ((double)x[2] - x[0])*((double)y[1] - y[0]);
+    if (!(fabs(area) > 0.0) || !std::isfinite(area))
+        return;
+
+    SetupTriangle triangle;
+    float minX = min(x[0], min(x[1], x[2])), maxX = max(x[0], max(x[1], x[2]));
+    float minY = min(y[0], min(y[1], y[2])), maxY = max(y[0], max(y[1], y[2]));
+    triangle.minX = max(0, (int)floorf(max(minX, -1.f)));
+    triangle.minY = max(0, (int)floorf(max(minY, -1.f)));
+    triangle.maxX = min(width - 1, (int)ceilf(min(maxX, (float)width)));
+    triangle.maxY = min(height - 1, (int)ceilf(min(maxY, (float)height)));
+    if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+        return;
+
+    // nothing is culled, so clockwise triangles are flipped to make the
+    // inside positive either way
+    double sign = area > 0.0 ? 1.0 : -1.0;
+    for (int i = 0; i < 3; i++) {
+        int j = (i + 1) % 3, k = (i + 2) % 3;
+        triangle.edgeA[i] = sign*((double)y[j] - y[k]);
+        triangle.edgeB[i] = sign*((double)x[k] - x[j]);
+        triangle.edgeC[i] = sign*((double)x[j]*y[k] - (double)x[k]*y[j]);
+        triangle.topLeft[i] = triangle.edgeA[i] > 0.0 || (triangle.edgeA[i] == 0.0 && triangle.edgeB[i] > 0.0);
+    }
+    area = fabs(area);
+
+    // barycentric weight i is edge i over the area, so the gradient of any
+    // linear attribute is a weighted sum of the edge gradients
+    auto plane = [&](const float values[3]) {
+        Plane p;
+        p.a = (float)((triangle.edgeA[0]*values[0] + triangle.edgeA[1]*values[1] + triangle.edgeA[2]*values[2])/area);
+        p.b = (float)((triangle.edgeB[0]*values[0] + triangle.edgeB[1]*values[1] + triangle.edgeB[2]*values[2])/area);
+        p.c = values[0];
+        return p;
+    };
+    triangle.referenceX = x[0];
+    triangle.referenceY = y[0];
+    triangle.depth = plane(z);
+    triangle.inverseW = plane(inverseW);
+    for (int i = 0; i < ATTRIBUTE_COUNT; i++) {
+        float values[3] = {attributes[0][i]*inverseW[0], attributes[1][i]*inverseW[1], attributes[2][i]*inverseW[2]};
+        triangle.attributes[i] = plane(values);
+    }
+    triangle.draw = draw;
+
+    vector<SetupTriangle> &output = chunkTriangles[chunk];
+    int index = (int)output.size();
+    output.push_back(triangle);
+    vector<vector<int>> &bins = chunkBins[chunk];
+    for (int ty = triangle.minY/TILE_SIZE; ty <= triangle.maxY/TILE_SIZE; ty++)
+        for (int tx = triangle.minX/TILE_SIZE; tx <= triangle.maxX/TILE_SIZE; tx++)
+            bins[ty*tilesX + tx].push_back(index);
+}
+
+void SoftwareRasterizer :: rasterizeTile(int tile)
+{
+    PROFILE_SCOPE("rasterizeTile");
+    static thread_local TileScratch scratch;
+
+    int tileX = (tile % tilesX)*TILE_SIZE;
+    int tileY = (tile / tilesX)*TILE_SIZE;
+    int tileWidth = min(TILE_SIZE, width - tileX);
+    int tileHeight = min(TILE_SIZE, height - tileY);
+
+    // glClearDepth default; LEQUAL below matches glDepthFunc in main
+    std::fill(scratch.depth, scratch.depth + TILE_SIZE*TILE_SIZE, 1.f);
+    std::fill(scratch.triangle, scratch.triangle + TILE_SIZE*TILE_SIZE, -1);
+
+    // visibility: depth and the nearest triangle per pixel, no shading yet
+    for (size_t chunk = 0; chunk < chunkOffset.size(); chunk++) {
+        for (int local : chunkBins[chunk][tile]) {
+            int index = chunkOffset[chunk] + local;
+            const SetupTriangle &triangle = triangles[index];
+            int x0 = max(triangle.minX, tileX) - tileX, x1 = min(triangle.maxX, tileX + tileWidth - 1) - tileX;
+            int y0 = max(triangle.minY, tileY) - tileY, y1 = min(triangle.maxY, tileY + tileHeight - 1) - tileY;
+            if (x0 > x1 || y0 > y1)
+                continue;
+
+            // edges and depth are evaluated at the tile's first pixel centre
+            // in double, then stepped in float over at most 64 pixels
+            double centreX = tileX + 0.5, centreY = tileY + 0.5;
+            float edgeOrigin[3], edgeA[3], edgeB[3];
+            for (int i = 0; i < 3; i++) {
+                edgeOrigin[i] = (float)(triangle.edgeA[i]*centreX + triangle.edgeB[i]*centreY + triangle.edgeC[i]);
+                edgeA[i] = (float)triangle.edgeA[i];
+                edgeB[i] = (float)triangle.edgeB[i];
+            }
+            float depthOrigin = triangle.depth.c + triangle.depth.a*(float)(centreX - triangle.referenceX)
+                                                 + triangle.depth.b*(float)(centreY - triangle.referenceY);
+
+#if RASTER_USE_SSE2
+            const __m128 lane = _mm_set_ps(3.f, 2.f, 1.f, 0.f);
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 one = _mm_set1_ps(1.f);
+            const __m128 firstColumn = _mm_set1_ps((float)x0);
+            const __m128 lastColumn = _mm_set1_ps((float)x1);
+            const __m128i reference = _mm_set1_epi32(index);
+            // a pixel exactly on an edge belongs to it only for top and left
+            // edges, so shared edges are drawn once
+            __m128 owns[3];
+            for (int i = 0; i < 3; i++)
+                owns[i] = _mm_castsi128_ps(_mm_set1_epi32(triangle.topLeft[i] ? -1 : 0));
+            for (int y = y0; y <= y1; y++) {
+                __m128 row[3];
+                for (int i = 0; i < 3; i++)
+                    row[i] = _mm_set1_ps(edgeOrigin[i] + edgeB[i]*y);
+                __m128 rowDepth = _mm_set1_ps(depthOrigin + triangle.depth.b*y);
+
+                // groups of four stay inside the tile since it is 64 wide
+                for (int x = x0 & ~3; x <= x1; x += 4) {
+                    __m128 column = _mm_add_ps(_mm_set1_ps((float)x), lane);
+                    __m128 e0 = _mm_add_ps(row[0], _mm_mul_ps(_mm_set1_ps(edgeA[0]), column));
+                    __m128 e1 = _mm_add_ps(row[1], _mm_mul_ps(_mm_set1_ps(edgeA[1]), column));
+                    __m128 e2 = _mm_add_ps(row[2], _mm_mul_ps(_mm_set1_ps(edgeA[2]), column));
+                    __m128 inside0 = _mm_or_ps(_mm_cmpgt_ps(e0, zero), _mm_and_ps(owns[0], _mm_cmpeq_ps(e0, zero)));
+                    __m128 inside1 = _mm_or_ps(_mm_cmpgt_ps(e1, zero), _mm_and_ps(owns[1], _mm_cmpeq_ps(e1, zero)));
+                    __m128 inside2 = _mm_or_ps(_mm_cmpgt_ps(e2, zero), _mm_and_ps(owns[2], _mm_cmpeq_ps(e2, zero)));
+                    __m128 columns = _mm_and_ps(_mm_cmpge_ps(column, firstColumn), _mm_cmple_ps(column, lastColumn));
+                    __m128 inside = _mm_and_ps(_mm_and_ps(inside0, inside1), _mm_and_ps(inside2, columns));
+                    if (_mm_movemask_ps(inside) == 0)
+                        continue;
+
+                    __m128 depth = _mm_add_ps(rowDepth, _mm_mul_ps(_mm_set1_ps(triangle.depth.a), column));
+                    float *depthRow = scratch.depth + y*TILE_SIZE + x;
+                    __m128 stored = _mm_loadu_ps(depthRow);
+                    __m128 pass = _mm_and_ps(inside, _mm_and_ps(_mm_cmple_ps(depth, stored),
+                                                                _mm_and_ps(_mm_cmple_ps(depth, one), _mm_cmpge_ps(depth, zero))));
+                    if (_mm_movemask_ps(pass) == 0)
+                        continue;
+                    _mm_storeu_ps(depthRow, _mm_or_ps(_mm_and_ps(pass, depth), _mm_andnot_ps(pass, stored)));
+                    __m128i *triangleRow = (__m128i *)(scratch.triangle + y*TILE_SIZE + x);
+                    __m128i passMask = _mm_castps_si128(pass);
+                    __m128i storedTriangle = _mm_loadu_si128(triangleRow);
+                    _mm_storeu_si128(triangleRow, _mm_or_si128(_mm_and_si128(passMask, reference), _mm_andnot_si128(passMask, storedTriangle)));
+                }
+            }
+#else
+            for (int y = y0; y <= y1; y++) {
+                for (int x = x0; x <= x1; x++) {
+                    bool inside = true;
+                    for (int i = 0; i < 3; i++) {
+                        float e = edgeOrigin[i] + edgeA[i]*x + edgeB[i]*y;
+                        // a pixel exactly on an edge belongs to it only for
+                        // top and left edges, so shared edges are drawn once
+                        inside = inside && (e > 0.f || (e == 0.f && triangle.topLeft[i]));
+                    }
+                    if (!inside)
+                        continue;
+                    float depth = depthOrigin + triangle.depth.a*x + triangle.depth.b*y;
+                    float &stored = scratch.depth[y*TILE_SIZE + x];
+                    if (depth <= stored && depth <= 1.f && depth >= 0.f) {
+                        stored = depth;
+                        scratch.triangle[y*TILE_SIZE + x] = index;
+                    }
+                }
+            }
+#endif
+        }
+    }
+
+    // shading: visible pixels grouped by draw call, so each batch samples
+    // one texture, then written out
+    int drawCount = (int)draws->size();
+    scratch.drawStart.assign(drawCount + 1, 0);
+    for (int y = 0; y < tileHeight; y++)
+        for (int x = 0; x < tileWidth; x++) {
+            int index = scratch.triangle[y*TILE_SIZE + x];
+            if (index >= 0)
+                scratch.drawStart[triangles[index].draw + 1]++;
+        }
+    for (int d = 0; d < drawCount; d++)
+        scratch.drawStart[d + 1] += scratch.drawStart[d];
+    int visible = scratch.drawStart[drawCount];
+    scratch.sortedPixels.resize(visible);
+    {
+        vector<int> next(scratch.drawStart.begin(), scratch.drawStart.end() - 1);
+        for (int y = 0; y < tileHeight; y++)
+            for (int x = 0; x < tileWidth; x++) {
+                int index = scratch.triangle[y*TILE_SIZE + x];
+                if (index >= 0)
+                    scratch.sortedPixels[next[triangles[index].draw]++] = y*TILE_SIZE + x;
+            }
+    }
+
+    for (int y = 0; y < tileHeight; y++)
+        memset(colour.data() + ((size_t)(tileY + y)*width + tileX)*4, 0, (size_t)tileWidth*4);
+
+    if ((int)scratch.batch.u.size() < visible)
+        scratch.batch.resize(visible);
+    scratch.shaded.resize((size_t)visible*4);
+
+    for (int d = 0; d < drawCount; d++) {
+        int first = scratch.drawStart[d], last = scratch.drawStart[d + 1];
+        if (first == last)
+            continue;
+        FragmentBatch &batch = scratch.batch;
+        batch.count = last - first;
+        float *outputs[ATTRIBUTE_COUNT] = {batch.u.data(), batch.v.data(),
+                                           batch.positionX.data(), batch.positionY.data(), batch.positionZ.data(),
+                                           batch.normalX.data(), batch.normalY.data(), batch.normalZ.data()};
+        for (int f = 0; f < batch.count; f++) {
+            int pixel = scratch.sortedPixels[first + f];
+            const SetupTriangle &triangle = triangles[scratch.triangle[pixel]];
+            float dx = tileX + pixel % TILE_SIZE + 0.5f - triangle.referenceX;
+            float dy = tileY + pixel / TILE_SIZE + 0.5f - triangle.referenceY;
+            float w = 1.f/(triangle.inverseW.c + triangle.inverseW.a*dx + triangle.inverseW.b*dy);
+            for (int i = 0; i < ATTRIBUTE_COUNT; i++) {
+                const Plane &p = triangle.attributes[i];
+                outputs[i][f] = (p.c + p.a*dx + p.b*dy)*w;
+            }
+        }
+
+        ShadeFragmentBatch(batch, *(*draws)[d].texture, shading, scratch.shaded.data());
+        for (int f = 0; f < batch.count; f++) {
+            int pixel = scratch.sortedPixels[first + f];
+            size_t target = ((size_t)(tileY + pixel / TILE_SIZE)*width + tileX + pixel % TILE_SIZE)*4;
+            memcpy(colour.data() + target, scratch.shaded.data() + (size_t)f*4, 4);
+        }
+    }
+}
+
+const unsigned char* SoftwareRasterizer :: pixels() const
+{
+    return colour.data();
+}
+
+int SoftwareRasterizer :: getWidth() const
+{
+    return width;
+}
+
+int SoftwareRasterizer :: getHeight() const
+{
+    return height;
+}
+
+int SoftwareRasterizer :: threadCount() const
+{
+    return threads;
+}
+
+int SoftwareRasterizer :: triangleCountLastFrame() const
+{
+    return (int)triangles.size();
+}
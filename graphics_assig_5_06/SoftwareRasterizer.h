@@ -0,0 +1,101 @@
+//
+//  SoftwareRasterizer.h
+//  graphics_assig_5_06
+//
+//  CPU rendering backend for machines without a GPU. Draws the same meshes,
+//  textures and matrices as the GL path with a binned tile architecture:
+//  triangles are transformed, clipped and set up in parallel chunks and
+//  binned into 64x64 screen tiles; tiles are then rasterised independently
+//  across the thread pool. Coverage and depth use half-space edge functions
+//  four pixels at a time, each pixel keeps only its nearest triangle, and
+//  visible pixels are shaded once per tile with the fragment.glsl model.
+//
+
+#ifndef SoftwareRasterizer_h
+#define SoftwareRasterizer_h
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "SoftwareShading.h"
+#include "ThreadPool.h"
+
+using namespace glm;
+using namespace std;
+
+// one glDrawArrays(GL_TRIANGLES) worth of geometry
+struct SoftwareDrawCall
+{
+    const vector<vec3> *vertices = nullptr;
+    const vector<vec2> *textureCoords = nullptr;
+    const vector<vec3> *normals = nullptr;      // entries past its end read as zero
+    const SoftwareTexture *texture = nullptr;
+    mat4 model = mat4(1.f);
+};
+
+class SoftwareRasterizer
+{
+public:
+    static const int TILE_SIZE = 64;
+
+private:
+    // value of an attribute across the screen: c + a*(x - x0) + b*(y - y0)
+    // about the triangle's first vertex (x0, y0), which keeps precision
+    // when clipping leaves very large triangles
+    struct Plane
+    {
+        float a, b, c;
+    };
+
+    struct SetupTriangle
+    {
+        double edgeA[3], edgeB[3], edgeC[3];    // inside where all are positive
+        bool topLeft[3];                        // edge owns pixels exactly on it
+        float referenceX, referenceY;
+        Plane depth;
+        Plane inverseW;
+        Plane attributes[8];                    // u, v, position xyz, normal xyz; all divided by w
+        int minX, minY, maxX, maxY;             // pixel bounds, inclusive
+        int draw;
+    };
+
+    int width, height;
+    int tilesX, tilesY;
+    int threads;
+    ThreadPool *pool = nullptr;
+
+    vector<unsigned char> colour;
+
+    const vector<SoftwareDrawCall> *draws = nullptr;
+    vector<int> drawFirstTriangle;
+    mat4 viewProjection;
+    ShadingParameters shading;
+
+    vector<vector<SetupTriangle>> chunkTriangles;
+    vector<vector<vector<int>>> chunkBins;      // [chunk][tile] -> index into chunkTriangles
+    vector<int> chunkOffset;
+    vector<SetupTriangle> triangles;            // all chunks, in submission order
+
+    void parallelFor(int begin, int end, int grain, const function<void(int, int)> &body);
+    void processChunk(int chunk, int firstTriangle, int lastTriangle);
+    void setupTriangle(int chunk, const vec4 clip[3], const float attributes[3][8], int draw);
+    void rasterizeTile(int tile);
+
+public:
+    // threadCount <= 0 uses every hardware thread
+    SoftwareRasterizer(int width, int height, int threadCount = 0);
+    ~SoftwareRasterizer();
+
+    void render(const vector<SoftwareDrawCall> &drawCalls, const mat4 &viewProjection, const ShadingParameters &parameters);
+
+    // RGBA8, top row first; uncovered pixels are transparent black, as
+    // after glClear with the default clear colour
+    const unsigned char* pixels() const;
+
+    int getWidth() const;
+    int getHeight() const;
+    int threadCount() const;
+    int triangleCountLastFrame() const;
+};
+
+#endif /* SoftwareRasterizer_h */
@@ -0,0 +1,561 @@
+//
+//  SoftwareShading.cpp
+//  graphics_assig_5_06
+//
+
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <stb/stb_image.h>
+
+#include "SoftwareShading.h"
+#include "Profiler.h"
+
+using namespace std;
+using namespace glm;
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SHADING_X86 1
+#include <immintrin.h>
+#endif
+
+// widest vector is 16 floats
+static const int BATCH_PADDING = 16;
+
+bool LoadSoftwareTexture(SoftwareTexture *texture, const char *filename)
+{
+    PROFILE_SCOPE("LoadSoftwareTexture");
+    int components;
+    stbi_set_flip_vertically_on_load(true);
+    unsigned char *data = stbi_load(filename, &texture->width, &texture->height, &components, 3);
+    if (data == nullptr) {
+        cout << "Could not load texture " << filename << endl;
+        return false;
+    }
+    size_t texelCount = (size_t)texture->width*texture->height;
+    texture->texels.resize(texelCount);
+    for (size_t i = 0; i < texelCount; i++)
+        texture->texels[i] = data[3*i] | (data[3*i + 1] << 8) | (data[3*i + 2] << 16);
+    stbi_image_free(data);
+    return true;
+}
+
+void FragmentBatch :: resize(int size)
+{
+    size = (size + BATCH_PADDING - 1)/BATCH_PADDING*BATCH_PADDING;
+    u.resize(size); v.resize(size);
+    positionX.resize(size); positionY.resize(size); positionZ.resize(size);
+    normalX.resize(size); normalY.resize(size); normalZ.resize(size);
+}
+
+// GL_LINEAR with GL_CLAMP_TO_EDGE: texel centres sit at half-integers
+static vec3 SampleBilinear(const SoftwareTexture &texture, float u, float v)
+{
+    float x = u*texture.width - 0.5f;
+    float y = v*texture.height - 0.5f;
+    float fx = floorf(x), fy = floorf(y);
+    float ax = x - fx, ay = y - fy;
+
+    int x0 = std::min(std::max((int)fx, 0), texture.width - 1);
+    int x1 = std::min(std::max((int)fx + 1, 0), texture.width - 1);
+    int y0 = std::min(std::max((int)fy, 0), texture.height - 1);
+    int y1 = std::min(std::max((int)fy + 1, 0), texture.height - 1);
+
+    const uint32_t *row0 = texture.texels.data() + (size_t)y0*texture.width;
+    const uint32_t *row1 = texture.texels.data() + (size_t)y1*texture.width;
+    vec3 result;
+    for (int c = 0; c < 3; c++) {
+        int shift = 8*c;
+        float c00 = (row0[x0] >> shift) & 0xff, c10 = (row0[x1] >> shift) & 0xff;
+        float c01 = (row1[x0] >> shift) & 0xff, c11 = (row1[x1] >> shift) & 0xff;
+        float top = c00 + (c10 - c00)*ax;
+        float bottom = c01 + (c11 - c01)*ax;
+        result[c] = (top + (bottom - top)*ay)*(1.f/255.f);
+    }
+    return result;
+}
+
+static inline unsigned char ToUnorm8(float value)
+{
+    return (unsigned char)(std::min(std::max(value, 0.f), 1.f)*255.f + 0.5f);
+}
+
+// shades count fragments starting at first; out gets count RGBA8 pixels.
+// The vector kernels take whole vectors only.
+typedef void (*ShadingFunction)(const FragmentBatch &batch, const SoftwareTexture &texture,
+                                const ShadingParameters &parameters, int first, int count, unsigned char *out);
+
+// Mirrors fragment.glsl line for line, including reflecting the direction
+// *to* the light. fmaxf keeps the GPU's NaN behaviour: a zero normal (the
+// backdrop has none) gives the 0.5 diffuse floor and no specular.
+static void ShadeScalar(const FragmentBatch &batch, const SoftwareTexture &texture,
+                        const ShadingParameters &parameters, int first, int count, unsigned char *out)
+{
+    for (int f = 0; f < count; f++) {
+        int i = first + f;
+        vec3 colour = SampleBilinear(texture, batch.u[i], batch.v[i]);
+        vec3 position(batch.positionX[i], batch.positionY[i], batch.positionZ[i]);
+        vec3 normalIn(batch.normalX[i], batch.normalY[i], batch.normalZ[i]);
+
+        vec3 ambient = colour;
+
+        vec3 lightDirection = normalize(parameters.lightPosition - position);
+        vec3 normal = normalIn/sqrtf(dot(normalIn, normalIn));
+        float difference = fmaxf(dot(lightDirection, normal), 0.5f);
+        vec3 diffuse = colour*difference;
+
+        vec3 viewDirection = normalize(parameters.cameraPosition - position);
+        vec3 reflectionDirection = lightDirection - normal*(2.f*dot(normal, lightDirection));
+
+        float spec = powf(fmaxf(dot(viewDirection, reflectionDirection), 0.f), 8.f);
+        vec3 specular = vec3(spec);
+
+        vec3 fragment = (ambient + diffuse + specular)*colour;
+        out[4*f + 0] = ToUnorm8(fragment.x);
+        out[4*f + 1] = ToUnorm8(fragment.y);
+        out[4*f + 2] = ToUnorm8(fragment.z);
+        out[4*f + 3] = 255;
+    }
+}
+
+#ifdef SHADING_X86
+
+// The vector kernels follow ShadeScalar step for step. Texel addresses come
+// from the clamped integer corners; each corner is one 32-bit gather (SSE
+// has none and loads the four lanes one by one), and the channels are then
+// split out with shifts. max(x, floor) returns the floor when x is NaN, as
+// fmaxf does, and pow(s, 8) is three squarings.
+
+// 1/|v| from the estimate instruction and one Newton step, ~1e-7
+// relative; a zero vector gives NaN, as normalize() does
+__attribute__((target("sse4.1")))
+static inline __m128 InverseLengthSSE(__m128 x, __m128 y, __m128 z)
+{
+    __m128 squared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+    __m128 estimate = _mm_rsqrt_ps(squared);
+    __m128 correction = _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), squared), _mm_mul_ps(estimate, estimate)));
+    return _mm_mul_ps(estimate, correction);
+}
+
+__attribute__((target("avx2,fma")))
+static inline __m256 InverseLengthAVX2(__m256 x, __m256 y, __m256 z)
+{
+    __m256 squared = _mm256_fmadd_ps(z, z, _mm256_fmadd_ps(y, y, _mm256_mul_ps(x, x)));
+    __m256 estimate = _mm256_rsqrt_ps(squared);
+    __m256 correction = _mm256_fnmadd_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), squared), _mm256_mul_ps(estimate, estimate), _mm256_set1_ps(1.5f));
+    return _mm256_mul_ps(estimate, correction);
+}
+
+__attribute__((target("avx512f")))
+static inline __m512 InverseLengthAVX512(__m512 x, __m512 y, __m512 z)
+{
+    __m512 squared = _mm512_fmadd_ps(z, z, _mm512_fmadd_ps(y, y, _mm512_mul_ps(x, x)));
+    __m512 estimate = _mm512_rsqrt14_ps(squared);
+    __m512 correction = _mm512_fnmadd_ps(_mm512_mul_ps(_mm512_set1_ps(0.5f), squared), _mm512_mul_ps(estimate, estimate), _mm512_set1_ps(1.5f));
+    return _mm512_mul_ps(estimate, correction);
+}
+
+__attribute__((target("sse4.1")))
+static void ShadeSSE(const FragmentBatch &batch, const SoftwareTexture &texture,
+                     const ShadingParameters &parameters, int first, int count, unsigned char *out)
+{
+    const int *texels = (const int *)texture.texels.data();
+    const __m128 width = _mm_set1_ps((float)texture.width), height = _mm_set1_ps((float)texture.height);
+    const __m128i lastX = _mm_set1_epi32(texture.width - 1), lastY = _mm_set1_epi32(texture.height - 1);
+    const __m128i stride = _mm_set1_epi32(texture.width);
+    const __m128i zeroInt = _mm_setzero_si128(), oneInt = _mm_set1_epi32(1);
+    const __m128i channelMask = _mm_set1_epi32(0xff), alpha = _mm_set1_epi32((int)0xff000000u);
+    const __m128 zero = _mm_setzero_ps(), half = _mm_set1_ps(0.5f), one = _mm_set1_ps(1.f), two = _mm_set1_ps(2.f);
+    const __m128 toUnit = _mm_set1_ps(1.f/255.f), toByte = _mm_set1_ps(255.f);
+    const __m128 lightX = _mm_set1_ps(parameters.lightPosition.x), lightY = _mm_set1_ps(parameters.lightPosition.y),
+                 lightZ = _mm_set1_ps(parameters.lightPosition.z);
+    const __m128 cameraX = _mm_set1_ps(parameters.cameraPosition.x), cameraY = _mm_set1_ps(parameters.cameraPosition.y),
+                 cameraZ = _mm_set1_ps(parameters.cameraPosition.z);
+
+    for (int i = first; i < first + count; i += 4) {
+        __m128 x = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(&batch.u[i]), width), half);
+        __m128 y = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(&batch.v[i]), height), half);
+        __m128 fx = _mm_floor_ps(x), fy = _mm_floor_ps(y);
+        __m128 ax = _mm_sub_ps(x, fx), ay = _mm_sub_ps(y, fy);
+        __m128i ix = _mm_cvttps_epi32(fx), iy = _mm_cvttps_epi32(fy);
+        __m128i x0 = _mm_min_epi32(_mm_max_epi32(ix, zeroInt), lastX);
+        __m128i x1 = _mm_min_epi32(_mm_max_epi32(_mm_add_epi32(ix, oneInt), zeroInt), lastX);
+        __m128i row0 = _mm_mullo_epi32(_mm_min_epi32(_mm_max_epi32(iy, zeroInt), lastY), stride);
+        __m128i row1 = _mm_mullo_epi32(_mm_min_epi32(_mm_max_epi32(_mm_add_epi32(iy, oneInt), zeroInt), lastY), stride);
+
+        alignas(16) int index[4][4];
+        _mm_store_si128((__m128i *)index[0], _mm_add_epi32(row0, x0));
+        _mm_store_si128((__m128i *)index[1], _mm_add_epi32(row0, x1));
+        _mm_store_si128((__m128i *)index[2], _mm_add_epi32(row1, x0));
+        _mm_store_si128((__m128i *)index[3], _mm_add_epi32(row1, x1));
+        __m128i corner[4];
+        for (int k = 0; k < 4; k++)
+            corner[k] = _mm_set_epi32(texels[index[k][3]], texels[index[k][2]], texels[index[k][1]], texels[index[k][0]]);
+
+        __m128 colour[3];
+        for (int c = 0; c < 3; c++) {
+            __m128i shift = _mm_cvtsi32_si128(8*c);
+            __m128 c00 = _mm_cvtepi32_ps(_mm_and_si128(_mm_srl_epi32(corner[0], shift), channelMask));
+            __m128 c10 = _mm_cvtepi32_ps(_mm_and_si128(_mm_srl_epi32(corner[1], shift), channelMask));
+            __m128 c01 = _mm_cvtepi32_ps(_mm_and_si128(_mm_srl_epi32(corner[2], shift), channelMask));
+            __m128 c11 = _mm_cvtepi32_ps(_mm_and_si128(_mm_srl_epi32(corner[3], shift), channelMask));
+            __m128 top = _mm_add_ps(c00, _mm_mul_ps(_mm_sub_ps(c10, c00), ax));
+            __m128 bottom = _mm_add_ps(c01, _mm_mul_ps(_mm_sub_ps(c11, c01), ax));
+            colour[c] = _mm_mul_ps(_mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), ay)), toUnit);
+        }
+
+        __m128 px = _mm_loadu_ps(&batch.positionX[i]), py = _mm_loadu_ps(&batch.positionY[i]), pz = _mm_loadu_ps(&batch.positionZ[i]);
+        __m128 nx = _mm_loadu_ps(&batch.normalX[i]), ny = _mm_loadu_ps(&batch.normalY[i]), nz = _mm_loadu_ps(&batch.normalZ[i]);
+
+        __m128 lx = _mm_sub_ps(lightX, px), ly = _mm_sub_ps(lightY, py), lz = _mm_sub_ps(lightZ, pz);
+        __m128 scale = InverseLengthSSE(lx, ly, lz);
+        lx = _mm_mul_ps(lx, scale); ly = _mm_mul_ps(ly, scale); lz = _mm_mul_ps(lz, scale);
+
+        scale = InverseLengthSSE(nx, ny, nz);
+        nx = _mm_mul_ps(nx, scale); ny = _mm_mul_ps(ny, scale); nz = _mm_mul_ps(nz, scale);
+
+        __m128 lightDotNormal = _mm_add_ps(_mm_add_ps(_mm_mul_ps(lx, nx), _mm_mul_ps(ly, ny)), _mm_mul_ps(lz, nz));
+        __m128 difference = _mm_max_ps(lightDotNormal, half);
+
+        __m128 vx = _mm_sub_ps(cameraX, px), vy = _mm_sub_ps(cameraY, py), vz = _mm_sub_ps(cameraZ, pz);
+        scale = InverseLengthSSE(vx, vy, vz);
+        vx = _mm_mul_ps(vx, scale); vy = _mm_mul_ps(vy, scale); vz = _mm_mul_ps(vz, scale);
+
+        __m128 twiceDot = _mm_mul_ps(two, lightDotNormal);
+        __m128 rx = _mm_sub_ps(lx, _mm_mul_ps(nx, twiceDot));
+        __m128 ry = _mm_sub_ps(ly, _mm_mul_ps(ny, twiceDot));
+        __m128 rz = _mm_sub_ps(lz, _mm_mul_ps(nz, twiceDot));
+        __m128 spec = _mm_max_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, rx), _mm_mul_ps(vy, ry)), _mm_mul_ps(vz, rz)), zero);
+        spec = _mm_mul_ps(spec, spec);
+        spec = _mm_mul_ps(spec, spec);
+        spec = _mm_mul_ps(spec, spec);
+
+        __m128i pixel = alpha;
+        for (int c = 0; c < 3; c++) {
+            __m128 fragment = _mm_mul_ps(_mm_add_ps(_mm_add_ps(colour[c], _mm_mul_ps(colour[c], difference)), spec), colour[c]);
+            fragment = _mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(fragment, zero), one), toByte), half);
+            pixel = _mm_or_si128(pixel, _mm_sll_epi32(_mm_cvttps_epi32(fragment), _mm_cvtsi32_si128(8*c)));
+        }
+        _mm_storeu_si128((__m128i *)(out + 4*(i - first)), pixel);
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static void ShadeAVX2(const FragmentBatch &batch, const SoftwareTexture &texture,
+                      const ShadingParameters &parameters, int first, int count, unsigned char *out)
+{
+    const int *texels = (const int *)texture.texels.data();
+    const __m256 width = _mm256_set1_ps((float)texture.width), height = _mm256_set1_ps((float)texture.height);
+    const __m256i lastX = _mm256_set1_epi32(texture.width - 1), lastY = _mm256_set1_epi32(texture.height - 1);
+    const __m256i stride = _mm256_set1_epi32(texture.width);
+    const __m256i zeroInt = _mm256_setzero_si256(), oneInt = _mm256_set1_epi32(1);
+    const __m256i channelMask = _mm256_set1_epi32(0xff), alpha = _mm256_set1_epi32((int)0xff000000u);
+    const __m256 zero = _mm256_setzero_ps(), half = _mm256_set1_ps(0.5f), one = _mm256_set1_ps(1.f), two = _mm256_set1_ps(2.f);
+    const __m256 toUnit = _mm256_set1_ps(1.f/255.f), toByte = _mm256_set1_ps(255.f);
+    const __m256 lightX = _mm256_set1_ps(parameters.lightPosition.x), lightY = _mm256_set1_ps(parameters.lightPosition.y),
+                 lightZ = _mm256_set1_ps(parameters.lightPosition.z);
+    const __m256 cameraX = _mm256_set1_ps(parameters.cameraPosition.x), cameraY = _mm256_set1_ps(parameters.cameraPosition.y),
+                 cameraZ = _mm256_set1_ps(parameters.cameraPosition.z);
+
+    for (int i = first; i < first + count; i += 8) {
+        __m256 x = _mm256_fmsub_ps(_mm256_loadu_ps(&batch.u[i]), width, half);
+        __m256 y = _mm256_fmsub_ps(_mm256_loadu_ps(&batch.v[i]), height, half);
+        __m256 fx = _mm256_floor_ps(x), fy = _mm256_floor_ps(y);
+        __m256 ax = _mm256_sub_ps(x, fx), ay = _mm256_sub_ps(y, fy);
+        __m256i ix = _mm256_cvttps_epi32(fx), iy = _mm256_cvttps_epi32(fy);
+        __m256i x0 = _mm256_min_epi32(_mm256_max_epi32(ix, zeroInt), lastX);
+        __m256i x1 = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(ix, oneInt), zeroInt), lastX);
+        __m256i row0 = _mm256_mullo_epi32(_mm256_min_epi32(_mm256_max_epi32(iy, zeroInt), lastY), stride);
+        __m256i row1 = _mm256_mullo_epi32(_mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(iy, oneInt), zeroInt), lastY), stride);
+
+        __m256i corner[4];
+        corner[0] = _mm256_i32gather_epi32(texels, _mm256_add_epi32(row0, x0), 4);
+        corner[1] = _mm256_i32gather_epi32(texels, _mm256_add_epi32(row0, x1), 4);
+        corner[2] = _mm256_i32gather_epi32(texels, _mm256_add_epi32(row1, x0), 4);
+        corner[3] = _mm256_i32gather_epi32(texels, _mm256_add_epi32(row1, x1), 4);
+
+        __m256 colour[3];
+        for (int c = 0; c < 3; c++) {
+            __m128i shift = _mm_cvtsi32_si128(8*c);
+            __m256 c00 = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srl_epi32(corner[0], shift), channelMask));
+            __m256 c10 = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srl_epi32(corner[1], shift), channelMask));
+            __m256 c01 = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srl_epi32(corner[2], shift), channelMask));
+            __m256 c11 = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srl_epi32(corner[3], shift), channelMask));
+            __m256 top = _mm256_fmadd_ps(_mm256_sub_ps(c10, c00), ax, c00);
+            __m256 bottom = _mm256_fmadd_ps(_mm256_sub_ps(c11, c01), ax, c01);
+            colour[c] = _mm256_mul_ps(_mm256_fmadd_ps(_mm256_sub_ps(bottom, top), ay, top), toUnit);
+        }
+
+        __m256 px = _mm256_loadu_ps(&batch.positionX[i]), py = _mm256_loadu_ps(&batch.positionY[i]), pz = _mm256_loadu_ps(&batch.positionZ[i]);
+        __m256 nx = _mm256_loadu_ps(&batch.normalX[i]), ny = _mm256_loadu_ps(&batch.normalY[i]), nz = _mm256_loadu_ps(&batch.normalZ[i]);
+
+        __m256 lx = _mm256_sub_ps(lightX, px), ly = _mm256_sub_ps(lightY, py), lz = _mm256_sub_ps(lightZ, pz);
+        __m256 scale = InverseLengthAVX2(lx, ly, lz);
+        lx = _mm256_mul_ps(lx, scale); ly = _mm256_mul_ps(ly, scale); lz = _mm256_mul_ps(lz, scale);
+
+        scale = InverseLengthAVX2(nx, ny, nz);
+        nx = _mm256_mul_ps(nx, scale); ny = _mm256_mul_ps(ny, scale); nz = _mm256_mul_ps(nz, scale);
+
+        __m256 lightDotNormal = _mm256_fmadd_ps(lz, nz, _mm256_fmadd_ps(ly, ny, _mm256_mul_ps(lx, nx)));
+        __m256 difference = _mm256_max_ps(lightDotNormal, half);
+
+        __m256 vx = _mm256_sub_ps(cameraX, px), vy = _mm256_sub_ps(cameraY, py), vz = _mm256_sub_ps(cameraZ, pz);
+        scale = InverseLengthAVX2(vx, vy, vz);
+        vx = _mm256_mul_ps(vx, scale); vy = _mm256_mul_ps(vy, scale); vz = _mm256_mul_ps(vz, scale);
+
+        __m256 twiceDot = _mm256_mul_ps(two, lightDotNormal);
+        __m256 rx = _mm256_fnmadd_ps(nx, twiceDot, lx);
+        __m256 ry = _mm256_fnmadd_ps(ny, twiceDot, ly);
+        __m256 rz = _mm256_fnmadd_ps(nz, twiceDot, lz);
+        __m256 spec = _mm256_max_ps(_mm256_fmadd_ps(vz, rz, _mm256_fmadd_ps(vy, ry, _mm256_mul_ps(vx, rx))), zero);
+        spec = _mm256_mul_ps(spec, spec);
+        spec = _mm256_mul_ps(spec, spec);
+        spec = _mm256_mul_ps(spec, spec);
+
+        __m256i pixel = alpha;
+        for (int c = 0; c < 3; c++) {
+            __m256 fragment = _mm256_mul_ps(_mm256_add_ps(_mm256_fmadd_ps(colour[c], difference, colour[c]), spec), colour[c]);
+            fragment = _mm256_fmadd_ps(_mm256_min_ps(_mm256_max_ps(fragment, zero), one), toByte, half);
+            pixel = _mm256_or_si256(pixel, _mm256_sll_epi32(_mm256_cvttps_epi32(fragment), _mm_cvtsi32_si128(8*c)));
+        }
+        _mm256_storeu_si256((__m256i *)(out + 4*(i - first)), pixel);
+    }
+}
+
+__attribute__((target("avx512f")))
+static void ShadeAVX512(const FragmentBatch &batch, const SoftwareTexture &texture,
+                        const ShadingParameters &parameters, int first, int count, unsigned char *out)
+{
+    const int *texels = (const int *)texture.texels.data();
+    const __m512 width = _mm512_set1_ps((float)texture.width), height = _mm512_set1_ps((float)texture.height);
+    const __m512i lastX = _mm512_set1_epi32(texture.width - 1), lastY = _mm512_set1_epi32(texture.height - 1);
+    const __m512i stride = _mm512_set1_epi32(texture.width);
+    const __m512i zeroInt = _mm512_setzero_si512(), oneInt = _mm512_set1_epi32(1);
+    const __m512i channelMask = _mm512_set1_epi32(0xff), alpha = _mm512_set1_epi32((int)0xff000000u);
+    const __m512 zero = _mm512_setzero_ps(), half = _mm512_set1_ps(0.5f), one = _mm512_set1_ps(1.f), two = _mm512_set1_ps(2.f);
+    const __m512 toUnit = _mm512_set1_ps(1.f/255.f), toByte = _mm512_set1_ps(255.f);
+    const __m512 lightX = _mm512_set1_ps(parameters.lightPosition.x), lightY = _mm512_set1_ps(parameters.lightPosition.y),
+                 lightZ = _mm512_set1_ps(parameters.lightPosition.z);
+    const __m512 cameraX = _mm512_set1_ps(parameters.cameraPosition.x), cameraY = _mm512_set1_ps(parameters.cameraPosition.y),
+                 cameraZ = _mm512_set1_ps(parameters.cameraPosition.z);
+
+    for (int i = first; i < first + count; i += 16) {
+        __m512 x = _mm512_fmsub_ps(_mm512_loadu_ps(&batch.u[i]), width, half);
+        __m512 y = _mm512_fmsub_ps(_mm512_loadu_ps(&batch.v[i]), height, half);
+        __m512 fx = _mm512_roundscale_ps(x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+        __m512 fy = _mm512_roundscale_ps(y, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+        __m512 ax = _mm512_sub_ps(x, fx), ay = _mm512_sub_ps(y, fy);
+        __m512i ix = _mm512_cvttps_epi32(fx), iy = _mm512_cvttps_epi32(fy);
+        __m512i x0 = _mm512_min_epi32(_mm512_max_epi32(ix, zeroInt), lastX);
+        __m512i x1 = _mm512_min_epi32(_mm512_max_epi32(_mm512_add_epi32(ix, oneInt), zeroInt), lastX);
+        __m512i row0 = _mm512_mullo_epi32(_mm512_min_epi32(_mm512_max_epi32(iy, zeroInt), lastY), stride);
+        __m512i row1 = _mm512_mullo_epi32(_mm512_min_epi32(_mm512_max_epi32(_mm512_add_epi32(iy, oneInt), zeroInt), lastY), stride);
+
+        __m512i corner[4];
+        corner[0] = _mm512_i32gather_epi32(_mm512_add_epi32(row0, x0), texels, 4);
+        corner[1] = _mm512_i32gather_epi32(_mm512_add_epi32(row0, x1), texels, 4);
+        corner[2] = _mm512_i32gather_epi32(_mm512_add_epi32(row1, x0), texels, 4);
+        corner[3] = _mm512_i32gather_epi32(_mm512_add_epi32(row1, x1), texels, 4);
+
+        __m512 colour[3];
+        for (int c = 0; c < 3; c++) {
+            __m128i shift = _mm_cvtsi32_si128(8*c);
+            __m512 c00 = _mm512_cvtepi32_ps(_mm512_and_si512(_mm512_srl_epi32(corner[0], shift), channelMask));
+            __m512 c10 = _mm512_cvtepi32_ps(_mm512_and_si512(_mm512_srl_epi32(corner[1], shift), channelMask));
+            __m512 c01 = _mm512_cvtepi32_ps(_mm512_and_si512(_mm512_srl_epi32(corner[2], shift), channelMask));
+            __m512 c11 = _mm512_cvtepi32_ps(_mm512_and_si512(_mm512_srl_epi32(corner[3], shift), channelMask));
+            __m512 top = _mm512_fmadd_ps(_mm512_sub_ps(c10, c00), ax, c00);
+            __m512 bottom = _mm512_fmadd_ps(_mm512_sub_ps(c11, c01), ax, c01);
+            colour[c] = _mm512_mul_ps(_mm512_fmadd_ps(_mm512_sub_ps(bottom, top), ay, top), toUnit);
+        }
+
+        __m512 px = _mm512_loadu_ps(&batch.positionX[i]), py = _mm512_loadu_ps(&batch.positionY[i]), pz = _mm512_loadu_ps(&batch.positionZ[i]);
+        __m512 nx = _mm512_loadu_ps(&batch.normalX[i]), ny = _mm512_loadu_ps(&batch.normalY[i]), nz = _mm512_loadu_ps(&batch.normalZ[i]);
+
+        __m512 lx = _mm512_sub_ps(lightX, px), ly = _mm512_sub_ps(lightY, py), lz = _mm512_sub_ps(lightZ, pz);
+        __m512 scale = InverseLengthAVX512(lx, ly, lz);
+        lx = _mm512_mul_ps(lx, scale); ly = _mm512_mul_ps(ly, scale); lz = _mm512_mul_ps(lz, scale);
+
+        scale = InverseLengthAVX512(nx, ny, nz);
+        nx = _mm512_mul_ps(nx, scale); ny = _mm512_mul_ps(ny, scale); nz = _mm512_mul_ps(nz, scale);
+
+        __m512 lightDotNormal = _mm512_fmadd_ps(lz, nz, _mm512_fmadd_ps(ly, ny, _mm512_mul_ps(lx, nx)));
+        __m512 difference = _mm512_max_ps(lightDotNormal, half);
+
+        __m512 vx = _mm512_sub_ps(cameraX, px), vy = _mm512_sub_ps(cameraY, py), vz = _mm512_sub_ps(cameraZ, pz);
+        scale = InverseLengthAVX512(vx, vy, vz);
+        vx = _mm512_mul_ps(vx, scale); vy = _mm512_mul_ps(vy, scale); vz = _mm512_mul_ps(vz, scale);
+
+        __m512 twiceDot = _mm512_mul_ps(two, lightDotNormal);
+        __m512 rx = _mm512_fnmadd_ps(nx, twiceDot, lx);
+        __m512 ry = _mm512_fnmadd_ps(ny, twiceDot, ly);
+        __m512 rz = _mm512_fnmadd_ps(nz, twiceDot, lz);
+        __m512 spec = _mm512_max_ps(_mm512_fmadd_ps(vz, rz, _mm512_fmadd_ps(vy, ry, _mm512_mul_ps(vx, rx))), zero);
+        spec = _mm512_mul_ps(spec, spec);
+        spec = _mm512_mul_ps(spec, spec);
+        spec = _mm512_mul_ps(spec, spec);
+
+        __m512i pixel = alpha;
+        for (int c = 0; c < 3; c++) {
+            __m512 fragment = _mm512_mul_ps(_mm512_add_ps(_mm512_fmadd_ps(colour[c], difference, colour[c]), spec), colour[c]);
+            fragment = _mm512_fmadd_ps(_mm512_min_ps(_mm512_max_ps(fragment, zero), one), toByte, half);
+            pixel = _mm512_or_si512(pixel, _mm512_sll_epi32(_mm512_cvttps_epi32(fragment), _mm_cvtsi32_si128(8*c)));
+        }
+        _mm512_storeu_si512((void *)(out + 4*(i - first)), pixel);
+    }
+}
+
+#endif
+
+bool ShadingKernelSupported(ShadingKernel kernel)
+{
+    switch (kernel) {
+        case SHADING_SCALAR:
+            return true;
+#ifdef SHADING_X86
+        case SHADING_SSE:
+            return __builtin_cpu_supports("sse4.1");
+        case SHADING_AVX2:
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        case SHADING_AVX512:
+            return __builtin_cpu_supports("avx512f");
+#endif
+        default:
+            return false;
+    }
+}
+
+ShadingKernel BestShadingKernel()
+{
+    static ShadingKernel best = [] {
+        for (int kernel = SHADING_KERNEL_COUNT - 1; kernel > SHADING_SCALAR; kernel--)
+            if (ShadingKernelSupported((ShadingKernel)kernel))
+                return (ShadingKernel)kernel;
+        return SHADING_SCALAR;
+    }();
+    return best;
+}
+
+const char* ShadingKernelName(ShadingKernel kernel)
+{
+    switch (kernel) {
+        case SHADING_SCALAR: return "scalar";
+        case SHADING_SSE:    return "SSE4.1";
+        case SHADING_AVX2:   return "AVX2";
+        case SHADING_AVX512: return "AVX-512";
+        default:             return "unknown";
+    }
+}
+
+static int ShadingWidth(ShadingKernel kernel)
+{
+    switch (kernel) {
+        case SHADING_SSE:    return 4;
+        case SHADING_AVX2:   return 8;
+        case SHADING_AVX512: return 16;
+        default:             return 1;
+    }
+}
+
+static ShadingFunction ShadingKernelFunction(ShadingKernel kernel)
+{
+#ifdef SHADING_X86
+    switch (kernel) {
+        case SHADING_SSE:    return ShadeSSE;
+        case SHADING_AVX2:   return ShadeAVX2;
+        case SHADING_AVX512: return ShadeAVX512;
+        default:             break;
+    }
+#endif
+    return ShadeScalar;
+}
+
+void ShadeFragmentBatch(const FragmentBatch &batch, const SoftwareTexture &texture,
+                        const ShadingParameters &parameters, unsigned char *out, ShadingKernel kernel)
+{
+    ShadingFunction shade = ShadingKernelFunction(kernel);
+    int vectorWidth = ShadingWidth(kernel);
+    int whole = batch.count/vectorWidth*vectorWidth;
+    shade(batch, texture, parameters, 0, whole, out);
+
+    // the last partial vector reads padding lanes and keeps only real pixels
+    int remainder = batch.count - whole;
+    if (remainder > 0) {
+        unsigned char tail[4*BATCH_PADDING];
+        shade(batch, texture, parameters, whole, vectorWidth, tail);
+        memcpy(out + 4*whole, tail, 4*remainder);
+    }
+}
+
+// --------------------------------------------------------------------------
+// Benchmark
+
+int BenchmarkShading(int fragmentCount)
+{
+    SoftwareTexture texture;
+    if (!LoadSoftwareTexture(&texture, "celestialBodyTextures/earth.jpg")) {
+        // any texture of the same size will do for timing
+        texture.width = 2048;
+        texture.height = 1024;
+        texture.texels.resize((size_t)texture.width*texture.height);
+        for (size_t i = 0; i < texture.texels.size(); i++)
+            texture.texels[i] = (uint32_t)(i*2654435761u) & 0xffffff;
+    }
+
+    // a magnified patch of a sphere, sampled in screen order like the
+    // rasterizer does; every 64th fragment has no normal, like the backdrop
+    FragmentBatch batch;
+    batch.resize(fragmentCount);
+    batch.count = fragmentCount;
+    const int columns = 1024;
+    for (int i = 0; i < fragmentCount; i++) {
+        float u = 0.3f + float(i % columns)/4096.f;
+        float v = 0.3f + float(i / columns)/4096.f;
+        float theta = u*2.f*3.14159265f, phi = v*3.14159265f;
+        vec3 normal(sinf(phi)*cosf(theta), cosf(phi), sinf(phi)*sinf(theta));
+        batch.u[i] = u;
+        batch.v[i] = fmodf(v, 1.f);
+        batch.positionX[i] = normal.x; batch.positionY[i] = normal.y; batch.positionZ[i] = normal.z + 5.f;
+        if (i % 64 == 63)
+            normal = vec3(0.f);
+        batch.normalX[i] = normal.x; batch.normalY[i] = normal.y; batch.normalZ[i] = normal.z;
+    }
+    ShadingParameters parameters;
+    parameters.lightPosition = vec3(-3.f, 2.f, 0.f);
+    parameters.cameraPosition = vec3(0.f, 0.f, 0.f);
+
+    cout << "Fragment shading: " << fragmentCount << " fragments, " << texture.width << "x" << texture.height
+         << " texture, one thread, best kernel " << ShadingKernelName(BestShadingKernel()) << endl;
+
+    vector<unsigned char> reference((size_t)fragmentCount*4), result((size_t)fragmentCount*4);
+    int failures = 0;
+    for (int k = 0; k < SHADING_KERNEL_COUNT; k++) {
+        ShadingKernel kernel = (ShadingKernel)k;
+        if (!ShadingKernelSupported(kernel)) {
+            cout << "  " << ShadingKernelName(kernel) << ": not supported on this CPU" << endl;
+            continue;
+        }
+
+        vector<unsigned char> &output = (kernel == SHADING_SCALAR) ? reference : result;
+        ShadeFragmentBatch(batch, texture, parameters, output.data(), kernel);
+        double best = 1e30;
+        for (int pass = 0; pass < 5; pass++) {
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            ShadeFragmentBatch(batch, texture, parameters, output.data(), kernel);
+            best = min(best, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        }
+
+        int worst = 0;
+        for (size_t i = 0; i < output.size(); i++)
+            worst = max(worst, abs(int(output[i]) - int(reference[i])));
+        bool pass = worst <= 1;
+        if (!pass)
+            failures++;
+        cout << "  " << ShadingKernelName(kernel) << ": " << best*1000.0 << " ms, "
+             << fragmentCount/best/1e6 << " Mpixel/s, max difference from scalar " << worst
+             << (pass ? " ok" : " FAILED") << endl;
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,76 @@
+//
+//  SoftwareShading.h
+//  graphics_assig_5_06
+//
+//  CPU version of the lighting in shaders/fragment.glsl, for the software
+//  rasterizer. Fragments are shaded in batches held as structure-of-arrays,
+//  4, 8 or 16 at a time with SSE4.1 / AVX2 / AVX-512 kernels picked at run
+//  time; textures are sampled like the GL path (bilinear, clamp to edge,
+//  rows bottom-up as uploaded).
+//
+
+#ifndef SoftwareShading_h
+#define SoftwareShading_h
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+using namespace glm;
+using namespace std;
+
+struct SoftwareTexture
+{
+    int width = 0;
+    int height = 0;
+    // RGB8 packed one texel per 32-bit word (red in the low byte), bottom
+    // row first, so a single gather fetches all channels of a texel
+    vector<uint32_t> texels;
+};
+
+// decodes an image file the same way InitializeTexture does for GL
+bool LoadSoftwareTexture(SoftwareTexture *texture, const char *filename);
+
+enum ShadingKernel
+{
+    SHADING_SCALAR,
+    SHADING_SSE,
+    SHADING_AVX2,
+    SHADING_AVX512,
+    SHADING_KERNEL_COUNT
+};
+
+bool ShadingKernelSupported(ShadingKernel kernel);
+ShadingKernel BestShadingKernel();
+const char* ShadingKernelName(ShadingKernel kernel);
+
+// interpolated inputs of the fragment shader, one entry per fragment
+struct FragmentBatch
+{
+    int count = 0;
+    vector<float> u, v;
+    vector<float> positionX, positionY, positionZ;
+    vector<float> normalX, normalY, normalZ;
+
+    // rounds up to whole 16-wide vectors, so kernels never load past the end
+    void resize(int size);
+};
+
+struct ShadingParameters
+{
+    vec3 lightPosition;
+    vec3 cameraPosition;
+};
+
+// shades every fragment of the batch with one texture; out receives RGBA8
+void ShadeFragmentBatch(const FragmentBatch &batch, const SoftwareTexture &texture,
+                        const ShadingParameters &parameters, unsigned char *out,
+                        ShadingKernel kernel = BestShadingKernel());
+
+// shades fragmentCount synthetic fragments on one thread with every
+// supported kernel, printing megapixels per second and the largest channel
+// difference from the scalar kernel; returns non-zero if one is off by more
+// than one step
+int BenchmarkShading(int fragmentCount);
+
+#endif /* SoftwareShading_h */
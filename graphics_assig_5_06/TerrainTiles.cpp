@@ -0,0 +1,188 @@
+//
+//  TerrainTiles.cpp
+//  graphics_assig_5_06
+//
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <sys/stat.h>
+
+#include <stb/stb_image_write.h>
+
+#include "TerrainTiles.h"
+#include "ProceduralSphere.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
+#include "texture.h"
+
+using namespace std;
+using namespace glm;
+
+uint64_t TerrainPatchKey :: packed() const
+{
+    return (uint64_t(face) << 56) | (uint64_t(level) << 48) | (uint64_t(uint32_t(y)) << 24) | uint64_t(uint32_t(x));
+}
+
+TerrainPatchKey TerrainPatchKey :: child(int index) const
+{
+    TerrainPatchKey key;
+    key.face = face;
+    key.level = level + 1;
+    key.x = 2*x + (index & 1);
+    key.y = 2*y + (index >> 1);
+    return key;
+}
+
+vec3 TerrainPatchDirection(const TerrainPatchKey &key, float s, float t)
+{
+    vec3 normal, right, up;
+    CubeSphereFace(key.face, normal, right, up);
+    float size = 2.f/float(1 << key.level);
+    float a = -1.f + (key.x + s)*size;
+    float b = -1.f + (key.y + t)*size;
+    // the border samples of an edge patch reach a little past the cube's
+    // edge, which the mapping leaves just off the sphere
+    return normalize(CubeToSphere(normal + a*right + b*up));
+}
+
+string TerrainTilePath(const string &directory, const TerrainPatchKey &key, const char *extension)
+{
+    return directory + "/" + to_string(key.level) + "-" + to_string(key.face) + "-" + to_string(key.x) + "-"
+           + to_string(key.y) + "." + extension;
+}
+
+bool ReadHeightTile(const string &path, vector<float> &heights)
+{
+    const size_t count = TERRAIN_HEIGHT_SAMPLES*TERRAIN_HEIGHT_SAMPLES;
+    ifstream file(path, ios::binary);
+    if (!file)
+        return false;
+    vector<uint8_t> bytes(2*count);
+    file.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+    if (size_t(file.gcount()) != bytes.size())
+        return false;
+    heights.resize(count);
+    for (size_t i = 0; i < count; i++)
+        heights[i] = float(bytes[2*i] | (bytes[2*i + 1] << 8))/65535.f;
+    return true;
+}
+
+// --------------------------------------------------------------------------
+// Baking
+
+namespace {
+
+// writes one patch's tiles; an albedo texel averages enough image samples
+// to cover the source texels under it
+bool BakePatch(const TerrainPatchKey &key, const TextureImage &texture, const TextureImage *heightMap, const string &directory)
+{
+    const int T = TERRAIN_ALBEDO_TEXELS;
+    int samples = std::max(1, int(ceil(texture.width/(4.f*T*(1 << key.level)))));
+    vector<uint8_t> albedo(size_t(T)*T*3);
+    for (int row = 0; row < T; row++) {
+        // the file's first row is the top one, which decoding puts last
+        uint8_t *out = &albedo[size_t(T - 1 - row)*T*3];
+        for (int column = 0; column < T; column++) {
+            float sum[3] = { 0.f, 0.f, 0.f };
+            for (int sy = 0; sy < samples; sy++) {
+                for (int sx = 0; sx < samples; sx++) {
+                    float s = (column + (sx + 0.5f)/samples - 0.5f)/(T - 1);
+                    float t = (row + (sy + 0.5f)/samples - 0.5f)/(T - 1);
+                    float colour[3];
+                    vec2 coord = SphereTextureCoord(TerrainPatchDirection(key, s, t));
+                    SampleTextureImage(texture, coord.x, coord.y, colour, 3);
+                    for (int c = 0; c < 3; c++)
+                        sum[c] += colour[c];
+                }
+            }
+            for (int c = 0; c < 3; c++)
+                out[column*3 + c] = uint8_t(std::min(255.f, sum[c]/(samples*samples) + 0.5f));
+        }
+    }
+    if (!stbi_write_png(TerrainTilePath(directory, key, "png").c_str(), T, T, 3, albedo.data(), T*3))
+        return false;
+    if (!heightMap)
+        return true;
+
+    const int S = TERRAIN_HEIGHT_SAMPLES;
+    vector<uint8_t> heights(2*S*S);
+    for (int row = 0; row < S; row++) {
+        for (int column = 0; column < S; column++) {
+            float s = float(column - 1)/TERRAIN_PATCH_CELLS;
+            float t = float(row - 1)/TERRAIN_PATCH_CELLS;
+            float level;
+            vec2 coord = SphereTextureCoord(TerrainPatchDirection(key, s, t));
+            SampleTextureImage(*heightMap, coord.x, coord.y, &level, 1);
+            uint16_t height = uint16_t(std::min(65535.f, level*(65535.f/255.f) + 0.5f));
+            heights[2*(row*S + column)] = uint8_t(height & 0xff);
+            heights[2*(row*S + column) + 1] = uint8_t(height >> 8);
+        }
+    }
+    ofstream file(TerrainTilePath(directory, key, "height"), ios::binary);
+    file.write(reinterpret_cast<const char*>(heights.data()), heights.size());
+    return bool(file);
+}
+
+}
+
+bool BakeTerrainTiles(const string &texturePath, const string &heightMapPath, const string &directory, int levels)
+{
+    PROFILE_SCOPE("BakeTerrainTiles");
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    TextureImage texture, heightMap;
+    if (!DecodeTextureImage(&texture, texturePath.c_str())) {
+        cout << "Terrain: could not read " << texturePath << endl;
+        return false;
+    }
+    if (!heightMapPath.empty() && !DecodeTextureImage(&heightMap, heightMapPath.c_str())) {
+        cout << "Terrain: could not read " << heightMapPath << endl;
+        FreeTextureImage(&texture);
+        return false;
+    }
+    // the directory and any of its parents that are missing
+    for (size_t slash = directory.find('/', 1); ; slash = directory.find('/', slash + 1)) {
+        mkdir(directory.substr(0, slash).c_str(), 0755);
+        if (slash == string::npos)
+            break;
+    }
+    struct stat info;
+    if (stat(directory.c_str(), &info) != 0 || !S_ISDIR(info.st_mode)) {
+        cout << "Terrain: could not create " << directory << endl;
+        FreeTextureImage(&texture);
+        FreeTextureImage(&heightMap);
+        return false;
+    }
+
+    atomic<int> failures(0);
+    int tiles = 0;
+    for (int level = 0; level < levels; level++) {
+        int side = 1 << level;
+        ParallelFor(0, 6*side*side, 1, [&](int begin, int end) {
+            for (int index = begin; index < end; index++) {
+                TerrainPatchKey key;
+                key.level = level;
+                key.face = index/(side*side);
+                key.x = index % side;
+                key.y = (index/side) % side;
+                if (!BakePatch(key, texture, heightMap.data ? &heightMap : nullptr, directory))
+                    failures++;
+            }
+        });
+        tiles += 6*side*side;
+    }
+    FreeTextureImage(&texture);
+    FreeTextureImage(&heightMap);
+
+    if (failures > 0) {
+        cout << "Terrain: could not write " << failures << " of " << tiles << " tiles to " << directory << endl;
+        return false;
+    }
+    cout << "Terrain: baked " << tiles << " tiles of " << levels << " levels from " << texturePath << " into " << directory
+         << " in " << chrono::duration<double>(chrono::steady_clock::now() - start).count() << " s" << endl;
+    return true;
+}
@@ -0,0 +1,64 @@
+//
+//  TerrainTiles.h
+//  graphics_assig_5_06
+//
+//  The data behind a planet's terrain: a quadtree over each face of the
+//  cube-sphere (see CubeSphereFace), with a pair of tiles on disk for every
+//  patch of every level:
+//
+//  - <level>-<face>-<x>-<y>.png, the albedo, TERRAIN_ALBEDO_TEXELS square.
+//    The outermost texel centres lie on the patch's edges, so neighbours
+//    sample the same colour along them.
+//  - <level>-<face>-<x>-<y>.height, little-endian 16-bit heights on the
+//    patch's mesh grid plus one sample beyond every edge, for normals that
+//    match across patches. Without one the patch is flat.
+//
+//  --bake-terrain cuts them from the images a body already uses, which
+//  wrap the sphere like sphere.obj's texture coordinates.
+//
+
+#ifndef TerrainTiles_h
+#define TerrainTiles_h
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+using namespace glm;
+using namespace std;
+
+const int TERRAIN_PATCH_CELLS = 16;                             // mesh cells along a patch edge
+const int TERRAIN_HEIGHT_SAMPLES = TERRAIN_PATCH_CELLS + 3;     // per row of a height tile
+const int TERRAIN_ALBEDO_TEXELS = 256;
+
+struct TerrainPatchKey
+{
+    int face = 0;
+    int level = 0;
+    int x = 0;      // along the face's right vector, 0 to 2^level - 1
+    int y = 0;      // along its up vector
+
+    uint64_t packed() const;
+
+    // children 0 to 3: lower left, lower right, upper left, upper right
+    TerrainPatchKey child(int index) const;
+};
+
+// direction from the centre to the point s, t across a patch, which runs
+// from 0 at its lower left corner to 1 at its upper right
+vec3 TerrainPatchDirection(const TerrainPatchKey &key, float s, float t);
+
+string TerrainTilePath(const string &directory, const TerrainPatchKey &key, const char *extension);
+
+// TERRAIN_HEIGHT_SAMPLES squared heights from 0 to 1, rows along the up
+// vector from one cell below the patch; false if missing or damaged
+bool ReadHeightTile(const string &path, vector<float> &heights);
+
+// Writes the tiles of levels 0 to levels - 1 from a texture and, if
+// heightMapPath is not empty, a greyscale height map (white highest).
+// Tiles are cut in parallel; false if an image cannot be read or a tile
+// not written.
+bool BakeTerrainTiles(const string &texturePath, const string &heightMapPath, const string &directory, int levels);
+
+#endif /* TerrainTiles_h */
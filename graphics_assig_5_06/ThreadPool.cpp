@@ -0,0 +1,147 @@
+//
+//  ThreadPool.cpp
+//  graphics_assig_5_06
+//
+
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+#include "ThreadPool.h"
+
+using namespace std;
+
+ThreadPool :: ThreadPool(int threadCount)
+{
+    if (threadCount <= 0)
+        threadCount = max(1, (int)thread::hardware_concurrency());
+
+    for (int i = 0; i < threadCount; i++)
+        workers.push_back(thread(&ThreadPool::workerLoop, this));
+}
+
+ThreadPool :: ~ThreadPool()
+{
+    {
+        lock_guard<mutex> lock(queueMutex);
+        stopping = true;
+    }
+    taskAvailable.notify_all();
+    for (thread &worker : workers)
+        worker.join();
+}
+
+int ThreadPool :: threadCount() const
+{
+    return (int)workers.size();
+}
+
+void ThreadPool :: workerLoop()
+{
+    while (true) {
+        function<void()> task;
+        {
+            unique_lock<mutex> lock(queueMutex);
+            taskAvailable.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (stopping && tasks.empty())
+                return;
+            task = move(tasks.front());
+            tasks.pop_front();
+            busyCount++;
+        }
+
+        task();
+
+        {
+            lock_guard<mutex> lock(queueMutex);
+            busyCount--;
+            if (busyCount == 0 && tasks.empty())
+                allDone.notify_all();
+        }
+    }
+}
+
+void ThreadPool :: submit(function<void()> task)
+{
+    {
+        lock_guard<mutex> lock(queueMutex);
+        tasks.push_back(move(task));
+    }
+    taskAvailable.notify_one();
+}
+
+void ThreadPool :: wait()
+{
+    unique_lock<mutex> lock(queueMutex);
+    allDone.wait(lock, [this] { return tasks.empty() && busyCount == 0; });
+}
+
+// shared between the caller and helper tasks; helpers that start after the
+// range is exhausted find nothing to do and return, so the caller only waits
+// for chunks, never for helpers stuck behind other work in the queue
+struct ParallelForState
+{
+    atomic<int> nextChunk;
+    atomic<int> chunksDone;
+    int chunkCount;
+    int begin, end, grain;
+    const function<void(int, int)> *body;
+    mutex doneMutex;
+    condition_variable doneSignal;
+
+    void run()
+    {
+        int finished = 0;
+        for (int chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++) {
+            int chunkBegin = begin + chunk*grain;
+            (*body)(chunkBegin, min(end, chunkBegin + grain));
+            finished++;
+        }
+        if (finished > 0 && (chunksDone += finished) == chunkCount) {
+            lock_guard<mutex> lock(doneMutex);
+            doneSignal.notify_all();
+        }
+    }
+};
+
+void ThreadPool :: parallelFor(int begin, int end, int grain, const function<void(int, int)> &body)
+{
+    if (end <= begin)
+        return;
+    grain = max(1, grain);
+    int chunkCount = (end - begin + grain - 1)/grain;
+    if (chunkCount == 1 || workers.empty()) {
+        body(begin, end);
+        return;
+    }
+
+    shared_ptr<ParallelForState> state = make_shared<ParallelForState>();
+    state->nextChunk = 0;
+    state->chunksDone = 0;
+    state->chunkCount = chunkCount;
+    state->begin = begin;
+    state->end = end;
+    state->grain = grain;
+    state->body = &body;
+
+    int helpers = min((int)workers.size(), chunkCount - 1);
+    for (int i = 0; i < helpers; i++)
+        submit([state] { state->run(); });
+
+    state->run();
+
+    unique_lock<mutex> lock(state->doneMutex);
+    state->doneSignal.wait(lock, [&state] { return state->chunksDone == state->chunkCount; });
+}
+
+ThreadPool& DefaultThreadPool()
+{
+    // leave one hardware thread for the thread that submits the work
+    static ThreadPool pool(max(1, (int)thread::hardware_concurrency() - 1));
+    return pool;
+}
+
+void ParallelFor(int begin, int end, int grain, const function<void(int, int)> &body)
+{
+    DefaultThreadPool().parallelFor(begin, end, grain, body);
+}
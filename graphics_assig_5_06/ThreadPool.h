@@ -0,0 +1,57 @@
+//
+//  ThreadPool.h
+//  graphics_assig_5_06
+//
+//  Fixed set of worker threads fed from a shared task queue, plus a
+//  parallelFor helper that splits an index range into chunks.
+//
+
+#ifndef ThreadPool_h
+#define ThreadPool_h
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+using namespace std;
+
+class ThreadPool
+{
+private:
+    vector<thread> workers;
+    deque<function<void()>> tasks;
+    mutex queueMutex;
+    condition_variable taskAvailable;
+    condition_variable allDone;
+    int busyCount = 0;
+    bool stopping = false;
+
+    void workerLoop();
+
+public:
+    // threadCount <= 0 uses one worker per hardware thread
+    explicit ThreadPool(int threadCount = 0);
+    ~ThreadPool();
+
+    int threadCount() const;
+
+    void submit(function<void()> task);
+
+    // blocks until the queue is empty and no task is running
+    void wait();
+
+    // runs body(chunkBegin, chunkEnd) over [begin, end) in chunks of at most
+    // grain indices; the calling thread takes chunks too, so it is safe to
+    // call from inside a task
+    void parallelFor(int begin, int end, int grain, const function<void(int, int)> &body);
+};
+
+// process-wide pool shared by the simulation and asset code
+ThreadPool& DefaultThreadPool();
+
+void ParallelFor(int begin, int end, int grain, const function<void(int, int)> &body);
+
+#endif /* ThreadPool_h */
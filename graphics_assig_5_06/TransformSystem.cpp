@@ -0,0 +1,464 @@
+//
+//  TransformSystem.cpp
+//  graphics_assig_5_06
+//
+
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <climits>
+#include <glm/gtc/matrix_transform.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TRANSFORM_USE_SSE2 1
+#endif
+
+#include "TransformSystem.h"
+#include "ThreadPool.h"
+
+using namespace std;
+using namespace glm;
+
+// nodes per parallel chunk; keeps each task well above scheduling overhead
+static const int UPDATE_GRAIN = 2048;
+
+// out = a * b for column-major 4x4 double matrices, two rows per register,
+// summed in the same order as glm's operator*; out must not alias a or b
+static inline void MultiplyMat4(const double *a, const double *b, double *out)
+{
+#ifdef TRANSFORM_USE_SSE2
+    __m128d a0 = _mm_loadu_pd(a),      a0h = _mm_loadu_pd(a + 2);
+    __m128d a1 = _mm_loadu_pd(a + 4),  a1h = _mm_loadu_pd(a + 6);
+    __m128d a2 = _mm_loadu_pd(a + 8),  a2h = _mm_loadu_pd(a + 10);
+    __m128d a3 = _mm_loadu_pd(a + 12), a3h = _mm_loadu_pd(a + 14);
+    for (int col = 0; col < 4; col++) {
+        const double *bc = b + col*4;
+        __m128d b0 = _mm_set1_pd(bc[0]), b1 = _mm_set1_pd(bc[1]);
+        __m128d b2 = _mm_set1_pd(bc[2]), b3 = _mm_set1_pd(bc[3]);
+        __m128d low = _mm_add_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(a0, b0), _mm_mul_pd(a1, b1)), _mm_mul_pd(a2, b2)), _mm_mul_pd(a3, b3));
+        __m128d high = _mm_add_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(a0h, b0), _mm_mul_pd(a1h, b1)), _mm_mul_pd(a2h, b2)), _mm_mul_pd(a3h, b3));
+        _mm_storeu_pd(out + col*4, low);
+        _mm_storeu_pd(out + col*4 + 2, high);
+    }
+#else
+    for (int col = 0; col < 4; col++) {
+        for (int row = 0; row < 4; row++) {
+            out[col*4 + row] = a[row]*b[col*4] + a[4 + row]*b[col*4 + 1]
+                             + a[8 + row]*b[col*4 + 2] + a[12 + row]*b[col*4 + 3];
+        }
+    }
+#endif
+}
+
+TransformSystem :: TransformSystem()
+{}
+
+void TransformSystem :: reserve(int count)
+{
+    posX.reserve(count); posY.reserve(count); posZ.reserve(count);
+    rotX.reserve(count); rotY.reserve(count); rotZ.reserve(count); rotW.reserve(count);
+    scaleX.reserve(count); scaleY.reserve(count); scaleZ.reserve(count);
+    parentSlot.reserve(count);
+    depth.reserve(count);
+    localDirty.reserve(count);
+    localMatrices.reserve(count);
+    worldMatrices.reserve(count);
+    childStart.reserve(count + 1);
+    slotOfHandle.reserve(count);
+    handleOfSlot.reserve(count);
+    parentHandle.reserve(count);
+}
+
+int TransformSystem :: createTransform(int parent)
+{
+    int handle = (int)slotOfHandle.size();
+    int slot = (int)handleOfSlot.size();
+
+    // placed at the end for now; the next update sorts it in among its
+    // siblings, once however many were created
+    posX.push_back(0.0); posY.push_back(0.0); posZ.push_back(0.0);
+    rotX.push_back(0.f); rotY.push_back(0.f); rotZ.push_back(0.f); rotW.push_back(1.f);
+    scaleX.push_back(1.f); scaleY.push_back(1.f); scaleZ.push_back(1.f);
+    parentSlot.push_back(parent >= 0 ? slotOfHandle[parent] : -1);
+    depth.push_back(parent >= 0 ? depth[slotOfHandle[parent]] + 1 : 0);
+    localDirty.push_back(0);
+    localMatrices.push_back(dmat4(1.0));
+    worldMatrices.push_back(dmat4(1.0));
+
+    slotOfHandle.push_back(slot);
+    handleOfSlot.push_back(handle);
+    parentHandle.push_back(parent);
+    orderDirty = true;
+
+    // new transforms start flagged so the first update builds them
+    markDirty(handle);
+    return handle;
+}
+
+void TransformSystem :: setParent(int handle, int parent)
+{
+    parentHandle[handle] = parent;
+    orderDirty = true;
+    markDirty(handle);
+}
+
+int TransformSystem :: getParent(int handle) const
+{
+    return parentHandle[handle];
+}
+
+void TransformSystem :: markDirty(int handle)
+{
+    uint8_t &dirty = localDirty[slotOfHandle[handle]];
+    if (!dirty)
+        dirtyHandles.push_back(handle);
+    dirty = 1;
+}
+
+void TransformSystem :: setTranslation(int handle, dvec3 translation)
+{
+    int slot = slotOfHandle[handle];
+    posX[slot] = translation.x; posY[slot] = translation.y; posZ[slot] = translation.z;
+    markDirty(handle);
+}
+
+void TransformSystem :: setRotation(int handle, quat rotation)
+{
+    int slot = slotOfHandle[handle];
+    rotX[slot] = rotation.x; rotY[slot] = rotation.y; rotZ[slot] = rotation.z; rotW[slot] = rotation.w;
+    markDirty(handle);
+}
+
+void TransformSystem :: setScale(int handle, vec3 scaling)
+{
+    int slot = slotOfHandle[handle];
+    scaleX[slot] = scaling.x; scaleY[slot] = scaling.y; scaleZ[slot] = scaling.z;
+    markDirty(handle);
+}
+
+dvec3 TransformSystem :: getTranslation(int handle) const
+{
+    int slot = slotOfHandle[handle];
+    return dvec3(posX[slot], posY[slot], posZ[slot]);
+}
+
+quat TransformSystem :: getRotation(int handle) const
+{
+    int slot = slotOfHandle[handle];
+    return quat(rotW[slot], rotX[slot], rotY[slot], rotZ[slot]);
+}
+
+vec3 TransformSystem :: getScale(int handle) const
+{
+    int slot = slotOfHandle[handle];
+    return vec3(scaleX[slot], scaleY[slot], scaleZ[slot]);
+}
+
+// Breadth-first from the roots, in handle order, over the parent handles,
+// which setParent() may have changed: every level follows the one above
+// it, each node's children are next to each other, and they come in the
+// order of their parents. The arrays are then permuted to match.
+void TransformSystem :: rebuildOrder()
+{
+    int count = (int)depth.size();
+    vector<int> childOffset(count + 1, 0);
+    for (int handle = 0; handle < count; handle++)
+        if (parentHandle[handle] >= 0)
+            childOffset[parentHandle[handle] + 1]++;
+    for (int handle = 0; handle < count; handle++)
+        childOffset[handle + 1] += childOffset[handle];
+    vector<int> childHandles(childOffset[count]);
+    vector<int> cursor(childOffset.begin(), childOffset.end() - 1);
+    for (int handle = 0; handle < count; handle++)
+        if (parentHandle[handle] >= 0)
+            childHandles[cursor[parentHandle[handle]]++] = handle;
+
+    // the queue is the new order, so a node's children start wherever the
+    // queue has got to when the node is taken from it
+    vector<int> order;
+    order.reserve(count);
+    for (int handle = 0; handle < count; handle++)
+        if (parentHandle[handle] < 0)
+            order.push_back(handle);
+    childStart.assign(count + 1, count);
+    for (int slot = 0; slot < (int)order.size(); slot++) {
+        int handle = order[slot];
+        childStart[slot] = (int)order.size();
+        order.insert(order.end(), childHandles.begin() + childOffset[handle], childHandles.begin() + childOffset[handle + 1]);
+    }
+
+    vector<int> newSlotOf(count);
+    for (int slot = 0; slot < count; slot++)
+        slotOfHandle[order[slot]] = slot;
+    for (int slot = 0; slot < count; slot++)
+        newSlotOf[slot] = slotOfHandle[handleOfSlot[slot]];
+
+    auto permute = [&](auto &values) {
+        auto sorted = values;
+        for (int slot = 0; slot < count; slot++)
+            sorted[newSlotOf[slot]] = values[slot];
+        values.swap(sorted);
+    };
+    permute(posX); permute(posY); permute(posZ);
+    permute(rotX); permute(rotY); permute(rotZ); permute(rotW);
+    permute(scaleX); permute(scaleY); permute(scaleZ);
+    permute(localDirty);
+    permute(localMatrices);
+    permute(worldMatrices);
+    handleOfSlot = order;
+
+    levels = 0;
+    for (int slot = 0; slot < count; slot++) {
+        int parent = parentHandle[handleOfSlot[slot]];
+        parentSlot[slot] = (parent >= 0) ? slotOfHandle[parent] : -1;
+        depth[slot] = (parent >= 0) ? depth[parentSlot[slot]] + 1 : 0;
+        levels = max(levels, depth[slot] + 1);
+    }
+    orderDirty = false;
+}
+
+// Every slot in the range changed or has a parent that was rebuilt on the
+// level above, so each gets a new world matrix, and those whose TRS changed
+// a new local matrix, T * R * S, first. Parents live on earlier levels, so
+// this only reads results those levels finished.
+void TransformSystem :: updateRange(int begin, int end)
+{
+    for (int i = begin; i < end; i++) {
+        if (localDirty[i]) {
+            // the same values as translate() * mat4_cast() * scale()
+            mat3 rotation = mat3_cast(quat(rotW[i], rotX[i], rotY[i], rotZ[i]));
+            double scaling[3] = { scaleX[i], scaleY[i], scaleZ[i] };
+            double *m = &localMatrices[i][0][0];
+            for (int col = 0; col < 3; col++) {
+                for (int row = 0; row < 3; row++)
+                    m[col*4 + row] = double(rotation[col][row])*scaling[col];
+                m[col*4 + 3] = 0.0;
+            }
+            m[12] = posX[i];
+            m[13] = posY[i];
+            m[14] = posZ[i];
+            m[15] = 1.0;
+            localDirty[i] = 0;
+        }
+        int parent = parentSlot[i];
+        if (parent >= 0)
+            MultiplyMat4(&worldMatrices[parent][0][0], &localMatrices[i][0][0], &worldMatrices[i][0][0]);
+        else
+            worldMatrices[i] = localMatrices[i];
+    }
+}
+
+void TransformSystem :: update(bool parallel)
+{
+    if (orderDirty)
+        rebuildOrder();
+
+    // the changed slots in order; once many have changed, reading every
+    // flag is quicker than sorting the list
+    updatedLastFrame = 0;
+    vector<int> dirty;
+    dirty.reserve(dirtyHandles.size());
+    if (dirtyHandles.size() > localDirty.size()/16) {
+        for (int slot = 0; slot < (int)localDirty.size(); slot++)
+            if (localDirty[slot])
+                dirty.push_back(slot);
+    } else {
+        for (int handle : dirtyHandles)
+            dirty.push_back(slotOfHandle[handle]);
+        sort(dirty.begin(), dirty.end());
+    }
+    dirtyHandles.clear();
+
+    // each level updates the children of the last level's ranges and its
+    // own changed slots; a slot below a changed ancestor is only done once
+    ranges.clear();
+    size_t next = 0;
+    int level = 0;
+    while (!ranges.empty() || next < dirty.size()) {
+        level = ranges.empty() ? depth[dirty[next]] : level + 1;
+        nextRanges.clear();
+        auto add = [this](int begin, int end) {
+            if (begin >= end)
+                return;
+            if (!nextRanges.empty() && begin <= nextRanges.back().second)
+                nextRanges.back().second = max(nextRanges.back().second, end);
+            else
+                nextRanges.push_back(make_pair(begin, end));
+        };
+        size_t r = 0;
+        while (r < ranges.size() || (next < dirty.size() && depth[dirty[next]] == level)) {
+            int childBegin = r < ranges.size() ? childStart[ranges[r].first] : INT_MAX;
+            if (next < dirty.size() && depth[dirty[next]] == level && dirty[next] < childBegin) {
+                add(dirty[next], dirty[next] + 1);
+                next++;
+            } else {
+                add(childBegin, childStart[ranges[r].second]);
+                r++;
+            }
+        }
+
+        for (const pair<int, int> &range : nextRanges) {
+            if (parallel)
+                ParallelFor(range.first, range.second, UPDATE_GRAIN, [this](int begin, int end) { updateRange(begin, end); });
+            else
+                updateRange(range.first, range.second);
+            updatedLastFrame += range.second - range.first;
+        }
+        ranges.swap(nextRanges);
+    }
+}
+
+const dmat4& TransformSystem :: getWorldMatrix(int handle) const
+{
+    return worldMatrices[slotOfHandle[handle]];
+}
+
+int TransformSystem :: size() const
+{
+    return (int)depth.size();
+}
+
+int TransformSystem :: levelCount() const
+{
+    return levels;
+}
+
+int TransformSystem :: transformsUpdatedLastFrame() const
+{
+    return updatedLastFrame;
+}
+
+// --------------------------------------------------------------------------
+// Benchmark
+
+namespace {
+
+// one struct per node, children walked recursively: the layout SceneGraph
+// kept before its storage moved here, as the baseline
+struct NodeAoS
+{
+    dvec3 translation;
+    quat rotation;
+    vec3 scaling;
+    int parent = -1;
+    vector<int> children;
+    dmat4 localMatrix = dmat4(1.0);
+    dmat4 worldMatrix = dmat4(1.0);
+};
+
+void UpdateSubtreeAoS(vector<NodeAoS> &nodes, int node)
+{
+    NodeAoS &n = nodes[node];
+    n.localMatrix = translate(dmat4(1.0), n.translation) * dmat4(mat4_cast(n.rotation)) * scale(dmat4(1.0), dvec3(n.scaling));
+    n.worldMatrix = (n.parent >= 0) ? nodes[n.parent].worldMatrix * n.localMatrix : n.localMatrix;
+    for (int child : n.children)
+        UpdateSubtreeAoS(nodes, child);
+}
+
+// stars, planets, moons and stations in roughly 1:10:30:59 proportion,
+// created out of depth order so the first update also pays for sorting;
+// parents[i] is node i's parent in both layouts
+vector<int> SyntheticParents(int count)
+{
+    int stars = max(1, count/100);
+    int planets = max(1, count/10);
+    int moons = max(1, count*3/10);
+    int stations = max(0, count - stars - planets - moons);
+
+    vector<int> parents;
+    vector<int> starNodes, planetNodes, moonNodes;
+    for (int i = 0; i < stars; i++) {
+        starNodes.push_back((int)parents.size());
+        parents.push_back(-1);
+    }
+    for (int i = 0; i < planets; i++) {
+        planetNodes.push_back((int)parents.size());
+        parents.push_back(starNodes[i % stars]);
+        // a few late roots force the depth ordering to be rebuilt
+        if (i % 1000 == 0)
+            parents.push_back(-1);
+    }
+    for (int i = 0; i < moons; i++) {
+        moonNodes.push_back((int)parents.size());
+        parents.push_back(planetNodes[i % planets]);
+    }
+    for (int i = 0; i < stations; i++)
+        parents.push_back(moonNodes[i % moons]);
+    return parents;
+}
+
+dvec3 SyntheticTranslation(int node)
+{
+    return dvec3(1.0 + (node % 7), 0.0, 0.1*(node % 3));
+}
+
+
+template<class Body>
+double MillisecondsPerUpdate(int iterations, Body body)
+{
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+        body(i);
+    auto stop = chrono::steady_clock::now();
+    return chrono::duration<double, milli>(stop - start).count()/iterations;
+}
+
+}
+
+// every node is turned each update, as the bodies are in the app, so both
+// layouts rebuild every local and world matrix
+int BenchmarkTransformSystem()
+{
+    const int sizes[] = { 10000, 100000, 1000000 };
+
+    cout << "Transform update benchmark (" << DefaultThreadPool().threadCount() + 1 << " threads)" << endl;
+
+    for (int count : sizes) {
+        vector<int> parents = SyntheticParents(count);
+        int nodeCount = (int)parents.size();
+
+        TransformSystem system;
+        system.reserve(nodeCount);
+        vector<NodeAoS> nodes(nodeCount);
+        vector<int> roots;
+        for (int node = 0; node < nodeCount; node++) {
+            system.createTransform(parents[node]);
+            system.setTranslation(node, SyntheticTranslation(node));
+            system.setScale(node, vec3(0.5f));
+            nodes[node].translation = SyntheticTranslation(node);
+            nodes[node].scaling = vec3(0.5f);
+            nodes[node].parent = parents[node];
+            if (parents[node] >= 0)
+                nodes[parents[node]].children.push_back(node);
+            else
+                roots.push_back(node);
+        }
+        system.update(false);   // sorts and warms the caches
+
+        // two poses to alternate between, made outside the timing
+        vector<quat> poses[2];
+        for (int pose = 0; pose < 2; pose++)
+            for (int node = 0; node < nodeCount; node++)
+                poses[pose].push_back(angleAxis(node*0.001f + pose*0.01f, vec3(0, 1, 0)));
+        auto turnAll = [&](int i) {
+            for (int node = 0; node < nodeCount; node++)
+                system.setRotation(node, poses[i & 1][node]);
+        };
+        int iterations = max(5, 2000000/nodeCount);
+        double aos = MillisecondsPerUpdate(iterations, [&](int i) {
+            for (int node = 0; node < nodeCount; node++)
+                nodes[node].rotation = poses[i & 1][node];
+            for (int root : roots)
+                UpdateSubtreeAoS(nodes, root);
+        });
+        double serial = MillisecondsPerUpdate(iterations, [&](int i) { turnAll(i); system.update(false); });
+        double parallel = MillisecondsPerUpdate(iterations, [&](int i) { turnAll(i); system.update(true); });
+
+        cout << "  " << nodeCount << " nodes, " << system.levelCount() << " levels: "
+             << "struct per node " << aos << " ms (" << aos*1e6/nodeCount << " ns/node), "
+             << "SoA serial " << serial << " ms (" << serial*1e6/nodeCount << " ns/node), "
+             << "SoA parallel " << parallel << " ms (" << parallel*1e6/nodeCount << " ns/node)" << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,581 @@
+//
+//  VirtualTexture.cpp
+//  graphics_assig_5_06
+//
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <sys/stat.h>
+
+#include <stb/stb_image_write.h>
+
+#include "VirtualTexture.h"
+#include "SceneRenderer.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
+#include "PerformanceHud.h"
+
+using namespace std;
+
+namespace {
+
+// pages across a side of level, which always has at least one
+int PageCount(int texels, int level)
+{
+    int span = VIRTUAL_PAGE_TEXELS << level;
+    return (texels + span - 1)/span;
+}
+
+int NextPowerOfTwo(int n)
+{
+    int power = 1;
+    while (power < n)
+        power *= 2;
+    return power;
+}
+
+// one level of the pyramid, RGB with rows bottom-up
+struct PyramidLevel
+{
+    int width = 0;
+    int height = 0;
+    vector<uint8_t> texels;
+};
+
+// each texel the average of the two by two below it; a last odd row or
+// column is averaged with itself
+PyramidLevel HalveLevel(const PyramidLevel &level)
+{
+    PyramidLevel half;
+    half.width = (level.width + 1)/2;
+    half.height = (level.height + 1)/2;
+    half.texels.resize(size_t(half.width)*half.height*3);
+    ParallelFor(0, half.height, 16, [&](int begin, int end) {
+        for (int y = begin; y < end; y++) {
+            int y0 = 2*y, y1 = std::min(2*y + 1, level.height - 1);
+            for (int x = 0; x < half.width; x++) {
+                int x0 = 2*x, x1 = std::min(2*x + 1, level.width - 1);
+                for (int c = 0; c < 3; c++) {
+                    auto texel = [&](int tx, int ty) { return int(level.texels[(size_t(ty)*level.width + tx)*3 + c]); };
+                    int sum = texel(x0, y0) + texel(x1, y0) + texel(x0, y1) + texel(x1, y1);
+                    half.texels[(size_t(y)*half.width + x)*3 + c] = uint8_t((sum + 2)/4);
+                }
+            }
+        }
+    });
+    return half;
+}
+
+// a page and its border, wrapping around in x and clamped at the poles
+bool WritePage(const PyramidLevel &level, int x, int y, const string &path)
+{
+    const int S = VIRTUAL_PAGE_STRIDE;
+    vector<uint8_t> page(size_t(S)*S*3);
+    for (int row = 0; row < S; row++) {
+        int sourceY = std::min(std::max(y*VIRTUAL_PAGE_TEXELS + row - VIRTUAL_PAGE_BORDER, 0), level.height - 1);
+        // the file's first row is the top one, which decoding puts last
+        uint8_t *out = &page[size_t(S - 1 - row)*S*3];
+        for (int column = 0; column < S; column++) {
+            int sourceX = x*VIRTUAL_PAGE_TEXELS + column - VIRTUAL_PAGE_BORDER;
+            sourceX = ((sourceX % level.width) + level.width) % level.width;
+            memcpy(out + column*3, &level.texels[(size_t(sourceY)*level.width + sourceX)*3], 3);
+        }
+    }
+    return stbi_write_png(path.c_str(), S, S, 3, page.data(), S*3) != 0;
+}
+
+}
+
+bool BakeVirtualTexture(const string &imagePath, const string &directory)
+{
+    PROFILE_SCOPE("BakeVirtualTexture");
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    TextureImage image;
+    if (!DecodeTextureImage(&image, imagePath.c_str())) {
+        cout << "VirtualTexture: could not read " << imagePath << endl;
+        return false;
+    }
+    if (PageCount(image.width, 0) > VIRTUAL_MAX_PAGES || PageCount(image.height, 0) > VIRTUAL_MAX_PAGES) {
+        cout << "VirtualTexture: " << imagePath << " is over " << VIRTUAL_MAX_PAGES*VIRTUAL_PAGE_TEXELS
+             << " texels on a side" << endl;
+        FreeTextureImage(&image);
+        return false;
+    }
+    PyramidLevel level;
+    level.width = image.width;
+    level.height = image.height;
+    level.texels.resize(size_t(image.width)*image.height*3);
+    for (size_t i = 0; i < size_t(image.width)*image.height; i++)
+        for (int c = 0; c < 3; c++)
+            level.texels[i*3 + c] = image.data[i*image.components + std::min(c, image.components - 1)];
+    FreeTextureImage(&image);
+
+    // the directory and any of its parents that are missing
+    for (size_t slash = directory.find('/', 1); ; slash = directory.find('/', slash + 1)) {
+        mkdir(directory.substr(0, slash).c_str(), 0755);
+        if (slash == string::npos)
+            break;
+    }
+    ofstream layout(directory + "/pages.txt");
+    layout << level.width << " " << level.height << endl;
+    if (!layout) {
+        cout << "VirtualTexture: could not write " << directory << "/pages.txt" << endl;
+        return false;
+    }
+
+    atomic<int> failures(0);
+    const int width = level.width, height = level.height;
+    int pages = 0, levels = 0;
+    for (bool last = false; !last; levels++) {
+        int wide = PageCount(width, levels), high = PageCount(height, levels);
+        ParallelFor(0, wide*high, 1, [&](int begin, int end) {
+            for (int index = begin; index < end; index++) {
+                int x = index % wide, y = index/wide;
+                string path = directory + "/" + to_string(levels) + "-" + to_string(x) + "-" + to_string(y) + ".png";
+                if (!WritePage(level, x, y, path))
+                    failures++;
+            }
+        });
+        pages += wide*high;
+        last = wide == 1 && high == 1;
+        if (!last)
+            level = HalveLevel(level);
+    }
+
+    if (failures > 0) {
+        cout << "VirtualTexture: could not write " << failures << " of " << pages << " pages to " << directory << endl;
+        return false;
+    }
+    cout << "VirtualTexture: baked " << pages << " pages of " << levels << " levels from " << imagePath << " into "
+         << directory << " in " << chrono::duration<double>(chrono::steady_clock::now() - start).count() << " s" << endl;
+    return true;
+}
+
+// --------------------------------------------------------------------------
+// Streaming pages
+
+struct VirtualTexture :: LoadQueue
+{
+    mutex lock;
+    vector<PageData> finished;
+
+    // pages finished after their texture was destroyed
+    ~LoadQueue()
+    {
+        for (PageData &data : finished)
+            FreeTextureImage(&data.image);
+    }
+};
+
+uint32_t VirtualTexture :: pageKey(int level, int x, int y) const
+{
+    return (uint32_t(level + 1) << 28) | (uint32_t(y) << 14) | uint32_t(x);
+}
+
+string VirtualTexture :: pagePath(uint32_t page) const
+{
+    int level = int(page >> 28) - 1;
+    int y = int((page >> 14) & 0x3fff), x = int(page & 0x3fff);
+    return directory + "/" + to_string(level) + "-" + to_string(x) + "-" + to_string(y) + ".png";
+}
+
+void VirtualTexture :: loadPage(const string &path, PageData &data)
+{
+    PROFILE_SCOPE("VirtualTexture::loadPage");
+    data.found = DecodeTextureImage(&data.image, path.c_str());
+    if (data.found && (data.image.width != VIRTUAL_PAGE_STRIDE || data.image.height != VIRTUAL_PAGE_STRIDE
+                       || data.image.components != 3)) {
+        FreeTextureImage(&data.image);
+        data.found = false;
+    }
+}
+
+bool VirtualTexture :: initialize(const string &directory)
+{
+    PROFILE_SCOPE("VirtualTexture::initialize");
+    this->directory = directory;
+    statistics = Statistics();
+    frame = 0;
+
+    ifstream layout(directory + "/pages.txt");
+    if (!(layout >> width >> height) || width <= 0 || height <= 0) {
+        cout << "VirtualTexture: " << directory << " has no readable pages.txt" << endl;
+        return false;
+    }
+    if (PageCount(width, 0) > VIRTUAL_MAX_PAGES || PageCount(height, 0) > VIRTUAL_MAX_PAGES) {
+        cout << "VirtualTexture: " << directory << " is over " << VIRTUAL_MAX_PAGES << " pages on a side" << endl;
+        return false;
+    }
+    pagesWide.clear();
+    pagesHigh.clear();
+    for (levels = 0; levels == 0 || pagesWide.back() > 1 || pagesHigh.back() > 1; levels++) {
+        pagesWide.push_back(PageCount(width, levels));
+        pagesHigh.push_back(PageCount(height, levels));
+    }
+    tableWidth = NextPowerOfTwo(pagesWide[0]);
+    tableHeight = NextPowerOfTwo(pagesHigh[0]);
+
+    // slots are filled by glTexSubImage2D as pages arrive
+    pool.target = GL_TEXTURE_2D;
+    pool.width = pool.height = POOL_PAGES*VIRTUAL_PAGE_STRIDE;
+    glGenTextures(1, &pool.textureID);
+    glBindTexture(GL_TEXTURE_2D, pool.textureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, pool.width, pool.height, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+    // a mip level of the page table per level of pages, each a power of
+    // two so level n's texels line up with level 0's 2^n at a time
+    glGenTextures(1, &pageTable);
+    glBindTexture(GL_TEXTURE_2D, pageTable);
+    tableEntries.assign(levels, vector<uint8_t>());
+    for (int level = 0; level < levels; level++) {
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, std::max(1, tableWidth >> level), std::max(1, tableHeight >> level), 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        tableEntries[level].resize(size_t(pagesWide[level])*pagesHigh[level]*4);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    slots.assign(POOL_PAGES*POOL_PAGES, Slot());
+    queue = make_shared<LoadQueue>();
+
+    // the coarsest page stands in for everything else, so it is always there
+    PageData coarsest;
+    coarsest.page = pageKey(levels - 1, 0, 0);
+    loadPage(pagePath(coarsest.page), coarsest);
+    if (!coarsest.found || !upload(coarsest)) {
+        cout << "VirtualTexture: could not read " << pagePath(coarsest.page) << endl;
+        destroy();
+        return false;
+    }
+    rebuildPageTable();
+    return true;
+}
+
+// into a free slot, or the one seen least recently; false, dropping the
+// page, if every slot was seen in the latest feedback
+bool VirtualTexture :: upload(PageData &data)
+{
+    int slot = freeSlot();
+    if (slot < 0) {
+        FreeTextureImage(&data.image);
+        return false;
+    }
+    glBindTexture(GL_TEXTURE_2D, pool.textureID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, (slot % POOL_PAGES)*VIRTUAL_PAGE_STRIDE, (slot/POOL_PAGES)*VIRTUAL_PAGE_STRIDE,
+                    VIRTUAL_PAGE_STRIDE, VIRTUAL_PAGE_STRIDE, GL_RGB, GL_UNSIGNED_BYTE, data.image.data);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    FreeTextureImage(&data.image);
+
+    slots[slot].page = data.page;
+    slots[slot].lastUsed = frame;
+    resident[data.page] = slot;
+    statistics.residentPages++;
+    statistics.pagesLoaded++;
+    tableChanged = true;
+    return true;
+}
+
+int VirtualTexture :: freeSlot()
+{
+    const uint32_t coarsest = pageKey(levels - 1, 0, 0);
+    int oldest = -1;
+    for (int i = 0; i < int(slots.size()); i++) {
+        const Slot &slot = slots[i];
+        if (slot.page == 0)
+            return i;
+        if (slot.page != coarsest && slot.lastUsed < frame && (oldest < 0 || slot.lastUsed < slots[oldest].lastUsed))
+            oldest = i;
+    }
+    if (oldest < 0)
+        return -1;
+    resident.erase(slots[oldest].page);
+    slots[oldest].page = 0;
+    statistics.residentPages--;
+    statistics.pagesEvicted++;
+    tableChanged = true;
+    return oldest;
+}
+
+// Every page's entry, from the coarsest level down: its own slot if it is
+// resident, otherwise whatever its parent's entry says. The whole table is
+// redone, which at the largest size is a million entries, but only on
+// frames where pages came or went.
+void VirtualTexture :: rebuildPageTable()
+{
+    PROFILE_SCOPE("VirtualTexture::rebuildPageTable");
+    glBindTexture(GL_TEXTURE_2D, pageTable);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int level = levels - 1; level >= 0; level--) {
+        vector<uint8_t> &entries = tableEntries[level];
+        int wide = pagesWide[level];
+        for (int y = 0; y < pagesHigh[level]; y++) {
+            for (int x = 0; x < wide; x++) {
+                uint8_t *entry = &entries[(size_t(y)*wide + x)*4];
+                auto found = resident.find(pageKey(level, x, y));
+                if (found != resident.end()) {
+                    entry[0] = uint8_t(found->second % POOL_PAGES);
+                    entry[1] = uint8_t(found->second/POOL_PAGES);
+                    entry[2] = uint8_t(level);
+                    entry[3] = 255;
+                } else
+                    memcpy(entry, &tableEntries[level + 1][(size_t(y/2)*pagesWide[level + 1] + x/2)*4], 4);
+            }
+        }
+        glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, wide, pagesHigh[level], GL_RGBA, GL_UNSIGNED_BYTE, entries.data());
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    tableChanged = false;
+}
+
+void VirtualTexture :: requestPages(const vector<uint16_t> &feedback, int id)
+{
+    PROFILE_SCOPE("VirtualTexture::requestPages");
+    frame++;
+
+    const uint16_t tag = uint16_t(id + 1);
+    unordered_set<uint32_t> seen;
+    vector<pair<int, uint32_t>> wanted;    // level, page
+    for (size_t i = 0; i + 3 < feedback.size(); i += 4) {
+        if (feedback[i + 3] != tag)
+            continue;
+        int level = std::min(int(feedback[i + 2]), levels - 1);
+        int x = std::min(int(feedback[i]), pagesWide[level] - 1);
+        int y = std::min(int(feedback[i + 1]), pagesHigh[level] - 1);
+        // the page and its ancestors, which stand in for it until it arrives
+        for (; level < levels; level++, x /= 2, y /= 2) {
+            uint32_t page = pageKey(level, x, y);
+            if (!seen.insert(page).second)
+                break;
+            auto found = resident.find(page);
+            if (found != resident.end())
+                slots[found->second].lastUsed = frame;
+            else if (loading.count(page) == 0 && missing.count(page) == 0)
+                wanted.push_back(make_pair(level, page));
+        }
+    }
+    statistics.wantedPages = int(seen.size());
+
+    // coarse pages first, as each stands in for many finer ones
+    sort(wanted.begin(), wanted.end(), greater<pair<int, uint32_t>>());
+    for (const auto &entry : wanted) {
+        if (int(loading.size()) >= MAX_LOADING_PAGES)
+            break;
+        loading.insert(entry.second);
+
+        shared_ptr<LoadQueue> queue = this->queue;
+        string path = pagePath(entry.second);
+        uint32_t page = entry.second;
+        DefaultThreadPool().submit([queue, path, page]() {
+            PageData data;
+            data.page = page;
+            loadPage(path, data);
+            lock_guard<mutex> lock(queue->lock);
+            queue->finished.push_back(move(data));
+        });
+    }
+    statistics.loadingPages = int(loading.size());
+}
+
+void VirtualTexture :: update()
+{
+    PROFILE_SCOPE("VirtualTexture::update");
+
+    // a few finished pages a frame; the rest wait their turn
+    vector<PageData> finished;
+    {
+        lock_guard<mutex> lock(queue->lock);
+        size_t count = std::min(queue->finished.size(), size_t(MAX_UPLOADS_PER_FRAME));
+        finished.assign(make_move_iterator(queue->finished.begin()), make_move_iterator(queue->finished.begin() + count));
+        queue->finished.erase(queue->finished.begin(), queue->finished.begin() + count);
+    }
+    for (PageData &data : finished) {
+        loading.erase(data.page);
+        if (data.found)
+            upload(data);
+        else if (missing.insert(data.page).second && missing.size() == 1)
+            cout << "VirtualTexture: " << pagePath(data.page) << " is missing; its area stays coarser" << endl;
+    }
+    statistics.loadingPages = int(loading.size());
+
+    if (tableChanged)
+        rebuildPageTable();
+}
+
+MyTexture* VirtualTexture :: pagePool()
+{
+    return &pool;
+}
+
+void VirtualTexture :: bindPageTable(GLuint program) const
+{
+    BindTexture(2, GL_TEXTURE_2D, pageTable);
+    glUniform1i(glGetUniformLocation(program, "pageTable"), 2);
+
+    // the page table's texels cover whole pages only, so coordinates are
+    // scaled to the part of it the image fills
+    float pagesX = float(width)/VIRTUAL_PAGE_TEXELS, pagesY = float(height)/VIRTUAL_PAGE_TEXELS;
+    glUniform2f(glGetUniformLocation(program, "virtualPages"), pagesX, pagesY);
+    glUniform2f(glGetUniformLocation(program, "pageTableScale"), pagesX/tableWidth, pagesY/tableHeight);
+    glUniform1f(glGetUniformLocation(program, "virtualLevels"), float(levels));
+    glUniform1f(glGetUniformLocation(program, "poolTexels"), float(pool.width));
+}
+
+void VirtualTexture :: setFeedbackUniforms(GLuint program, int id, float lodBias) const
+{
+    glUniform2f(glGetUniformLocation(program, "virtualPages"), float(width)/VIRTUAL_PAGE_TEXELS, float(height)/VIRTUAL_PAGE_TEXELS);
+    glUniform1f(glGetUniformLocation(program, "virtualLevels"), float(levels));
+    glUniform1f(glGetUniformLocation(program, "lodBias"), lodBias);
+    glUniform1ui(glGetUniformLocation(program, "textureId"), GLuint(id + 1));
+}
+
+size_t VirtualTexture :: memoryBytes() const
+{
+    return TextureMemoryBytes(GL_TEXTURE_2D, pool.textureID) + TextureMemoryBytes(GL_TEXTURE_2D, pageTable);
+}
+
+void VirtualTexture :: destroy()
+{
+    if (pool.textureID != 0)
+        DestroyTexture(&pool);
+    pool = MyTexture();
+    glDeleteTextures(1, &pageTable);
+    pageTable = 0;
+    tableEntries.clear();
+    slots.clear();
+    resident.clear();
+    loading.clear();
+    missing.clear();
+    queue.reset();
+    statistics.residentPages = 0;
+    statistics.loadingPages = 0;
+}
+
+const VirtualTexture::Statistics& VirtualTexture :: getStatistics() const
+{
+    return statistics;
+}
+
+// --------------------------------------------------------------------------
+// Feedback
+
+bool VirtualTextureFeedback :: initialize(int screenWidth, int screenHeight)
+{
+    GLint framebuffer, viewport[4];
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    bool complete = InitializeRenderTarget(&target, std::max(1, screenWidth/DIVISOR), std::max(1, screenHeight/DIVISOR), GL_RGBA16UI);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    if (!complete)
+        return false;
+
+    GLsizeiptr bytes = GLsizeiptr(target.width)*target.height*4*sizeof(uint16_t);
+    for (int i = 0; i < RING_SIZE; i++) {
+        glGenBuffers(1, &ring[i].pixelBuffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, ring[i].pixelBuffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return true;
+}
+
+void VirtualTextureFeedback :: begin()
+{
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &savedDrawFramebuffer);
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &savedReadFramebuffer);
+    glGetIntegerv(GL_VIEWPORT, savedViewport);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    glViewport(0, 0, target.width, target.height);
+    const GLuint nothing[4] = { 0, 0, 0, 0 };
+    glClearBufferuiv(GL_COLOR, 0, nothing);
+    glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void VirtualTextureFeedback :: end()
+{
+    // the slot about to be reused was filled RING_SIZE - 1 frames ago; if
+    // the GPU is still on it, this frame's feedback is simply not taken
+    Readback &slot = ring[nextSlot];
+    bool free = true;
+    if (slot.fence) {
+        if (glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED) {
+            skipped++;
+            free = false;
+        } else {
+            glDeleteSync(slot.fence);
+            slot.fence = 0;
+            size_t count = size_t(target.width)*target.height*4;
+            latest.resize(count);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pixelBuffer);
+            void *texels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, count*sizeof(uint16_t), GL_MAP_READ_BIT);
+            if (texels) {
+                memcpy(latest.data(), texels, count*sizeof(uint16_t));
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+                arrived = true;
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+    }
+    if (free) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pixelBuffer);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glReadPixels(0, 0, target.width, target.height, GL_RGBA_INTEGER, GL_UNSIGNED_SHORT, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        nextSlot = (nextSlot + 1) % RING_SIZE;
+    }
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, savedDrawFramebuffer);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, savedReadFramebuffer);
+    glViewport(savedViewport[0], savedViewport[1], savedViewport[2], savedViewport[3]);
+}
+
+bool VirtualTextureFeedback :: takeFeedback(vector<uint16_t> &texels)
+{
+    if (!arrived)
+        return false;
+    texels.swap(latest);
+    arrived = false;
+    return true;
+}
+
+float VirtualTextureFeedback :: lodBias() const
+{
+    return -log2(float(DIVISOR));
+}
+
+int VirtualTextureFeedback :: skippedReadbacks() const
+{
+    return skipped;
+}
+
+void VirtualTextureFeedback :: destroy()
+{
+    for (Readback &slot : ring) {
+        if (slot.fence)
+            glDeleteSync(slot.fence);
+        glDeleteBuffers(1, &slot.pixelBuffer);
+        slot = Readback();
+    }
+    if (target.framebuffer != 0)
+        DestroyRenderTarget(&target);
+}
@@ -0,0 +1,191 @@
+//
+//  VirtualTexture.h
+//  graphics_assig_5_06
+//
+//  Surface images far larger than what is kept on the GPU. The image is
+//  cut into a mip pyramid of square pages on disk (BakeVirtualTexture); at
+//  run time only the pages the view needs are resident, in the slots of a
+//  fixed pool texture, and a page table with one texel per page of every
+//  level tells the VIRTUAL_TEXTURE shader variant which slot holds that
+//  page or, until it arrives, its nearest resident ancestor.
+//
+//  What the view needs comes from VirtualTextureFeedback: the bodies drawn
+//  small by shaders/vt_feedback.glsl, which writes the page each pixel
+//  would sample, and read back a couple of frames later so the GPU never
+//  waits. Missing pages are decoded on the thread pool, coarsest first, and
+//  uploaded a few per frame; the ones seen least recently make room. Only
+//  the single coarsest page is read up front.
+//
+//  A directory of pages holds pages.txt, the image's width and height, and
+//  <level>-<x>-<y>.png for every page: VIRTUAL_PAGE_TEXELS square plus a
+//  border of VIRTUAL_PAGE_BORDER copied from its neighbours, so filtering
+//  inside a slot never reaches the next one.
+//
+
+#ifndef VirtualTexture_h
+#define VirtualTexture_h
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdint>
+#include <glad/glad.h>
+
+#include "RenderTarget.h"
+#include "texture.h"
+
+using namespace std;
+
+const int VIRTUAL_PAGE_TEXELS = 128;
+const int VIRTUAL_PAGE_BORDER = 1;
+const int VIRTUAL_PAGE_STRIDE = VIRTUAL_PAGE_TEXELS + 2*VIRTUAL_PAGE_BORDER;   // a page as stored
+const int VIRTUAL_MAX_PAGES = 1024;     // along either side of level 0, which keeps the page table under 6 MB
+
+// Writes the pages of an image, which wraps around in x like sphere.obj's
+// texture coordinates, halving it level by level down to a single page;
+// false if it cannot be read or a page not written.
+bool BakeVirtualTexture(const string &imagePath, const string &directory);
+
+class VirtualTexture
+{
+public:
+    static const int POOL_PAGES = 16;           // slots along each side: 256 pages, 13 MB
+    static const int MAX_LOADING_PAGES = 16;
+    static const int MAX_UPLOADS_PER_FRAME = 8;
+
+    struct Statistics
+    {
+        int residentPages = 0;
+        int loadingPages = 0;
+        int wantedPages = 0;        // in the latest feedback, with their ancestors
+        int pagesLoaded = 0;        // since initialize()
+        int pagesEvicted = 0;
+    };
+
+private:
+    struct Slot
+    {
+        uint32_t page = 0;          // key of the page in it, 0 if free
+        uint64_t lastUsed = 0;
+    };
+
+    // what a worker hands back
+    struct PageData
+    {
+        uint32_t page = 0;
+        bool found = false;
+        TextureImage image;
+    };
+
+    // shared with the workers, so a VirtualTexture can go while they run
+    struct LoadQueue;
+
+    string directory;
+    int width = 0, height = 0;          // of the image, level 0
+    int levels = 0;
+    vector<int> pagesWide, pagesHigh;   // per level
+    int tableWidth = 0, tableHeight = 0;
+    MyTexture pool;
+    GLuint pageTable = 0;
+    vector<vector<uint8_t>> tableEntries;   // RGBA per page per level: slot x, slot y, level
+    vector<Slot> slots;
+    unordered_map<uint32_t, int> resident;  // page key to slot
+    unordered_set<uint32_t> loading;
+    unordered_set<uint32_t> missing;        // not on disk; never asked for again
+    shared_ptr<LoadQueue> queue;
+    uint64_t frame = 0;
+    bool tableChanged = false;
+    Statistics statistics;
+
+    // level + 1 in the top bits, then y and x, so no page is 0
+    uint32_t pageKey(int level, int x, int y) const;
+    string pagePath(uint32_t page) const;
+    static void loadPage(const string &path, PageData &data);
+    bool upload(PageData &data);
+    int freeSlot();
+    void rebuildPageTable();
+
+public:
+    // needs a current context; reads the page layout and the coarsest page
+    // before returning, and fails without them
+    bool initialize(const string &directory);
+
+    // Queues the pages the texels of one readback from VirtualTextureFeedback
+    // ask for, those tagged with id, and marks the resident ones as used.
+    void requestPages(const vector<uint16_t> &feedback, int id);
+
+    // uploads what the workers have finished and refreshes the page table;
+    // once a frame, before drawing
+    void update();
+
+    // the pool, to bind as the texture of unit 0
+    MyTexture* pagePool();
+
+    // binds the page table to unit 2 and sets the VIRTUAL_TEXTURE variant's
+    // uniforms; program must be in use
+    void bindPageTable(GLuint program) const;
+
+    // the uniforms of shaders/vt_feedback.glsl, texels tagged with id
+    void setFeedbackUniforms(GLuint program, int id, float lodBias) const;
+
+    // of the pool and page table together
+    size_t memoryBytes() const;
+
+    void destroy();
+
+    const Statistics& getStatistics() const;
+};
+
+// The feedback pass: an integer colour target a fraction of the screen's
+// size, and a ring of pixel buffers its texels are read back through.
+class VirtualTextureFeedback
+{
+public:
+    static const int DIVISOR = 8;       // screen pixels along each side of a feedback texel
+
+private:
+    static const int RING_SIZE = 3;
+
+    struct Readback
+    {
+        GLuint pixelBuffer = 0;
+        GLsync fence = 0;
+    };
+
+    RenderTarget target;
+    Readback ring[RING_SIZE];
+    int nextSlot = 0;
+    GLint savedDrawFramebuffer = 0, savedReadFramebuffer = 0;
+    GLint savedViewport[4];
+    vector<uint16_t> latest;
+    bool arrived = false;
+    int skipped = 0;        // readbacks not yet finished when their slot came round
+
+public:
+    bool initialize(int screenWidth, int screenHeight);
+
+    // makes the feedback target current and clears it; draw the bodies
+    // with the feedback program, then call end()
+    void begin();
+
+    // restores the framebuffer and viewport begin() found and queues the
+    // readback; collects the oldest one if the GPU is done with it
+    void end();
+
+    // the newest readback since the last call, four values per texel:
+    // page x, page y, level and texture id + 1, or 0 where nothing was
+    // drawn; false if none arrived
+    bool takeFeedback(vector<uint16_t> &texels);
+
+    // what the shaders' level of detail is offset by in the pass, since a
+    // feedback texel covers DIVISOR pixels each way
+    float lodBias() const;
+
+    int skippedReadbacks() const;
+
+    void destroy();
+};
+
+#endif /* VirtualTexture_h */
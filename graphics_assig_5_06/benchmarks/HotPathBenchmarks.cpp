@@ -0,0 +1,446 @@
+//
+//  HotPathBenchmarks.cpp
+//  graphics_assig_5_06
+//
+//  Entry point of the graphics_assig_5_06_bench target: the OBJ loader and
+//  procedural spheres, texture decode and upload, scene file loading, scene transform update,
+//  the camera, and the CPU cost of submitting bodies through RenderScene itself. Run from the
+//  app's directory so the real textures are found; everything else is
+//  generated. GL benchmarks use a headless context where the build has
+//  one, otherwise a hidden GLFW window.
+//
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "MicroBenchmark.h"
+#include "SyntheticData.h"
+#include "objectReader.h"
+#include "texture.h"
+#include "Camera.h"
+#include "SceneGraph.h"
+#include "SceneDescription.h"
+#include "ProceduralSphere.h"
+#include "HeadlessContext.h"
+#include "RenderTarget.h"
+#include "SceneRenderer.h"
+
+using namespace std;
+using namespace glm;
+
+// --------------------------------------------------------------------------
+// OBJ loading
+
+static void BM_ObjectReaderFindSphere(BenchmarkState &state)
+{
+    int segments = (int)state.range(0);
+    string path = SyntheticSphereObj(segments);
+    if (path.empty()) {
+        state.skipWithError("could not write the synthetic OBJ file");
+        return;
+    }
+    ifstream file(path, ios::binary | ios::ate);
+    int64_t fileBytes = (int64_t)file.tellg();
+
+    while (state.keepRunning()) {
+        ObjectReader reader;
+        reader.findSphere(path.c_str());
+        DoNotOptimize(reader);
+    }
+    state.setItemsProcessed(state.iterations()*SyntheticSphereTriangles(segments));
+    state.setBytesProcessed(state.iterations()*fileBytes);
+}
+BENCHMARK(BM_ObjectReaderFindSphere)->arg(32)->arg(128)->arg(512);
+
+static void BM_ObjectReaderProcessData(BenchmarkState &state)
+{
+    int segments = (int)state.range(0);
+    string path = SyntheticSphereObj(segments);
+    if (path.empty()) {
+        state.skipWithError("could not write the synthetic OBJ file");
+        return;
+    }
+    ObjectReader parsed;
+    parsed.findSphere(path.c_str());
+
+    // processData appends, so every iteration starts from a fresh copy
+    while (state.keepRunning()) {
+        state.pauseTiming();
+        ObjectReader reader(parsed);
+        state.resumeTiming();
+        reader.processData();
+        DoNotOptimize(reader);
+    }
+    state.setItemsProcessed(state.iterations()*SyntheticSphereTriangles(segments));
+}
+BENCHMARK(BM_ObjectReaderProcessData)->arg(32)->arg(128)->arg(512);
+
+// range(0) is the SphereKind and range(1) its detail; the UV spheres match
+// the sizes of the OBJ files above
+static void BM_GenerateSphere(BenchmarkState &state)
+{
+    SphereParameters sphere;
+    sphere.kind = (SphereKind)state.range(0);
+    sphere.detail = (int)state.range(1);
+
+    while (state.keepRunning()) {
+        vector<vec3> vertices, normals;
+        vector<vec2> textureCoords;
+        GenerateSphere(sphere, vertices, textureCoords, &normals);
+        DoNotOptimize(vertices);
+        DoNotOptimize(normals);
+    }
+    state.setItemsProcessed(state.iterations()*SphereTriangleCount(sphere));
+}
+BENCHMARK(BM_GenerateSphere)->args({ SPHERE_UV, 32 })->args({ SPHERE_UV, 128 })->args({ SPHERE_UV, 512 })
+                            ->args({ SPHERE_ICO, 3 })->args({ SPHERE_ICO, 6 })
+                            ->args({ SPHERE_CUBE, 16 })->args({ SPHERE_CUBE, 128 });
+
+// --------------------------------------------------------------------------
+// Texture decode (the CPU half of InitializeTexture)
+
+static void DecodeTextureLoop(BenchmarkState &state, const string &path)
+{
+    int64_t decodedBytes = 0;
+    while (state.keepRunning()) {
+        TextureImage image;
+        if (!DecodeTextureImage(&image, path.c_str())) {
+            state.skipWithError("could not decode " + path);
+            return;
+        }
+        decodedBytes += (int64_t)image.width*image.height*image.components;
+        FreeTextureImage(&image);
+    }
+    state.setBytesProcessed(decodedBytes);
+}
+
+static void BM_DecodeTexturePng(BenchmarkState &state)
+{
+    string path = SyntheticTexturePng((int)state.range(0));
+    if (path.empty()) {
+        state.skipWithError("could not write the synthetic texture");
+        return;
+    }
+    DecodeTextureLoop(state, path);
+}
+BENCHMARK(BM_DecodeTexturePng)->arg(512)->arg(2048);
+
+// the planet textures are JPEG, which stb_image_write cannot produce
+static void BM_DecodeTextureJpeg(BenchmarkState &state)
+{
+    const char *path = "celestialBodyTextures/earth.jpg";
+    if (!ifstream(path).good()) {
+        state.skipWithError(string(path) + " not found; run from the app directory");
+        return;
+    }
+    DecodeTextureLoop(state, path);
+}
+BENCHMARK(BM_DecodeTextureJpeg);
+
+// --------------------------------------------------------------------------
+// Scene files
+
+static void BM_SceneLoadJson(BenchmarkState &state)
+{
+    string path = SyntheticSceneJson((int)state.range(0));
+    if (path.empty()) {
+        state.skipWithError("could not write the synthetic scene");
+        return;
+    }
+    ifstream file(path, ios::binary | ios::ate);
+    int64_t fileBytes = (int64_t)file.tellg();
+
+    while (state.keepRunning()) {
+        SceneDescription scene;
+        scene.load(path);
+        DoNotOptimize(scene);
+    }
+    state.setItemsProcessed(state.iterations()*state.range(0));
+    state.setBytesProcessed(state.iterations()*fileBytes);
+}
+BENCHMARK(BM_SceneLoadJson)->arg(4)->arg(1000)->arg(10000);
+
+static void BM_SceneLoadBinary(BenchmarkState &state)
+{
+    string path = SyntheticSceneBinary((int)state.range(0));
+    if (path.empty()) {
+        state.skipWithError("could not write the synthetic scene");
+        return;
+    }
+
+    while (state.keepRunning()) {
+        SceneDescription scene;
+        scene.load(path);
+        DoNotOptimize(scene);
+    }
+    state.setItemsProcessed(state.iterations()*state.range(0));
+}
+BENCHMARK(BM_SceneLoadBinary)->arg(4)->arg(1000)->arg(10000);
+
+// --------------------------------------------------------------------------
+// Scene transforms
+
+// every body moves, as in physics mode with many bodies
+static void BM_SceneGraphUpdateAll(BenchmarkState &state)
+{
+    SceneGraph scene;
+    int roots = BuildSyntheticScene(scene, (int)state.range(0));
+    float angle = 0.f;
+    while (state.keepRunning()) {
+        angle += 0.01f;
+        for (int root = 0; root < roots; root++)
+            scene.setRotation(root, angleAxis(angle, vec3(0, 1, 0)));
+        scene.updateWorldMatrices();
+    }
+    state.setItemsProcessed(state.iterations()*scene.nodeCount());
+}
+BENCHMARK(BM_SceneGraphUpdateAll)->arg(1000)->arg(10000)->arg(100000)->arg(1000000);
+
+// one planet moves; only its subtree should be recomputed
+static void BM_SceneGraphUpdateOne(BenchmarkState &state)
+{
+    SceneGraph scene;
+    int roots = BuildSyntheticScene(scene, (int)state.range(0));
+    int planet = roots;
+    double x = 0.0;
+    while (state.keepRunning()) {
+        x += 0.01;
+        scene.setTranslation(planet, dvec3(x, 0.0, 0.0));
+        scene.updateWorldMatrices();
+    }
+    state.counters["nodes_updated"] = scene.nodesUpdatedLastFrame();
+}
+BENCHMARK(BM_SceneGraphUpdateOne)->arg(1000)->arg(100000);
+
+// camera-relative float matrices, as written into every FrameSnapshot
+static void BM_SceneGraphRelativeMatrices(BenchmarkState &state)
+{
+    SceneGraph scene;
+    BuildSyntheticScene(scene, (int)state.range(0));
+    vector<int> nodes(scene.nodeCount());
+    for (int i = 0; i < (int)nodes.size(); i++)
+        nodes[i] = i;
+    vector<mat4> matrices(nodes.size());
+    dvec3 eye(1e6, 2.0, -3.0);
+    while (state.keepRunning()) {
+        scene.getRelativeMatrices(nodes.data(), (int)nodes.size(), eye, matrices.data());
+        DoNotOptimize(matrices[0]);
+    }
+    state.setItemsProcessed(state.iterations()*nodes.size());
+}
+BENCHMARK(BM_SceneGraphRelativeMatrices)->arg(4)->arg(1000)->arg(100000);
+
+// --------------------------------------------------------------------------
+// Camera
+
+static void BM_CameraUpdateCamera(BenchmarkState &state)
+{
+    Camera camera;
+    while (state.keepRunning()) {
+        camera.theta += 1e-4f;
+        camera.updateCamera();
+        DoNotOptimize(camera.pos);
+    }
+    state.setItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CameraUpdateCamera);
+
+static void BM_CameraViewMatrix(BenchmarkState &state)
+{
+    Camera camera;
+    camera.updateCamera();
+    while (state.keepRunning()) {
+        camera.phi += 1e-4f;
+        mat4 view = camera.viewMatrix();
+        DoNotOptimize(view);
+    }
+    state.setItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CameraViewMatrix);
+
+// --------------------------------------------------------------------------
+// GL submission
+
+// reads the uniforms RenderScene sets, without the app's shading cost
+static const char *SUBMIT_VERTEX_SHADER =
+    "#version 410\n"
+    "layout(location = 0) in vec3 VertexPosition;\n"
+    "uniform mat4 modelViewProjection;\n"
+    "uniform mat4 transform;\n"
+    "void main() { gl_Position = modelViewProjection*transform*vec4(VertexPosition, 1.0); }\n";
+
+static const char *SUBMIT_FRAGMENT_SHADER =
+    "#version 410\n"
+    "uniform sampler2D textureImage_one;\n"
+    "uniform vec3 lightPosition;\n"
+    "uniform vec3 cameraPosition;\n"
+    "out vec4 FragmentColour;\n"
+    "void main() { FragmentColour = texture(textureImage_one, vec2(0.5))*vec4(lightPosition + cameraPosition, 1.0); }\n";
+
+// created on first use and kept for the whole run
+struct BenchmarkGL
+{
+    bool ready = false;
+    string error;
+    HeadlessContext headless;
+    GLFWwindow *window = nullptr;
+    RenderTarget target;
+
+    GLuint program = 0;
+    Geometry sphere;
+    MyTexture texture;
+
+    bool createContext();
+    bool createResources();
+};
+
+bool BenchmarkGL :: createContext()
+{
+    if (headless.create(64, 64) && gladLoadGLLoader(HeadlessContext::procLoader()))
+        return true;
+
+    if (!glfwInit())
+        return false;
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    window = glfwCreateWindow(64, 64, "bench", 0, 0);
+    if (!window)
+        return false;
+    glfwMakeContextCurrent(window);
+    return gladLoadGLLoader((GLADloadproc)glfwGetProcAddress) != 0;
+}
+
+static GLuint CompileStage(GLenum type, const char *source)
+{
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+    return shader;
+}
+
+bool BenchmarkGL :: createResources()
+{
+    if (!InitializeRenderTarget(&target, 64, 64))
+        return false;
+
+    GLuint vertex = CompileStage(GL_VERTEX_SHADER, SUBMIT_VERTEX_SHADER);
+    GLuint fragment = CompileStage(GL_FRAGMENT_SHADER, SUBMIT_FRAGMENT_SHADER);
+    program = glCreateProgram();
+    glAttachShader(program, vertex);
+    glAttachShader(program, fragment);
+    glLinkProgram(program);
+    glDeleteShader(vertex);
+    glDeleteShader(fragment);
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked)
+        return false;
+
+    // the same sphere the app draws, near enough
+    ObjectReader reader;
+    reader.findSphere(SyntheticSphereObj(32).c_str());
+    reader.processData();
+    vector<vec3> vertices = reader.getVertices();
+    if (!InitializeVAO(&sphere) || !LoadGeometry(&sphere, vertices, reader.getUvs(), reader.getNormals(), (int)vertices.size()))
+        return false;
+
+    const unsigned char texel[4] = { 255, 255, 255, 255 };
+    texture.target = GL_TEXTURE_2D;
+    texture.width = texture.height = 1;
+    glGenTextures(1, &texture.textureID);
+    glBindTexture(GL_TEXTURE_2D, texture.textureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glEnable(GL_DEPTH_TEST);
+    return glGetError() == GL_NO_ERROR;
+}
+
+static BenchmarkGL& GL()
+{
+    static BenchmarkGL gl;
+    static bool attempted = false;
+    if (!attempted) {
+        attempted = true;
+        if (!gl.createContext())
+            gl.error = "no GL context (headless backend or GLFW window)";
+        else if (!gl.createResources())
+            gl.error = "could not create the GL resources";
+        else
+            gl.ready = true;
+    }
+    return gl;
+}
+
+// CPU time to issue N bodies; the GPU catches up outside the timed region
+static void BM_SubmitBodies(BenchmarkState &state)
+{
+    BenchmarkGL &gl = GL();
+    if (!gl.ready) {
+        state.skipWithError(gl.error);
+        return;
+    }
+    int bodies = (int)state.range(0);
+    mat4 projection = infinitePerspective(1.2f, 1.f, 0.1f);
+    FrameSnapshot frame;
+    frame.viewMatrix = lookAt(vec3(0, 0, 10), vec3(0), vec3(0, 1, 0));
+    vector<mat4> models(bodies);
+    for (int i = 0; i < bodies; i++)
+        models[i] = translate(mat4(1.f), vec3(float(i % 9) - 4.f, float(i/9 % 9) - 4.f, 0.f))*scale(mat4(1.f), vec3(0.3f));
+
+    // each pass starts as the app's frames do, with nothing known to be bound
+    while (state.keepRunning()) {
+        ForgetBindings();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        for (int i = 0; i < bodies; i++)
+            RenderScene(&gl.sphere, &gl.texture, nullptr, nullptr, gl.program, frame, projection, GL_TRIANGLES, models[i]);
+        state.pauseTiming();
+        glFinish();
+        state.resumeTiming();
+    }
+    state.setItemsProcessed(state.iterations()*bodies);
+}
+BENCHMARK(BM_SubmitBodies)->arg(4)->arg(64)->arg(1024);
+
+// the GL half of InitializeTexture; includes the driver's copy
+static void BM_UploadTexture(BenchmarkState &state)
+{
+    BenchmarkGL &gl = GL();
+    if (!gl.ready) {
+        state.skipWithError(gl.error);
+        return;
+    }
+    TextureImage image;
+    string path = SyntheticTexturePng((int)state.range(0));
+    if (path.empty() || !DecodeTextureImage(&image, path.c_str())) {
+        state.skipWithError("could not prepare the synthetic texture");
+        return;
+    }
+    while (state.keepRunning()) {
+        MyTexture texture;
+        UploadTexture(&texture, image, GL_TEXTURE_2D);
+        glFinish();
+        state.pauseTiming();
+        DestroyTexture(&texture);
+        state.resumeTiming();
+    }
+    state.setBytesProcessed(state.iterations()*(int64_t)image.width*image.height*image.components);
+    FreeTextureImage(&image);
+}
+BENCHMARK(BM_UploadTexture)->arg(512)->arg(2048);
+
+int main(int argc, char *argv[])
+{
+    return RunBenchmarks(argc, argv);
+}
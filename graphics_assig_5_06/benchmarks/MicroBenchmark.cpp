@@ -0,0 +1,477 @@
+//
+//  MicroBenchmark.cpp
+//  graphics_assig_5_06
+//
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <memory>
+#include <regex>
+#include <thread>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <cstdlib>
+#include <ctime>
+#include <time.h>
+
+#include "MicroBenchmark.h"
+
+using namespace std;
+
+static const int64_t MAX_ITERATIONS = 1000000000;
+
+// CPU time of the calling thread, so helper threads that are merely alive
+// (the thread pool) are not counted
+static double ThreadCpuSeconds()
+{
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec + now.tv_nsec*1e-9;
+#else
+    return double(clock())/CLOCKS_PER_SEC;
+#endif
+}
+
+BenchmarkState :: BenchmarkState(const vector<int64_t> &arguments, int64_t iterations)
+    : arguments(arguments), maxIterations(iterations)
+{}
+
+void BenchmarkState :: startTimer()
+{
+    wallStart = chrono::steady_clock::now();
+    cpuStart = ThreadCpuSeconds();
+}
+
+void BenchmarkState :: stopTimer()
+{
+    wallSeconds += chrono::duration<double>(chrono::steady_clock::now() - wallStart).count();
+    cpuSeconds += ThreadCpuSeconds() - cpuStart;
+}
+
+bool BenchmarkState :: keepRunning()
+{
+    if (!started) {
+        started = true;
+        if (!error.empty())
+            return false;
+        startTimer();
+    } else {
+        completed++;
+    }
+    if (completed < maxIterations && error.empty())
+        return true;
+    if (!paused)
+        stopTimer();
+    return false;
+}
+
+void BenchmarkState :: pauseTiming()
+{
+    if (paused)
+        return;
+    stopTimer();
+    paused = true;
+}
+
+void BenchmarkState :: resumeTiming()
+{
+    if (!paused)
+        return;
+    startTimer();
+    paused = false;
+}
+
+int64_t BenchmarkState :: range(int index) const
+{
+    return index < (int)arguments.size() ? arguments[index] : 0;
+}
+
+int64_t BenchmarkState :: iterations() const
+{
+    return maxIterations;
+}
+
+void BenchmarkState :: setItemsProcessed(int64_t items)
+{
+    itemsProcessed = items;
+}
+
+void BenchmarkState :: setBytesProcessed(int64_t bytes)
+{
+    bytesProcessed = bytes;
+}
+
+void BenchmarkState :: skipWithError(const string &message)
+{
+    error = message;
+}
+
+// --------------------------------------------------------------------------
+
+Benchmark :: Benchmark(const char *name, BenchmarkFunction function)
+    : name(name), function(function)
+{}
+
+Benchmark* Benchmark :: arg(int64_t value)
+{
+    argumentSets.push_back(vector<int64_t>(1, value));
+    return this;
+}
+
+Benchmark* Benchmark :: args(const vector<int64_t> &values)
+{
+    argumentSets.push_back(values);
+    return this;
+}
+
+// constructed on first use, since registration runs during static
+// initialisation of other files
+static vector<unique_ptr<Benchmark>>& Registry()
+{
+    static vector<unique_ptr<Benchmark>> benchmarks;
+    return benchmarks;
+}
+
+Benchmark* RegisterBenchmark(const char *name, BenchmarkFunction function)
+{
+    Registry().push_back(unique_ptr<Benchmark>(new Benchmark(name, function)));
+    return Registry().back().get();
+}
+
+// --------------------------------------------------------------------------
+
+struct BenchmarkResult
+{
+    string name;            // with aggregate suffix
+    string runName;
+    string aggregate;       // empty for a single repetition
+    int repetition = 0;
+    int64_t iterations = 0;
+    double realTime = 0.0;  // ns per iteration
+    double cpuTime = 0.0;
+    double itemsPerSecond = 0.0;
+    double bytesPerSecond = 0.0;
+    map<string, double> counters;
+    string error;
+};
+
+class BenchmarkRunner
+{
+private:
+    double minTime = 0.5;
+    int repetitions = 1;
+    regex filter = regex(".");
+    string outputPath;
+    bool listOnly = false;
+    vector<BenchmarkResult> results;
+
+    BenchmarkResult measure(const Benchmark &benchmark, const vector<int64_t> &arguments, const string &runName, int64_t iterations, bool &finished);
+    void run(const Benchmark &benchmark, const vector<int64_t> &arguments);
+    void addAggregates(size_t first);
+    void print(const BenchmarkResult &result) const;
+    bool writeJSON(const string &executable) const;
+
+public:
+    bool parse(int argc, char *argv[]);
+    int runAll(const string &executable);
+};
+
+bool BenchmarkRunner :: parse(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        size_t equals = arg.find('=');
+        string flag = arg.substr(0, equals);
+        string value = equals == string::npos ? "" : arg.substr(equals + 1);
+        if (flag == "--benchmark_filter") {
+            // std::regex reports a malformed pattern only by throwing
+            try {
+                filter = regex(value);
+            } catch (const regex_error &) {
+                cout << "Invalid --benchmark_filter pattern " << value << endl;
+                return false;
+            }
+        }
+        else if (flag == "--benchmark_min_time")
+            minTime = max(0.001, atof(value.c_str()));
+        else if (flag == "--benchmark_repetitions")
+            repetitions = max(1, atoi(value.c_str()));
+        else if (flag == "--benchmark_out")
+            outputPath = value;
+        else if (flag == "--benchmark_list_tests")
+            listOnly = true;
+        else {
+            cout << "Unknown flag " << arg << endl
+                 << "Usage: " << argv[0] << " [--benchmark_filter=<regex>] [--benchmark_min_time=<seconds>]" << endl
+                 << "       [--benchmark_repetitions=<n>] [--benchmark_out=<file.json>] [--benchmark_list_tests]" << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+BenchmarkResult BenchmarkRunner :: measure(const Benchmark &benchmark, const vector<int64_t> &arguments, const string &runName, int64_t iterations, bool &finished)
+{
+    BenchmarkState state(arguments, iterations);
+    benchmark.function(state);
+
+    BenchmarkResult result;
+    result.name = runName;
+    result.runName = runName;
+    result.iterations = iterations;
+    result.error = state.error;
+    if (result.error.empty() && state.completed < iterations)
+        result.error = "the benchmark loop ended early";
+    result.realTime = state.wallSeconds*1e9/iterations;
+    result.cpuTime = state.cpuSeconds*1e9/iterations;
+    if (state.wallSeconds > 0.0) {
+        result.itemsPerSecond = state.itemsProcessed/state.wallSeconds;
+        result.bytesPerSecond = state.bytesProcessed/state.wallSeconds;
+    }
+    result.counters = state.counters;
+    finished = !result.error.empty() || state.wallSeconds >= minTime || iterations >= MAX_ITERATIONS;
+
+    // aim 40% past the minimum so the next run is very likely the last,
+    // growing at most tenfold in case the first iterations were unusually
+    // fast
+    if (!finished) {
+        double multiplier = state.wallSeconds > 0.0 ? min(10.0, minTime*1.4/state.wallSeconds) : 10.0;
+        int64_t next = (int64_t)ceil(iterations*multiplier);
+        result.iterations = min(MAX_ITERATIONS, max(iterations + 1, next));
+    }
+    return result;
+}
+
+void BenchmarkRunner :: run(const Benchmark &benchmark, const vector<int64_t> &arguments)
+{
+    string runName = benchmark.name;
+    for (int64_t argument : arguments)
+        runName += "/" + to_string(argument);
+    if (!regex_search(runName, filter))
+        return;
+    if (listOnly) {
+        cout << runName << endl;
+        return;
+    }
+
+    // the run that reaches the minimum time is also the first repetition
+    int64_t iterations = 1;
+    bool finished = false;
+    BenchmarkResult result;
+    while (!finished) {
+        result = measure(benchmark, arguments, runName, iterations, finished);
+        iterations = result.iterations;
+    }
+
+    size_t first = results.size();
+    results.push_back(result);
+    print(result);
+    for (int repetition = 1; repetition < repetitions && result.error.empty(); repetition++) {
+        BenchmarkResult next = measure(benchmark, arguments, runName, iterations, finished);
+        next.repetition = repetition;
+        next.iterations = iterations;
+        results.push_back(next);
+        print(next);
+    }
+    if (repetitions > 1 && result.error.empty())
+        addAggregates(first);
+}
+
+// mean, median and standard deviation of every repetition from first on
+void BenchmarkRunner :: addAggregates(size_t first)
+{
+    vector<BenchmarkResult> runs(results.begin() + first, results.end());
+    auto aggregate = [&runs](const char *name, function<double(vector<double>&)> reduce) {
+        BenchmarkResult result = runs[0];
+        result.aggregate = name;
+        result.name = runs[0].runName + "_" + name;
+        auto reduceField = [&](function<double(const BenchmarkResult&)> field) {
+            vector<double> values;
+            for (const BenchmarkResult &run : runs)
+                values.push_back(field(run));
+            return reduce(values);
+        };
+        result.realTime = reduceField([](const BenchmarkResult &r) { return r.realTime; });
+        result.cpuTime = reduceField([](const BenchmarkResult &r) { return r.cpuTime; });
+        result.itemsPerSecond = reduceField([](const BenchmarkResult &r) { return r.itemsPerSecond; });
+        result.bytesPerSecond = reduceField([](const BenchmarkResult &r) { return r.bytesPerSecond; });
+        for (auto &counter : result.counters) {
+            string key = counter.first;
+            counter.second = reduceField([key](const BenchmarkResult &r) {
+                auto found = r.counters.find(key);
+                return found == r.counters.end() ? 0.0 : found->second;
+            });
+        }
+        return result;
+    };
+
+    auto mean = [](vector<double> &values) {
+        double sum = 0.0;
+        for (double value : values)
+            sum += value;
+        return sum/values.size();
+    };
+    auto median = [](vector<double> &values) {
+        sort(values.begin(), values.end());
+        size_t middle = values.size()/2;
+        return values.size() % 2 ? values[middle] : 0.5*(values[middle - 1] + values[middle]);
+    };
+    auto deviation = [mean](vector<double> &values) {
+        double average = mean(values), sum = 0.0;
+        for (double value : values)
+            sum += (value - average)*(value - average);
+        return values.size() > 1 ? sqrt(sum/(values.size() - 1)) : 0.0;
+    };
+
+    results.push_back(aggregate("mean", mean));
+    results.push_back(aggregate("median", median));
+    results.push_back(aggregate("stddev", deviation));
+    for (size_t i = results.size() - 3; i < results.size(); i++)
+        print(results[i]);
+}
+
+static string HumanRate(double perSecond, const char *unit)
+{
+    const char *prefixes[] = { "", "k", "M", "G", "T" };
+    int prefix = 0;
+    while (perSecond >= 1000.0 && prefix < 4) {
+        perSecond /= 1000.0;
+        prefix++;
+    }
+    char text[64];
+    snprintf(text, sizeof(text), "%.4g%s%s/s", perSecond, prefixes[prefix], unit);
+    return text;
+}
+
+void BenchmarkRunner :: print(const BenchmarkResult &result) const
+{
+    char line[256];
+    if (!result.error.empty()) {
+        snprintf(line, sizeof(line), "%-44s ERROR: %s", result.name.c_str(), result.error.c_str());
+        cout << line << endl;
+        return;
+    }
+    snprintf(line, sizeof(line), "%-44s %14.0f ns %14.0f ns %12lld", result.name.c_str(), result.realTime, result.cpuTime,
+             (long long)result.iterations);
+    cout << line;
+    if (result.bytesPerSecond > 0.0)
+        cout << " bytes_per_second=" << HumanRate(result.bytesPerSecond, "B");
+    if (result.itemsPerSecond > 0.0)
+        cout << " items_per_second=" << HumanRate(result.itemsPerSecond, "");
+    for (const auto &counter : result.counters)
+        cout << " " << counter.first << "=" << counter.second;
+    cout << endl;
+}
+
+static void WriteJSONString(ostream &out, const string &text)
+{
+    out << '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\')
+            out << '\\' << c;
+        else if ((unsigned char)c >= 0x20)
+            out << c;
+    }
+    out << '"';
+}
+
+bool BenchmarkRunner :: writeJSON(const string &executable) const
+{
+    ofstream out(outputPath);
+    if (!out) {
+        cout << "Could not write " << outputPath << endl;
+        return false;
+    }
+
+    char date[64];
+    time_t now = time(nullptr);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+
+    out << setprecision(10);
+    out << "{\n  \"context\": {\n    \"date\": \"" << date << "\",\n    \"executable\": ";
+    WriteJSONString(out, executable);
+    out << ",\n    \"num_cpus\": " << max(1u, thread::hardware_concurrency()) << ",\n"
+#ifdef NDEBUG
+        << "    \"library_build_type\": \"release\"\n"
+#else
+        << "    \"library_build_type\": \"debug\"\n"
+#endif
+        << "  },\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchmarkResult &result = results[i];
+        out << (i ? "," : "") << "\n    {\n      \"name\": ";
+        WriteJSONString(out, result.name);
+        out << ",\n      \"run_name\": ";
+        WriteJSONString(out, result.runName);
+        out << ",\n      \"run_type\": \"" << (result.aggregate.empty() ? "iteration" : "aggregate") << "\",\n"
+            << "      \"repetitions\": " << repetitions << ",\n"
+            << "      \"repetition_index\": " << result.repetition << ",\n"
+            << "      \"threads\": 1,\n";
+        if (!result.aggregate.empty())
+            out << "      \"aggregate_name\": \"" << result.aggregate << "\",\n";
+        if (!result.error.empty()) {
+            out << "      \"error_occurred\": true,\n      \"error_message\": ";
+            WriteJSONString(out, result.error);
+            out << ",\n";
+        }
+        out << "      \"iterations\": " << result.iterations << ",\n"
+            << "      \"real_time\": " << result.realTime << ",\n"
+            << "      \"cpu_time\": " << result.cpuTime << ",\n"
+            << "      \"time_unit\": \"ns\"";
+        if (result.bytesPerSecond > 0.0)
+            out << ",\n      \"bytes_per_second\": " << result.bytesPerSecond;
+        if (result.itemsPerSecond > 0.0)
+            out << ",\n      \"items_per_second\": " << result.itemsPerSecond;
+        for (const auto &counter : result.counters) {
+            out << ",\n      ";
+            WriteJSONString(out, counter.first);
+            out << ": " << counter.second;
+        }
+        out << "\n    }";
+    }
+    out << "\n  ]\n}\n";
+    return (bool)out;
+}
+
+int BenchmarkRunner :: runAll(const string &executable)
+{
+    int failures = 0;
+    if (!listOnly) {
+        char header[256];
+        snprintf(header, sizeof(header), "%-44s %17s %17s %12s", "Benchmark", "Time", "CPU", "Iterations");
+        cout << header << endl << string(strlen(header), '-') << endl;
+    }
+    for (const unique_ptr<Benchmark> &benchmark : Registry()) {
+        if (benchmark->argumentSets.empty())
+            run(*benchmark, vector<int64_t>());
+        for (const vector<int64_t> &arguments : benchmark->argumentSets)
+            run(*benchmark, arguments);
+    }
+    for (const BenchmarkResult &result : results)
+        failures += !result.error.empty();
+
+    if (!outputPath.empty() && !listOnly) {
+        if (!writeJSON(executable))
+            return 1;
+        cout << "Results written to " << outputPath << endl;
+    }
+    // benchmarks that cannot run here (no GL context) are reported but do
+    // not fail the run
+    if (failures > 0)
+        cout << failures << " benchmark" << (failures == 1 ? "" : "s") << " reported an error" << endl;
+    return 0;
+}
+
+int RunBenchmarks(int argc, char *argv[])
+{
+    BenchmarkRunner runner;
+    if (!runner.parse(argc, argv))
+        return 1;
+    return runner.runAll(argc > 0 ? argv[0] : "");
+}
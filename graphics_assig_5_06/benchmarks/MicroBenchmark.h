@@ -0,0 +1,115 @@
+//
+//  MicroBenchmark.h
+//  graphics_assig_5_06
+//
+//  Small benchmark harness for the graphics_assig_5_06_bench target, in the
+//  style of Google Benchmark: functions are registered with BENCHMARK(),
+//  given arguments with arg(), and time their loop with
+//  while (state.keepRunning()). The iteration count grows until a run lasts
+//  --benchmark_min_time; results go to the console and, with
+//  --benchmark_out, to JSON in Google Benchmark's format so existing
+//  comparison tools can track them between builds.
+//
+
+#ifndef MicroBenchmark_h
+#define MicroBenchmark_h
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+#include <chrono>
+
+using namespace std;
+
+class BenchmarkState
+{
+private:
+    vector<int64_t> arguments;
+    int64_t maxIterations;
+    int64_t completed = 0;
+    bool started = false;
+    bool paused = false;
+
+    chrono::steady_clock::time_point wallStart;
+    double cpuStart = 0.0;
+    double wallSeconds = 0.0;
+    double cpuSeconds = 0.0;
+
+    int64_t itemsProcessed = 0;
+    int64_t bytesProcessed = 0;
+    string error;
+
+    void startTimer();
+    void stopTimer();
+
+    friend class BenchmarkRunner;
+
+public:
+    BenchmarkState(const vector<int64_t> &arguments, int64_t iterations);
+
+    // true while another iteration should run; the first call starts timing
+    bool keepRunning();
+
+    // leave per-iteration setup and teardown out of the measurement
+    void pauseTiming();
+    void resumeTiming();
+
+    int64_t range(int index = 0) const;
+    int64_t iterations() const;
+
+    // totals over every iteration, reported per second
+    void setItemsProcessed(int64_t items);
+    void setBytesProcessed(int64_t bytes);
+
+    // extra values reported as they are, averaged over repetitions
+    map<string, double> counters;
+
+    // marks the run as failed; call before keepRunning() or return after
+    void skipWithError(const string &message);
+};
+
+typedef void (*BenchmarkFunction)(BenchmarkState &state);
+
+class Benchmark
+{
+private:
+    string name;
+    BenchmarkFunction function;
+    vector<vector<int64_t>> argumentSets;
+
+    friend class BenchmarkRunner;
+
+public:
+    Benchmark(const char *name, BenchmarkFunction function);
+
+    // adds one run with state.range(0) == value
+    Benchmark* arg(int64_t value);
+    // adds one run with state.range(0), range(1), ... == values
+    Benchmark* args(const vector<int64_t> &values);
+};
+
+Benchmark* RegisterBenchmark(const char *name, BenchmarkFunction function);
+
+#define BENCHMARK_CONCAT_(a, b) a##b
+#define BENCHMARK_CONCAT(a, b) BENCHMARK_CONCAT_(a, b)
+#define BENCHMARK(function) \
+    static Benchmark *BENCHMARK_CONCAT(registered, __LINE__) = RegisterBenchmark(#function, function)
+
+// keeps the compiler from discarding a result that is otherwise unused
+template <typename T>
+inline void DoNotOptimize(const T &value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    const volatile char *escape = reinterpret_cast<const volatile char*>(&value);
+    (void)*escape;
+#endif
+}
+
+// parses the --benchmark_* flags, runs every registered benchmark that
+// matches the filter and returns the process exit code
+int RunBenchmarks(int argc, char *argv[]);
+
+#endif /* MicroBenchmark_h */
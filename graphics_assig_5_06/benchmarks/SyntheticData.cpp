@@ -0,0 +1,195 @@
+//
+//  SyntheticData.cpp
+//  graphics_assig_5_06
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+
+// the benchmark target does not link FrameCapture.cpp, which holds the
+// app's copy of the implementation
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb/stb_image_write.h>
+
+#include "SyntheticData.h"
+#include "SceneDescription.h"
+
+using namespace std;
+
+static const double PI = 3.14159265358979;
+
+string SyntheticDirectory()
+{
+    const char *directory = getenv("TMPDIR");
+    string path = (directory && *directory) ? directory : "/tmp";
+    if (path.back() != '/')
+        path += '/';
+    return path;
+}
+
+static bool FileExists(const string &path)
+{
+    ifstream file(path);
+    return file.good();
+}
+
+int SyntheticSphereTriangles(int segments)
+{
+    int rings = max(2, segments/2);
+    return 2*segments*(rings - 1);
+}
+
+string SyntheticSphereObj(int segments)
+{
+    segments = max(3, segments);
+    int rings = max(2, segments/2);
+    string path = SyntheticDirectory() + "bench_sphere_" + to_string(segments) + ".obj";
+    if (FileExists(path))
+        return path;
+
+    FILE *file = fopen(path.c_str(), "w");
+    if (!file)
+        return "";
+    fprintf(file, "# synthetic UV sphere, %d segments\n", segments);
+
+    // a (segments + 1) x (rings + 1) grid, the seam column duplicated so
+    // texture coordinates do not wrap
+    for (int ring = 0; ring <= rings; ring++) {
+        double polar = PI*ring/rings;
+        for (int segment = 0; segment <= segments; segment++) {
+            double azimuth = 2.0*PI*segment/segments;
+            double x = sin(polar)*cos(azimuth), y = cos(polar), z = sin(polar)*sin(azimuth);
+            fprintf(file, "v %.6f %.6f %.6f\n", x, y, z);
+            fprintf(file, "vt %.6f %.6f\n", double(segment)/segments, 1.0 - double(ring)/rings);
+            fprintf(file, "vn %.6f %.6f %.6f\n", x, y, z);
+        }
+    }
+
+    // OBJ indices start at 1; v, vt and vn share them. The pole rings get
+    // one triangle per segment, the rest two.
+    auto index = [segments](int ring, int segment) { return ring*(segments + 1) + segment + 1; };
+    for (int ring = 0; ring < rings; ring++) {
+        for (int segment = 0; segment < segments; segment++) {
+            int a = index(ring, segment), b = index(ring, segment + 1);
+            int c = index(ring + 1, segment), d = index(ring + 1, segment + 1);
+            if (ring != 0)
+                fprintf(file, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, d, d, d, b, b, b);
+            if (ring != rings - 1)
+                fprintf(file, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, c, c, c, d, d, d);
+        }
+    }
+    bool written = ferror(file) == 0;
+    fclose(file);
+    return written ? path : "";
+}
+
+string SyntheticTexturePng(int width)
+{
+    width = max(2, width);
+    int height = width/2;
+    string path = SyntheticDirectory() + "bench_texture_" + to_string(width) + ".png";
+    if (FileExists(path))
+        return path;
+
+    vector<unsigned char> pixels((size_t)width*height*3);
+    uint32_t seed = 12345;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            double u = double(x)/width, v = double(y)/height;
+            double bands = 0.5 + 0.25*sin(v*40.0 + 3.0*sin(u*12.0)) + 0.15*sin(u*90.0 + v*30.0);
+            seed = seed*1664525u + 1013904223u;
+            int noise = int(seed >> 28) - 8;
+            unsigned char *pixel = pixels.data() + ((size_t)y*width + x)*3;
+            pixel[0] = (unsigned char)min(255, max(0, int(bands*200.0) + noise));
+            pixel[1] = (unsigned char)min(255, max(0, int(bands*150.0) + noise));
+            pixel[2] = (unsigned char)min(255, max(0, int(bands*90.0) + noise));
+        }
+    }
+    if (!stbi_write_png(path.c_str(), width, height, 3, pixels.data(), width*3))
+        return "";
+    return path;
+}
+
+int BuildSyntheticScene(SceneGraph &scene, int count)
+{
+    int stars = max(1, count/100);
+    int planets = max(1, count/10);
+    int moons = max(1, count*3/10);
+    int stations = max(0, count - stars - planets - moons);
+
+    vector<int> starNodes, planetNodes, moonNodes;
+    for (int i = 0; i < stars; i++)
+        starNodes.push_back(scene.createNode());
+    for (int i = 0; i < planets; i++)
+        planetNodes.push_back(scene.createNode(starNodes[i % stars]));
+    for (int i = 0; i < moons; i++)
+        moonNodes.push_back(scene.createNode(planetNodes[i % planets]));
+    for (int i = 0; i < stations; i++)
+        scene.createNode(moonNodes[i % moons]);
+
+    for (int node = 0; node < scene.nodeCount(); node++) {
+        scene.setTranslation(node, dvec3(1.0 + (node % 7), 0.0, 0.1*(node % 3)));
+        scene.setRotation(node, angleAxis(node*0.001f, vec3(0, 1, 0)));
+        scene.setScale(node, vec3(0.5f));
+    }
+    scene.updateWorldMatrices();
+    return stars;
+}
+
+string SyntheticSceneJson(int count)
+{
+    count = max(2, count);
+    string path = SyntheticDirectory() + "bench_scene_" + to_string(count) + ".json";
+    if (FileExists(path))
+        return path;
+
+    FILE *file = fopen(path.c_str(), "w");
+    if (!file)
+        return "";
+    fprintf(file, "{\n    \"bodies\": [\n");
+    fprintf(file, "        { \"name\": \"stars\", \"backdrop\": true, \"scale\": 10, \"mesh\": \"sphere.obj\",\n"
+                  "          \"material\": { \"texture\": \"celestialBodyTextures/stars.jpg\", \"features\": [\"UNLIT\"] } },\n");
+    fprintf(file, "        { \"name\": \"sun\", \"light\": true, \"mesh\": \"sphere.obj\",\n"
+                  "          \"material\": { \"texture\": \"celestialBodyTextures/sun.jpg\", \"features\": [\"EMISSIVE\"] } }");
+    int planet = -1;
+    for (int i = 2; i < count; i++) {
+        if ((i - 2) % 4 == 0) {
+            planet = i;
+            fprintf(file, ",\n        { \"name\": \"planet %d\", \"parent\": \"sun\",\n"
+                          "          \"orbit\": { \"semiMajorAxis\": %.3f, \"eccentricity\": 0.02, \"period\": %.3f, \"meanAnomalyAtEpoch\": %d },\n"
+                          "          \"scale\": 0.05, \"tilt\": 20, \"spin\": { \"period\": 3 }, \"mesh\": \"sphere.obj\",\n"
+                          "          \"material\": { \"texture\": \"celestialBodyTextures/earth.jpg\", \"features\": [\"LIT\", \"SPECULAR\"] } }",
+                    i, 2.0 + 0.01*i, 10.0 + 0.05*i, (i*37) % 360);
+        } else {
+            int moon = i - planet;
+            fprintf(file, ",\n        { \"name\": \"moon %d\", \"parent\": \"planet %d\", \"massRatio\": 0.01,\n"
+                          "          \"orbit\": { \"semiMajorAxis\": %.3f, \"eccentricity\": 0.05, \"inclination\": %d, \"period\": %d },\n"
+                          "          \"scale\": 0.01, \"mesh\": \"sphere.obj\",\n"
+                          "          \"material\": { \"texture\": \"celestialBodyTextures/moon.jpg\" } }",
+                    i, planet, 0.1 + 0.03*moon, 10*moon, moon);
+        }
+    }
+    fprintf(file, "\n    ]\n}\n");
+    bool failed = ferror(file) != 0;
+    fclose(file);
+    return failed ? "" : path;
+}
+
+string SyntheticSceneBinary(int count)
+{
+    string jsonPath = SyntheticSceneJson(count);
+    if (jsonPath.empty())
+        return "";
+    string path = jsonPath.substr(0, jsonPath.size() - 4) + "scnb";
+    // one left by a build with another format version is written again
+    SceneDescription scene;
+    if (FileExists(path) && scene.load(path))
+        return path;
+    if (!scene.load(jsonPath) || !scene.writeBinary(path))
+        return "";
+    return path;
+}
@@ -0,0 +1,47 @@
+//
+//  SyntheticData.h
+//  graphics_assig_5_06
+//
+//  Generated inputs for the microbenchmarks, so the hot paths can be
+//  measured at sizes well beyond the shipped sphere.obj and textures: UV
+//  sphere OBJ files in the same layout as sphere.obj, planet-like PNG
+//  images, scene graphs of stars, planets, moons and stations, and scene
+//  files of a sun with planets and moons.
+//
+
+#ifndef SyntheticData_h
+#define SyntheticData_h
+
+#include <string>
+
+#include "SceneGraph.h"
+
+using namespace std;
+
+// directory for generated files ($TMPDIR, or /tmp)
+string SyntheticDirectory();
+
+// Writes a UV sphere with the given number of segments around and
+// segments/2 rings, as v/vt/vn lines and triangular f lines, unless the
+// file already exists. Returns the path, or an empty string on failure.
+string SyntheticSphereObj(int segments);
+int SyntheticSphereTriangles(int segments);
+
+// width x width/2 RGB PNG with smooth bands and fine noise, which
+// compresses about as well as the planet textures; cached like the OBJ
+string SyntheticTexturePng(int width);
+
+// count nodes in roughly 1:10:30:59 proportion of stars, planets, moons
+// and stations, each parented to one of the level above. Returns the
+// number of root nodes, which are created first.
+int BuildSyntheticScene(SceneGraph &scene, int count);
+
+// a JSON scene file in the layout of scenes/solar_system.json: a backdrop,
+// a sun, and count - 2 planets and moons, three moons to a planet; cached
+// like the OBJ
+string SyntheticSceneJson(int count);
+
+// the same scene in the binary form, written with SceneDescription
+string SyntheticSceneBinary(int count);
+
+#endif /* SyntheticData_h */
@@ -18,6 +18,12 @@
 #include <algorithm>
 #include <string>
 #include <iterator>
+#include <map>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -28,6 +34,31 @@
 #include "texture.h"
 #include "Camera.h"
 #include "objectReader.h"
+#include "SceneGraph.h"
+#include "TransformSystem.h"
+#include "Ephemeris.h"
+#include "SimulationClock.h"
+#include "FramePipeline.h"
+#include "NBody.h"
+#include "HeadlessContext.h"
+#include "RenderTarget.h"
+#include "FrameCapture.h"
+#include "SoftwareRasterizer.h"
+#include "ImageCompare.h"
+#include "Profiler.h"
+#include "PerformanceHud.h"
+#include "InputRecording.h"
+#include "ShaderManager.h"
+#include "ShaderVariants.h"
+#include "FileWatcher.h"
+#include "SceneDescription.h"
+#include "ProceduralSphere.h"
+#include "TerrainTiles.h"
+#include "PlanetTerrain.h"
+#include "VirtualTexture.h"
+#include "SkyBox.h"
+#include "SceneRenderer.h"
+#include "ThreadPool.h"
 
 using namespace std;
 using namespace glm;
@@ -39,208 +70,678 @@ using namespace glm;
 void QueryGLVersion();
 bool CheckGLErrors();
 
-string LoadSource(const string &filename);
-GLuint CompileShader(GLenum shaderType, const string &source);
-GLuint LinkProgram(GLuint vertexShader, GLuint fragmentShader);
-
 bool lbPushed = false;
 
-ObjectReader sunObject;
-ObjectReader earthObject;
-ObjectReader moonObject;
-ObjectReader starsBackdropObject;
+// a mesh file as drawn; bodies using the same file share it, except that
+// backdrops get their own copy without normals
+struct MeshAsset
+{
+    string path;
+    bool lit = true;
+    Geometry geometry;
+    vector<vec3> vertices;
+    vector<vec2> textureCoords;
+    vector<vec3> normals;
+};
+
+// an image file, uploaded once however many bodies use it; the sky's is
+// uploaded as a cube map, apart from any other use of the same file
+struct TextureAsset
+{
+    string path;
+    bool cubemap = false;
+    MyTexture texture;
+    SoftwareTexture softwareTexture;
+};
 
-// --------------------------------------------------------------------------
-// Functions to set up OpenGL buffers for storing geometry data
+vector<MeshAsset> meshes;
+vector<TextureAsset> textures;
 
-struct Geometry
+// one per body of the scene file, in its order, which is also the draw order
+// and the order of the model matrices in a FrameSnapshot
+struct CelestialBodies
 {
-    // OpenGL names for array buffer objects, vertex array object
-    GLuint  vertexBuffer;
-    GLuint  textureBuffer;
-    GLuint  colourBuffer;
-    GLuint  normalBuffer;
+    string name;
+    string drawName;            // GPU timer label
+    bool backdrop = false;
     
-    GLuint  vertexArray;
-    GLsizei elementCount;
+    // a backdrop drawn by the sky pass, after everything else; its texture
+    // is then a cube map
+    bool sky = false;
     
-    // initialize object names to zero (OpenGL reserved value)
-    Geometry() : vertexBuffer(0), colourBuffer(0), vertexArray(0), elementCount(0)
-    {}
+    int mesh = -1;
+    int texture = -1;
+    int normalMap = -1;         // optional, sampled by SHADER_NORMAL_MAP variants on texture unit 1
+    
+    // drawn from its quadtree tiles instead of the mesh when they are
+    // there; the mesh and texture still serve the software path
+    int terrain = -1;           // in terrains
+    
+    // highest point of a streamed surface, scaled, which the camera may
+    // come down close to; 0 for the rest
+    float surfaceRadius = 0.f;
+    
+    // texture read a page at a time instead of whole when its pages are
+    // baked; texture is then -1
+    int virtualTexture = -1;    // in virtualTextures
+    
+    // The centre node carries the orbital position; satellites hang off it
+    // and the camera follows it. The body node below adds tilt, spin and
+    // scale, which satellites do not inherit.
+    int centreNode = -1;
+    int node = -1;
+    
+    int orbit = -1;             // ephemeris index, if the body orbits its parent
+    OrbitalElements elements;   // scaled by worldScale
+    int gravityIndex = -1;      // in physics mode; backdrops take no part
+    
+    quat tilt = quat(1.f, 0.f, 0.f, 0.f);
+    vec3 spinAxis = vec3(0.f, 1.f, 0.f);
+    double spinPeriod = 0.0;
+    
+    // cheapest shader variant that draws the body (ShaderVariants.h), its
+    // ShaderManager handle and the program once built; bodies that need the
+    // same variant share a program
+    unsigned shaderFeatures = SHADER_LIT | SHADER_SPECULAR;
+    int shaderRequest = -1;
+    GLuint program = 0;
 };
 
-struct CelestialBodies
+// --scene, or scenes/solar_system.json
+SceneDescription sceneDescription;
+vector<CelestialBodies> bodies;
+vector<int> drawNodes;
+
+// surfaces of the bodies with terrain; not used by the software path or
+// golden renders, which compare the meshes
+vector<PlanetTerrain> terrains;
+
+// the bodies' virtual textures, and the pass that finds the pages they
+// need; likewise GL only
+vector<VirtualTexture> virtualTextures;
+VirtualTextureFeedback virtualTextureFeedback;
+vector<uint16_t> feedbackTexels;
+
+// draws the backdrops' cube maps; the software path and golden renders
+// draw them as meshes
+SkyBox skyBox;
+
+SceneGraph scene;
+
+// orbits are evaluated in closed form at the simulation time
+Ephemeris ephemeris;
+
+// the light sits at the centre of this body, or the origin if none is marked
+int lightBody = -1;
+
+// owned by the simulation thread once it starts
+Camera cam;
+vec3 lightSource = vec3(0.f, 0.f, 0.f);
+
+// the camera orbits whichever body it is following (F key): any but backdrops
+vector<int> focusBodies;
+
+// multiplies the orbit sizes (--world-scale) to exercise realistic distances;
+// body sizes and the camera distance are unchanged
+double worldScale = 1.0;
+
+// GL thread -> simulation thread -> GL thread
+TripleBuffer<InputSnapshot> inputBuffer;
+TripleBuffer<FrameSnapshot> frameBuffer;
+atomic<bool> simulationRunning(false);
+
+// the simulation thread stays one frame ahead: it waits until the GL
+// thread has taken its last snapshot before producing the next
+mutex frameRequestMutex;
+condition_variable frameRequested;
+uint64_t framesConsumed = 0;
+
+// headless runs wait for each snapshot instead of redrawing the last one
+condition_variable frameAvailable;
+uint64_t framesPublished = 0;
+
+// when positive, every frame advances the simulation by this much instead of
+// by wall time, so offscreen renders are deterministic
+double fixedFrameSeconds = 0.0;
+
+// optional image sequence of every rendered frame (--capture)
+FrameCapture frameCapture;
+
+// GPU side of the --profile trace, used on the GL thread only
+GpuTimer gpuTimer;
+
+// performance overlay (H key, --hud); the counters it shows are in
+// SceneRenderer.h
+PerformanceHud hud;
+bool hudVisible = false;
+
+// written by scroll_callback on the GL thread
+double scrollTotal = 0.0;
+
+// --record writes the input and clock ticks the simulation consumes;
+// --replay feeds a recording back instead of live input. Both are used
+// on the simulation thread only, apart from inputReplay.finished().
+InputRecorder inputRecorder;
+InputReplay inputReplay;
+
+// compiles while assets load and caches linked programs between launches
+ShaderManager shaderManager;
+int hudShaders = -1;
+int feedbackShaders = -1;
+GLuint feedbackProgram = 0;     // 0 while no virtual texture streams
+int skyShaders = -1;
+
+// --watch reloads shaders, textures and meshes when they are saved; files
+// are decoded or parsed on the thread pool and handed to the GL thread here
+bool watchFiles = false;
+FileWatcher fileWatcher;
+
+struct ReloadedAsset
 {
-    Geometry geometry;
-    MyTexture myTexture;
+    string path;
+    chrono::steady_clock::time_point changed;
+    TextureImage image;             // a texture, its cube map if the sky uses it, or
+    CubemapImage cubemap;
+    vector<vec3> vertices;          // a mesh
     vector<vec2> textureCoords;
-    vector<vec3> vertices;
     vector<vec3> normals;
-    float scaleBy;
-    
-    CelestialBodies *orbitAround;
-    mat4 transformBy = mat4(1.f);
-    mat4 translateBy = mat4(1.f);
-    mat4 rotateBy = mat4(1.f);
 };
 
-CelestialBodies sun;
-CelestialBodies earth;
-CelestialBodies moon;
-CelestialBodies backdrop;
+mutex reloadedAssetsMutex;
+vector<ReloadedAsset> reloadedAssets;
 
-Camera cam;
-vec3 movement(0.f);
-vec3 lightSource = vec3(0.f, 0.f, 0.f);
-float scrollDir;
-bool pauseAnim = false;
+// swaps a freshly uploaded texture in for texture
+bool ReplaceTexture(MyTexture *texture, const MyTexture &replacement, bool uploaded)
+{
+    if (!uploaded) {
+        glDeleteTextures(1, &replacement.textureID);
+        return false;
+    }
+    renderCounters.textureBytes -= TextureMemoryBytes(texture->target, texture->textureID);
+    DestroyTexture(texture);
+    *texture = replacement;
+    renderCounters.textureBytes += TextureMemoryBytes(texture->target, texture->textureID);
+    return true;
+}
+
+// a freshly decoded image, for texture, which keeps its target
+bool ReplaceTexture(MyTexture *texture, const TextureImage &image)
+{
+    MyTexture replacement;
+    bool uploaded = UploadTexture(&replacement, image, texture->target);
+    return ReplaceTexture(texture, replacement, uploaded);
+}
+
+// and the sky's faces made from one
+bool ReplaceTexture(MyTexture *texture, const CubemapImage &cubemap)
+{
+    MyTexture replacement;
+    bool uploaded = UploadCubemap(&replacement, cubemap);
+    return ReplaceTexture(texture, replacement, uploaded);
+}
 
 // --------------------------------------------------------------------------
-// Functions to set up OpenGL shader programs for rendering
+// Rendering function that draws our scene to the frame buffer
 
-// load, compile, and link shaders, returning true if successful
-GLuint InitializeShaders()
+// chooses and draws the patches of a body's terrain for this view
+void RenderTerrain(PlanetTerrain &terrain, GLuint program, const FrameSnapshot &frame, mat4 perspectiveMatrix, mat4 transformVertice)
 {
-    // load shader source from files
-    string vertexSource = LoadSource("shaders/vertex.glsl");
-    string fragmentSource = LoadSource("shaders/fragment.glsl");
-    if (vertexSource.empty() || fragmentSource.empty()) return false;
+    PROFILE_SCOPE("RenderTerrain");
+    
+    // patches are picked in the unit sphere's space, where the eye is the
+    // origin of the camera-relative frame moved back through the model
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    vec3 eye = vec3(inverse(transformVertice)*vec4(0.f, 0.f, 0.f, 1.f));
+    terrain.update(perspectiveMatrix*frame.viewMatrix*transformVertice, eye, 0.5f*viewport[3]*perspectiveMatrix[1][1]);
     
-    // compile shader source into shader objects
-    GLuint vertex = CompileShader(GL_VERTEX_SHADER, vertexSource);
-    GLuint fragment = CompileShader(GL_FRAGMENT_SHADER, fragmentSource);
+    // the patches that arrived were uploaded there, binding as they went
+    ForgetBindings();
     
-    // link shader program
-    GLuint program = LinkProgram(vertex, fragment);
+    BindProgram(program);
+    SetSceneUniforms(program, frame, perspectiveMatrix, transformVertice);
+    int triangles = terrain.draw();
     
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
+    renderCounters.drawCalls += terrain.getStatistics().drawnPatches;
+    renderCounters.triangles += triangles;
     
-    // check for OpenGL errors and return false if error occurred
-    return program;
+    CheckGLErrors();
 }
 
-bool InitializeVAO(Geometry *geometry){
+// fills in the sky wherever no body was drawn
+void RenderSky(const MyTexture &cubemap, const FrameSnapshot &frame, mat4 perspectiveMatrix, mat4 transformVertice)
+{
+    PROFILE_SCOPE("RenderSky");
+    skyBox.render(cubemap, perspectiveMatrix*frame.viewMatrix*transformVertice);
     
-    const GLuint VERTEX_INDEX = 0;
-    const GLuint TEXTURE_INDEX = 1;
-    const GLuint NORMAL_INDEX = 2;
+    renderCounters.drawCalls++;
+    renderCounters.triangles++;
     
-    //Generate Vertex Buffer Objects
-    // create an array buffer object for storing our vertices
-    glGenBuffers(1, &geometry->vertexBuffer);
-    glGenBuffers(1, &geometry->textureBuffer);
-    glGenBuffers(1, &geometry->normalBuffer);
+    CheckGLErrors();
+}
+
+// Draws the bodies with virtual textures into the feedback target, hands
+// the latest readback to their textures and uploads the pages that have
+// arrived. Other bodies are left out, so pages behind them are still asked
+// for.
+void StreamVirtualTextures(const FrameSnapshot &frame, mat4 perspectiveMatrix)
+{
+    PROFILE_SCOPE("StreamVirtualTextures");
     
-    //Set up Vertex Array Object
-    // create a vertex array object encapsulating all our vertex attributes
-    glGenVertexArrays(1, &geometry->vertexArray);
-    glBindVertexArray(geometry->vertexArray);
+    gpuTimer.begin("VirtualTextureFeedback");
+    virtualTextureFeedback.begin();
+    BindProgram(feedbackProgram);
+    for (size_t i = 0; i < bodies.size(); i++) {
+        const CelestialBodies &body = bodies[i];
+        if (body.virtualTexture < 0)
+            continue;
+        const Geometry &geometry = meshes[body.mesh].geometry;
+        SetSceneUniforms(feedbackProgram, frame, perspectiveMatrix, frame.modelMatrices[i]);
+        virtualTextures[body.virtualTexture].setFeedbackUniforms(feedbackProgram, body.virtualTexture, virtualTextureFeedback.lodBias());
+        BindVertexArray(geometry.vertexArray);
+        glDrawArrays(GL_TRIANGLES, 0, geometry.elementCount);
+        renderCounters.drawCalls++;
+        renderCounters.triangles += geometry.elementCount/3;
+    }
+    virtualTextureFeedback.end();
+    gpuTimer.end();
     
-    // associate the position array with the vertex array object
-    glBindBuffer(GL_ARRAY_BUFFER, geometry->vertexBuffer);
-    glVertexAttribPointer(
-        VERTEX_INDEX,        //Attribute index
-        3,                     //# of components
-        GL_FLOAT,             //Type of component
-        GL_FALSE,             //Should be normalized?
-        sizeof(vec3),        //Stride - can use 0 if tightly packed
-        0);                    //Offset to first element
-    glEnableVertexAttribArray(VERTEX_INDEX);
+    bool arrived = virtualTextureFeedback.takeFeedback(feedbackTexels);
+    for (const CelestialBodies &body : bodies) {
+        if (body.virtualTexture < 0)
+            continue;
+        if (arrived)
+            virtualTextures[body.virtualTexture].requestPages(feedbackTexels, body.virtualTexture);
+        virtualTextures[body.virtualTexture].update();
+    }
+    // the pages were uploaded through binds of their own
+    ForgetBindings();
     
-    // texture buffer
-    glBindBuffer(GL_ARRAY_BUFFER, geometry->textureBuffer);
-    glVertexAttribPointer(
-        TEXTURE_INDEX,
-        2,
-        GL_FLOAT,
-        GL_FALSE,
-        sizeof(vec2),
-        0);
-    glEnableVertexAttribArray(TEXTURE_INDEX);
+    CheckGLErrors();
+}
+
+// The projection a snapshot is drawn with. It has no far plane, so bodies
+// are drawn however far --world-scale puts them; depth only reaches 1, where
+// the sky is, at infinity.
+mat4 ProjectionMatrix(const FrameSnapshot &frame, float aspectRatio)
+{
+    return infinitePerspective(PI_F*0.4f, aspectRatio, frame.nearPlane);
+}
+
+// clears the bound framebuffer and draws every body of one snapshot
+void RenderFrame(const FrameSnapshot &frame, float aspectRatio)
+{
+    PROFILE_SCOPE("RenderFrame");
+    mat4 perspectiveMatrix = ProjectionMatrix(frame, aspectRatio);
+    renderCounters.beginFrame();
+    // loading, uploads and the HUD bound their own objects since the last frame
+    ForgetBindings();
+    
+    // the pages this frame draws with are settled before it starts
+    if (feedbackProgram != 0 && frame.modelMatrices.size() == bodies.size())
+        StreamVirtualTextures(frame, perspectiveMatrix);
     
-    // normal buffer
-    glBindBuffer(GL_ARRAY_BUFFER, geometry->normalBuffer);
-    glVertexAttribPointer(
-                          NORMAL_INDEX,
-                          3,
-                          GL_FLOAT,
-                          GL_FALSE,
-                          sizeof(vec3),
-                          0);
-    glEnableVertexAttribArray(NORMAL_INDEX);
+    // clear screen to a dark grey colour
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     
-    // unbind our buffers, resetting to default state
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    // nothing to draw until the first snapshot arrives
+    if (frame.modelMatrices.size() != bodies.size())
+        return;
+    for (size_t i = 0; i < bodies.size(); i++) {
+        CelestialBodies &body = bodies[i];
+        if (body.sky)
+            continue;
+        MyTexture *normalMap = body.normalMap >= 0 ? &textures[body.normalMap].texture : nullptr;
+        gpuTimer.begin(body.drawName.c_str());
+        if (body.terrain >= 0)
+            RenderTerrain(terrains[body.terrain], body.program, frame, perspectiveMatrix, frame.modelMatrices[i]);
+        else if (body.virtualTexture >= 0) {
+            VirtualTexture &virtualTexture = virtualTextures[body.virtualTexture];
+            RenderScene(&meshes[body.mesh].geometry, virtualTexture.pagePool(), normalMap, &virtualTexture, body.program, frame,
+                        perspectiveMatrix, GL_TRIANGLES, frame.modelMatrices[i]);
+        } else
+            RenderScene(&meshes[body.mesh].geometry, &textures[body.texture].texture, normalMap, nullptr, body.program, frame,
+                        perspectiveMatrix, GL_TRIANGLES, frame.modelMatrices[i]);
+        gpuTimer.end();
+    }
     
-    return !CheckGLErrors();
+    // the sky last, so the depth test leaves out every pixel a body covers
+    for (size_t i = 0; i < bodies.size(); i++) {
+        if (!bodies[i].sky)
+            continue;
+        gpuTimer.begin(bodies[i].drawName.c_str());
+        RenderSky(textures[bodies[i].texture].texture, frame, perspectiveMatrix, frame.modelMatrices[i]);
+        gpuTimer.end();
+    }
+    ResetBindings();
+}
+
+// draws the performance overlay over the current viewport
+void RenderHud()
+{
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    gpuTimer.begin("PerformanceHud");
+    hud.render(viewport[2], viewport[3], renderCounters);
+    gpuTimer.end();
 }
 
-// create buffers and fill with geometry data, returning true if successful
-bool LoadGeometry(Geometry *geometry, vector<vec3> vertices, vector<vec2> textureCoords, vector<vec3> normals, int elementCount)
+// the same frame drawn on the CPU (--software)
+void RenderFrameSoftware(SoftwareRasterizer &rasterizer, const FrameSnapshot &frame, float aspectRatio)
 {
-    geometry->elementCount = elementCount;
+    PROFILE_SCOPE("RenderFrameSoftware");
+    mat4 perspectiveMatrix = ProjectionMatrix(frame, aspectRatio);
     
-    // create an array buffer object for storing our vertices
-    glBindBuffer(GL_ARRAY_BUFFER, geometry->vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vec3)*geometry->elementCount, &vertices[0], GL_STATIC_DRAW);
+    vector<SoftwareDrawCall> draws;
+    if (frame.modelMatrices.size() == bodies.size()) {
+        draws.resize(bodies.size());
+        for (size_t i = 0; i < bodies.size(); i++) {
+            const MeshAsset &mesh = meshes[bodies[i].mesh];
+            draws[i].vertices = &mesh.vertices;
+            draws[i].textureCoords = &mesh.textureCoords;
+            draws[i].normals = &mesh.normals;
+            draws[i].texture = &textures[bodies[i].texture].softwareTexture;
+            draws[i].model = frame.modelMatrices[i];
+        }
+    }
     
-    glBindBuffer(GL_ARRAY_BUFFER, geometry->textureBuffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vec2)*textureCoords.size(), &textureCoords[0], GL_STATIC_DRAW);
+    ShadingParameters shading;
+    shading.lightPosition = frame.lightPosition;
+    shading.cameraPosition = frame.cameraPosition;
+    rasterizer.render(draws, perspectiveMatrix*frame.viewMatrix, shading);
+}
+
+// --------------------------------------------------------------------------
+// Simulation update, run once per fixed step
+
+// tilt and spin of every body at simulation time t
+void SetSpins(double t, SimulationState &state)
+{
+    for (size_t i = 0; i < bodies.size(); i++) {
+        const CelestialBodies &body = bodies[i];
+        state.bodies[i].rotation = body.spinPeriod > 0.0 ? body.tilt*angleAxis(float(SpinAngle(body.spinPeriod, t)), body.spinAxis)
+                                                         : body.tilt;
+    }
+}
+
+// evaluates every animated transform at simulation time t; a body's
+// translation is its centre's, its rotation the body node's
+void StepSimulation(double t, SimulationState &state)
+{
+    PROFILE_SCOPE("StepSimulation");
+    state.time = t;
+    state.bodies.resize(bodies.size());
     
-    glBindBuffer(GL_ARRAY_BUFFER, geometry->normalBuffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vec3)*normals.size(), &normals[0], GL_STATIC_DRAW);
+    ephemeris.evaluate(t);
+    for (size_t i = 0; i < bodies.size(); i++)
+        state.bodies[i].translation = bodies[i].orbit >= 0 ? ephemeris.getPosition(bodies[i].orbit) : dvec3(0.0);
+    SetSpins(t, state);
+}
+
+// Starts the gravity bodies where the ephemeris has them at time t. A body's
+// mass is the scene's, or else follows from the orbit of its first
+// satellite by Kepler's third law (G = 1), or else is massRatio of its
+// parent's. The compressed default scene so makes the earth nearly as heavy
+// as the sun and both visibly circle their common centre of mass, which is
+// put at the origin.
+void SeedGravity(NBodySimulation &gravity, double t)
+{
+    const double fourPiSquared = 4.0*PI_F*PI_F;
+    const double h = 1e-3;
+    size_t count = bodies.size();
     
-    //Unbind buffer to reset to default state
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    vector<double> mass(count, 0.0);
+    vector<bool> derived(count, false);
+    for (size_t i = 0; i < count; i++)
+        mass[i] = sceneDescription.body(i).mass;
+    for (size_t i = 0; i < count; i++) {
+        int parent = sceneDescription.body(i).parent;
+        if (bodies[i].orbit < 0 || parent < 0 || mass[parent] > 0.0 || derived[parent])
+            continue;
+        const OrbitalElements &elements = bodies[i].elements;
+        mass[parent] = fourPiSquared*pow(elements.semiMajorAxis, 3.0)/(elements.period*elements.period);
+        derived[parent] = true;
+    }
     
-    // check for OpenGL errors and return false if error occurred
-    return !CheckGLErrors();
+    // parents come first, so theirs are known by the time a child needs them
+    vector<dvec3> position(count, dvec3(0.0)), velocity(count, dvec3(0.0));
+    dvec3 weightedPosition(0.0);
+    double totalMass = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        const SceneBody &description = sceneDescription.body(i);
+        int parent = description.parent;
+        if (mass[i] <= 0.0 && parent >= 0)
+            mass[i] = mass[parent]*description.massRatio;
+        if (parent >= 0) {
+            position[i] = position[parent];
+            velocity[i] = velocity[parent];
+        }
+        if (bodies[i].orbit >= 0) {
+            const OrbitalElements &elements = bodies[i].elements;
+            position[i] += OrbitPosition(elements, t);
+            velocity[i] += (OrbitPosition(elements, t + h) - OrbitPosition(elements, t - h))/(2.0*h);
+        }
+        if (bodies[i].gravityIndex >= 0) {
+            weightedPosition += position[i]*mass[i];
+            totalMass += mass[i];
+        }
+    }
+    dvec3 centreOfMass = totalMass > 0.0 ? weightedPosition/totalMass : dvec3(0.0);
+    
+    gravity.clear();
+    gravity.softening = 1e-3;
+    for (size_t i = 0; i < count; i++)
+        if (bodies[i].gravityIndex >= 0)
+            gravity.addBody(position[i] - centreOfMass, velocity[i], mass[i]);
+    gravity.removeNetMomentum();
+}
+
+// advances the gravity bodies by one fixed step; spins stay scripted
+void StepGravity(NBodySimulation &gravity, double dt, double t, SimulationState &state)
+{
+    PROFILE_SCOPE("StepGravity");
+    state.time = t;
+    state.bodies.resize(bodies.size());
+    
+    gravity.step(dt);
+    for (size_t i = 0; i < bodies.size(); i++) {
+        if (bodies[i].gravityIndex < 0)
+            continue;
+        // centres hang off their parent's
+        int parent = sceneDescription.body(i).parent;
+        dvec3 parentPosition = parent >= 0 && bodies[parent].gravityIndex >= 0 ? gravity.getPosition(bodies[parent].gravityIndex) : dvec3(0.0);
+        state.bodies[i].translation = gravity.getPosition(bodies[i].gravityIndex) - parentPosition;
+    }
+    SetSpins(t, state);
+}
+
+// copies an (interpolated) state onto the scene graph nodes it animates
+void ApplyStateToScene(const SimulationState &state)
+{
+    for (size_t i = 0; i < bodies.size(); i++) {
+        scene.setTranslation(bodies[i].centreNode, state.bodies[i].translation);
+        scene.setRotation(bodies[i].node, state.bodies[i].rotation);
+    }
 }
 
-// deallocate geometry-related objects
-void DestroyGeometry(Geometry *geometry)
+// fills in the camera and every model matrix of a snapshot from the current
+// scene graph, with the camera orbiting bodies[focusBody]
+void WriteFrameSnapshot(FrameSnapshot &frame, int focusBody)
 {
-    // unbind and destroy our vertex array object and associated buffers
-    glBindVertexArray(0);
-    glDeleteVertexArrays(1, &geometry->vertexArray);
-    glDeleteBuffers(1, &geometry->vertexBuffer);
+    PROFILE_SCOPE("WriteFrameSnapshot");
+    const CelestialBodies &focus = bodies[focusBody];
+    int focusNode = focus.centreNode;
+    
+    // Camera-relative rendering: the eye is the origin of everything sent
+    // to the GPU. World positions stay in double until the eye has been
+    // subtracted, so only small offsets are ever rounded to float.
+    dvec3 eye = scene.getWorldPosition(focusNode) + dvec3(cam.getPosition());
+    frame.viewMatrix = mat4(mat3(cam.viewMatrix()));
+    frame.cameraPosition = vec3(0.f);
+    // the light stays at its body's centre, which only moves in physics mode
+    dvec3 light = lightBody >= 0 ? scene.getWorldPosition(bodies[lightBody].centreNode) : dvec3(0.0);
+    frame.lightPosition = vec3(light + dvec3(lightSource) - eye);
+    frame.modelMatrices.resize(bodies.size());
+    scene.getRelativeMatrices(drawNodes.data(), int(drawNodes.size()), eye, frame.modelMatrices.data());
+    // backdrops surround the viewer wherever the camera is
+    for (size_t i = 0; i < bodies.size(); i++)
+        if (bodies[i].backdrop)
+            frame.modelMatrices[i][3] = vec4(0.f, 0.f, 0.f, 1.f);
+    
+    // Depth precision goes with the near plane, so it only comes in as the
+    // camera comes down to a surface, to half the height above it.
+    frame.nearPlane = 0.1f;
+    if (focus.surfaceRadius > 0.f)
+        frame.nearPlane = std::min(std::max(0.5f*(cam.radius - focus.surfaceRadius), 0.001f), 0.1f);
 }
 
 // --------------------------------------------------------------------------
-// Rendering function that draws our scene to the frame buffer
+// Simulation thread: input -> camera and animation -> FrameSnapshot
 
-void RenderScene(Geometry *geometry, MyTexture *texture, GLuint program, Camera* camera, mat4 perspectiveMatrix, GLenum rendermode, mat4 transformVertice)
+void SimulationThread(double simulationRate)
 {
-    // bind our shader program and the vertex array object containing our
-    // scene geometry, then tell OpenGL to draw our geometry
-    glUseProgram(program);
+    SetProfileThreadName("Simulation");
     
-    mat4 modelViewProjection = perspectiveMatrix*camera->viewMatrix();
-    GLint uniformLocation = glGetUniformLocation(program, "modelViewProjection");
-    glUniformMatrix4fv(uniformLocation, 1, false, glm::value_ptr(modelViewProjection));
+    const float cursorSensitivity = PI_F/200.f;    //PI/hundred pixels
+    const float movementSpeed = 0.01f;
     
-    unsigned int transformLoc = glGetUniformLocation(program, "transform");
-    glUniformMatrix4fv(transformLoc, 1, GL_FALSE, value_ptr(transformVertice));
+    // time warp: simulation seconds per real second
+    float speed = 1.f;
+    bool pauseAnim = false;
     
-    unsigned int lightPos = glGetUniformLocation(program, "lightPosition");
-    glUniform3f(lightPos, lightSource.x, lightSource.y, lightSource.z);
+    bool physicsMode = false;
+    NBodySimulation gravity;
     
-    unsigned int camPos = glGetUniformLocation(program, "cameraPosition");
-    glUniform3f(camPos, cam.getPosition().x, cam.getPosition().y, cam.getPosition().z);
+    size_t cameraFocus = 0;
     
-    glBindVertexArray(geometry->vertexArray);
-    glBindTexture(texture->target, texture->textureID);
-    glDrawArrays(rendermode, 0, geometry->elementCount);
+    // fixed-step simulation; each snapshot blends the last two states
+    SimulationClock simClock(1.0/simulationRate);
+    SimulationState previousState, currentState, renderState;
+    StepSimulation(simClock.time(), currentState);
+    previousState = currentState;
+    ApplyStateToScene(currentState);
     
-    // reset state to default (no shader or geometry bound)
-    glBindTexture(texture->target, 0);
-    glBindVertexArray(0);
-    glUseProgram(0);
+    InputSnapshot lastInput, replayedInput;
+    bool haveInput = false;
+    uint64_t frameIndex = 0;
+    chrono::steady_clock::time_point lastFrame = chrono::steady_clock::now();
     
-    // check for an report any OpenGL errors
-    CheckGLErrors();
+    while (simulationRunning)
+    {
+        // the wait for the GL thread at the end is left out of the scope
+        uint64_t profileStart = ProfilingEnabled() ? ProfileTimestamp() : 0;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        float frameSeconds = chrono::duration<float>(start - lastFrame).count();
+        lastFrame = start;
+        double tickSeconds = frameSeconds;
+        if (fixedFrameSeconds > 0.0)
+            tickSeconds = fixedFrameSeconds;
+        
+        // the first real input becomes the reference, so the cursor does
+        // not jump from the origin. A replay brings its own input and
+        // clock ticks; once it runs out, time stands still.
+        bool inputReference = false;
+        if (inputReplay.isOpen()) {
+            if (!inputReplay.nextFrame(replayedInput, inputReference, tickSeconds))
+                tickSeconds = 0.0;
+            if (inputReference)
+                lastInput = replayedInput;
+        } else if (inputBuffer.update() && !haveInput) {
+            lastInput = inputBuffer.readBuffer();
+            haveInput = true;
+            inputReference = true;
+        }
+        const InputSnapshot &input = inputReplay.isOpen() ? replayedInput : inputBuffer.readBuffer();
+        inputRecorder.recordInput(input, inputReference);
+        frameSeconds = float(tickSeconds);
+        
+        // zoom level, 10 units per scroll step
+        vec3 movement(0.f);
+        movement.z = 10.f*float(input.scrollTotal - lastInput.scrollTotal);
+        
+        // speed up and slow down, at 6x per second of holding the key
+        if (input.speedUp) {
+            speed = std::min(speed + 6.f*frameSeconds, 3.f);
+        }
+        if (input.slowDown) {
+            speed = std::max(speed - 6.f*frameSeconds, 1.f);
+        }
+        if (input.pause) {
+            pauseAnim = true;
+        }
+        if (input.resume) {
+            pauseAnim = false;
+        }
+        if (input.gravityMode && !lastInput.gravityMode) {
+            physicsMode = !physicsMode;
+            if (physicsMode)
+                SeedGravity(gravity, simClock.time());
+            cout << "Physics mode " << (physicsMode ? "on" : "off") << endl;
+        }
+        if (input.cycleFocus && !lastInput.cycleFocus) {
+            cameraFocus = (cameraFocus + 1) % focusBodies.size();
+            cout << "Camera following the " << bodies[focusBodies[cameraFocus]].name << endl;
+        }
+        
+        // moving camera
+        vec2 cursorChange = input.cursorPosition - lastInput.cursorPosition;
+        if (input.leftButtonDown) {
+            cam.rotateHorizontal(cursorChange.y*cursorSensitivity);
+            cam.rotateVertical(cursorChange.x*cursorSensitivity);
+        }
+        
+        // above a body with terrain or a virtual texture the camera may come
+        // down to just over its mountains, slowing as it nears them
+        const CelestialBodies &focus = bodies[focusBodies[cameraFocus]];
+        float zoomSpeed = 1.f;
+        cam.minRadius = 2.f;
+        if (focus.surfaceRadius > 0.f) {
+            cam.minRadius = focus.surfaceRadius + 0.02f;     // the near plane is 0.01 here
+            zoomSpeed = std::min(std::max((cam.radius - focus.surfaceRadius)/focus.surfaceRadius, 0.01f), 1.f);
+        }
+        // zooming every frame, even by nothing, also keeps the camera clear
+        // of a body it has just switched to
+        cam.zoom(movement*movementSpeed*zoomSpeed);
+        lastInput = input;
+        
+        simClock.setTimeWarp(speed);
+        simClock.setPaused(pauseAnim);
+        simClock.accumulate(tickSeconds);
+        while (simClock.consumeStep()) {
+            previousState = currentState;
+            if (physicsMode)
+                StepGravity(gravity, simClock.step(), simClock.time(), currentState);
+            else
+                StepSimulation(simClock.time(), currentState);
+        }
+        
+        if (!simClock.isPaused()) {
+            InterpolateStates(previousState, currentState, float(simClock.interpolationAlpha()), renderState);
+            ApplyStateToScene(renderState);
+        }
+        
+        // only subtrees touched above are recomputed
+        {
+            PROFILE_SCOPE("updateWorldMatrices");
+            scene.updateWorldMatrices();
+        }
+        
+        FrameSnapshot &frame = frameBuffer.writeBuffer();
+        frame.frameIndex = ++frameIndex;
+        frame.simulationTime = simClock.time();
+        WriteFrameSnapshot(frame, int(focusBodies[cameraFocus]));
+        inputRecorder.recordTick(tickSeconds, frame);
+        inputReplay.checkFrame(frame);
+        frame.simulationMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        frameBuffer.publish();
+        if (profileStart != 0)
+            RecordProfileEvent("Simulation frame", profileStart, ProfileTimestamp() - profileStart);
+        
+        unique_lock<mutex> lock(frameRequestMutex);
+        framesPublished = frameIndex;
+        frameAvailable.notify_one();
+        frameRequested.wait(lock, [frameIndex] { return !simulationRunning || framesConsumed >= frameIndex; });
+    }
 }
 
 // --------------------------------------------------------------------------
@@ -258,6 +759,8 @@ void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
 {
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
         glfwSetWindowShouldClose(window, GL_TRUE);
+    if (key == GLFW_KEY_H && action == GLFW_PRESS)
+        hudVisible = !hudVisible;
 }
 
 // glfw: whenever the mouse scroll wheel scrolls, this callback is called
@@ -265,244 +768,1140 @@ void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
     if (yoffset < 0) {
-        scrollDir = -1.f;
+        scrollTotal -= 1.0;
     } else {
-        scrollDir = 1.f;
+        scrollTotal += 1.0;
     }
 }
 
 
-// ==========================================================================
-// PROGRAM ENTRY POINT
+// --------------------------------------------------------------------------
+// Hot reloading
 
-int main(int argc, char *argv[])
+// called once a frame on the GL thread with --watch: changed shaders are
+// rebuilt beside the programs in use and swapped in once they link, and
+// changed textures and meshes are swapped in once the pool has read them
+void HotReload()
 {
-    // initialize the GLFW windowing system
-    if (!glfwInit()) {
-        cout << "ERROR: GLFW failed to initialize, TERMINATING" << endl;
-        return -1;
+    for (const string &path : fileWatcher.changedFiles()) {
+        if (shaderManager.reloadFile(path) > 0)
+            continue;
+        bool isMesh = false, isSky = false;
+        for (const MeshAsset &mesh : meshes)
+            isMesh = isMesh || mesh.path == path;
+        for (const TextureAsset &texture : textures)
+            isSky = isSky || (texture.cubemap && texture.path == path);
+        chrono::steady_clock::time_point changed = chrono::steady_clock::now();
+        DefaultThreadPool().submit([path, isMesh, isSky, changed]() {
+            ReloadedAsset asset;
+            asset.path = path;
+            asset.changed = changed;
+            if (isMesh) {
+                ObjectReader reader;
+                reader.findSphere(path.c_str());
+                reader.processData();
+                asset.vertices = reader.getVertices();
+                asset.textureCoords = reader.getUvs();
+                asset.normals = reader.getNormals();
+                if (asset.vertices.empty()) {
+                    cout << "Hot reload: " << path << " has no triangles, keeping the old mesh" << endl;
+                    return;
+                }
+            } else if (!DecodeTextureImage(&asset.image, path.c_str())) {
+                cout << "Hot reload: could not decode " << path << ", keeping the old texture" << endl;
+                return;
+            } else if (isSky)
+                ConvertToCubemap(asset.image, asset.cubemap);
+            lock_guard<mutex> lock(reloadedAssetsMutex);
+            reloadedAssets.push_back(asset);
+        });
     }
-    glfwSetErrorCallback(ErrorCallback);
     
-    // attempt to create a window with an OpenGL 4.1 core profile context
-    GLFWwindow *window = 0;
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    int width = 920, height = 680;
-    window = glfwCreateWindow(width, height, "CPSC 453 OpenGL Boilerplate", 0, 0);
-    if (!window) {
-        cout << "Program failed to create GLFW window, TERMINATING" << endl;
-        glfwTerminate();
-        return -1;
+    for (const ShaderManager::ProgramSwap &swap : shaderManager.collectReloads()) {
+        for (CelestialBodies &body : bodies)
+            if (body.shaderRequest == swap.handle)
+                body.program = swap.newProgram;
+        if (swap.handle == hudShaders)
+            hud.setProgram(swap.newProgram);
+        if (swap.handle == feedbackShaders)
+            feedbackProgram = swap.newProgram;
+        if (swap.handle == skyShaders)
+            skyBox.setProgram(swap.newProgram);
+        glDeleteProgram(swap.oldProgram);
     }
     
-    // set keyboard callback function and make our context current (active)
-    glfwSetKeyCallback(window, KeyCallback);
-    glfwMakeContextCurrent(window);
-    glfwSetScrollCallback(window, scroll_callback);
-    
-    //Intialize GLAD
-    if (!gladLoadGL())
+    vector<ReloadedAsset> ready;
     {
-        cout << "GLAD init failed" << endl;
-        return -1;
+        lock_guard<mutex> lock(reloadedAssetsMutex);
+        ready.swap(reloadedAssets);
+    }
+    for (ReloadedAsset &asset : ready) {
+        bool swapped = false;
+        for (TextureAsset &texture : textures) {
+            if (!asset.image.data || texture.path != asset.path)
+                continue;
+            if (texture.cubemap)
+                swapped = ReplaceTexture(&texture.texture, asset.cubemap) || swapped;
+            else
+                swapped = ReplaceTexture(&texture.texture, asset.image) || swapped;
+        }
+        for (MeshAsset &mesh : meshes) {
+            if (asset.vertices.empty() || mesh.path != asset.path)
+                continue;
+            renderCounters.bufferBytes -= sizeof(vec3)*mesh.vertices.size() + sizeof(vec2)*mesh.textureCoords.size()
+                                          + sizeof(vec3)*mesh.normals.size();
+            mesh.vertices = asset.vertices;
+            mesh.textureCoords = asset.textureCoords;
+            mesh.normals = mesh.lit ? asset.normals : vector<vec3>();
+            swapped = LoadGeometry(&mesh.geometry, mesh.vertices, mesh.textureCoords, mesh.normals, mesh.vertices.size()) || swapped;
+        }
+        FreeTextureImage(&asset.image);
+        if (swapped)
+            cout << "Hot reload: " << asset.path << " in "
+                 << chrono::duration<double, milli>(chrono::steady_clock::now() - asset.changed).count() << " ms" << endl;
     }
+}
+
+// --------------------------------------------------------------------------
+// Headless loop: no window or input, every snapshot is rendered offscreen
+
+// renders each snapshot as soon as the simulation thread publishes it, until
+// frameLimit frames (if positive) or simulation time timeLimit (if not
+// negative) is reached; with a rasterizer, frames are drawn on the CPU
+void RunHeadless(SoftwareRasterizer *rasterizer, float aspectRatio, int frameLimit, double timeLimit)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    chrono::steady_clock::time_point lastFrame = start;
+    double renderMilliseconds = 0.0;
+    int frames = 0;
+        
+    while (true)
+    {
+        {
+            unique_lock<mutex> lock(frameRequestMutex);
+            frameAvailable.wait(lock, [] { return framesPublished > framesConsumed; });
+        }
+        frameBuffer.update();
+        const FrameSnapshot &frame = frameBuffer.readBuffer();
+        {
+            lock_guard<mutex> lock(frameRequestMutex);
+            framesConsumed = frame.frameIndex;
+        }
+        frameRequested.notify_one();
+        
+        PROFILE_SCOPE("Frame");
+        chrono::steady_clock::time_point renderStart = chrono::steady_clock::now();
+        if (rasterizer) {
+            RenderFrameSoftware(*rasterizer, frame, aspectRatio);
+            frameCapture.captureImage(rasterizer->pixels());
+        } else {
+            if (watchFiles)
+                HotReload();
+            gpuTimer.beginFrame();
+            RenderFrame(frame, aspectRatio);
+            chrono::steady_clock::time_point now = chrono::steady_clock::now();
+            hud.addFrame(chrono::duration<double, milli>(now - lastFrame).count());
+            lastFrame = now;
+            if (hudVisible)
+                RenderHud();
+            frameCapture.captureFrame();
+            glFlush();
+        }
+        renderMilliseconds += chrono::duration<double, milli>(chrono::steady_clock::now() - renderStart).count();
+        frames++;
+        
+        if ((frameLimit > 0 && frames >= frameLimit) || (timeLimit >= 0.0 && frame.simulationTime >= timeLimit))
+            break;
+    }
+    if (!rasterizer)
+        glFinish();
+        
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << (rasterizer ? "Software: " : "Headless: ") << frames << " frames to simulation time " << frameBuffer.readBuffer().simulationTime
+         << " in " << seconds << " s (" << frames/seconds << " fps, render " << renderMilliseconds/frames << " ms/frame)" << endl;
+}
+
+// renders the first snapshot repeatedly on 1, 2, 4, ... threads and reports
+// how the software rasterizer scales
+int BenchmarkSoftwareRasterizer(float aspectRatio, int width, int height, int frames)
+{
+    {
+        unique_lock<mutex> lock(frameRequestMutex);
+        frameAvailable.wait(lock, [] { return framesPublished > 0; });
+    }
+    frameBuffer.update();
+    FrameSnapshot frame = frameBuffer.readBuffer();
     
-    // query and print out information about our OpenGL environment
-    QueryGLVersion();
+    int hardwareThreads = max(1, (int)thread::hardware_concurrency());
+    vector<int> threadCounts;
+    for (int threads = 1; threads < hardwareThreads; threads *= 2)
+        threadCounts.push_back(threads);
+    threadCounts.push_back(hardwareThreads);
     
-    // call function to load and compile shader programs
-    GLuint program = InitializeShaders();
+    cout << "Software rasterizer, " << width << "x" << height << ", " << frames << " frames per run" << endl;
+    double singleThreadMilliseconds = 0.0;
+    for (int threads : threadCounts) {
+        SoftwareRasterizer rasterizer(width, height, threads);
+        RenderFrameSoftware(rasterizer, frame, aspectRatio);     // warm-up
+        
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (int i = 0; i < frames; i++)
+            RenderFrameSoftware(rasterizer, frame, aspectRatio);
+        double milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count()/frames;
+        if (threads == 1)
+            singleThreadMilliseconds = milliseconds;
+        
+        cout << "  " << threads << " threads: " << milliseconds << " ms/frame (" << 1000.0/milliseconds << " fps), "
+             << "speedup " << singleThreadMilliseconds/milliseconds << "x, "
+             << rasterizer.triangleCountLastFrame() << " triangles set up" << endl;
+    }
+    return 0;
+}
+
+// --------------------------------------------------------------------------
+// Golden-image regression check: fixed scenes at fixed simulation times
+
+struct GoldenScene
+{
+    const char *name;
+    double time;
+    const char *focus;          // body name
+    float theta, phi, radius;   // camera orbit, as Camera keeps it
+    
+    // the focus drawn from its virtual texture's coarsest page (GL only)
+    bool virtualTexture;
+};
+
+const GoldenScene goldenScenes[] = {
+    { "overview",     0.0,  "sun",   -1.0f, 1.0f, 10.f, false },
+    { "sun_close",    1.5,  "sun",   -1.2f, 0.6f,  2.f, false },
+    { "earth_close",  3.0,  "earth", -1.0f, 1.0f,  3.f, false },
+    { "moon_close",   7.25, "moon",  -1.4f, 0.4f,  2.f, false },
+    { "moon_virtual", 7.25, "moon",  -1.4f, 0.4f,  2.f, true },
+};
+
+// Gives a body its virtual texture for one golden render, baking the pages
+// where --bake-virtual-textures puts them if they are not there yet. With
+// no feedback pass nothing streams, so the coarsest page is the only one
+// resident and the render is the same every run. The caller restores the
+// body and drops the texture and program afterwards.
+bool PinGoldenVirtualTexture(size_t index)
+{
+    CelestialBodies &body = bodies[index];
+    const SceneBody &description = sceneDescription.body(index);
+    if (description.virtualTexture == 0) {
+        cout << "VirtualTexture: the " << body.name << " has none" << endl;
+        return false;
+    }
+    string directory = sceneDescription.text(description.virtualTexture);
+    if (!ifstream(directory + "/pages.txt").good() && !BakeVirtualTexture(sceneDescription.text(description.texture), directory))
+        return false;
+    
+    virtualTextures.push_back(VirtualTexture());
+    if (!virtualTextures.back().initialize(directory)) {
+        virtualTextures.pop_back();
+        return false;
+    }
+    int request = shaderManager.request("shaders/vertex.glsl", "shaders/fragment.glsl",
+                                        ShaderFeatureDefines(body.shaderFeatures | SHADER_VIRTUAL_TEXTURE));
+    GLuint program = request >= 0 ? shaderManager.program(request) : 0;
     if (program == 0) {
-        cout << "Program could not initialize shaders, TERMINATING" << endl;
-        return -1;
+        virtualTextures.back().destroy();
+        virtualTextures.pop_back();
+        cout << "VirtualTexture: the " << body.name << "'s shader variant did not build" << endl;
+        return false;
     }
+    body.virtualTexture = int(virtualTextures.size()) - 1;
+    body.program = program;
+    return true;
+}
+
+// Renders every golden scene with the software rasterizer if given, or
+// else GL into the bound framebuffer, and compares it with
+// goldenDirectory/<name>.png. The render and a diff image are written to
+// outputDirectory as <name>_actual.png and <name>_diff.png. With update set
+// the renders replace the goldens instead. Returns non-zero on any failure.
+int RunGoldenTests(const string &goldenDirectory, const string &outputDirectory, bool update,
+                   SoftwareRasterizer *rasterizer, float aspectRatio, int width, int height)
+{
+    ImageTolerance tolerance;
+    int failures = 0;
+    int sceneCount = 0;
     
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LEQUAL);
-    //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    cout << "Golden images in " << goldenDirectory << "/, rendered with " << (rasterizer ? "the software rasterizer" : "OpenGL") << endl;
+    for (const GoldenScene &golden : goldenScenes) {
+        if (golden.virtualTexture && rasterizer) {
+            cout << "  " << golden.name << ": skipped, the software rasterizer has no virtual textures" << endl;
+            continue;
+        }
+        sceneCount++;
+        
+        // the goldens are of scenes/solar_system.json
+        int focusBody = -1;
+        for (size_t i = 0; i < bodies.size(); i++)
+            if (bodies[i].name == golden.focus)
+                focusBody = int(i);
+        if (focusBody < 0) {
+            cout << "  " << golden.name << ": FAILED, the scene has no body named " << golden.focus << endl;
+            failures++;
+            continue;
+        }
+        CelestialBodies unpinned = bodies[focusBody];
+        if (golden.virtualTexture && !PinGoldenVirtualTexture(focusBody)) {
+            cout << "  " << golden.name << ": FAILED, the " << golden.focus << " cannot be drawn from its virtual texture" << endl;
+            failures++;
+            continue;
+        }
+        
+        SimulationState state;
+        StepSimulation(golden.time, state);
+        ApplyStateToScene(state);
+        scene.updateWorldMatrices();
+        cam.theta = golden.theta;
+        cam.phi = golden.phi;
+        cam.radius = golden.radius;
+        cam.updateCamera();
+        
+        FrameSnapshot frame;
+        frame.simulationTime = golden.time;
+        WriteFrameSnapshot(frame, focusBody);
+        
+        RGBImage rendered;
+        rendered.width = width;
+        rendered.height = height;
+        rendered.pixels.resize((size_t)width*height*3);
+        vector<unsigned char> rgba((size_t)width*height*4);
+        if (rasterizer) {
+            RenderFrameSoftware(*rasterizer, frame, aspectRatio);
+            copy(rasterizer->pixels(), rasterizer->pixels() + rgba.size(), rgba.begin());
+        } else {
+            RenderFrame(frame, aspectRatio);
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+        }
+        if (golden.virtualTexture) {
+            glDeleteProgram(bodies[focusBody].program);
+            virtualTextures.back().destroy();
+            virtualTextures.pop_back();
+            bodies[focusBody] = unpinned;
+        }
+        for (int y = 0; y < height; y++) {
+            // GL rows come bottom-up
+            int sourceRow = rasterizer ? y : height - 1 - y;
+            for (int x = 0; x < width; x++)
+                for (int c = 0; c < 3; c++)
+                    rendered.pixels[((size_t)y*width + x)*3 + c] = rgba[((size_t)sourceRow*width + x)*4 + c];
+        }
+        
+        string goldenPath = goldenDirectory + "/" + golden.name + ".png";
+        if (update) {
+            bool written = WriteRGBImage(rendered, goldenPath);
+            cout << "  " << golden.name << ": " << (written ? "updated " : "could not write ") << goldenPath << endl;
+            failures += !written;
+            continue;
+        }
+        
+        RGBImage expected;
+        if (!LoadRGBImage(&expected, goldenPath)) {
+            cout << "  " << golden.name << ": FAILED, no golden image " << goldenPath << endl;
+            failures++;
+            continue;
+        }
+        RGBImage diff;
+        ImageComparison comparison = CompareImages(expected, rendered, tolerance, &diff);
+        WriteRGBImage(rendered, outputDirectory + "/" + golden.name + "_actual.png");
+        if (!comparison.sameSize) {
+            cout << "  " << golden.name << ": FAILED, golden is " << expected.width << "x" << expected.height
+                 << ", render is " << width << "x" << height << endl;
+            failures++;
+            continue;
+        }
+        WriteRGBImage(diff, outputDirectory + "/" + golden.name + "_diff.png");
+        
+        if (!comparison.passed)
+            failures++;
+        cout << "  " << golden.name << ": " << (comparison.passed ? "ok" : "FAILED")
+             << ", SSIM " << comparison.similarity << " (min " << tolerance.minSimilarity << ")"
+             << ", " << comparison.differentFraction*100.0 << "% pixels off by more than " << tolerance.channelThreshold
+             << " (max " << tolerance.maxDifferentFraction*100.0 << "%)"
+             << ", mean error " << comparison.meanError << ", max error " << comparison.maxError << endl;
+    }
     
-    starsBackdropObject.findSphere("sphere.obj");
-    starsBackdropObject.processData();
-    const char* starsTexturePath = "celestialBodyTextures/stars.jpg";
+    if (!update)
+        cout << sceneCount - failures << " of " << sceneCount << " golden images match";
+    if (!update && failures)
+        cout << "; renders and diffs are in " << outputDirectory << "/";
+    if (!update)
+        cout << endl;
+    return failures ? 1 : 0;
+}
+
+// --------------------------------------------------------------------------
+// Scene setup
+
+// the texture asset for an image file, or its cube map, added the first
+// time it is asked for
+int FindTextureAsset(const string &path, bool cubemap = false)
+{
+    for (size_t i = 0; i < textures.size(); i++)
+        if (textures[i].path == path && textures[i].cubemap == cubemap)
+            return int(i);
+    textures.push_back(TextureAsset());
+    textures.back().path = path;
+    textures.back().cubemap = cubemap;
+    textures.back().texture.target = cubemap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+    return int(textures.size()) - 1;
+}
+
+// Makes a body for every entry of the scene description, with its scene
+// graph nodes, orbit and shader variant, and lists the meshes and textures
+// the bodies use, each file once. Only normal maps and, if streaming is
+// allowed, terrain tiles and virtual texture pages are looked for on disk.
+// Backdrops are drawn by the sky pass when skyPass is set, and as meshes
+// otherwise: the software rasterizer has no cube maps.
+bool CreateSceneBodies(bool streamingAllowed, bool skyPass)
+{
+    size_t count = sceneDescription.bodyCount();
+    bodies.assign(count, CelestialBodies());
+    drawNodes.resize(count);
     
-    sunObject.findSphere("sphere.obj");
-    sunObject.processData();
-    const char* sunTexturePath = "celestialBodyTextures/sun.jpg";
+    map<pair<string, bool>, int> meshIndex;
+    map<string, bool> fileExists;
     
-    earthObject.findSphere("sphere.obj");
-    earthObject.processData();
-    const char* earthTexturePath = "celestialBodyTextures/earth.jpg";
+    for (size_t i = 0; i < count; i++) {
+        const SceneBody &description = sceneDescription.body(i);
+        CelestialBodies &body = bodies[i];
+        body.name = sceneDescription.text(description.name);
+        if (body.name.empty())
+            body.name = "body " + to_string(i);
+        body.backdrop = (description.flags & SCENE_BODY_BACKDROP) != 0;
+        body.sky = skyPass && body.backdrop;
+        body.drawName = (body.sky ? "RenderSky " : "RenderScene ") + body.name;
+        
+        // backdrops are drawn unlit and get no normals
+        pair<string, bool> meshKey(sceneDescription.text(description.mesh), !body.backdrop);
+        auto mesh = meshIndex.insert(make_pair(meshKey, int(meshes.size())));
+        if (mesh.second) {
+            meshes.push_back(MeshAsset());
+            meshes.back().path = meshKey.first;
+            meshes.back().lit = meshKey.second;
+        }
+        body.mesh = mesh.first->second;
+        
+        // terrain without tiles is drawn as the mesh until they are baked
+        if (streamingAllowed && description.terrainLevels > 0 && !body.backdrop) {
+            string directory = sceneDescription.text(description.terrainTiles);
+            if (ifstream(TerrainTilePath(directory, TerrainPatchKey(), "png")).good()) {
+                body.terrain = int(terrains.size());
+                body.surfaceRadius = description.scale*(1.f + description.heightScale);
+                terrains.push_back(PlanetTerrain());
+            } else
+                cout << "Terrain: no tiles in " << directory << ", drawing the " << body.name << " as a mesh (see --bake-terrain)" << endl;
+        }
+        
+        // a normal map that is not there is left out, with its shading; the
+        // terrain's tiles are not laid out like the mesh's texture coordinates
+        body.shaderFeatures = body.backdrop ? unsigned(SHADER_UNLIT) : description.shaderFeatures & ~SHADER_VIRTUAL_TEXTURE;
+        if (description.normalMap != 0 && !body.backdrop && body.terrain < 0) {
+            string path = sceneDescription.text(description.normalMap);
+            auto exists = fileExists.find(path);
+            if (exists == fileExists.end())
+                exists = fileExists.insert(make_pair(path, ifstream(path).good())).first;
+            if (exists->second) {
+                body.normalMap = FindTextureAsset(path);
+                body.shaderFeatures = NormalizeShaderFeatures(body.shaderFeatures | SHADER_NORMAL_MAP);
+            }
+        }
+        
+        // so is a virtual texture's, whose image is read whole until they
+        // are baked; terrain has its own
+        if (streamingAllowed && description.virtualTexture != 0 && !body.backdrop && body.terrain < 0) {
+            string directory = sceneDescription.text(description.virtualTexture);
+            if (ifstream(directory + "/pages.txt").good()) {
+                body.virtualTexture = int(virtualTextures.size());
+                body.surfaceRadius = description.scale;
+                body.shaderFeatures |= SHADER_VIRTUAL_TEXTURE;
+                virtualTextures.push_back(VirtualTexture());
+            } else
+                cout << "VirtualTexture: no pages in " << directory << ", reading the " << body.name
+                     << "'s texture whole (see --bake-virtual-textures)" << endl;
+        }
+        if (body.virtualTexture < 0)
+            body.texture = FindTextureAsset(sceneDescription.text(description.texture), body.sky);
+        
+        body.centreNode = scene.createNode(description.parent >= 0 ? bodies[description.parent].centreNode : -1);
+        body.node = scene.createNode(body.centreNode);
+        drawNodes[i] = body.node;
+        scene.setScale(body.node, vec3(description.scale));
+        if (description.flags & SCENE_BODY_ORBITS) {
+            body.elements = description.orbit;
+            body.elements.semiMajorAxis *= worldScale;
+            body.orbit = ephemeris.addBody(body.elements);
+        }
+        
+        vec3 axis(description.spinAxis[0], description.spinAxis[1], description.spinAxis[2]);
+        body.tilt = angleAxis(description.tilt, vec3(1, 0, 0));
+        body.spinAxis = length(axis) > 0.f ? normalize(axis) : vec3(0.f, 1.f, 0.f);
+        body.spinPeriod = description.spinPeriod;
+        scene.setRotation(body.node, body.tilt);
+        
+        if (!body.backdrop) {
+            body.gravityIndex = int(focusBodies.size());
+            focusBodies.push_back(int(i));
+        }
+        if ((description.flags & SCENE_BODY_LIGHT) && lightBody < 0)
+            lightBody = int(i);
+    }
     
-    moonObject.findSphere("sphere.obj");
-    moonObject.processData();
-    const char* moonTexturePath = "celestialBodyTextures/moon.jpg";
+    if (focusBodies.empty()) {
+        cout << "Scene: there are no bodies to show besides backdrops" << endl;
+        return false;
+    }
+    return true;
+}
+
+// --bake-terrain: cuts the tiles of every body with terrain from its texture
+// and height map
+bool BakeSceneTerrain()
+{
+    int baked = 0, failed = 0;
+    for (size_t i = 0; i < sceneDescription.bodyCount(); i++) {
+        const SceneBody &description = sceneDescription.body(i);
+        if (description.terrainLevels == 0)
+            continue;
+        if (BakeTerrainTiles(sceneDescription.text(description.texture), sceneDescription.text(description.heightMap),
+                             sceneDescription.text(description.terrainTiles), description.terrainLevels))
+            baked++;
+        else
+            failed++;
+    }
+    if (baked + failed == 0)
+        cout << "Terrain: no body of the scene has terrain to bake" << endl;
+    return baked > 0 && failed == 0;
+}
+
+// --bake-virtual-textures: cuts the pages of every body with a virtual
+// texture from its texture
+bool BakeSceneVirtualTextures()
+{
+    int baked = 0, failed = 0;
+    for (size_t i = 0; i < sceneDescription.bodyCount(); i++) {
+        const SceneBody &description = sceneDescription.body(i);
+        if (description.virtualTexture == 0)
+            continue;
+        if (BakeVirtualTexture(sceneDescription.text(description.texture), sceneDescription.text(description.virtualTexture)))
+            baked++;
+        else
+            failed++;
+    }
+    if (baked + failed == 0)
+        cout << "VirtualTexture: no body of the scene has a virtual texture to bake" << endl;
+    return baked > 0 && failed == 0;
+}
+
+// Reads every mesh and texture file the bodies use on the thread pool, then
+// uploads them from this thread unless drawing in software. Meshes named
+// like "icosphere:4" are generated instead of read, and the sky's cube maps
+// are made from their images on the pool as well.
+void LoadSceneAssets(bool software)
+{
+    PROFILE_SCOPE("LoadSceneAssets");
     
-    vector<vec3> tmp;
-    tmp.push_back(vec3(0,0,0));
-    backdrop.vertices = starsBackdropObject.getVertices();
-    backdrop.textureCoords = starsBackdropObject.getUvs();
-    backdrop.normals = tmp;
+    // a mesh file is parsed once even when backdrops need a copy of it;
+    // generated meshes are made for each copy, which is as quick
+    vector<string> meshFiles;
+    vector<int> meshFile(meshes.size());
+    for (size_t i = 0; i < meshes.size(); i++) {
+        meshFile[i] = int(find(meshFiles.begin(), meshFiles.end(), meshes[i].path) - meshFiles.begin());
+        if (meshFile[i] == int(meshFiles.size()))
+            meshFiles.push_back(meshes[i].path);
+    }
     
-    sun.vertices = sunObject.getVertices();
-    sun.textureCoords = sunObject.getUvs();
-    sun.normals = sunObject.getNormals();
+    int meshJobs = int(meshFiles.size());
+    vector<ObjectReader> readers(meshJobs);
+    vector<TextureImage> images(textures.size());
+    vector<CubemapImage> cubemaps(textures.size());
+    ParallelFor(0, meshJobs + int(textures.size()), 1, [&](int begin, int end) {
+        for (int job = begin; job < end; job++) {
+            if (job < meshJobs && IsProceduralSphere(meshFiles[job])) {
+                SphereParameters sphere;
+                if (!ParseProceduralSphere(meshFiles[job], sphere))
+                    continue;
+                for (size_t i = 0; i < meshes.size(); i++) {
+                    if (meshFile[i] == job)
+                        GenerateSphere(sphere, meshes[i].vertices, meshes[i].textureCoords, meshes[i].lit ? &meshes[i].normals : nullptr);
+                }
+                continue;
+            }
+            if (job < meshJobs) {
+                readers[job].findSphere(meshFiles[job].c_str());
+                readers[job].processData();
+                continue;
+            }
+            TextureAsset &texture = textures[job - meshJobs];
+            TextureImage &image = images[job - meshJobs];
+            if (software)
+                LoadSoftwareTexture(&texture.softwareTexture, texture.path.c_str());
+            else if (!DecodeTextureImage(&image, texture.path.c_str()))
+                cout << "Could not load texture " << texture.path << endl;
+            else if (texture.cubemap) {
+                ConvertToCubemap(image, cubemaps[job - meshJobs]);
+                FreeTextureImage(&image);
+            }
+        }
+    });
     
-    earth.vertices = earthObject.getVertices();
-    earth.textureCoords = earthObject.getUvs();
-    earth.normals = earthObject.getNormals();
+    for (size_t i = 0; i < meshes.size(); i++) {
+        MeshAsset &mesh = meshes[i];
+        if (!IsProceduralSphere(mesh.path)) {
+            ObjectReader &reader = readers[meshFile[i]];
+            mesh.vertices = reader.getVertices();
+            mesh.textureCoords = reader.getUvs();
+            if (mesh.lit)
+                mesh.normals = reader.getNormals();
+        }
+        if (mesh.vertices.empty())
+            cout << "Scene: " << mesh.path << " has no triangles" << endl;
+    }
+    if (software)
+        return;
     
-    moon.vertices = moonObject.getVertices();
-    moon.textureCoords = moonObject.getUvs();
-    moon.normals = moonObject.getNormals();
+    for (MeshAsset &mesh : meshes) {
+        if (!InitializeVAO(&mesh.geometry))
+            cout << "Program failed to intialize geometry!" << endl;
+        if (!mesh.vertices.empty() && !LoadGeometry(&mesh.geometry, mesh.vertices, mesh.textureCoords, mesh.normals, mesh.vertices.size()))
+            cout << "Failed to load geometry" << endl;
+    }
+    for (size_t i = 0; i < textures.size(); i++) {
+        bool uploaded;
+        if (images[i].data)
+            uploaded = UploadTexture(&textures[i].texture, images[i]);
+        else if (cubemaps[i].size > 0)
+            uploaded = UploadCubemap(&textures[i].texture, cubemaps[i]);
+        else
+            continue;
+        if (!uploaded)
+            cout << "Program failed to initialize texture!" << endl;
+        FreeTextureImage(&images[i]);
+        renderCounters.textureBytes += TextureMemoryBytes(textures[i].texture.target, textures[i].texture.textureID);
+    }
+}
 
-    mat4 perspectiveMatrix = perspective(PI_F*0.4f, float(width)/float(height), 0.1f, 20.f);    //Fill in with Perspective Matrix
+// ==========================================================================
+// PROGRAM ENTRY POINT
+
+int main(int argc, char *argv[])
+{
+    // simulation and render rates are tuned independently
+    double simulationRate = 60.0;
+    bool vsync = true;
     
-    Geometry geometry;
+    // offscreen mode for machines without a display
+    bool headless = false;
+    int frameLimit = 0;
+    double timeLimit = -1.0;
     
-    if (!InitializeVAO(&backdrop.geometry))
-    cout << "Program failed to intialize geometry!" << endl;
-    if (!LoadGeometry(&backdrop.geometry, backdrop.vertices, backdrop.textureCoords, backdrop.normals, backdrop.vertices.size()))
-    cout << "Failed to load geometry" << endl;
-    if (!InitializeTexture(&backdrop.myTexture, starsTexturePath)) {
-        cout << "Program failed to initialize texture!" << endl;
-    }
-    backdrop.transformBy = scale(backdrop.transformBy, vec3(10.f, 10.f, 10.f));
-    
-    // call function to create and fill buffers with geometry data
-    if (!InitializeVAO(&sun.geometry))
-        cout << "Program failed to intialize geometry!" << endl;
-    if (!LoadGeometry(&sun.geometry, sun.vertices, sun.textureCoords, sun.normals, sun.vertices.size()))
-        cout << "Failed to load geometry" << endl;
-    if (!InitializeTexture(&sun.myTexture, sunTexturePath)) {
-        cout << "Program failed to initialize texture!" << endl;
-    }
-    sun.transformBy = rotate(sun.transformBy, radians(180.f), vec3(1, 0, 0));
-    
-    if (!InitializeVAO(&earth.geometry))
-        cout << "Program failed to intialize geometry!" << endl;
-    if (!LoadGeometry(&earth.geometry, earth.vertices, earth.textureCoords, earth.normals, earth.vertices.size()))
-        cout << "Failed to load geometry" << endl;
-    if (!InitializeTexture(&earth.myTexture, earthTexturePath)) {
-        cout << "Program failed to initialize texture!" << endl;
-    }
-    earth.transformBy = rotate(earth.transformBy, radians(23.5f), vec3(1, 0, 0));
-    earth.transformBy = translate(earth.transformBy, vec3(3, 0, 0));
-    earth.transformBy = scale(earth.transformBy, vec3(0.5f, 0.5f, 0.5f));
-    
-    if (!InitializeVAO(&moon.geometry))
-        cout << "Program failed to intialize geometry!" << endl;
-    if (!LoadGeometry(&moon.geometry, moon.vertices, moon.textureCoords, moon.normals, moon.vertices.size()))
-        cout << "Failed to load geometry" << endl;
-    if (!InitializeTexture(&moon.myTexture, moonTexturePath)) {
-        cout << "Program failed to initialize texture!" << endl;
-    }
-    moon.transformBy = rotate(moon.transformBy, radians(23.5f), vec3(1, 0, 0));
-    moon.transformBy = translate(moon.transformBy, vec3(3.2, 0, 0));
-    moon.transformBy = scale(moon.transformBy, vec3(0.5f, 0.5f, 0.5f));
-    
-    vec2 lastCursorPos;
-    float scrollSpeed = 2.f;
-    
-    float cursorSensitivity = PI_F/200.f;    //PI/hundred pixels
-    float movementSpeed = 0.01f;
-    
-    mat4 modelMatrix = mat4(1.f);
-    vec3 translateVal = vec3(1, 0, 0);
-    
-    float angle = 0.f;
-    float speed = 1.f;
+    // CPU rendering, no GL at all
+    bool software = false;
+    int softwareThreads = 0;
+    int benchmarkFrames = 0;
     
-    // run an event-triggered main loop
-    while (!glfwWindowShouldClose(window))
-    {
-        movement = vec3(0.f);
-        
-        // zoom level
-        if (scrollDir < 0) {
-            movement.z -= 10.f;
-        } else if (scrollDir > 0) {
-            movement.z += 10.f;
+    // golden-image regression check
+    string goldenDirectory;
+    string goldenOutputDirectory;
+    bool goldenUpdate = false;
+    
+    // image sequence output
+    string captureDirectory;
+    CaptureFormat captureFormat = CAPTURE_PNG;
+    
+    // Chrome trace of CPU scopes and GPU timers
+    string profilePath;
+    
+    // deterministic input for repeatable runs
+    string recordPath;
+    string replayPath;
+    
+    // linked programs are kept here between launches; empty turns it off
+    string shaderCacheDirectory = "shader_cache";
+    
+    // the bodies to show, and optionally where to write them in binary
+    string scenePath = "scenes/solar_system.json";
+    string writeScenePath;
+    
+    // cut terrain tiles or virtual texture pages from the scene's images
+    // and exit
+    bool bakeTerrain = false;
+    bool bakeVirtualTextures = false;
+    
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        // benchmark modes run without opening a window
+        if (arg == "--bench-transforms")
+            return BenchmarkTransformSystem();
+        else if (arg == "--bench-nbody") {
+            int bodies = (i + 1 < argc) ? atoi(argv[i + 1]) : 100000;
+            int steps = (i + 2 < argc) ? atoi(argv[i + 2]) : 10;
+            return BenchmarkNBody(max(bodies, 2), max(steps, 1));
         }
-        scrollDir = 0;
-        
-        // speed up and slow down
-        if(glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
-            if (speed > 3.f) {
-                speed = 3.f;
-            } else {
-                speed += 0.1f;
-            }
+        else if (arg == "--check-direct-sum") {
+            int bodies = (i + 1 < argc) ? atoi(argv[i + 1]) : 8192;
+            return CheckDirectSum(max(bodies, 2));
         }
-        if(glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
-            if (speed < 1.f) {
-                speed = 1.f;
-            } else {
-                speed -= 0.1f;
-            }
+        else if (arg == "--bench-shading") {
+            int fragments = (i + 1 < argc) ? atoi(argv[i + 1]) : 1 << 20;
+            return BenchmarkShading(max(fragments, 1));
         }
-        if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS) {
-            pauseAnim = true;
+        else if (arg == "--sim-hz" && i + 1 < argc)
+            simulationRate = max(1.0, atof(argv[++i]));
+        else if (arg == "--no-vsync")
+            vsync = false;
+        else if (arg == "--world-scale" && i + 1 < argc)
+            worldScale = max(1e-3, atof(argv[++i]));
+        else if (arg == "--headless")
+            headless = true;
+        else if (arg == "--software")
+            software = true;
+        else if (arg == "--software-threads" && i + 1 < argc)
+            softwareThreads = max(1, atoi(argv[++i]));
+        else if (arg == "--bench-software") {
+            software = true;
+            benchmarkFrames = (i + 1 < argc && atoi(argv[i + 1]) > 0) ? atoi(argv[++i]) : 20;
         }
-        if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS) {
-            pauseAnim = false;
+        else if (arg == "--frames" && i + 1 < argc)
+            frameLimit = max(1, atoi(argv[++i]));
+        else if (arg == "--time" && i + 1 < argc)
+            timeLimit = max(0.0, atof(argv[++i]));
+        else if (arg == "--golden" && i + 1 < argc)
+            goldenDirectory = argv[++i];
+        else if (arg == "--golden-output" && i + 1 < argc)
+            goldenOutputDirectory = argv[++i];
+        else if (arg == "--golden-update")
+            goldenUpdate = true;
+        else if (arg == "--capture" && i + 1 < argc)
+            captureDirectory = argv[++i];
+        else if (arg == "--capture-format" && i + 1 < argc)
+            captureFormat = (string(argv[++i]) == "ppm") ? CAPTURE_PPM : CAPTURE_PNG;
+        else if (arg == "--profile" && i + 1 < argc)
+            profilePath = argv[++i];
+        else if (arg == "--hud")
+            hudVisible = true;
+        else if (arg == "--record" && i + 1 < argc)
+            recordPath = argv[++i];
+        else if (arg == "--replay" && i + 1 < argc)
+            replayPath = argv[++i];
+        else if (arg == "--shader-cache" && i + 1 < argc)
+            shaderCacheDirectory = argv[++i];
+        else if (arg == "--no-shader-cache")
+            shaderCacheDirectory.clear();
+        else if (arg == "--watch")
+            watchFiles = true;
+        else if (arg == "--scene" && i + 1 < argc)
+            scenePath = argv[++i];
+        else if (arg == "--write-scene" && i + 1 < argc)
+            writeScenePath = argv[++i];
+        else if (arg == "--bake-terrain")
+            bakeTerrain = true;
+        else if (arg == "--bake-virtual-textures")
+            bakeVirtualTextures = true;
+    }
+    
+    // a replay runs at the rate and scale it was recorded with and, offscreen,
+    // for as many frames as it holds unless told otherwise
+    if (!replayPath.empty()) {
+        if (!inputReplay.open(replayPath))
+            return -1;
+        simulationRate = inputReplay.simulationRate();
+        worldScale = inputReplay.worldScale();
+        if (frameLimit == 0 && timeLimit < 0.0)
+            frameLimit = int(inputReplay.frameCount());
+    }
+    
+    if (!profilePath.empty()) {
+        EnableProfiling(true);
+        SetProfileThreadName("Main");
+    }
+    
+    // golden renders never need a window
+    if (!goldenDirectory.empty() && !software)
+        headless = true;
+    if (goldenOutputDirectory.empty())
+        goldenOutputDirectory = goldenDirectory;
+    
+    // a scene that does not load fails before any window opens
+    chrono::steady_clock::time_point sceneStart = chrono::steady_clock::now();
+    if (!sceneDescription.load(scenePath))
+        return -1;
+    if (!writeScenePath.empty())
+        return sceneDescription.writeBinary(writeScenePath) ? 0 : -1;
+    if (bakeTerrain || bakeVirtualTextures) {
+        bool baked = !bakeTerrain || BakeSceneTerrain();
+        baked = (!bakeVirtualTextures || BakeSceneVirtualTextures()) && baked;
+        return baked ? 0 : -1;
+    }
+    chrono::steady_clock::time_point sceneLoaded = chrono::steady_clock::now();
+    if (!CreateSceneBodies(!software && goldenDirectory.empty(), !software))
+        return -1;
+    double parseMilliseconds = chrono::duration<double, milli>(sceneLoaded - sceneStart).count();
+    double setupMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - sceneLoaded).count();
+    
+    int width = 920, height = 680;
+    GLFWwindow *window = 0;
+    HeadlessContext headlessContext;
+    RenderTarget offscreenTarget;
+    
+    if (software) {
+        // same frame pacing as headless GL
+        fixedFrameSeconds = 1.0/simulationRate;
+        if (frameLimit == 0 && timeLimit < 0.0)
+            frameLimit = 1;
+    } else if (headless) {
+        // no window system: a bare context that renders into an FBO
+        if (!headlessContext.create(width, height)) {
+            cout << "Program failed to create a headless " << HeadlessContext::backendName() << " context, TERMINATING" << endl;
+            return -1;
+        }
+        if (!gladLoadGLLoader(HeadlessContext::procLoader())) {
+            cout << "GLAD init failed" << endl;
+            return -1;
+        }
+        if (!InitializeRenderTarget(&offscreenTarget, width, height)) {
+            cout << "Program failed to create the offscreen framebuffer, TERMINATING" << endl;
+            return -1;
         }
         
-        // moving camera
-        double xpos, ypos;
-        glfwGetCursorPos(window, &xpos, &ypos);
-        vec2 cursorPos (xpos, ypos);
-        vec2 cursorChange = cursorPos - lastCursorPos;
+        // one simulation step per frame, however long rendering takes
+        fixedFrameSeconds = 1.0/simulationRate;
+        if (frameLimit == 0 && timeLimit < 0.0)
+            frameLimit = 1;
+    } else {
+        // initialize the GLFW windowing system
+        if (!glfwInit()) {
+            cout << "ERROR: GLFW failed to initialize, TERMINATING" << endl;
+            return -1;
+        }
+        glfwSetErrorCallback(ErrorCallback);
         
-        if(glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS){
-            cam.rotateHorizontal(cursorChange.y*cursorSensitivity);
-            cam.rotateVertical(cursorChange.x*cursorSensitivity);
+        // attempt to create a window with an OpenGL 4.1 core profile context
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        window = glfwCreateWindow(width, height, "CPSC 453 OpenGL Boilerplate", 0, 0);
+        if (!window) {
+            cout << "Program failed to create GLFW window, TERMINATING" << endl;
+            glfwTerminate();
+            return -1;
         }
         
-        lastCursorPos = cursorPos;
-        cam.zoom(movement*movementSpeed);
-
-        // draw scene
+        // set keyboard callback function and make our context current (active)
+        glfwSetKeyCallback(window, KeyCallback);
+        glfwMakeContextCurrent(window);
+        glfwSwapInterval(vsync ? 1 : 0);
+        glfwSetScrollCallback(window, scroll_callback);
         
-        // clear screen to a dark grey colour
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        //Intialize GLAD
+        if (!gladLoadGL())
+        {
+            cout << "GLAD init failed" << endl;
+            return -1;
+        }
+    }
+    
+    if (!software) {
+        // query and print out information about our OpenGL environment
+        QueryGLVersion();
         
-        RenderScene(&backdrop.geometry, &backdrop.myTexture, program, &cam, perspectiveMatrix, GL_TRIANGLES, backdrop.transformBy);
+        // each virtual texture reads its coarsest page here and the rest as
+        // they are seen; a body whose pages cannot be read has its texture
+        // loaded with the others instead
+        bool streamingPages = false;
+        for (size_t i = 0; i < bodies.size(); i++) {
+            CelestialBodies &body = bodies[i];
+            if (body.virtualTexture < 0)
+                continue;
+            const SceneBody &description = sceneDescription.body(i);
+            string directory = sceneDescription.text(description.virtualTexture);
+            VirtualTexture &virtualTexture = virtualTextures[body.virtualTexture];
+            if (virtualTexture.initialize(directory)) {
+                cout << "VirtualTexture: the " << body.name << " streams its texture from " << directory << endl;
+                renderCounters.textureBytes += virtualTexture.memoryBytes();
+                streamingPages = true;
+            } else {
+                body.virtualTexture = -1;
+                body.texture = FindTextureAsset(sceneDescription.text(description.texture));
+                body.shaderFeatures &= ~SHADER_VIRTUAL_TEXTURE;
+            }
+        }
         
-        if (!pauseAnim) {
-            sun.transformBy = rotate(sun.transformBy, radians(.5f)*speed, vec3(0, -1, 0));
+        // start every shader variant building; they are collected once the
+        // assets have loaded, and bodies asking for the same one share it
+        shaderManager.initialize(window ? (GLADloadproc)glfwGetProcAddress : HeadlessContext::procLoader(), shaderCacheDirectory);
+        map<unsigned, int> variants;
+        bool drawingSky = false;
+        for (CelestialBodies &body : bodies) {
+            drawingSky = drawingSky || body.sky;
+            if (body.sky)
+                continue;
+            auto variant = variants.find(body.shaderFeatures);
+            if (variant == variants.end()) {
+                int request = shaderManager.request("shaders/vertex.glsl", "shaders/fragment.glsl", ShaderFeatureDefines(body.shaderFeatures));
+                variant = variants.insert(make_pair(body.shaderFeatures, request)).first;
+            }
+            body.shaderRequest = variant->second;
         }
+        hudShaders = shaderManager.request("shaders/hud_vertex.glsl", "shaders/hud_fragment.glsl");
+        if (streamingPages)
+            feedbackShaders = shaderManager.request("shaders/vertex.glsl", "shaders/vt_feedback.glsl", ShaderFeatureDefines(SHADER_UNLIT));
+        if (drawingSky)
+            skyShaders = shaderManager.request("shaders/sky_vertex.glsl", "shaders/sky_fragment.glsl");
         
-        RenderScene(&sun.geometry, &sun.myTexture, program, &cam, perspectiveMatrix, GL_TRIANGLES, sun.transformBy);
-         
-        earth.translateBy = translate(earth.transformBy, vec3(0, 0, 1.f));
-        earth.rotateBy = rotate(earth.transformBy, radians(2.f), vec3(0, 1, 0));
-        modelMatrix = sun.transformBy * earth.translateBy * earth.rotateBy;
-        RenderScene(&earth.geometry, &earth.myTexture, program, &cam, perspectiveMatrix, GL_TRIANGLES, modelMatrix);
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_LEQUAL);
+    }
+    
+    if (!captureDirectory.empty()) {
+        // the window's framebuffer can be larger than its size in points
+        int captureWidth = width, captureHeight = height;
+        if (window)
+            glfwGetFramebufferSize(window, &captureWidth, &captureHeight);
+        frameCapture.initialize(captureWidth, captureHeight, captureDirectory, captureFormat);
+    }
+    //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    
+    uint64_t loadStart = ProfilingEnabled() ? ProfileTimestamp() : 0;
+    
+    float aspectRatio = float(width)/float(height);
+    
+    chrono::steady_clock::time_point assetStart = chrono::steady_clock::now();
+    LoadSceneAssets(software);
+    cout << "Scene: " << bodies.size() << " bodies from " << scenePath << ", read in " << parseMilliseconds << " ms and set up in "
+         << setupMilliseconds << " ms; " << meshes.size() << " meshes and " << textures.size() << " textures loaded in "
+         << chrono::duration<double, milli>(chrono::steady_clock::now() - assetStart).count() << " ms" << endl;
+    if (loadStart != 0)
+        RecordProfileEvent("Load assets", loadStart, ProfileTimestamp() - loadStart);
+    
+    if (!software) {
+        for (CelestialBodies &body : bodies) {
+            if (body.sky)
+                continue;
+            body.program = shaderManager.program(body.shaderRequest);
+            if (body.program == 0) {
+                cout << "Program could not initialize shaders, TERMINATING" << endl;
+                return -1;
+            }
+        }
+        if (skyShaders >= 0 && !skyBox.initialize(shaderManager.program(skyShaders))) {
+            cout << "Program could not initialize the sky pass, TERMINATING" << endl;
+            return -1;
+        }
+        if (!hud.initialize(shaderManager.program(hudShaders)))
+            cout << "Program failed to initialize the performance overlay" << endl;
         
-        moon.translateBy = translate(moon.transformBy, vec3(0, 0, 1.f));
-        moon.rotateBy = rotate(moon.transformBy, radians(2.5f), vec3(0, 1, 0));
-        modelMatrix = (sun.transformBy * earth.translateBy * earth.rotateBy) *
-                    sun.transformBy * earth.transformBy * moon.rotateBy * moon.translateBy;
-        RenderScene(&moon.geometry, &moon.myTexture, program, &cam, perspectiveMatrix, GL_TRIANGLES, modelMatrix);
+        // without the feedback pass virtual textures stay at their coarsest
+        if (feedbackShaders >= 0) {
+            GLint viewport[4];
+            glGetIntegerv(GL_VIEWPORT, viewport);
+            feedbackProgram = shaderManager.program(feedbackShaders);
+            if (feedbackProgram == 0 || !virtualTextureFeedback.initialize(viewport[2], viewport[3])) {
+                cout << "VirtualTexture: no feedback pass, so only the coarsest pages are drawn" << endl;
+                feedbackProgram = 0;
+            }
+        }
+        shaderManager.report();
+        
+        // the six faces of each terrain load here, the rest as they are seen
+        for (size_t i = 0; i < bodies.size(); i++) {
+            CelestialBodies &body = bodies[i];
+            if (body.terrain < 0)
+                continue;
+            const SceneBody &description = sceneDescription.body(i);
+            string directory = sceneDescription.text(description.terrainTiles);
+            if (terrains[body.terrain].initialize(directory, description.terrainLevels, description.heightScale))
+                cout << "Terrain: the " << body.name << " streams " << description.terrainLevels << " levels from " << directory << endl;
+            else
+                body.terrain = -1;
+        }
+    }
+    
+    // golden renders must not change under them, and the software path
+    // reads its textures once
+    if (watchFiles && !software && goldenDirectory.empty()) {
+        set<string> watched = { "shaders/vertex.glsl", "shaders/fragment.glsl",
+                                "shaders/hud_vertex.glsl", "shaders/hud_fragment.glsl" };
+        if (feedbackShaders >= 0)
+            watched.insert("shaders/vt_feedback.glsl");
+        if (skyShaders >= 0) {
+            watched.insert("shaders/sky_vertex.glsl");
+            watched.insert("shaders/sky_fragment.glsl");
+        }
+        for (const MeshAsset &mesh : meshes) {
+            if (!IsProceduralSphere(mesh.path))
+                watched.insert(mesh.path);
+        }
+        for (const TextureAsset &texture : textures)
+            watched.insert(texture.path);
+        int watching = 0;
+        for (const string &path : watched)
+            watching += fileWatcher.watch(path);
+        cout << "Watching " << watching << " files for changes (" << fileWatcher.backendName() << ")" << endl;
+    } else
+        watchFiles = false;
+    
+    // simulation runs on its own thread from here on; this thread only
+    // samples input and submits GL work. Golden renders set the scene up
+    // themselves and run without it.
+    thread simulationThread;
+    if (goldenDirectory.empty()) {
+        if (!recordPath.empty())
+            inputRecorder.open(recordPath, simulationRate, worldScale);
+        simulationRunning = true;
+        simulationThread = thread(SimulationThread, simulationRate);
+    }
+    
+    int exitCode = 0;
+    if (!goldenDirectory.empty()) {
+        SoftwareRasterizer *rasterizer = software ? new SoftwareRasterizer(width, height, softwareThreads) : nullptr;
+        exitCode = RunGoldenTests(goldenDirectory, goldenOutputDirectory, goldenUpdate, rasterizer, aspectRatio, width, height);
+        delete rasterizer;
+    } else if (benchmarkFrames > 0)
+        exitCode = BenchmarkSoftwareRasterizer(aspectRatio, width, height, benchmarkFrames);
+    else if (software) {
+        SoftwareRasterizer rasterizer(width, height, softwareThreads);
+        cout << "Software rasterizer on " << rasterizer.threadCount() << " threads" << endl;
+        RunHeadless(&rasterizer, aspectRatio, frameLimit, timeLimit);
+    } else if (headless)
+        RunHeadless(nullptr, aspectRatio, frameLimit, timeLimit);
+    else {
+        FrameMetrics metrics;
+        double lastFrameTime = glfwGetTime();
         
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        // run an event-triggered main loop
+        while (!glfwWindowShouldClose(window))
+        {
+            double now = glfwGetTime();
+            double frameSeconds = now - lastFrameTime;
+            lastFrameTime = now;
+            
+            // hand the current input state to the simulation thread
+            InputSnapshot &input = inputBuffer.writeBuffer();
+            double xpos, ypos;
+            glfwGetCursorPos(window, &xpos, &ypos);
+            input.cursorPosition = vec2(xpos, ypos);
+            input.leftButtonDown = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+            input.speedUp = glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS;
+            input.slowDown = glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS;
+            input.pause = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+            input.resume = glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS;
+            input.gravityMode = glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS;
+            input.cycleFocus = glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS;
+            input.scrollTotal = scrollTotal;
+            inputBuffer.publish();
+            
+            // take the newest snapshot and let the simulation start the next
+            bool fresh = frameBuffer.update();
+            const FrameSnapshot &frame = frameBuffer.readBuffer();
+            if (fresh) {
+                {
+                    lock_guard<mutex> lock(frameRequestMutex);
+                    framesConsumed = frame.frameIndex;
+                }
+                frameRequested.notify_one();
+            }
+            
+            // draw scene
+            PROFILE_SCOPE("Frame");
+            if (watchFiles)
+                HotReload();
+            gpuTimer.beginFrame();
+            double renderStart = glfwGetTime();
+            RenderFrame(frame, aspectRatio);
+            hud.addFrame(frameSeconds*1000.0);
+            if (hudVisible)
+                RenderHud();
+            frameCapture.captureFrame();
+            
+            metrics.addFrame(frameSeconds, frame.simulationMilliseconds, (glfwGetTime() - renderStart)*1000.0, fresh);
+            
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+            if (inputReplay.finished())
+                glfwSetWindowShouldClose(window, GL_TRUE);
+        }
+    }
+    
+    {
+        lock_guard<mutex> lock(frameRequestMutex);
+        simulationRunning = false;
+    }
+    frameRequested.notify_one();
+    if (simulationThread.joinable())
+        simulationThread.join();
+    inputRecorder.close();
+    inputReplay.report();
+    
+    if (!profilePath.empty()) {
+        if (!software) {
+            gpuTimer.finish();
+            if (gpuTimer.framesDropped() > 0)
+                cout << "Profile: GPU timings of " << gpuTimer.framesDropped() << " frames were not ready in time and were dropped" << endl;
+        }
+        EnableProfiling(false);
+        WriteChromeTrace(profilePath);
+    }
+    
+    for (const CelestialBodies &body : bodies) {
+        if (body.terrain < 0)
+            continue;
+        const PlanetTerrain::Statistics &statistics = terrains[body.terrain].getStatistics();
+        cout << "Terrain: the " << body.name << " loaded " << statistics.patchesLoaded << " patches and evicted "
+             << statistics.patchesEvicted << "; " << statistics.residentPatches << " resident at exit" << endl;
     }
+    for (const CelestialBodies &body : bodies) {
+        if (body.virtualTexture < 0)
+            continue;
+        const VirtualTexture::Statistics &statistics = virtualTextures[body.virtualTexture].getStatistics();
+        cout << "VirtualTexture: the " << body.name << " loaded " << statistics.pagesLoaded << " pages and evicted "
+             << statistics.pagesEvicted << "; " << statistics.residentPages << " resident at exit" << endl;
+    }
+    if (virtualTextureFeedback.skippedReadbacks() > 0)
+        cout << "VirtualTexture: " << virtualTextureFeedback.skippedReadbacks() << " feedback readbacks were not ready in time and were skipped" << endl;
     
     // clean up allocated resources before exit
-    DestroyGeometry(&sun.geometry);
-    DestroyGeometry(&earth.geometry);
-    DestroyGeometry(&moon.geometry);
-    glUseProgram(0);
-    glDeleteProgram(program);
-    glfwDestroyWindow(window);
-    glfwTerminate();
+    frameCapture.destroy();
+    if (!software) {
+        for (PlanetTerrain &terrain : terrains)
+            terrain.destroy();
+        for (const CelestialBodies &body : bodies)
+            if (body.virtualTexture >= 0)
+                virtualTextures[body.virtualTexture].destroy();
+        virtualTextureFeedback.destroy();
+        for (MeshAsset &mesh : meshes)
+            DestroyGeometry(&mesh.geometry);
+        for (TextureAsset &texture : textures)
+            DestroyTexture(&texture.texture);
+        gpuTimer.destroy();
+        hud.destroy();
+        skyBox.destroy();
+        glUseProgram(0);
+        // bodies share programs; each is deleted once
+        set<GLuint> programs;
+        for (const CelestialBodies &body : bodies)
+            programs.insert(body.program);
+        programs.insert(feedbackProgram);
+        for (GLuint program : programs)
+            glDeleteProgram(program);
+        if (headless) {
+            DestroyRenderTarget(&offscreenTarget);
+            headlessContext.destroy();
+        } else {
+            glfwDestroyWindow(window);
+            glfwTerminate();
+        }
+    }
     
     cout << "Goodbye!" << endl;
-    return 0;
+    return exitCode;
 }
 
 // ==========================================================================
@@ -547,84 +1946,3 @@ bool CheckGLErrors()
     }
     return error;
 }
-
-// --------------------------------------------------------------------------
-// OpenGL shader support functions
-
-// reads a text file with the given name into a string
-string LoadSource(const string &filename)
-{
-    string source;
-    
-    ifstream input(filename.c_str());
-    if (input) {
-        copy(istreambuf_iterator<char>(input),
-             istreambuf_iterator<char>(),
-             back_inserter(source));
-        input.close();
-    }
-    else {
-        cout << "ERROR: Could not load shader source from file "
-        << filename << endl;
-    }
-    
-    return source;
-}
-
-// creates and returns a shader object compiled from the given source
-GLuint CompileShader(GLenum shaderType, const string &source)
-{
-    // allocate shader object name
-    GLuint shaderObject = glCreateShader(shaderType);
-    
-    // try compiling the source as a shader of the given type
-    const GLchar *source_ptr = source.c_str();
-    glShaderSource(shaderObject, 1, &source_ptr, 0);
-    glCompileShader(shaderObject);
-    
-    // retrieve compile status
-    GLint status;
-    glGetShaderiv(shaderObject, GL_COMPILE_STATUS, &status);
-    if (status == GL_FALSE)
-    {
-        GLint length;
-        glGetShaderiv(shaderObject, GL_INFO_LOG_LENGTH, &length);
-        string info(length, ' ');
-        glGetShaderInfoLog(shaderObject, info.length(), &length, &info[0]);
-        cout << "ERROR compiling shader:" << endl << endl;
-        cout << source << endl;
-        cout << info << endl;
-    }
-    
-    return shaderObject;
-}
-
-// creates and returns a program object linked from vertex and fragment shaders
-GLuint LinkProgram(GLuint vertexShader, GLuint fragmentShader)
-{
-    // allocate program object name
-    GLuint programObject = glCreateProgram();
-    
-    // attach provided shader objects to this program
-    if (vertexShader)   glAttachShader(programObject, vertexShader);
-    if (fragmentShader) glAttachShader(programObject, fragmentShader);
-    
-    // try linking the program with given attachments
-    glLinkProgram(programObject);
-    
-    // retrieve link status
-    GLint status;
-    glGetProgramiv(programObject, GL_LINK_STATUS, &status);
-    if (status == GL_FALSE)
-    {
-        GLint length;
-        glGetProgramiv(programObject, GL_INFO_LOG_LENGTH, &length);
-        string info(length, ' ');
-        glGetProgramInfoLog(programObject, info.length(), &length, &info[0]);
-        cout << "ERROR linking shader program:" << endl;
-        cout << info << endl;
-    }
-    
-    return programObject;
-}
-
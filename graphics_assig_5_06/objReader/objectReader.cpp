@@ -21,6 +21,7 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include "objectReader.h"
+#include "Profiler.h"
 
 using namespace std;
 using namespace glm;
@@ -30,6 +31,7 @@ ObjectReader :: ObjectReader()
 
 void ObjectReader :: findSphere(const char *filename)
 {
+    PROFILE_SCOPE("ObjectReader::findSphere");
     ifstream f (filename);
     char buffer [BUFF_SIZE];
     
@@ -69,6 +71,7 @@ void ObjectReader :: findSphere(const char *filename)
 
 void ObjectReader :: processData()
 {
+    PROFILE_SCOPE("ObjectReader::processData");
     for (int i = 0; i < vertexIndices.size(); i++) {
         int vertexIndex = vertexIndices[i];
         vec3 vertex = tmpVerticies[vertexIndex - 1];
@@ -6,39 +6,130 @@
 // ==========================================================================
 #version 410
 
+// ShaderManager adds the variant's #defines here (see ShaderVariants.h):
+//   LIT         diffuse light from lightPosition
+//   SPECULAR    the highlight as well
+//   NORMAL_MAP  normals perturbed by normalMap
+//   EMISSIVE    the sun, lit from its own centre
+// and UNLIT, for surfaces with no normals such as the stars backdrop, plus
+// any of them with VIRTUAL_TEXTURE, the colour read through a page table.
+
 in vec2 TextureCoords;
 
 // interpolated colour received from vertex stage
 uniform vec3 Colour;
 uniform sampler2D textureImage_one;
 
+#if defined(LIT) || defined(EMISSIVE)
 // for shading
 uniform vec3 lightPosition;
 uniform vec3 cameraPosition;
 
 in vec3 Normals;
 in vec3 FragmentPosition;
+#endif
+
+#ifdef NORMAL_MAP
+uniform sampler2D normalMap;
+
+// tangent frame from screen-space derivatives, so the mesh needs no
+// tangent attribute
+vec3 PerturbNormal(vec3 normal, vec3 position, vec2 uv)
+{
+    vec3 dp1 = dFdx(position);
+    vec3 dp2 = dFdy(position);
+    vec2 duv1 = dFdx(uv);
+    vec2 duv2 = dFdy(uv);
+    
+    vec3 dp2perp = cross(dp2, normal);
+    vec3 dp1perp = cross(normal, dp1);
+    vec3 tangent = dp2perp * duv1.x + dp1perp * duv2.x;
+    vec3 bitangent = dp2perp * duv1.y + dp1perp * duv2.y;
+    float scale = inversesqrt(max(dot(tangent, tangent), dot(bitangent, bitangent)));
+    
+    vec3 mapped = texture(normalMap, uv).xyz * 2.0 - 1.0;
+    return normalize(mat3(tangent * scale, bitangent * scale, normal) * mapped);
+}
+#endif
+
+#ifdef VIRTUAL_TEXTURE
+// textureImage_one is the pool of resident pages (VirtualTexture.h), and
+// pageTable has a texel per page of every level: the pool slot and level of
+// the page to read in its place
+#define PAGE_TEXELS 128.0
+#define PAGE_BORDER 1.0
+
+uniform sampler2D pageTable;
+uniform vec2 virtualPages;      // the image's size in level 0 pages
+uniform vec2 pageTableScale;
+uniform float virtualLevels;
+uniform float poolTexels;
+
+vec3 SampleVirtualTexture(vec2 uv)
+{
+    // the nearest level to what texture() would choose, as
+    // vt_feedback.glsl asks for it
+    vec2 texels = uv * virtualPages * PAGE_TEXELS;
+    vec2 dx = dFdx(texels);
+    vec2 dy = dFdy(texels);
+    float level = clamp(floor(0.5 * log2(max(dot(dx, dx), dot(dy, dy))) + 0.5), 0.0, virtualLevels - 1.0);
+    
+    vec3 entry = floor(textureLod(pageTable, uv * pageTableScale, level).xyz * 255.0 + 0.5);
+    vec2 inPage = fract(uv * virtualPages * exp2(-entry.z));
+    vec2 texel = entry.xy * (PAGE_TEXELS + 2.0 * PAGE_BORDER) + PAGE_BORDER + inPage * PAGE_TEXELS;
+    return textureLod(textureImage_one, texel / poolTexels, 0.0).rgb;
+}
+#endif
 
 // first output is mapped to the framebuffer's colour index by default
 out vec4 FragmentColour;
 
 void main(void)
 {
+#ifdef VIRTUAL_TEXTURE
+    vec3 colour = SampleVirtualTexture(TextureCoords);
+#else
     vec3 colour = texture(textureImage_one, TextureCoords).rgb;
+#endif
     
     vec3 ambient = 1 * colour;
     
+#if defined(LIT)
     vec3 lightDirection = normalize(lightPosition - FragmentPosition);
     vec3 normal = normalize(Normals);
+#ifdef NORMAL_MAP
+    normal = PerturbNormal(normal, FragmentPosition, TextureCoords);
+#endif
     float difference = max(dot(lightDirection, normal), 0.5);
     vec3 diffuse = difference * colour;
     
+#ifdef SPECULAR
     vec3 viewDirection = normalize(cameraPosition - FragmentPosition);
     vec3 reflectionDirection = reflect(lightDirection, normal);
     
     float spec = pow(max(dot(viewDirection, reflectionDirection), 0.0), 8.0);
     
     vec3 specular = vec3(1.) * spec;
+#else
+    vec3 specular = vec3(0.);
+#endif
+#elif defined(EMISSIVE)
+    // lit from inside, the light is behind every point of the surface, so
+    // the diffuse term never leaves its floor; the highlight remains
+    vec3 diffuse = 0.5 * colour;
+    
+    vec3 lightDirection = normalize(lightPosition - FragmentPosition);
+    vec3 viewDirection = normalize(cameraPosition - FragmentPosition);
+    vec3 reflectionDirection = reflect(lightDirection, normalize(Normals));
+    
+    float spec = pow(max(dot(viewDirection, reflectionDirection), 0.0), 8.0);
+    
+    vec3 specular = vec3(1.) * spec;
+#else
+    // what the lit shader gives at its diffuse floor, with no highlight
+    vec3 diffuse = 0.5 * colour;
+    vec3 specular = vec3(0.);
+#endif
     
     FragmentColour = vec4((ambient + diffuse + specular) * colour, 1.0);
     
@@ -0,0 +1,20 @@
+// ==========================================================================
+// Fragment program for the performance overlay
+//
+// The font atlas holds coverage in its red channel; rectangles sample a
+// solid cell of it.
+// ==========================================================================
+#version 410
+
+in vec2 TextureCoords;
+in vec4 Colour;
+
+uniform sampler2D fontAtlas;
+
+out vec4 FragmentColour;
+
+void main(void)
+{
+    float coverage = texture(fontAtlas, TextureCoords).r;
+    FragmentColour = vec4(Colour.rgb, Colour.a*coverage);
+}
@@ -0,0 +1,23 @@
+// ==========================================================================
+// Vertex program for the performance overlay
+//
+// Positions arrive in pixels from the top left of the framebuffer.
+// ==========================================================================
+#version 410
+
+layout(location = 0) in vec2 VertexPosition;
+layout(location = 1) in vec2 TexturePosition;
+layout(location = 2) in vec4 VertexColour;
+
+uniform vec2 screenSize;
+
+out vec2 TextureCoords;
+out vec4 Colour;
+
+void main()
+{
+    vec2 ndc = VertexPosition/screenSize*2.0 - 1.0;
+    gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+    TextureCoords = TexturePosition;
+    Colour = VertexColour;
+}
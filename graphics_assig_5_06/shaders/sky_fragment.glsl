@@ -0,0 +1,19 @@
+// ==========================================================================
+// Fragment program for the sky pass
+//
+// Matches the UNLIT variant of fragment.glsl, which drew the backdrop as a
+// sphere before: the colour at the lit shader's diffuse floor.
+// ==========================================================================
+#version 410
+
+in vec3 Direction;
+
+uniform samplerCube sky;
+
+out vec4 FragmentColour;
+
+void main(void)
+{
+    vec3 colour = texture(sky, Direction).rgb;
+    FragmentColour = vec4(1.5 * colour * colour, 1.0);
+}
@@ -0,0 +1,23 @@
+// ==========================================================================
+// Vertex program for the sky pass
+//
+// One triangle that covers the screen, at the far plane so the depth test
+// keeps only the pixels no body was drawn on. Each corner carries the
+// direction from the eye through it in the backdrop's space.
+// ==========================================================================
+#version 410
+
+uniform mat4 skyFromClip;
+
+out vec3 Direction;
+
+void main()
+{
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2)*2.0 - 1.0;
+    gl_Position = vec4(corner, 1.0, 1.0);
+    
+    // a point on the far plane; its w is positive and the cube map lookup
+    // ignores length, so xyz alone is the direction, and it stays linear
+    // across the screen
+    Direction = (skyFromClip*vec4(corner, 1.0, 1.0)).xyz;
+}
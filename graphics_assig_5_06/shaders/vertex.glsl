@@ -6,6 +6,9 @@
 // ==========================================================================
 #version 410
 
+// ShaderManager adds the variant's #defines (see ShaderVariants.h) here;
+// unlit variants have no use for normals or positions
+
 // location indices for these attributes correspond to those specified in the
 // InitializeGeometry() function of the main program
 layout(location = 0) in vec3 VertexPosition;
@@ -16,15 +19,20 @@ uniform mat4 modelViewProjection;
 uniform mat4 transform;
 
 out vec2 TextureCoords;
+#if defined(LIT) || defined(EMISSIVE)
 out vec3 Normals;
 out vec3 FragmentPosition;
+#endif
 
 void main()
 {
     // assign vertex position without modification
     gl_Position = modelViewProjection * transform * vec4(VertexPosition, 1.0);
     
+    // lighting happens in the camera-relative frame the uniforms are given in
     TextureCoords = TexturePosition;
-    Normals = NormalPosition;
-    FragmentPosition = VertexPosition;
+#if defined(LIT) || defined(EMISSIVE)
+    Normals = mat3(transform) * NormalPosition;
+    FragmentPosition = vec3(transform * vec4(VertexPosition, 1.0));
+#endif
 }
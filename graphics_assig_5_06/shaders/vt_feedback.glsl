@@ -0,0 +1,29 @@
+// ==========================================================================
+// Feedback program for virtual textures (see VirtualTexture.h), drawn with
+// the UNLIT variant of vertex.glsl into an integer target
+// ==========================================================================
+#version 410
+
+#define PAGE_TEXELS 128.0      // VIRTUAL_PAGE_TEXELS
+
+in vec2 TextureCoords;
+
+uniform vec2 virtualPages;      // the image's size in level 0 pages
+uniform float virtualLevels;
+uniform float lodBias;          // for the target being smaller than the screen
+uniform uint textureId;         // which texture, plus one; 0 is the clear value
+
+// the page the VIRTUAL_TEXTURE variant of fragment.glsl would want here:
+// x, y, level and the texture
+out uvec4 FeedbackPage;
+
+void main(void)
+{
+    vec2 texels = TextureCoords * virtualPages * PAGE_TEXELS;
+    vec2 dx = dFdx(texels);
+    vec2 dy = dFdy(texels);
+    float level = clamp(floor(0.5 * log2(max(dot(dx, dx), dot(dy, dy))) + lodBias + 0.5), 0.0, virtualLevels - 1.0);
+    
+    vec2 page = max(floor(TextureCoords * virtualPages * exp2(-level)), vec2(0.0));
+    FeedbackPage = uvec4(uvec2(page), uint(level), textureId);
+}
@@ -1,8 +1,11 @@
 #include "texture.h"
+#include "Profiler.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
 #include <iostream>
 #include <string>
+#include <algorithm>
+#include <cmath>
 
 using namespace std;
 
@@ -35,56 +38,103 @@ MyTexture::MyTexture() : textureID(0), target(0), width(0), height(0)
 	{}
 
 
-bool InitializeTexture(MyTexture* texture, const char* filename, GLenum target)
+TextureImage::TextureImage() : data(nullptr), width(0), height(0), components(0)
+	{}
+
+
+bool DecodeTextureImage(TextureImage* image, const char* filename)
 {
-	int numComponents;
+	PROFILE_SCOPE("DecodeTextureImage");
 	stbi_set_flip_vertically_on_load(true);
-	unsigned char *data = stbi_load(filename, &texture->width, &texture->height, &numComponents, 0);
-	if (data != nullptr)
+	image->data = stbi_load(filename, &image->width, &image->height, &image->components, 0);
+	return image->data != nullptr;
+}
+
+void FreeTextureImage(TextureImage* image)
+{
+	stbi_image_free(image->data);
+	image->data = nullptr;
+}
+
+void SampleTextureImage(const TextureImage& image, float u, float v, float* out, int channels)
+{
+	float x = u*image.width - 0.5f;
+	float y = std::min(std::max(v*image.height - 0.5f, 0.f), float(image.height - 1));
+	int x0 = int(std::floor(x));
+	int y0 = int(y);
+	float fx = x - x0, fy = y - y0;
+	int y1 = std::min(y0 + 1, image.height - 1);
+	x0 = ((x0 % image.width) + image.width) % image.width;
+	int x1 = (x0 + 1) % image.width;
+	for (int c = 0; c < channels; c++) {
+		int source = std::min(c, image.components - 1);
+		auto texel = [&](int tx, int ty) { return float(image.data[(size_t(ty)*image.width + tx)*image.components + source]); };
+		float bottom = texel(x0, y0) + (texel(x1, y0) - texel(x0, y0))*fx;
+		float top = texel(x0, y1) + (texel(x1, y1) - texel(x0, y1))*fx;
+		out[c] = bottom + (top - bottom)*fy;
+	}
+}
+
+bool UploadTexture(MyTexture* texture, const TextureImage& image, GLenum target)
+{
+	PROFILE_SCOPE("UploadTexture");
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);		//Set alignment to be 1
+
+	texture->target = target;
+	texture->width = image.width;
+	texture->height = image.height;
+	glGenTextures(1, &texture->textureID);
+	glBindTexture(texture->target, texture->textureID);
+
+	//Set number of components by format of the texture
+	GLuint format = GL_RGB;
+	switch(image.components)
+	{
+		case 4:
+			format = GL_RGBA;
+			break;
+		case 3:
+			format = GL_RGB;
+			break;
+		case 2:
+			format = GL_RG;
+			break;
+		case 1:
+			format = GL_RED;
+			break;
+		default:
+			cout << "Invalid Texture Format" << endl;
+			break;
+	};
+	//Loads texture data into bound texture
+	glTexImage2D(texture->target, 0, format, texture->width, texture->height, 0, format, GL_UNSIGNED_BYTE, image.data);
+
+	//Modifies behaviour for bound texture
+	// Note: Only wrapping modes supported for GL_TEXTURE_RECTANGLE when defining
+	// GL_TEXTURE_WRAP are GL_CLAMP_TO_EDGE or GL_CLAMP_TO_BORDER
+	glTexParameteri(texture->target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(texture->target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	// Clean up
+	glBindTexture(texture->target, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);	//Return to default alignment
+
+	return !CheckGLErrors("Uploading texture: ");
+}
+
+bool InitializeTexture(MyTexture* texture, const char* filename, GLenum target)
+{
+	PROFILE_SCOPE("InitializeTexture");
+	TextureImage image;
+	if (DecodeTextureImage(&image, filename))
 	{
-		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);		//Set alignment to be 1
-
-		texture->target = target;
-		glGenTextures(1, &texture->textureID);
-		glBindTexture(texture->target, texture->textureID);
-
-		//Set number of components by format of the texture
-		GLuint format = GL_RGB;
-		switch(numComponents)
-		{
-			case 4:
-				format = GL_RGBA;
-				break;
-			case 3:
-				format = GL_RGB;
-				break;
-			case 2:
-				format = GL_RG;
-				break;
-			case 1:
-				format = GL_RED;
-				break;
-			default:
-				cout << "Invalid Texture Format" << endl;
-				break;
-		};
-		//Loads texture data into bound texture
-		glTexImage2D(texture->target, 0, format, texture->width, texture->height, 0, format, GL_UNSIGNED_BYTE, data);
-
-		//Modifies behaviour for bound texture
-		// Note: Only wrapping modes supported for GL_TEXTURE_RECTANGLE when defining
-		// GL_TEXTURE_WRAP are GL_CLAMP_TO_EDGE or GL_CLAMP_TO_BORDER
-		glTexParameteri(texture->target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(texture->target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		// Clean up
-		glBindTexture(texture->target, 0);
-		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);	//Return to default alignment
-		stbi_image_free(data);
-
-		return !CheckGLErrors( (string("Loading texture: ")+filename).c_str() );
+		bool uploaded = UploadTexture(texture, image, target);
+		FreeTextureImage(&image);
+		if (!uploaded)
+			cout << "Loading texture: " << filename << endl;
+		return uploaded;
 	}
 
 	return true; //error
@@ -5,6 +5,9 @@
 // --------------------------------------------------------------------------
 // Functions to set up OpenGL buffers for storing textures
 
+//Prints any pending OpenGL errors after errorLocation; true if there were any
+bool CheckGLErrors(const char* errorLocation);
+
 struct MyTexture
 {
 	GLuint textureID;	//Handle for OpenGL texture object
@@ -16,6 +19,28 @@ struct MyTexture
 	MyTexture();
 };
 
+// Decoded image file, rows bottom-up as OpenGL expects
+struct TextureImage
+{
+	unsigned char* data;	//Owned by stb_image; release with FreeTextureImage
+	int width;
+	int height;
+	int components;
+
+	TextureImage();
+};
+
+//Decoding and uploading are separate so decode can be timed (and run) without
+//a GL context; InitializeTexture does both
+bool DecodeTextureImage(TextureImage* image, const char* filename);
+void FreeTextureImage(TextureImage* image);
+bool UploadTexture(MyTexture* texture, const TextureImage& image, GLenum target = GL_TEXTURE_2D);
+
+//Bilinear sample at texture coordinates u, v of a decoded image, wrapping
+//around in u and clamped in v, as images wrapped around a sphere need;
+//channels beyond the image's repeat its last one
+void SampleTextureImage(const TextureImage& image, float u, float v, float* out, int channels);
+
 //Function to create a texture from an image file
 //Does several things:
 //	Uses stb_image to extract bytes from a file